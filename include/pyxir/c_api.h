@@ -0,0 +1,140 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Plain C API for embedding pyxir runtime modules from C or through the
+ *  foreign function interfaces of other languages. Tensors are described by
+ *  caller-owned memory which is used in place, synchronous execution
+ *  doesn't allocate after the first call with a given number of inputs and
+ *  outputs.
+ */
+
+#ifndef PYXIR_C_API_H_
+#define PYXIR_C_API_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef PX_C_API
+#define PX_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  PX_OK = 0,
+  /** @brief The request is still in flight */
+  PX_PENDING = 1,
+  PX_ERR_INVALID_ARGUMENT = 2,
+  PX_ERR_RUNTIME = 3
+} px_status;
+
+typedef enum {
+  PX_FLOAT32 = 0,
+  PX_INT8 = 1,
+  PX_UINT8 = 2,
+  PX_INT32 = 3
+} px_dtype;
+
+/** @brief A contiguous tensor in caller-owned memory */
+typedef struct {
+  void *data;
+  px_dtype dtype;
+  int32_t ndim;
+  const int64_t *shape;
+} px_tensor;
+
+typedef struct {
+  uint64_t executions;
+  uint64_t failures;
+  uint64_t async_submitted;
+  /** @brief Latency of synchronous executions in microseconds */
+  double mean_latency_us;
+  double max_latency_us;
+} px_metrics;
+
+typedef struct px_module px_module;
+typedef struct px_request px_request;
+
+/** @brief Return the error message of the last failed call on this thread */
+PX_C_API const char *px_last_error(void);
+
+/** @brief Load a runtime module from a serialized runtime module file */
+PX_C_API px_status px_module_load(const char *path, px_module **module);
+
+/** @brief Load a runtime module from a serialized runtime module in memory */
+PX_C_API px_status px_module_load_from_buffer(const char *data, size_t size,
+                                              px_module **module);
+
+PX_C_API void px_module_free(px_module *module);
+
+PX_C_API px_status px_module_num_inputs(px_module *module, size_t *nb_inputs);
+
+PX_C_API px_status px_module_num_outputs(px_module *module, size_t *nb_outputs);
+
+/** @brief Run the given number of synthetic warmup iterations */
+PX_C_API px_status px_module_warmup(px_module *module, int nb_iterations);
+
+/**
+ * @brief Execute the module, results are written into the output tensors.
+ *  Concurrent px_module_execute and px_module_warmup calls on the same
+ *  module are serialized with each other. Whether they run concurrently
+ *  with requests from px_module_submit depends on the module, see
+ *  px_module_submit.
+ */
+PX_C_API px_status px_module_execute(px_module *module,
+                                     const px_tensor *inputs, size_t nb_inputs,
+                                     const px_tensor *outputs, size_t nb_outputs);
+
+/**
+ * @brief Submit the module for asynchronous execution. The tensor
+ *  descriptions are copied but the tensor memory has to stay valid until
+ *  the request is done. The request has to be released with
+ *  px_request_free.
+ *
+ *  Modules that support concurrent requests (e.g. DPU modules on the VART
+ *  runtime) hand the request to the accelerator and return, the request
+ *  then runs concurrently with other requests and px_module_execute calls.
+ *  Other modules, e.g. modules that are still calibrating, execute one
+ *  request at a time: the request is queued behind the requests that are
+ *  still executing and px_module_submit returns without waiting for them.
+ *  A request itself may only be polled, waited on or freed from
+ *  one thread at a time.
+ */
+PX_C_API px_status px_module_submit(px_module *module,
+                                    const px_tensor *inputs, size_t nb_inputs,
+                                    const px_tensor *outputs, size_t nb_outputs,
+                                    px_request **request);
+
+/** @brief Return PX_PENDING while the request is in flight, its status
+    otherwise */
+PX_C_API px_status px_request_poll(px_request *request);
+
+/** @brief Block until the request is done and return its status */
+PX_C_API px_status px_request_wait(px_request *request);
+
+/** @brief Release the request, blocks if it's still in flight */
+PX_C_API void px_request_free(px_request *request);
+
+PX_C_API px_status px_module_get_metrics(px_module *module, px_metrics *metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PYXIR_C_API_H_
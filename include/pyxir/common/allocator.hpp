@@ -0,0 +1,459 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+
+#include "numa.hpp"
+
+namespace pyxir {
+
+/**
+ * @brief Allocator of tensor memory. Buffers created with create_buffer use
+ *  the allocator installed on the calling thread with ScopedAllocator, or
+ *  the heap if there is none.
+ */
+class Allocator {
+
+  public:
+    virtual ~Allocator() {}
+
+    virtual void *allocate(size_t size) = 0;
+
+    /** @brief Release memory returned by allocate with the same size */
+    virtual void deallocate(void *ptr, size_t size) = 0;
+};
+
+typedef std::shared_ptr<Allocator> AllocatorHolder;
+
+/** @brief Allocator using the heap, i.e. operator new and delete */
+class HeapAllocator : public Allocator {
+
+  public:
+    void *allocate(size_t size) override { return ::operator new(size); }
+
+    void deallocate(void *ptr, size_t) override { ::operator delete(ptr); }
+};
+
+/**
+ * @brief Allocator placing memory on a NUMA node. Large allocations are
+ *  mapped separately and bound to the node, small allocations come from the
+ *  heap and are placed by the first touch of the (bound) calling thread.
+ */
+class NumaAllocator : public Allocator {
+
+  public:
+    /**
+     * @param node The NUMA node
+     * @param min_bind_size The minimum allocation size in bytes that is
+     *  mapped and bound to the node
+     */
+    explicit NumaAllocator(int node, size_t min_bind_size = 256 * 1024)
+      : node_(node), min_bind_size_(min_bind_size) {}
+
+    void *allocate(size_t size) override
+    {
+      if (size < min_bind_size_)
+        return ::operator new(size);
+      void *ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (ptr == MAP_FAILED)
+        throw std::bad_alloc();
+      numa::bind_memory(ptr, size, node_);
+      return ptr;
+    }
+
+    void deallocate(void *ptr, size_t size) override
+    {
+      if (size < min_bind_size_)
+        ::operator delete(ptr);
+      else
+        ::munmap(ptr, size);
+    }
+
+    int get_node() const { return node_; }
+
+  private:
+    int node_;
+    size_t min_bind_size_;
+};
+
+/** @brief Live and peak byte counts shared by TrackingAllocators */
+struct AllocationCounter {
+  std::atomic<size_t> live{0};
+  std::atomic<size_t> peak{0};
+
+  void add(size_t size)
+  {
+    size_t now = live.fetch_add(size) + size;
+    size_t prev = peak.load();
+    while (now > prev && !peak.compare_exchange_weak(prev, now)) {}
+  }
+
+  void remove(size_t size) { live.fetch_sub(size); }
+
+  /** @brief Restart peak tracking from the current live bytes */
+  void reset_peak() { peak = live.load(); }
+};
+
+/** @brief Allocator counting the live and peak bytes allocated through
+    another allocator, e.g. to account the memory of a runtime module */
+class TrackingAllocator : public Allocator {
+
+  public:
+    /**
+     * @param counter The counter to update
+     * @param inner The allocator serving the allocations, null for the heap
+     */
+    TrackingAllocator(const std::shared_ptr<AllocationCounter> &counter,
+                      const AllocatorHolder &inner = AllocatorHolder())
+      : counter_(counter), inner_(inner) {}
+
+    void *allocate(size_t size) override
+    {
+      void *ptr = inner_ ? inner_->allocate(size) : ::operator new(size);
+      counter_->add(size);
+      return ptr;
+    }
+
+    void deallocate(void *ptr, size_t size) override
+    {
+      counter_->remove(size);
+      if (inner_)
+        inner_->deallocate(ptr, size);
+      else
+        ::operator delete(ptr);
+    }
+
+    const AllocatorHolder &get_inner() const { return inner_; }
+
+  private:
+    std::shared_ptr<AllocationCounter> counter_;
+    AllocatorHolder inner_;
+};
+
+/** @brief How the HugePageAllocator backs large allocations */
+enum class HugePageMode {
+  /** @brief Regular pages */
+  NONE,
+  /** @brief 2MB aligned mappings advised for transparent huge pages */
+  TRANSPARENT,
+  /** @brief Pages from the explicitly reserved huge page pool (hugetlbfs),
+      falling back to transparent huge pages if the pool is exhausted */
+  EXPLICIT
+};
+
+/** @brief Parse "transparent" or "explicit", anything else disables huge pages */
+inline HugePageMode parse_huge_page_mode(const std::string &mode)
+{
+  if (mode == "transparent" || mode == "thp" || mode == "1")
+    return HugePageMode::TRANSPARENT;
+  if (mode == "explicit" || mode == "hugetlb" || mode == "2")
+    return HugePageMode::EXPLICIT;
+  return HugePageMode::NONE;
+}
+
+/** @brief Huge page coverage of the memory handed out by a HugePageAllocator */
+struct HugePageStats {
+  /** @brief Live bytes requested by callers */
+  size_t requested_bytes = 0;
+  /** @brief Live bytes backed by explicitly reserved huge pages */
+  size_t explicit_bytes = 0;
+  /** @brief Live bytes in mappings advised for transparent huge pages, see
+      get_transparent_huge_bytes for the part the kernel actually backs */
+  size_t transparent_bytes = 0;
+  /** @brief Live bytes on regular pages, small allocations and fallbacks */
+  size_t fallback_bytes = 0;
+  /** @brief Freed mappings kept for reuse */
+  size_t cached_bytes = 0;
+  /** @brief Allocations served from the cached mappings */
+  size_t cache_hits = 0;
+
+  /** @brief The fraction of live bytes in huge page backed mappings */
+  double coverage() const
+  {
+    size_t total = explicit_bytes + transparent_bytes + fallback_bytes;
+    return total > 0 ? (double) (explicit_bytes + transparent_bytes) / total : 0.;
+  }
+};
+
+/**
+ * @brief Return the bytes of the mappings overlapping [ptr, ptr + size)
+ *  that the kernel backs with transparent huge pages
+ */
+inline size_t get_transparent_huge_bytes(const void *ptr, size_t size)
+{
+  std::ifstream smaps("/proc/self/smaps");
+  const uintptr_t begin = (uintptr_t) ptr, end = begin + size;
+  bool overlaps = false;
+  size_t res = 0;
+  std::string line;
+  while (std::getline(smaps, line)) {
+    size_t dash = line.find('-');
+    if (dash != std::string::npos && dash < line.find(' ')) {
+      uintptr_t map_begin = std::stoull(line.substr(0, dash), nullptr, 16);
+      uintptr_t map_end = std::stoull(line.substr(dash + 1), nullptr, 16);
+      overlaps = map_begin < end && begin < map_end;
+    } else if (overlaps && line.compare(0, 14, "AnonHugePages:") == 0) {
+      res += std::stoull(line.substr(14)) * 1024;
+    }
+  }
+  return res;
+}
+
+/**
+ * @brief Allocator backing large allocations (weight stores, activation
+ *  buffers) with 2MB huge pages to reduce TLB misses. Allocations fall back
+ *  to transparent huge pages and then to regular pages if huge pages aren't
+ *  available. Freed mappings are cached for reuse by later requests, so
+ *  per request activation buffers don't pay for mapping and faulting pages.
+ */
+class HugePageAllocator : public Allocator {
+
+  public:
+    static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /**
+     * @param mode The huge page mode
+     * @param node The NUMA node to bind the mappings to, -1 for none
+     * @param min_size The minimum allocation size in bytes that is backed by
+     *  huge pages, smaller allocations come from the heap
+     * @param max_cached_bytes The maximum size of the freed mappings kept
+     *  for reuse
+     */
+    explicit HugePageAllocator(HugePageMode mode = HugePageMode::TRANSPARENT,
+                               int node = -1,
+                               size_t min_size = 256 * 1024,
+                               size_t max_cached_bytes = 256 * 1024 * 1024)
+      : mode_(mode), node_(node), min_size_(min_size),
+        max_cached_bytes_(max_cached_bytes) {}
+
+    ~HugePageAllocator()
+    {
+      for (auto &it : cache_)
+        ::munmap(it.second.addr, it.second.mapped);
+    }
+
+    void *allocate(size_t size) override
+    {
+      if (mode_ == HugePageMode::NONE || size < min_size_) {
+        void *ptr = ::operator new(size);
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats_.requested_bytes += size;
+        stats_.fallback_bytes += size;
+        return ptr;
+      }
+
+      const size_t mapped = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+      Mapping m;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = cache_.find(mapped);
+        if (it != cache_.end()) {
+          m = it->second;
+          cache_.erase(it);
+          stats_.cached_bytes -= mapped;
+          ++stats_.cache_hits;
+        }
+      }
+      if (!m.addr)
+        m = map(mapped);
+
+      std::lock_guard<std::mutex> lock(mtx_);
+      live_[m.addr] = m;
+      stats_.requested_bytes += size;
+      bytes(m.kind) += mapped;
+      return m.addr;
+    }
+
+    void deallocate(void *ptr, size_t size) override
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      stats_.requested_bytes -= size;
+      auto it = live_.find(ptr);
+      if (it == live_.end()) {
+        stats_.fallback_bytes -= size;
+        lock.unlock();
+        ::operator delete(ptr);
+        return;
+      }
+      Mapping m = it->second;
+      live_.erase(it);
+      bytes(m.kind) -= m.mapped;
+      if (stats_.cached_bytes + m.mapped <= max_cached_bytes_) {
+        cache_.insert(std::make_pair(m.mapped, m));
+        stats_.cached_bytes += m.mapped;
+        return;
+      }
+      lock.unlock();
+      ::munmap(m.addr, m.mapped);
+    }
+
+    /** @brief Release the cached mappings */
+    void trim()
+    {
+      std::multimap<size_t, Mapping> cache;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::swap(cache, cache_);
+        stats_.cached_bytes = 0;
+      }
+      for (auto &it : cache)
+        ::munmap(it.second.addr, it.second.mapped);
+    }
+
+    HugePageStats get_stats()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return stats_;
+    }
+
+    HugePageMode get_mode() const { return mode_; }
+
+    /** @brief Change the maximum size of the cached mappings, releasing
+        cached mappings above it */
+    void set_max_cached_bytes(size_t max_cached_bytes)
+    {
+      std::vector<Mapping> released;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        max_cached_bytes_ = max_cached_bytes;
+        while (stats_.cached_bytes > max_cached_bytes_) {
+          auto it = std::prev(cache_.end());
+          released.push_back(it->second);
+          stats_.cached_bytes -= it->second.mapped;
+          cache_.erase(it);
+        }
+      }
+      for (const Mapping &m : released)
+        ::munmap(m.addr, m.mapped);
+    }
+
+  private:
+    struct Mapping {
+      void *addr = nullptr;
+      size_t mapped = 0;
+      HugePageMode kind = HugePageMode::NONE;
+    };
+
+    size_t &bytes(HugePageMode kind)
+    {
+      if (kind == HugePageMode::EXPLICIT)
+        return stats_.explicit_bytes;
+      if (kind == HugePageMode::TRANSPARENT)
+        return stats_.transparent_bytes;
+      return stats_.fallback_bytes;
+    }
+
+    /** @brief Map size bytes (a multiple of the huge page size), trying the
+        requested mode first */
+    Mapping map(size_t size)
+    {
+      Mapping m;
+      m.mapped = size;
+#ifdef MAP_HUGETLB
+      if (mode_ == HugePageMode::EXPLICIT) {
+        void *addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) {
+          m.addr = addr;
+          m.kind = HugePageMode::EXPLICIT;
+          bind(m);
+          return m;
+        }
+      }
+#endif
+      // Over-allocate to align the mapping on a huge page boundary
+      char *addr = (char *) ::mmap(nullptr, size + HUGE_PAGE_SIZE,
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (addr == MAP_FAILED)
+        throw std::bad_alloc();
+      char *aligned = (char *) (((uintptr_t) addr + HUGE_PAGE_SIZE - 1)
+                                & ~(uintptr_t) (HUGE_PAGE_SIZE - 1));
+      if (aligned > addr)
+        ::munmap(addr, aligned - addr);
+      if (aligned + size < addr + size + HUGE_PAGE_SIZE)
+        ::munmap(aligned + size, addr + size + HUGE_PAGE_SIZE - (aligned + size));
+      m.addr = aligned;
+      m.kind = HugePageMode::NONE;
+#ifdef MADV_HUGEPAGE
+      if (::madvise(aligned, size, MADV_HUGEPAGE) == 0)
+        m.kind = HugePageMode::TRANSPARENT;
+#endif
+      bind(m);
+      return m;
+    }
+
+    void bind(const Mapping &m)
+    {
+      if (node_ >= 0)
+        numa::bind_memory(m.addr, m.mapped, node_);
+    }
+
+    HugePageMode mode_;
+    int node_;
+    size_t min_size_;
+    size_t max_cached_bytes_;
+    std::mutex mtx_;
+    /** @brief The live mappings */
+    std::unordered_map<void *, Mapping> live_;
+    /** @brief The freed mappings by size */
+    std::multimap<size_t, Mapping> cache_;
+    HugePageStats stats_;
+};
+
+/** @brief The allocator of the calling thread, null for the heap */
+inline AllocatorHolder &thread_allocator()
+{
+  static thread_local AllocatorHolder allocator;
+  return allocator;
+}
+
+/** @brief Install an allocator on the calling thread for the lifetime of
+    this object */
+class ScopedAllocator {
+
+  public:
+    explicit ScopedAllocator(const AllocatorHolder &allocator)
+      : prev_(thread_allocator())
+    {
+      thread_allocator() = allocator;
+    }
+
+    ~ScopedAllocator() { thread_allocator() = prev_; }
+
+    ScopedAllocator(const ScopedAllocator &) = delete;
+    ScopedAllocator &operator=(const ScopedAllocator &) = delete;
+
+  private:
+    AllocatorHolder prev_;
+};
+
+} // namespace pyxir
@@ -0,0 +1,120 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <cerrno>
+#include <streambuf>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace pyxir {
+
+/**
+ * @brief Read-only memory mapping of a file. Keeping a file mapped allows
+ *  re-reading it (e.g. reloading a runtime module) from the page cache
+ *  without going through read system calls and intermediate buffers.
+ */
+class MappedFile {
+
+  public:
+    explicit MappedFile(const std::string &path) : path_(path)
+    {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+        throw std::runtime_error("MappedFile: can't open " + path + ": "
+                                 + std::strerror(errno));
+      struct stat st;
+      if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("MappedFile: can't stat " + path + ": "
+                                 + std::strerror(errno));
+      }
+      size_ = (size_t) st.st_size;
+      if (size_ > 0) {
+        void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+          ::close(fd);
+          throw std::runtime_error("MappedFile: can't map " + path + ": "
+                                   + std::strerror(errno));
+        }
+        data_ = (const char *) addr;
+        ::madvise(addr, size_, MADV_WILLNEED);
+      }
+      // The mapping stays valid after closing the descriptor
+      ::close(fd);
+    }
+
+    ~MappedFile()
+    {
+      if (data_)
+        ::munmap((void *) data_, size_);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    const std::string &path() const { return path_; }
+
+  private:
+    std::string path_;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/**
+ * @brief Read-only stream buffer over memory owned by someone else, e.g. a
+ *  MappedFile, so that streams can read it without copying it first
+ */
+class MemoryStreamBuf : public std::streambuf {
+
+  public:
+    MemoryStreamBuf(const char *data, size_t size)
+    {
+      char *begin = const_cast<char *>(data);
+      setg(begin, begin, begin + size);
+    }
+
+  protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which) override
+    {
+      if (!(which & std::ios_base::in))
+        return pos_type(off_type(-1));
+      char *base = dir == std::ios_base::beg ? eback()
+        : (dir == std::ios_base::cur ? gptr() : egptr());
+      if (off < eback() - base || off > egptr() - base)
+        return pos_type(off_type(-1));
+      setg(eback(), base + off, egptr());
+      return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+      return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+} // pyxir
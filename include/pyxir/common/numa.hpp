@@ -0,0 +1,184 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace pyxir {
+namespace numa {
+
+// Memory policy constants of the Linux mbind system call, see mbind(2)
+const int MPOL_PREFERRED_ = 1;
+const unsigned MPOL_MF_MOVE_ = 1u << 1;
+
+/** @brief Parse a sysfs cpu or node list, e.g. "0-3,8-11" */
+inline std::vector<int> parse_list(const std::string &list)
+{
+  std::vector<int> res;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty() || range == "\n")
+      continue;
+    size_t dash = range.find('-');
+    int first = std::atoi(range.substr(0, dash).c_str());
+    int last = dash == std::string::npos ? first
+                                         : std::atoi(range.substr(dash + 1).c_str());
+    for (int i = first; i <= last; ++i)
+      res.push_back(i);
+  }
+  return res;
+}
+
+inline std::string read_sysfs(const std::string &path)
+{
+  std::ifstream in(path);
+  std::string res;
+  std::getline(in, res);
+  return res;
+}
+
+/** @brief Return the online NUMA nodes, a single node 0 if the system doesn't
+    expose its NUMA topology */
+inline std::vector<int> get_nodes()
+{
+  std::vector<int> nodes = parse_list(read_sysfs("/sys/devices/system/node/online"));
+  if (nodes.empty())
+    nodes.push_back(0);
+  return nodes;
+}
+
+inline int nb_nodes() { return (int) get_nodes().size(); }
+
+/** @brief Return the CPUs of the node, empty if unknown */
+inline std::vector<int> get_node_cpus(int node)
+{
+  return parse_list(read_sysfs("/sys/devices/system/node/node"
+                               + std::to_string(node) + "/cpulist"));
+}
+
+/** @brief Return the node of the CPU the calling thread runs on, 0 if unknown */
+inline int get_current_node()
+{
+  unsigned cpu = 0, node = 0;
+  if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    return 0;
+  return (int) node;
+}
+
+/** @brief Restrict the calling thread to the CPUs of the node, returns
+    whether the thread was bound */
+inline bool bind_thread(int node)
+{
+  std::vector<int> cpus = get_node_cpus(node);
+  if (cpus.empty())
+    return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+/**
+ * @brief Prefer the node for the pages that lie entirely within
+ *  [ptr, ptr + size). Pages that are faulted in afterwards are placed on the
+ *  node if it has free memory, already touched pages are migrated if move is
+ *  set. Returns false if the kernel doesn't support memory policies.
+ */
+inline bool bind_memory(void *ptr, size_t size, int node, bool move = false)
+{
+  static const uintptr_t page_size = (uintptr_t) sysconf(_SC_PAGESIZE);
+  uintptr_t begin = ((uintptr_t) ptr + page_size - 1) & ~(page_size - 1);
+  uintptr_t end = ((uintptr_t) ptr + size) & ~(page_size - 1);
+  if (node < 0 || end <= begin)
+    return false;
+  const size_t nb_bits = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> mask(node / nb_bits + 1, 0);
+  mask[node / nb_bits] |= 1ul << (node % nb_bits);
+  return ::syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED_, &mask[0],
+                   mask.size() * nb_bits + 1, move ? MPOL_MF_MOVE_ : 0) == 0;
+}
+
+/** @brief Placement of the pages of a memory region relative to a node */
+struct PageLocality {
+  /** @brief Pages on the node */
+  size_t local = 0;
+  /** @brief Pages on other nodes */
+  size_t remote = 0;
+  /** @brief Pages that weren't faulted in yet or couldn't be queried */
+  size_t absent = 0;
+
+  double local_fraction() const
+  {
+    return local + remote > 0 ? (double) local / (local + remote) : 1.;
+  }
+
+  PageLocality &operator+=(const PageLocality &other)
+  {
+    local += other.local;
+    remote += other.remote;
+    absent += other.absent;
+    return *this;
+  }
+};
+
+/** @brief Return where the pages of [ptr, ptr + size) reside relative to the
+    node, e.g. to report local versus remote memory access in benchmarks */
+inline PageLocality get_page_locality(const void *ptr, size_t size, int node)
+{
+  static const uintptr_t page_size = (uintptr_t) sysconf(_SC_PAGESIZE);
+  PageLocality res;
+  uintptr_t begin = (uintptr_t) ptr & ~(page_size - 1);
+  uintptr_t end = (uintptr_t) ptr + size;
+  const size_t CHUNK = 1024;
+  std::vector<void *> pages;
+  std::vector<int> status;
+  for (uintptr_t addr = begin; addr < end; ) {
+    pages.clear();
+    for (; addr < end && pages.size() < CHUNK; addr += page_size)
+      pages.push_back((void *) addr);
+    status.assign(pages.size(), -1);
+    if (::syscall(SYS_move_pages, 0, pages.size(), &pages[0], nullptr,
+                  &status[0], 0) != 0) {
+      res.absent += pages.size();
+      continue;
+    }
+    for (int s : status) {
+      if (s < 0)
+        ++res.absent;
+      else if (s == node)
+        ++res.local;
+      else
+        ++res.remote;
+    }
+  }
+  return res;
+}
+
+} // namespace numa
+} // namespace pyxir
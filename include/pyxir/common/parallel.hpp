@@ -0,0 +1,188 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include <sys/types.h>
+
+namespace pyxir {
+
+/**
+ * @brief Return the number of threads to be used by parallel CPU kernels. This
+ *  defaults to the hardware concurrency and can be overridden with the
+ *  PX_NUM_THREADS environment variable. The environment is only read once.
+ */
+inline int get_num_threads()
+{
+  static const int num_threads = []() {
+    const char *env_num_threads = std::getenv("PX_NUM_THREADS");
+    if (env_num_threads != NULL && std::atoi(env_num_threads) > 0)
+      return std::atoi(env_num_threads);
+    int hw_threads = (int) std::thread::hardware_concurrency();
+    return hw_threads > 0 ? hw_threads : 1;
+  }();
+  return num_threads;
+}
+
+/**
+ * @brief Process wide pool of persistent worker threads used by parallel_for.
+ *  The pool holds get_num_threads() - 1 workers as the calling thread always
+ *  takes part in the work.
+ */
+class ThreadPool {
+
+  public:
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    static ThreadPool &Get()
+    {
+      static ThreadPool pool(get_num_threads() - 1);
+      return pool;
+    }
+
+    /** @brief Whether the current thread is one of the pool workers */
+    static bool &is_worker()
+    {
+      static thread_local bool worker = false;
+      return worker;
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    void enqueue(std::function<void()> task)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        tasks_.push_back(std::move(task));
+      }
+      cv_.notify_one();
+    }
+
+    ~ThreadPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      for (auto &w : workers_)
+        w.join();
+    }
+
+  private:
+    explicit ThreadPool(int nb_workers)
+    {
+      for (int i = 0; i < nb_workers; ++i)
+        workers_.emplace_back([this]() { work(); });
+    }
+
+    void work()
+    {
+      is_worker() = true;
+      while (true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mtx_);
+          cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+          if (tasks_.empty())
+            return;
+          task = std::move(tasks_.front());
+          tasks_.pop_front();
+        }
+        task();
+      }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+/**
+ * @brief Execute func(begin, end) on the range [0, size), split into
+ *  contiguous chunks of at least `grain` elements that run on the persistent
+ *  thread pool. Small ranges and nested calls from inside a pool worker are
+ *  executed inline on the calling thread.
+ * @param size The size of the iteration range
+ * @param grain The minimum number of elements to be handled by one thread
+ * @param func The function to be called as func(begin, end)
+ */
+template <typename Func>
+inline void parallel_for(ssize_t size, ssize_t grain, Func func)
+{
+  if (size <= 0)
+    return;
+  grain = std::max<ssize_t>(grain, 1);
+  ssize_t nb_chunks = std::min<ssize_t>(get_num_threads(),
+                                        (size + grain - 1) / grain);
+  if (nb_chunks <= 1 || ThreadPool::is_worker()) {
+    func((ssize_t) 0, size);
+    return;
+  }
+
+  ssize_t chunk_size = (size + nb_chunks - 1) / nb_chunks;
+  // Rounding up the chunk size can leave trailing chunks empty
+  nb_chunks = (size + chunk_size - 1) / chunk_size;
+  std::vector<std::exception_ptr> errors(nb_chunks);
+  std::mutex mtx;
+  std::condition_variable done_cv;
+  // Set before enqueueing as workers may already finish their chunk while
+  //  the remaining ones are being enqueued
+  ssize_t pending = nb_chunks - 1;
+  ThreadPool &pool = ThreadPool::Get();
+  for (ssize_t c = 1; c < nb_chunks; ++c) {
+    ssize_t begin = c * chunk_size;
+    ssize_t end = std::min(size, begin + chunk_size);
+    pool.enqueue([&func, &errors, &mtx, &done_cv, &pending, c, begin, end]() {
+      try {
+        func(begin, end);
+      } catch (...) {
+        errors[c] = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(mtx);
+      if (--pending == 0)
+        done_cv.notify_one();
+    });
+  }
+  // The calling thread handles the first chunk
+  try {
+    func((ssize_t) 0, std::min(size, chunk_size));
+  } catch (...) {
+    errors[0] = std::current_exception();
+  }
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [&pending]() { return pending == 0; });
+  }
+  for (auto &e : errors)
+    if (e)
+      std::rethrow_exception(e);
+}
+
+} // pyxir
@@ -0,0 +1,161 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace pyxir {
+
+/**
+ * @brief Shared memory segment backed by a file in /dev/shm which can be
+ *  mapped by other processes on the same machine. The backing file can be
+ *  unlinked as soon as all processes mapped the segment.
+ */
+class SharedMemory {
+
+  public:
+    /** @brief Create and map a new shared memory segment of the given size */
+    static std::unique_ptr<SharedMemory> Create(size_t size)
+    {
+      std::string path = Prefix() + "XXXXXX";
+      std::vector<char> path_buf(path.begin(), path.end());
+      path_buf.push_back('\0');
+      int fd = ::mkstemp(path_buf.data());
+      if (fd < 0)
+        throw std::runtime_error("SharedMemory: can't create segment: "
+                                 + std::string(std::strerror(errno)));
+      path = path_buf.data();
+      if (::ftruncate(fd, (off_t) size) != 0) {
+        int err = errno;
+        ::close(fd);
+        ::unlink(path.c_str());
+        throw std::runtime_error("SharedMemory: can't resize segment: "
+                                 + std::string(std::strerror(err)));
+      }
+      return std::unique_ptr<SharedMemory>(new SharedMemory(path, fd, size, true));
+    }
+
+    /** @brief The path prefix of the backing files of created segments */
+    static std::string Prefix()
+    {
+      static const std::string prefix =
+        std::string(access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp")
+        + "/pyxir-shm-";
+      return prefix;
+    }
+
+    /** @brief Whether the path names a segment created by Create */
+    static bool IsSegmentPath(const std::string &path)
+    {
+      std::string prefix = Prefix();
+      return path.size() > prefix.size()
+        && path.compare(0, prefix.size(), prefix) == 0
+        && path.find('/', prefix.size()) == std::string::npos;
+    }
+
+    /**
+     * @brief Map an existing shared memory segment. Only regular files
+     *  created by Create can be opened, so paths received from other
+     *  processes can't be used to map arbitrary files.
+     */
+    static std::unique_ptr<SharedMemory> Open(const std::string &path)
+    {
+      if (!IsSegmentPath(path))
+        throw std::invalid_argument("SharedMemory: " + path + " is not a"
+                                    " shared memory segment");
+      int fd = ::open(path.c_str(), O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+      if (fd < 0)
+        throw std::runtime_error("SharedMemory: can't open " + path + ": "
+                                 + std::strerror(errno));
+      struct stat st;
+      if (::fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error("SharedMemory: can't stat " + path + ": "
+                                 + std::strerror(err));
+      }
+      if (!S_ISREG(st.st_mode)) {
+        ::close(fd);
+        throw std::invalid_argument("SharedMemory: " + path + " is not a"
+                                    " regular file");
+      }
+      return std::unique_ptr<SharedMemory>(
+        new SharedMemory(path, fd, (size_t) st.st_size, false));
+    }
+
+    ~SharedMemory()
+    {
+      if (data_)
+        ::munmap(data_, size_);
+      if (owner_)
+        unlink();
+    }
+
+    SharedMemory(const SharedMemory &) = delete;
+    SharedMemory &operator=(const SharedMemory &) = delete;
+
+    /** @brief Remove the backing file, existing mappings stay valid */
+    void unlink()
+    {
+      if (!path_.empty())
+        ::unlink(path_.c_str());
+      owner_ = false;
+    }
+
+    char *data() { return data_; }
+
+    size_t size() const { return size_; }
+
+    const std::string &path() const { return path_; }
+
+  private:
+    SharedMemory(const std::string &path, int fd, size_t size, bool owner)
+      : path_(path), size_(size), owner_(owner)
+    {
+      if (size_ > 0) {
+        void *addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            fd, 0);
+        if (addr == MAP_FAILED) {
+          int err = errno;
+          ::close(fd);
+          if (owner_)
+            ::unlink(path_.c_str());
+          throw std::runtime_error("SharedMemory: can't map " + path_ + ": "
+                                   + std::strerror(err));
+        }
+        data_ = (char *) addr;
+      }
+      ::close(fd);
+    }
+
+    std::string path_;
+    char *data_ = nullptr;
+    size_t size_ = 0;
+    bool owner_;
+};
+
+} // pyxir
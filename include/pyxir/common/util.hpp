@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <regex>
@@ -71,4 +73,30 @@ inline void rmrf(const std::string &path)
   }
 }
 
+inline size_t &dir_size_acc()
+{
+  static thread_local size_t acc = 0;
+  return acc;
+}
+
+inline int dir_size_cb(const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+  (void) fpath;
+  (void) ftwbuf;
+  if (typeflag == FTW_F)
+    dir_size_acc() += (size_t) sb->st_size;
+  return 0;
+}
+
+/** @brief Return the total size in bytes of the regular files in the
+    directory tree, 0 if it doesn't exist */
+inline size_t get_dir_size(const std::string &path)
+{
+  if (!is_dir(path))
+    return 0;
+  dir_size_acc() = 0;
+  nftw(path.c_str(), dir_size_cb, 64, FTW_PHYS);
+  return dir_size_acc();
+}
+
 } // pyxir
@@ -18,13 +18,81 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <sys/types.h>
 
+#include "allocator.hpp"
+
 namespace pyxir {
 
+/**
+ * @brief Copy between two (possibly non-contiguous) strided arrays with the
+ *  same shape. Trailing dimensions that are laid out contiguously in both
+ *  source and destination are copied with a single memcpy
+ * @param src Pointer to the first element of the source array
+ * @param src_strides The source strides in bytes, may be negative
+ * @param dst Pointer to the first element of the destination array
+ * @param dst_strides The destination strides in bytes, may be negative
+ * @param shape The array shape
+ * @param itemsize The size of one element in bytes
+ */
+inline void copy_strided(const void *src, const std::vector<ssize_t> &src_strides,
+                         void *dst, const std::vector<ssize_t> &dst_strides,
+                         const std::vector<ssize_t> &shape, ssize_t itemsize)
+{
+  // Find the number of trailing dimensions that can be copied in one block
+  ssize_t block = itemsize;
+  ssize_t outer = (ssize_t) shape.size();
+  while (outer > 0 && src_strides[outer - 1] == block
+         && dst_strides[outer - 1] == block) {
+    block *= shape[outer - 1];
+    --outer;
+  }
+  ssize_t nb_blocks = 1;
+  for (ssize_t i = 0; i < outer; ++i)
+    nb_blocks *= shape[i];
+  if (nb_blocks == 0 || block == 0)
+    return;
+
+  std::vector<ssize_t> idx(outer, 0);
+  const char *src_c = (const char *) src;
+  char *dst_c = (char *) dst;
+  ssize_t src_offset = 0, dst_offset = 0;
+  for (ssize_t b = 0; b < nb_blocks; ++b) {
+    memcpy(dst_c + dst_offset, src_c + src_offset, block);
+    // Increment the multi-dimensional index and offsets
+    for (ssize_t i = outer - 1; i >= 0; --i) {
+      src_offset += src_strides[i];
+      dst_offset += dst_strides[i];
+      if (++idx[i] < shape[i])
+        break;
+      src_offset -= shape[i] * src_strides[i];
+      dst_offset -= shape[i] * dst_strides[i];
+      idx[i] = 0;
+    }
+  }
+}
+
+/**
+ * @brief Pack a (possibly non-contiguous) strided array into a contiguous
+ *  destination buffer
+ */
+inline void copy_strided(const void *src, const std::vector<ssize_t> &shape,
+                         const std::vector<ssize_t> &strides,
+                         ssize_t itemsize, void *dst)
+{
+  std::vector<ssize_t> dst_strides(shape.size());
+  ssize_t stride = itemsize;
+  for (ssize_t i = (ssize_t) shape.size() - 1; i >= 0; --i) {
+    dst_strides[i] = stride;
+    stride *= shape[i];
+  }
+  copy_strided(src, strides, dst, dst_strides, shape, itemsize);
+}
+
 struct XBuffer {
 
   void* data;
@@ -36,6 +104,9 @@ struct XBuffer {
 
   ssize_t size;
   bool own_data;
+  // Optional owner of externally allocated data (e.g. a Python object or
+  //  DLPack tensor) that has to be kept alive as long as this buffer
+  std::shared_ptr<void> base;
 
   XBuffer(const XBuffer &xb)
       : itemsize(xb.itemsize), format(xb.format), ndim(xb.ndim),
@@ -44,13 +115,18 @@ struct XBuffer {
     // data = xb.data;
     // xb.own_data = false;
     data = ::operator new(size * itemsize);
-    memcpy(data, xb.data, size * itemsize);
+    if (xb.is_contiguous()) {
+      memcpy(data, xb.data, size * itemsize);
+    } else {
+      copy_strided(xb.data, shape, xb.strides, itemsize, data);
+      strides = contiguous_strides(shape, itemsize);
+    }
   }
 
   XBuffer(XBuffer &&xb)
       : itemsize(xb.itemsize), format(xb.format), ndim(xb.ndim),
         shape(xb.shape), strides(xb.strides), size(xb.size),
-        own_data(xb.own_data) {
+        own_data(xb.own_data), base(std::move(xb.base)) {
     // If xb owns the data that is being moved, then we transfer ownership
     //  to this object
     if (xb.own_data)
@@ -74,7 +150,13 @@ struct XBuffer {
 
     if (copy) {
       data = ::operator new(size * itemsize);
-      memcpy(data, data_, size * itemsize);
+      if (is_contiguous()) {
+        memcpy(data, data_, size * itemsize);
+      } else {
+        // Repack strided input into a contiguous buffer
+        copy_strided(data_, shape, strides, itemsize, data);
+        strides = contiguous_strides(shape, itemsize);
+      }
     } else {
       data = data_;
     }
@@ -93,13 +175,7 @@ struct XBuffer {
     if (size < 0)
       size *= -1;
 
-    ssize_t nxt_stride = (size > 0) ? size * itemsize : itemsize;
-    strides.push_back(nxt_stride / shape[0]);
-    nxt_stride /= shape[0];
-    for (ssize_t i = 1; i < (ssize_t) ndim; ++i) {
-      nxt_stride /= shape[i];
-      strides.push_back(nxt_stride);
-    }
+    strides = contiguous_strides(shape, itemsize);
 
     if (copy) {
       data = ::operator new(size * itemsize);
@@ -122,8 +198,14 @@ struct XBuffer {
     strides = xb.strides;
     size = xb.size;
     own_data = true;
+    base.reset();
     data = ::operator new(size *itemsize);
-    memcpy(data, xb.data, size * itemsize);
+    if (xb.is_contiguous()) {
+      memcpy(data, xb.data, size * itemsize);
+    } else {
+      copy_strided(xb.data, shape, xb.strides, itemsize, data);
+      strides = contiguous_strides(shape, itemsize);
+    }
     return *this;
   }
 
@@ -140,6 +222,7 @@ struct XBuffer {
     strides = xb.strides;
     size = xb.size;
     own_data = xb.own_data;
+    base = std::move(xb.base);
     // If xb owns the data that is being moved, then we transfer ownership
     //  to this object
     if (xb.own_data)
@@ -148,6 +231,34 @@ struct XBuffer {
     return *this;
   }
 
+  /** @brief Return the row-major contiguous strides for the given shape */
+  static std::vector<ssize_t> contiguous_strides(const std::vector<ssize_t> &shape,
+                                                 ssize_t itemsize)
+  {
+    std::vector<ssize_t> res(shape.size());
+    ssize_t stride = itemsize;
+    for (ssize_t i = (ssize_t) shape.size() - 1; i >= 0; --i) {
+      res[i] = stride;
+      stride *= shape[i];
+    }
+    return res;
+  }
+
+  /**
+   * @brief Whether the buffer data is laid out in row-major contiguous
+   *  order. Strides of dimensions with size 1 are ignored
+   */
+  bool is_contiguous() const
+  {
+    ssize_t stride = itemsize;
+    for (ssize_t i = ndim - 1; i >= 0; --i) {
+      if (shape[i] != 1 && strides[i] != stride)
+        return false;
+      stride *= shape[i];
+    }
+    return true;
+  }
+
   void enable_data_ownership() { own_data = true; }
 
   void disable_data_ownership() { own_data = false; }
@@ -160,7 +271,15 @@ struct XBuffer {
 
 typedef std::shared_ptr<XBuffer> XBufferHolder;
 
-inline XBufferHolder create_buffer(std::vector<ssize_t> &shape)
+/**
+ * @brief Create a new contiguous buffer with the given shape and element type
+ * @param shape The buffer shape
+ * @param itemsize The size of one element in bytes
+ * @param format The Python struct style format descriptor, e.g. "f" or "i"
+ */
+inline XBufferHolder create_buffer(std::vector<ssize_t> &shape,
+                                   ssize_t itemsize,
+                                   const std::string &format)
 {
   int64_t size = 1;
   std::vector<ssize_t> buffer_shape;
@@ -170,9 +289,173 @@ inline XBufferHolder create_buffer(std::vector<ssize_t> &shape)
   }
   if (size < 0)
     size *= -1;
-  void* input_data = malloc(4 * size); 
+  AllocatorHolder allocator = thread_allocator();
+  if (allocator) {
+    // The buffer keeps the allocator alive and releases the data through it
+    size_t nb_bytes = itemsize * size;
+    void *data = allocator->allocate(nb_bytes);
+    XBufferHolder xb(new XBuffer(data, itemsize, format, buffer_shape.size(),
+                                 shape, false, false));
+    xb->base = std::shared_ptr<void>(data, [allocator, nb_bytes](void *p) {
+      allocator->deallocate(p, nb_bytes);
+    });
+    return xb;
+  }
+  // Allocate with operator new as the XBuffer destructor releases owned data
+  //  with operator delete
+  void* input_data = ::operator new(itemsize * size);
   return std::shared_ptr<XBuffer>(
-    new XBuffer(input_data, 4, "f", buffer_shape.size(), shape, false, true));
+    new XBuffer(input_data, itemsize, format, buffer_shape.size(), shape,
+                false, true));
+}
+
+inline XBufferHolder create_buffer(std::vector<ssize_t> &shape)
+{
+  return create_buffer(shape, 4, "f");
+}
+
+/**
+ * @brief Create a non-owning view on the parent buffer that shares its
+ *  storage and keeps it alive
+ */
+inline XBufferHolder create_view(const XBufferHolder &parent, void *data,
+                                 const std::vector<ssize_t> &shape,
+                                 const std::vector<ssize_t> &strides)
+{
+  XBufferHolder view(new XBuffer(data, parent->itemsize, parent->format,
+                                 (ssize_t) shape.size(), shape, strides,
+                                 false, false));
+  view->base = parent;
+  return view;
+}
+
+/**
+ * @brief Return a view on the [begin, end) range of the given axis, e.g.
+ *  a sub-batch when slicing along axis 0
+ */
+inline XBufferHolder slice(const XBufferHolder &xb, ssize_t axis,
+                           ssize_t begin, ssize_t end)
+{
+  if (axis < 0)
+    axis += xb->ndim;
+  if (axis < 0 || axis >= xb->ndim)
+    throw std::invalid_argument("XBuffer: slice axis out of range");
+  end = std::min(end, xb->shape[axis]);
+  if (begin < 0 || begin > end)
+    throw std::invalid_argument("XBuffer: invalid slice range [" +
+                                std::to_string(begin) + ", " +
+                                std::to_string(end) + ")");
+  std::vector<ssize_t> shape(xb->shape);
+  shape[axis] = end - begin;
+  return create_view(xb, (char *) xb->data + begin * xb->strides[axis],
+                     shape, xb->strides);
+}
+
+/**
+ * @brief Return a view on the given index of an axis with that axis
+ *  removed, e.g. a single channel
+ */
+inline XBufferHolder select(const XBufferHolder &xb, ssize_t axis,
+                            ssize_t index)
+{
+  if (axis < 0)
+    axis += xb->ndim;
+  if (axis < 0 || axis >= xb->ndim)
+    throw std::invalid_argument("XBuffer: select axis out of range");
+  if (index < 0 || index >= xb->shape[axis])
+    throw std::invalid_argument("XBuffer: select index out of range");
+  std::vector<ssize_t> shape(xb->shape), strides(xb->strides);
+  shape.erase(shape.begin() + axis);
+  strides.erase(strides.begin() + axis);
+  return create_view(xb, (char *) xb->data + index * xb->strides[axis],
+                     shape, strides);
+}
+
+/**
+ * @brief Return a view with a different shape on the same contiguous
+ *  storage. One dimension can be -1 in which case it is inferred
+ */
+inline XBufferHolder reshape(const XBufferHolder &xb,
+                             std::vector<ssize_t> shape)
+{
+  if (!xb->is_contiguous())
+    throw std::invalid_argument("XBuffer: only contiguous buffers can be"
+                                " reshaped without copying");
+  ssize_t size = 1, infer = -1;
+  for (size_t i = 0; i < shape.size(); ++i) {
+    if (shape[i] == -1 && infer < 0)
+      infer = (ssize_t) i;
+    else
+      size *= shape[i];
+  }
+  if (infer >= 0 && size > 0)
+    shape[infer] = xb->size / size;
+  ssize_t new_size = 1;
+  for (const ssize_t &e : shape)
+    new_size *= e;
+  if (new_size != xb->size)
+    throw std::invalid_argument("XBuffer: can't reshape buffer of size " +
+                                std::to_string(xb->size) + " into size " +
+                                std::to_string(new_size));
+  return create_view(xb, xb->data, shape,
+                     XBuffer::contiguous_strides(shape, xb->itemsize));
+}
+
+/**
+ * @brief Copy the contents of src into dst. Contiguous buffers only need
+ *  matching byte sizes, strided buffers need the same shape and element size
+ */
+inline void copy_buffer(const XBuffer &src, XBuffer &dst)
+{
+  if (src.size * src.itemsize != dst.size * dst.itemsize)
+    throw std::invalid_argument("XBuffer: can't copy buffers with different"
+                                " sizes");
+  if (src.is_contiguous() && dst.is_contiguous()) {
+    memcpy(dst.data, src.data, src.size * src.itemsize);
+  } else {
+    if (src.shape != dst.shape || src.itemsize != dst.itemsize)
+      throw std::invalid_argument("XBuffer: can't copy strided buffers with"
+                                  " different shapes or element sizes");
+    copy_strided(src.data, src.strides, dst.data, dst.strides, src.shape,
+                 src.itemsize);
+  }
+}
+
+/**
+ * @brief Move the data of the buffer into memory from the allocator, e.g. to
+ *  back weights with huge pages. The buffer is packed if it's strided.
+ */
+inline void move_to_allocator(XBuffer &xb, const AllocatorHolder &allocator)
+{
+  size_t nb_bytes = xb.size * xb.itemsize;
+  void *data = allocator->allocate(nb_bytes);
+  if (xb.is_contiguous()) {
+    memcpy(data, xb.data, nb_bytes);
+  } else {
+    copy_strided(xb.data, xb.shape, xb.strides, xb.itemsize, data);
+    xb.strides = XBuffer::contiguous_strides(xb.shape, xb.itemsize);
+  }
+  if (xb.own_data)
+    ::operator delete(xb.data);
+  xb.data = data;
+  xb.own_data = false;
+  xb.base = std::shared_ptr<void>(data, [allocator, nb_bytes](void *p) {
+    allocator->deallocate(p, nb_bytes);
+  });
+}
+
+/**
+ * @brief Return the buffer itself if it's contiguous, otherwise a packed
+ *  contiguous copy
+ */
+inline XBufferHolder ascontiguous(const XBufferHolder &xb)
+{
+  if (xb->is_contiguous())
+    return xb;
+  std::vector<ssize_t> shape(xb->shape);
+  XBufferHolder res = create_buffer(shape, xb->itemsize, xb->format);
+  copy_strided(xb->data, xb->shape, xb->strides, xb->itemsize, res->data);
+  return res;
 }
 
 } // pyxir
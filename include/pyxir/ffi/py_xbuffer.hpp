@@ -16,25 +16,230 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+
 #include <pybind11/pybind11.h>
 #include "../common/xbuffer.hpp"
+#include "dlpack.hpp"
 
 namespace py = pybind11;
 
 namespace pyxir {
 
+/**
+ * @brief Deleter of the handle keeping the owner of wrapped memory alive,
+ *  remembers the wrapped data pointer so that shares_memory can check that
+ *  a buffer still points into it
+ */
+struct ExternalMemoryDeleter {
+	const void *data;
+	std::function<void(void *)> release;
+
+	void operator()(void *p) { release(p); }
+};
+
+/**
+ * @brief Return a shared handle keeping the given Python object, whose
+ *  memory at data is wrapped, alive. The GIL is acquired on release as the
+ *  last reference might be dropped from a runtime thread
+ */
+inline std::shared_ptr<void> keep_alive(py::object obj, const void *data)
+{
+	return std::shared_ptr<void>(new py::object(std::move(obj)),
+		ExternalMemoryDeleter{data, [](void *p) {
+			py::gil_scoped_acquire gil;
+			delete (py::object *) p;
+		}});
+}
+
+/** @brief Whether the buffer wraps the memory of another object */
+inline bool shares_memory(const XBuffer &xb)
+{
+	if (xb.own_data)
+		return false;
+	ExternalMemoryDeleter *d = std::get_deleter<ExternalMemoryDeleter>(xb.base);
+	return d != nullptr && d->data == xb.data;
+}
+
+inline DLDataType format_to_dl_dtype(const std::string &format, ssize_t itemsize)
+{
+	// Strip byte order / alignment prefix
+	char c = format.empty() ? 'f' : format.back();
+	DLDataType dtype;
+	dtype.bits = (uint8_t) (itemsize * 8);
+	dtype.lanes = 1;
+	switch (c) {
+		case 'e': case 'f': case 'd':
+			dtype.code = kDLFloat; break;
+		case 'E':
+			// bfloat16, ml_dtypes descriptor
+			dtype.code = kDLBfloat; break;
+		case 'b': case 'h': case 'i': case 'l': case 'q':
+			dtype.code = kDLInt; break;
+		case 'B': case 'H': case 'I': case 'L': case 'Q':
+			dtype.code = kDLUInt; break;
+		case '?':
+			dtype.code = kDLBool; break;
+		default:
+			throw std::invalid_argument("XBuffer: format `" + format + "` can't be"
+			                            " exported to DLPack");
+	}
+	return dtype;
+}
+
+inline std::string dl_dtype_to_format(const DLDataType &dtype)
+{
+	if (dtype.lanes != 1)
+		throw std::invalid_argument("XBuffer: vectorized DLPack types are not"
+		                            " supported");
+	if (dtype.code == kDLFloat) {
+		if (dtype.bits == 16) return "e";
+		if (dtype.bits == 32) return py::format_descriptor<float>::format();
+		if (dtype.bits == 64) return py::format_descriptor<double>::format();
+	} else if (dtype.code == kDLInt) {
+		if (dtype.bits == 8) return py::format_descriptor<int8_t>::format();
+		if (dtype.bits == 16) return py::format_descriptor<int16_t>::format();
+		if (dtype.bits == 32) return py::format_descriptor<int32_t>::format();
+		if (dtype.bits == 64) return py::format_descriptor<int64_t>::format();
+	} else if (dtype.code == kDLUInt) {
+		if (dtype.bits == 8) return py::format_descriptor<uint8_t>::format();
+		if (dtype.bits == 16) return py::format_descriptor<uint16_t>::format();
+		if (dtype.bits == 32) return py::format_descriptor<uint32_t>::format();
+		if (dtype.bits == 64) return py::format_descriptor<uint64_t>::format();
+	} else if (dtype.code == kDLBfloat && dtype.bits == 16) {
+		return "E";
+	} else if (dtype.code == kDLBool && dtype.bits == 8) {
+		return "?";
+	}
+	throw std::invalid_argument("XBuffer: unsupported DLPack data type with code: "
+	                            + std::to_string(dtype.code) + " and bits: "
+	                            + std::to_string(dtype.bits));
+}
+
+/** @brief Context owning the shape and strides of an exported DLPack tensor */
+struct DLPackExportCtx {
+	XBufferHolder xb;
+	std::vector<int64_t> shape;
+	std::vector<int64_t> strides;
+	DLManagedTensor tensor;
+};
+
+/**
+ * @brief Export the buffer as a DLPack capsule without copying. The capsule
+ *  keeps the buffer alive until the consumer calls the tensor deleter
+ */
+inline py::capsule to_dlpack(XBufferHolder xb)
+{
+	DLPackExportCtx *ctx = new DLPackExportCtx();
+	ctx->xb = xb;
+	for (ssize_t i = 0; i < xb->ndim; ++i) {
+		ctx->shape.push_back(xb->shape[i]);
+		ctx->strides.push_back(xb->strides[i] / xb->itemsize);
+	}
+	DLTensor &t = ctx->tensor.dl_tensor;
+	t.data = xb->data;
+	t.device.device_type = kDLCPU;
+	t.device.device_id = 0;
+	t.ndim = (int32_t) xb->ndim;
+	t.dtype = format_to_dl_dtype(xb->format, xb->itemsize);
+	t.shape = ctx->shape.data();
+	t.strides = ctx->strides.data();
+	t.byte_offset = 0;
+	ctx->tensor.manager_ctx = ctx;
+	ctx->tensor.deleter = [](DLManagedTensor *self) {
+		delete (DLPackExportCtx *) self->manager_ctx;
+	};
+
+	// If the capsule is never consumed, it is still called "dltensor" and
+	//  we are responsible for releasing the tensor
+	return py::capsule(&ctx->tensor, "dltensor", [](PyObject *cap) {
+		if (PyCapsule_IsValid(cap, "dltensor")) {
+			DLManagedTensor *t = (DLManagedTensor *) PyCapsule_GetPointer(cap, "dltensor");
+			t->deleter(t);
+		}
+	});
+}
+
+/**
+ * @brief Import a DLPack capsule as XBuffer. Contiguous CPU tensors are
+ *  wrapped without copying, other tensors are repacked into a new
+ *  contiguous buffer
+ */
+inline XBufferHolder from_dlpack(py::capsule cap)
+{
+	if (!PyCapsule_IsValid(cap.ptr(), "dltensor"))
+		throw std::invalid_argument("XBuffer: expected an unconsumed DLPack"
+		                            " capsule named `dltensor`");
+	DLManagedTensor *mt = (DLManagedTensor *) PyCapsule_GetPointer(cap.ptr(), "dltensor");
+	const DLTensor &t = mt->dl_tensor;
+	if (t.device.device_type != kDLCPU && t.device.device_type != kDLCUDAHost)
+		throw std::invalid_argument("XBuffer: only CPU DLPack tensors can be"
+		                            " imported");
+
+	std::string format = dl_dtype_to_format(t.dtype);
+	ssize_t itemsize = t.dtype.bits / 8;
+	std::vector<ssize_t> shape(t.shape, t.shape + t.ndim);
+	std::vector<ssize_t> strides;
+	if (t.strides) {
+		for (int32_t i = 0; i < t.ndim; ++i)
+			strides.push_back(t.strides[i] * itemsize);
+	} else {
+		strides = XBuffer::contiguous_strides(shape, itemsize);
+	}
+	void *data = (char *) t.data + t.byte_offset;
+
+	// Ownership of the tensor is transferred to us
+	PyCapsule_SetName(cap.ptr(), "used_dltensor");
+	std::shared_ptr<void> base(mt, ExternalMemoryDeleter{data, [](void *p) {
+		DLManagedTensor *mt = (DLManagedTensor *) p;
+		if (mt->deleter) {
+			py::gil_scoped_acquire gil;
+			mt->deleter(mt);
+		}
+	}});
+
+	XBufferHolder xb(new XBuffer(data, itemsize, format, (ssize_t) shape.size(),
+	                             shape, strides, false, false));
+	if (xb->is_contiguous()) {
+		xb->base = base;
+		return xb;
+	}
+	return XBufferHolder(new XBuffer(data, itemsize, format, (ssize_t) shape.size(),
+	                                 shape, strides, true, true));
+}
+
 void declare_xbuffer(py::module &m) {
 
 	py::class_<XBuffer, std::shared_ptr<XBuffer>>(
 		  m, "XBuffer", py::buffer_protocol())
-		.def(py::init([](py::buffer b) {
+		.def(py::init([](py::buffer b, bool copy) {
 
 			/* Request a buffer descriptor from Python */
 			py::buffer_info info = b.request();
 
+			std::vector<ssize_t> shape(info.shape.begin(), info.shape.end());
+			std::vector<ssize_t> strides(info.strides.begin(), info.strides.end());
+			XBuffer *xb = new XBuffer(info.ptr, info.itemsize, info.format,
+			                          info.ndim, shape, strides, false, false);
+
+			// Strided buffers are always repacked as the runtime works on
+			//  contiguous data
+			if (!copy && xb->is_contiguous()) {
+				/* Share the data and keep the Python object alive */
+				xb->base = keep_alive(b, info.ptr);
+				return xb;
+			}
+			delete xb;
 			return new XBuffer(info.ptr, info.itemsize, info.format,
-                               info.ndim, info.shape, info.strides);
-		}))
+			                   info.ndim, shape, strides, true, true);
+		}), py::arg("b"), py::arg("copy") = true)
+		.def_property_readonly("is_contiguous", &XBuffer::is_contiguous)
+		.def_property_readonly("shares_memory", [](const XBuffer &xb) {
+			return shares_memory(xb);
+		})
+		.def("to_dlpack", &to_dlpack)
+		.def_static("from_dlpack", &from_dlpack)
 		.def_buffer([](XBuffer &xb) -> py::buffer_info {
 			return py::buffer_info(
 					xb.data,        /* Pointer to data */
@@ -47,4 +252,4 @@ void declare_xbuffer(py::module &m) {
 		});
 }
 
-} // pyxir
\ No newline at end of file
+} // pyxir
@@ -0,0 +1,95 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "../pyxir_api.hpp"
+#include "../common/xbuffer.hpp"
+
+namespace pyxir {
+namespace quantization {
+
+/** @brief Value of the axis argument for searching a single threshold */
+constexpr int PER_TENSOR = -1;
+
+/**
+ * @brief Histogram of the absolute values of a tensor (channel) over
+ *  [0, max] which keeps the count, sum and sum of squares of every bin so
+ *  the squared error of a bin's values against any single value is exact
+ */
+struct AbsHistogram {
+  double max = 0.;
+  std::vector<double> count;
+  std::vector<double> sum;
+  std::vector<double> sum_sq;
+};
+
+struct ThresholdSearchOptions {
+  int bitwidth = 8;
+  int nb_bins = 2048;
+  // The candidate thresholds are k / nb_candidates * max for
+  //  k = 1..nb_candidates
+  int nb_candidates = 256;
+};
+
+/**
+ * @brief Build the absolute value histogram of the elements
+ *  data[o * stride + i] for o in [0, outer) and i in [0, inner)
+ */
+PX_API AbsHistogram build_abs_histogram(const float *data, ssize_t outer,
+                                        ssize_t inner, ssize_t stride,
+                                        int nb_bins);
+
+/**
+ * @brief Return the sum of squared errors between the histogram values and
+ *  their symmetric fix point quantization with the given threshold.
+ *
+ * Every value of a bin is approximated as quantized like the bin's mean
+ *  (clipped to the threshold). The result is exact for bins whose values
+ *  all round to the same level, e.g. bins entirely above the threshold.
+ *  Otherwise a value x is within the bin width w = max / nb_bins of the
+ *  mean, so both |x - q(x)| and |x - q(mean)| are at most w + step / 2 with
+ *  step = threshold / (2^(bitwidth - 1) - 1), and the result differs from
+ *  the exact error by at most count * (w + step / 2)^2 over those bins.
+ *  With bins narrower than a step, only the bins containing a rounding
+ *  boundary are affected.
+ */
+PX_API double histogram_sse(const AbsHistogram &hist, double threshold,
+                            int bitwidth);
+
+/**
+ * @brief Return the candidate threshold with the lowest quantization error
+ *  on the histogram, 0 for all zero histograms
+ */
+PX_API float search_mse_threshold(const AbsHistogram &hist,
+                                  const ThresholdSearchOptions &options);
+
+/**
+ * @brief Search the MSE optimal thresholds of the given float32 tensors in
+ *  parallel, one per channel along the tensor's axis or a single threshold
+ *  if its axis is PER_TENSOR
+ */
+PX_API std::vector<std::vector<float>>
+search_mse_thresholds(const std::vector<std::shared_ptr<XBuffer>> &tensors,
+                      const std::vector<int> &axes,
+                      const ThresholdSearchOptions &options);
+
+} // namespace quantization
+} // namespace pyxir
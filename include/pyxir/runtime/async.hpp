@@ -0,0 +1,282 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "compute_func_info.hpp"
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define PX_HAS_COROUTINES 1
+#endif
+#endif
+
+namespace pyxir {
+namespace runtime {
+
+/**
+ * @brief Completion state of an asynchronously executed request. Callers
+ *  can block on it with wait(), register continuations with then() or,
+ *  when compiled with C++20 coroutine support, co_await it
+ */
+class Completion {
+
+  public:
+    Completion() {}
+
+    static std::shared_ptr<Completion> Ready(std::exception_ptr error = nullptr)
+    {
+      std::shared_ptr<Completion> c(new Completion());
+      c->set(error);
+      return c;
+    }
+
+    /**
+     * @brief Run the registered continuations and mark the request as done.
+     *  Waiters are only woken up after all continuations ran, continuations
+     *  registered in the meantime are run as well. Continuations must not
+     *  wait on the completion they are registered on. If the request
+     *  succeeded but a continuation throws, the first such error is
+     *  reported by the completion.
+     */
+    void set(std::exception_ptr error = nullptr)
+    {
+      std::vector<std::function<void()>> continuations;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        error_ = error;
+        continuations.swap(continuations_);
+      }
+      while (true) {
+        for (auto &c : continuations) {
+          try {
+            c();
+          } catch (...) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!error_)
+              error_ = std::current_exception();
+          }
+        }
+        continuations.clear();
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (continuations_.empty()) {
+          done_ = true;
+          break;
+        }
+        continuations.swap(continuations_);
+      }
+      cv_.notify_all();
+    }
+
+    bool ready()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return done_;
+    }
+
+    /** @brief Block until the request is done, rethrows execution errors */
+    void wait()
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this]() { return done_; });
+      if (error_)
+        std::rethrow_exception(error_);
+    }
+
+    /**
+     * @brief Register a continuation which is called on the completing
+     *  thread, or immediately if the request is already done
+     */
+    void then(std::function<void()> continuation)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!done_) {
+          continuations_.push_back(std::move(continuation));
+          return;
+        }
+      }
+      continuation();
+    }
+
+    /**
+     * @brief Register a continuation which is called on the completing
+     *  thread. Returns false without calling it if the request is already
+     *  done.
+     */
+    bool then_if_pending(std::function<void()> continuation)
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if (done_)
+        return false;
+      continuations_.push_back(std::move(continuation));
+      return true;
+    }
+
+    std::exception_ptr error()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return error_;
+    }
+
+  private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool done_ = false;
+    std::exception_ptr error_ = nullptr;
+    std::vector<std::function<void()>> continuations_;
+};
+
+typedef std::shared_ptr<Completion> CompletionHolder;
+
+/**
+ * @brief Completion driven executor. Submitted wait functions (returned by
+ *  compute funcs after handing work to an accelerator) are completed in
+ *  submission order on a small number of completion threads, so that the
+ *  submitting thread never blocks and can keep many requests in flight.
+ */
+class CompletionExecutor {
+
+  public:
+    CompletionExecutor(size_t nb_threads = 1)
+    {
+      nb_threads = nb_threads > 0 ? nb_threads : 1;
+      for (size_t i = 0; i < nb_threads; ++i)
+        threads_.emplace_back([this]() { run(); });
+    }
+
+    ~CompletionExecutor()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      for (auto &t : threads_)
+        t.join();
+    }
+
+    CompletionExecutor(const CompletionExecutor &) = delete;
+    CompletionExecutor &operator=(const CompletionExecutor &) = delete;
+
+    /**
+     * @brief Enqueue a wait function and return the completion that is set
+     *  once it returned. An empty wait function means that the work was
+     *  already done synchronously.
+     */
+    CompletionHolder submit(WaitFuncType wait_func)
+    {
+      CompletionHolder c(new Completion());
+      if (!wait_func) {
+        c->set();
+        return c;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        queue_.emplace_back(std::move(wait_func), c);
+        ++in_flight_;
+      }
+      cv_.notify_one();
+      return c;
+    }
+
+    /** @brief The number of submitted requests that didn't complete yet */
+    size_t in_flight() const { return in_flight_; }
+
+    /** @brief The process wide default executor */
+    static CompletionExecutor &Global()
+    {
+      static CompletionExecutor executor(1);
+      return executor;
+    }
+
+  private:
+    void run()
+    {
+      while (true) {
+        std::pair<WaitFuncType, CompletionHolder> job;
+        {
+          std::unique_lock<std::mutex> lock(mtx_);
+          cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+          // Drain the queue before stopping
+          if (queue_.empty())
+            return;
+          job = std::move(queue_.front());
+          queue_.pop_front();
+        }
+        std::exception_ptr error = nullptr;
+        try {
+          job.first();
+        } catch (...) {
+          error = std::current_exception();
+        }
+        --in_flight_;
+        job.second->set(error);
+      }
+    }
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::atomic<size_t> in_flight_{0};
+    std::deque<std::pair<WaitFuncType, CompletionHolder>> queue_;
+    std::vector<std::thread> threads_;
+};
+
+#ifdef PX_HAS_COROUTINES
+
+/**
+ * @brief Awaiter suspending a coroutine until the request completes. The
+ *  coroutine is resumed on the completing executor thread, or continues
+ *  without suspending if the request completed in the meantime.
+ */
+struct CompletionAwaiter {
+  CompletionHolder completion;
+
+  bool await_ready() { return completion->ready(); }
+
+  bool await_suspend(std::coroutine_handle<> handle)
+  {
+    return completion->then_if_pending([handle]() { handle.resume(); });
+  }
+
+  void await_resume()
+  {
+    if (std::exception_ptr error = completion->error())
+      std::rethrow_exception(error);
+  }
+};
+
+inline CompletionAwaiter operator co_await(const CompletionHolder &completion)
+{
+  return CompletionAwaiter{completion};
+}
+
+#endif
+
+} // namespace runtime
+} // namespace pyxir
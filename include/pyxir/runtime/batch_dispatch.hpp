@@ -0,0 +1,238 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <condition_variable>
+
+#include "../common/xbuffer.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+/**
+ * @brief Persistent worker threads executing the chunks dispatched by
+ *  dispatch_batch, so that dispatching a batch doesn't create threads.
+ *  Worker w always runs on the same thread and the calling thread acts as
+ *  worker 0. Threads are created on first use and calls to run are
+ *  serialized, so a worker index is never executing concurrently.
+ */
+class DispatchWorkers {
+
+  public:
+    DispatchWorkers() {}
+
+    ~DispatchWorkers()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      for (auto &t : threads_)
+        t.join();
+    }
+
+    DispatchWorkers(const DispatchWorkers &) = delete;
+    DispatchWorkers &operator=(const DispatchWorkers &) = delete;
+
+    /** @brief The process wide workers used if none are provided */
+    static DispatchWorkers &Shared()
+    {
+      static DispatchWorkers workers;
+      return workers;
+    }
+
+    /**
+     * @brief Call func(w) for every worker w in [0, nb_workers) and wait
+     *  until all calls returned. The first error is rethrown. Must not be
+     *  called from inside func.
+     */
+    void run(size_t nb_workers, const std::function<void(size_t)> &func)
+    {
+      std::lock_guard<std::mutex> run_lock(run_mtx_);
+      nb_workers = std::max<size_t>(nb_workers, 1);
+      while (threads_.size() + 1 < nb_workers) {
+        const size_t w = threads_.size() + 1;
+        const uint64_t generation = generation_;
+        threads_.emplace_back([this, w, generation]() { work(w, generation); });
+      }
+      std::vector<std::exception_ptr> errors(nb_workers);
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        func_ = &func;
+        errors_ = &errors;
+        nb_active_ = nb_workers;
+        pending_ = nb_workers - 1;
+        ++generation_;
+      }
+      cv_.notify_all();
+      try {
+        func(0);
+      } catch (...) {
+        errors[0] = std::current_exception();
+      }
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        done_cv_.wait(lock, [this]() { return pending_ == 0; });
+        func_ = nullptr;
+        errors_ = nullptr;
+      }
+      for (auto &e : errors)
+        if (e)
+          std::rethrow_exception(e);
+    }
+
+  private:
+    void work(size_t w, uint64_t generation)
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      while (true) {
+        cv_.wait(lock, [this, generation]() {
+          return stop_ || generation_ != generation;
+        });
+        if (stop_)
+          return;
+        generation = generation_;
+        if (w >= nb_active_)
+          continue;
+        const std::function<void(size_t)> *func = func_;
+        std::vector<std::exception_ptr> *errors = errors_;
+        lock.unlock();
+        try {
+          (*func)(w);
+        } catch (...) {
+          (*errors)[w] = std::current_exception();
+        }
+        lock.lock();
+        if (--pending_ == 0)
+          done_cv_.notify_all();
+      }
+    }
+
+    std::vector<std::thread> threads_;
+    /** @brief Serializes calls to run */
+    std::mutex run_mtx_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::condition_variable done_cv_;
+    bool stop_ = false;
+    /** @brief Incremented for every call to run */
+    uint64_t generation_ = 0;
+    const std::function<void(size_t)> *func_ = nullptr;
+    std::vector<std::exception_ptr> *errors_ = nullptr;
+    size_t nb_active_ = 0;
+    size_t pending_ = 0;
+};
+
+/**
+ * @brief Split the batch (axis 0) of the given input and output buffers
+ *  into chunks of at most `chunk_size` and execute them concurrently on
+ *  `nb_workers` persistent workers. Chunks are passed as zero-copy batch
+ *  views so results are gathered in place into the output buffers. Worker w
+ *  handles chunks w, w + nb_workers, ... sequentially so that per-worker
+ *  resources (e.g. a DPU runner) are never used concurrently. Workers have
+ *  to write their results in place into the output chunks.
+ * @param in_tensors The input buffers sharing the same batch size
+ * @param out_tensors The (allocated) output buffers
+ * @param chunk_size The maximum batch size of one chunk
+ * @param nb_workers The number of concurrent workers
+ * @param worker The function to be called as worker(worker_idx, in_chunk,
+ *  out_chunk)
+ * @param workers The worker threads, by default the process wide ones
+ */
+template <typename Worker>
+inline void dispatch_batch(std::vector<XBufferHolder> &in_tensors,
+                           std::vector<XBufferHolder> &out_tensors,
+                           ssize_t chunk_size, size_t nb_workers,
+                           Worker worker,
+                           DispatchWorkers &workers = DispatchWorkers::Shared())
+{
+  if (in_tensors.empty())
+    throw std::invalid_argument("dispatch_batch: expected at least one input");
+  const ssize_t batch = in_tensors[0]->shape[0];
+  chunk_size = std::max<ssize_t>(chunk_size, 1);
+  const ssize_t nb_chunks = (batch + chunk_size - 1) / chunk_size;
+  nb_workers = std::max<size_t>(1, std::min<size_t>(nb_workers, nb_chunks));
+
+  std::function<void(size_t)> run_worker = [&](size_t w) {
+    for (ssize_t c = w; c < nb_chunks; c += nb_workers) {
+      const ssize_t begin = c * chunk_size;
+      const ssize_t end = std::min(batch, begin + chunk_size);
+      std::vector<XBufferHolder> in_chunk, out_chunk;
+      for (const XBufferHolder &xb : in_tensors)
+        in_chunk.push_back(slice(xb, 0, begin, end));
+      for (const XBufferHolder &xb : out_tensors)
+        out_chunk.push_back(slice(xb, 0, begin, end));
+      worker(w, in_chunk, out_chunk);
+    }
+  };
+
+  if (nb_workers == 1)
+    run_worker(0);
+  else
+    workers.run(nb_workers, run_worker);
+}
+
+/**
+ * @brief Execute a batch on a pool of runners with a fixed batch size.
+ *  Batches that fit in one runner are executed on `first_runner`, larger
+ *  batches are split in runner sized chunks with dispatch_batch, starting
+ *  at `first_runner`.
+ * @param in_tensors The input buffers sharing the same batch size
+ * @param out_tensors The (allocated) output buffers
+ * @param runner_batch The batch size of the runners
+ * @param nb_runners The number of runners
+ * @param run_chunk The function to be called as run_chunk(runner_idx,
+ *  in_chunk, out_chunk)
+ * @param first_runner The runner to start with, e.g. to spread concurrent
+ *  requests over the pool
+ * @param workers The worker threads, by default the process wide ones
+ */
+template <typename RunChunk>
+inline void dispatch_to_runners(std::vector<XBufferHolder> &in_tensors,
+                                std::vector<XBufferHolder> &out_tensors,
+                                ssize_t runner_batch, size_t nb_runners,
+                                RunChunk run_chunk, size_t first_runner = 0,
+                                DispatchWorkers &workers =
+                                  DispatchWorkers::Shared())
+{
+  if (in_tensors.empty())
+    throw std::invalid_argument("dispatch_to_runners: expected at least one"
+                                " input");
+  nb_runners = std::max<size_t>(nb_runners, 1);
+  first_runner %= nb_runners;
+  if (in_tensors[0]->shape[0] <= runner_batch)
+    run_chunk(first_runner, in_tensors, out_tensors);
+  else
+    dispatch_batch(in_tensors, out_tensors, runner_batch, nb_runners,
+      [&run_chunk, first_runner, nb_runners](
+          size_t w, std::vector<XBufferHolder> &in_chunk,
+          std::vector<XBufferHolder> &out_chunk) {
+        run_chunk((first_runner + w) % nb_runners, in_chunk, out_chunk);
+      }, workers);
+}
+
+} // namespace runtime
+} // namespace pyxir
@@ -20,8 +20,10 @@
 #include <stdexcept>
 #include <functional>
 
+#include "stats.hpp"
 #include "compute_func_info.hpp"
 #include "../opaque_func.hpp"
+#include "../common/allocator.hpp"
 #include "../common/serializable.hpp"
 
 
@@ -41,6 +43,63 @@ class IComputeFunc : public ISerializable {
     virtual void operator()(std::vector<XBufferHolder> &in_tensors,
                             std::vector<XBufferHolder> &out_tensors) = 0;
 
+    /**
+     * @brief Start execution and return a function that completes it. Compute
+     *  funcs offloading to an accelerator return as soon as the work is
+     *  submitted, the default implementation executes synchronously and
+     *  returns an empty function. The output vector has to stay alive until
+     *  the returned function was called.
+     */
+    virtual WaitFuncType submit(std::vector<XBufferHolder> &in_tensors,
+                                std::vector<XBufferHolder> &out_tensors)
+    {
+      (*this)(in_tensors, out_tensors);
+      return WaitFuncType();
+    }
+
+    /**
+     * @brief Prepare this compute func for execution, e.g. create runners
+     *  and look up kernels, before the first request. Returns whether
+     *  synthetic warmup iterations may be run, compute funcs that would be
+     *  affected by synthetic inputs (e.g. during calibration) return false
+     */
+    virtual bool warmup() { return true; }
+
+    /**
+     * @brief Return whether this compute func may execute multiple requests
+     *  at the same time. Runtime modules serialize the calls into compute
+     *  funcs that aren't reentrant, including the completion of submitted
+     *  requests. Once a compute func reports that it's reentrant, it has to
+     *  stay reentrant.
+     */
+    virtual bool is_reentrant() { return false; }
+
+    /** @brief Return whether this compute func takes int8 inputs quantized
+        by the input stage (see InputStageOptions::quantize) instead of
+        float inputs */
+    virtual bool accepts_quantized_inputs() { return false; }
+
+    /** @brief Return the declared input shapes, empty if unknown */
+    virtual std::vector<std::vector<ssize_t>> get_in_shapes()
+    {
+      return std::vector<std::vector<ssize_t>>();
+    }
+
+    /** @brief Return the statistics of the comparison against a reference
+        compute func, empty if comparison isn't enabled */
+    virtual ComparisonStats get_comparison_stats() { return ComparisonStats(); }
+
+    /** @brief Move the weights held by this compute func into memory from the
+        allocator, e.g. huge page backed memory */
+    virtual void move_weights(const AllocatorHolder &allocator)
+    {
+      (void) allocator;
+    }
+
+    /** @brief Return the memory held by this compute func, i.e. all
+        categories except for the request buffers */
+    virtual MemoryUsage get_memory_usage() { return MemoryUsage(); }
+
     void set_rt_mod_save_func(RtModSaveFuncType save_func) //(void (*save_func)(const std::string &))
     { 
       rt_mod_save_callback_ = save_func;
@@ -104,6 +163,22 @@ class StatefulComputeFunc : public IComputeFunc {
       cfi_.compute_func(func_state_, in_tensors, out_tensors);
     }
 
+    virtual WaitFuncType submit(std::vector<XBufferHolder> &in_tensors,
+                                std::vector<XBufferHolder> &out_tensors)
+    {
+      if (!cfi_.submit_func)
+        return IComputeFunc::submit(in_tensors, out_tensors);
+      return cfi_.submit_func(func_state_, in_tensors, out_tensors);
+    }
+
+    virtual bool is_reentrant() { return cfi_.reentrant; }
+
+    virtual bool accepts_quantized_inputs()
+    {
+      return cfi_.quantized_inputs_func
+        && cfi_.quantized_inputs_func(func_state_);
+    }
+
     virtual void serialize_px(PxOStringStream &pstream)
     {
       cfi_.serial_func(func_state_, pstream);
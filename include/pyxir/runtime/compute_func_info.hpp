@@ -35,6 +35,12 @@ typedef std::function<void(FuncState,
 typedef std::function<void(FuncState)> ReleaseFuncFType;
 typedef std::function<void(FuncState, PxOStringStream &)> SerializationFuncFType;
 typedef std::function<void(FuncState*, PxIStringStream &)> DeserializationFuncFType;
+/** @brief Function blocking until asynchronously submitted work completes */
+typedef std::function<void()> WaitFuncType;
+typedef std::function<WaitFuncType(FuncState,
+                                   std::vector<XBufferHolder> &,
+                                   std::vector<XBufferHolder> &)> SubmitFuncFType;
+typedef std::function<bool(FuncState)> QueryFuncFType;
 
 struct ComputeFuncInfo {
   AllocFuncFType alloc_func;
@@ -42,6 +48,15 @@ struct ComputeFuncInfo {
   ReleaseFuncFType release_func;
   SerializationFuncFType serial_func;
   DeserializationFuncFType deserial_func;
+  /** @brief Optional asynchronous compute function that returns after
+      handing work to the accelerator together with a function completing it */
+  SubmitFuncFType submit_func;
+  /** @brief Whether the compute and submit functions may be called from
+      multiple threads at the same time, see IComputeFunc::is_reentrant */
+  bool reentrant = false;
+  /** @brief Optional query whether the compute and submit functions take
+      int8 fix point inputs, see IComputeFunc::accepts_quantized_inputs */
+  QueryFuncFType quantized_inputs_func;
 };
 
 } // namespace runtime
@@ -0,0 +1,171 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+
+#include "../common/shared_memory.hpp"
+#include "../common/xbuffer.hpp"
+#include "runtime_module.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+struct InferenceServerOptions {
+  /** @brief The float32 input shapes of a single request, the first
+      dimension is the batch dimension along which requests are batched */
+  std::vector<std::vector<ssize_t>> in_shapes;
+  /** @brief The float32 output shapes of a single request */
+  std::vector<std::vector<ssize_t>> out_shapes;
+  /** @brief The maximum number of requests executed as one batch */
+  size_t max_batch_size = 8;
+  /** @brief The maximum time to wait for a batch to fill up */
+  int64_t batch_timeout_us = 500;
+};
+
+struct InferenceServerStats {
+  uint64_t clients = 0;
+  /** @brief The number of currently connected clients */
+  uint64_t connected = 0;
+  uint64_t requests = 0;
+  uint64_t failed = 0;
+  uint64_t batches = 0;
+
+  double mean_batch_size() const
+  {
+    return batches > 0 ? (double) requests / batches : 0.;
+  }
+};
+
+/**
+ * @brief Local inference daemon serving a runtime module to clients in
+ *  other processes on the same machine. Clients connect over a UNIX socket
+ *  and exchange tensors through a shared memory ring of request slots, only
+ *  slot indices go over the socket. Requests of all clients are batched
+ *  along the first dimension up to the maximum batch size.
+ */
+class InferenceServer {
+
+  public:
+    InferenceServer(SharedRtModHolder rt_mod, const std::string &socket_path,
+                    const InferenceServerOptions &options);
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer &) = delete;
+    InferenceServer &operator=(const InferenceServer &) = delete;
+
+    /** @brief Start listening on the socket path */
+    void start();
+
+    /** @brief Stop serving, requests that weren't executed yet fail */
+    void stop();
+
+    InferenceServerStats get_stats();
+
+  private:
+    struct Client;
+    struct Request {
+      std::shared_ptr<Client> client;
+      uint32_t slot;
+    };
+
+    void accept_loop();
+    void client_loop(std::shared_ptr<Client> client);
+    /** @brief Remove a disconnected client, called from its own thread */
+    void finish_client(const std::shared_ptr<Client> &client);
+    void batch_loop();
+    void execute_batch(std::vector<Request> &batch);
+
+    SharedRtModHolder rt_mod_;
+    std::string socket_path_;
+    InferenceServerOptions options_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stop_{false};
+    std::thread accept_thread_;
+    std::thread batch_thread_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Request> queue_;
+    std::vector<std::shared_ptr<Client>> clients_;
+    /** @brief The thread of the last disconnected client, joined by the
+        next client to disconnect or on stop */
+    std::thread finished_thread_;
+    InferenceServerStats stats_;
+};
+
+/**
+ * @brief Client of a local inference server. Input and output tensors live
+ *  in a shared memory ring of request slots mapped by both processes, the
+ *  slot buffers can be filled and read in place to avoid copies. A client
+ *  instance is not thread safe.
+ */
+class InferenceClient {
+
+  public:
+    /**
+     * @brief Connect to the inference server
+     * @param socket_path The UNIX socket path of the server
+     * @param nb_slots The number of request slots, i.e. the maximum number
+     *  of requests in flight
+     */
+    InferenceClient(const std::string &socket_path, size_t nb_slots = 4);
+    ~InferenceClient();
+
+    InferenceClient(const InferenceClient &) = delete;
+    InferenceClient &operator=(const InferenceClient &) = delete;
+
+    size_t nb_slots() const { return slot_inputs_.size(); }
+
+    /** @brief The input buffers of the given slot, backed by shared memory */
+    std::vector<XBufferHolder> &get_inputs(size_t slot) { return slot_inputs_.at(slot); }
+
+    /** @brief The output buffers of the given slot, backed by shared memory */
+    std::vector<XBufferHolder> &get_outputs(size_t slot) { return slot_outputs_.at(slot); }
+
+    /** @brief Submit the request in the given slot */
+    void submit(size_t slot);
+
+    /** @brief Wait for the request in the given slot, throws on failure */
+    void wait(size_t slot);
+
+    /**
+     * @brief Execute a request by copying the provided inputs into a free
+     *  slot and the results into the provided output buffers
+     */
+    void execute(std::vector<XBufferHolder> &in_tensors,
+                 std::vector<XBufferHolder> &out_tensors);
+
+  private:
+    int fd_ = -1;
+    std::shared_ptr<SharedMemory> shm_;
+    std::vector<std::vector<XBufferHolder>> slot_inputs_;
+    std::vector<std::vector<XBufferHolder>> slot_outputs_;
+    /** @brief The request state of every slot: 0 = free, 1 = in flight,
+        2 = done, 3 = failed */
+    std::vector<int> slot_states_;
+};
+
+} // namespace runtime
+} // namespace pyxir
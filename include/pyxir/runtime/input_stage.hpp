@@ -0,0 +1,69 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "../graph/xlayer.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+/**
+ * @brief Configuration of the optional native input stage of a runtime module.
+ *  The input stage takes raw uint8 NHWC frames and produces the network input
+ *  in one pass (see the `cpu.Preprocess` kernel func).
+ */
+struct InputStageOptions {
+  /** @brief The network input (height, width), empty for no resizing */
+  std::vector<int64_t> size;
+  /** @brief Per channel (or single) mean to be subtracted */
+  std::vector<double> mean;
+  /** @brief Per channel (or single) scale to be applied after mean subtraction */
+  std::vector<double> scale;
+  /** @brief The output layout: NCHW or NHWC */
+  std::string layout = "NCHW";
+  /** @brief Whether to swap the R and B channels of 3 channel frames */
+  bool swap_rb = false;
+  /** @brief Whether to quantize the output to int8, only supported for
+      compute funcs accepting quantized inputs */
+  bool quantize = false;
+  /** @brief The fix point position used for quantization: q = x * 2^fix_point */
+  int fix_point = 0;
+
+  /**
+   * @brief Create the Preprocess XLayer corresponding to these options
+   */
+  XLayerHolder to_xlayer(const std::string &name = "px_input_stage") const
+  {
+    XLayerHolder X(new graph::XLayer(name, std::vector<std::string>{"Preprocess"}));
+    X->set_attr("size", graph::XAttr("size", size));
+    X->set_attr("mean", graph::XAttr("mean", mean));
+    X->set_attr("scale", graph::XAttr("scale", scale));
+    X->set_attr("layout", graph::XAttr("layout", layout));
+    X->set_attr("swap_rb", graph::XAttr("swap_rb", swap_rb));
+    X->set_attr("quantize", graph::XAttr("quantize", quantize));
+    X->set_attr("fix_point", graph::XAttr("fix_point", fix_point));
+    return X;
+  }
+};
+
+} // namespace runtime
+} // namespace pyxir
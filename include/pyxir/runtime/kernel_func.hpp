@@ -19,6 +19,7 @@
 #include <string>
 
 #include "../graph/xlayer.hpp"
+#include "compute_func_info.hpp"
 // #include "../opaque_func_registry.hpp"
 
 namespace pyxir {
@@ -34,6 +35,17 @@ class KernelFunc {
     virtual void operator()(std::vector<XBufferHolder> &in_tensors,
                             std::vector<XBufferHolder> &out_tensors) {};
 
+    /**
+     * @brief Start execution and return a function that completes it, see
+     *  IComputeFunc::submit. Executes synchronously by default.
+     */
+    virtual WaitFuncType submit(std::vector<XBufferHolder> &in_tensors,
+                                std::vector<XBufferHolder> &out_tensors)
+    {
+      (*this)(in_tensors, out_tensors);
+      return WaitFuncType();
+    }
+
   public:
     XLayerHolder xl_;
 };
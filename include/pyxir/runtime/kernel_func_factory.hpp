@@ -57,15 +57,23 @@ class KernelFuncFactory {
     RegisterImpl(const std::string &kernel_id);
     
     /**
-     * @brief Retrieve the kernel func corresponding to the given identifier
+     * @brief Retrieve the kernel func corresponding to the given identifier.
+     *  Kernels registered through REGISTER_KERNEL_FUNC take precedence over
+     *  the built-in CPU kernels of the StaticKernelRegistry, which are
+     *  available as "cpu.<op_type>".
      * @param xl The XLayer to initialize the kernel function
      * @returns The kernel func corresponding to the given identifier
      */
     PX_API static KernelFuncHolder
     GetKernelFunc(const std::string &kernel_id, XLayerHolder &xl);
 
+    /** @brief Whether a registered or built-in kernel func exists */
     PX_API static bool Exists(const std::string &kernel_id);
 
+    /** @brief Whether a kernel func was registered through
+        REGISTER_KERNEL_FUNC */
+    PX_API static bool IsRegistered(const std::string &kernel_id);
+
     class Manager;
   
   private:
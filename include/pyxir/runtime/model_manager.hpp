@@ -0,0 +1,374 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "../common/mapped_file.hpp"
+#include "stats.hpp"
+#include "runtime_module.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+struct ModelManagerOptions {
+  /** @brief The memory budget in bytes for resident runtime modules, 0 means
+      unlimited */
+  size_t memory_budget = 0;
+  /** @brief Whether to keep module files memory mapped after loading so
+      reloading an evicted module doesn't have to go back to disk */
+  bool keep_files_mapped = true;
+};
+
+struct ModelManagerStats {
+  /** @brief Requests for a model that was resident */
+  uint64_t hits = 0;
+  /** @brief Requests for a model that had to be (re)loaded */
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  /** @brief Loads that exceeded the memory budget because all resident
+      modules were in use */
+  uint64_t over_budget = 0;
+  LatencyStats load_time;
+  LatencyStats evict_time;
+
+  double hit_rate() const
+  {
+    uint64_t total = hits + misses;
+    return total > 0 ? (double) hits / total : 0.;
+  }
+};
+
+/**
+ * @brief Keeps multiple runtime modules resident within a memory budget.
+ *  Models are registered up front and loaded lazily on first request. If
+ *  loading a model exceeds the budget, the least recently used modules that
+ *  are not in use are evicted. Evicted modules are reloaded on their next
+ *  request.
+ *
+ * Models are loaded and evicted modules are destroyed outside of the
+ *  manager lock, so a slow load only blocks the requests for the model
+ *  being loaded.
+ *
+ * NOTE Runtime modules with online quantization compute funcs remove their
+ *  build directory on destruction and extract it again when reloaded
+ */
+class ModelManager {
+
+  public:
+    typedef std::function<RtModHolder()> LoaderFuncType;
+    typedef std::chrono::steady_clock Clock;
+
+    ModelManager(const ModelManagerOptions &options = ModelManagerOptions())
+      : options_(options) {}
+
+    ModelManager(const ModelManager &) = delete;
+    ModelManager &operator=(const ModelManager &) = delete;
+
+    /**
+     * @brief Register a model stored in a runtime module file. The file size
+     *  is used as the resident size of the model until it's loaded, then the
+     *  memory reported by the module is used.
+     */
+    void add_model(const std::string &name, const std::string &module_path)
+    {
+      std::shared_ptr<MappedFile> file(new MappedFile(module_path));
+      size_t size = file->size();
+      if (!options_.keep_files_mapped)
+        file.reset();
+      add_model(name, [file, module_path]() {
+        if (file)
+          return RuntimeModule::LoadFromBuffer(file->data(), file->size());
+        return RuntimeModule::Load(module_path);
+      }, size);
+    }
+
+    /**
+     * @brief Register a model created by the given loader function
+     * @param name The model name
+     * @param loader Function returning the loaded runtime module
+     * @param size The estimated resident size of the model in bytes, used
+     *  until the module reports its memory usage after loading
+     */
+    void add_model(const std::string &name, LoaderFuncType loader, size_t size)
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if (models_.find(name) != models_.end())
+        throw std::invalid_argument("ModelManager: model " + name
+                                    + " already exists");
+      Model &model = models_[name];
+      model.loader = loader;
+      model.size = size;
+    }
+
+    /** @brief Remove the given model, which doesn't count as an eviction */
+    void remove_model(const std::string &name)
+    {
+      SharedRtModHolder module;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        load_cv_.wait(lock, [this, &name]() { return !at(name).loading; });
+        Model &model = at(name);
+        if (model.module)
+          module = unload(model);
+        models_.erase(name);
+      }
+      // Destroyed outside of the lock
+      module.reset();
+    }
+
+    bool has_model(const std::string &name) const
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return models_.find(name) != models_.end();
+    }
+
+    bool is_resident(const std::string &name) const
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      auto it = models_.find(name);
+      return it != models_.end() && it->second.module != nullptr;
+    }
+
+    /**
+     * @brief Return the runtime module for the given model, loading it if
+     *  it's not resident. Modules are not evicted while the returned holder
+     *  is alive.
+     */
+    SharedRtModHolder get(const std::string &name)
+    {
+      // Evicted modules are destroyed after the lock is released
+      std::vector<SharedRtModHolder> unloaded;
+      std::unique_lock<std::mutex> lock(mtx_);
+      // Requests for a model that is being loaded wait for that load
+      load_cv_.wait(lock, [this, &name]() { return !at(name).loading; });
+      Model &model = at(name);
+      if (model.module) {
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, model.lru_it);
+        return model.module;
+      }
+      ++stats_.misses;
+      // Reserve the estimated size while loading. Models are only erased
+      //  when not loading, so the reference stays valid.
+      bool fits = make_room(model.size, name, unloaded);
+      const size_t estimate = model.size;
+      resident_size_ += estimate;
+      model.loading = true;
+      LoaderFuncType loader = model.loader;
+      lock.unlock();
+      destroy(unloaded);
+
+      Clock::time_point start = Clock::now();
+      RtModHolder rt_mod;
+      size_t measured = 0;
+      try {
+        rt_mod = loader();
+        // Account the memory the module reports instead of the registered
+        //  estimate, which is also used for subsequent loads
+        measured = rt_mod->get_memory_usage().total();
+      } catch (...) {
+        lock.lock();
+        resident_size_ -= estimate;
+        model.loading = false;
+        lock.unlock();
+        load_cv_.notify_all();
+        throw;
+      }
+      double load_us = elapsed_us(start);
+
+      lock.lock();
+      stats_.load_time.add(load_us);
+      if (fits && measured > estimate)
+        make_room(measured - estimate, name, unloaded);
+      if (measured > 0) {
+        resident_size_ = resident_size_ - estimate + measured;
+        model.size = measured;
+      }
+      model.module = SharedRtModHolder(std::move(rt_mod));
+      model.loading = false;
+      lru_.push_front(name);
+      model.lru_it = lru_.begin();
+      SharedRtModHolder res = model.module;
+      lock.unlock();
+      load_cv_.notify_all();
+      destroy(unloaded);
+      return res;
+    }
+
+    /**
+     * @brief Execute the given model, loading it if necessary. Concurrent
+     *  requests for a model are serialized by its runtime module if the
+     *  compute func isn't reentrant (see IComputeFunc::is_reentrant)
+     */
+    void execute(const std::string &name,
+                 std::vector<XBufferHolder> &in_tensors,
+                 std::vector<XBufferHolder> &out_tensors)
+    {
+      SharedRtModHolder rt_mod = get(name);
+      rt_mod->execute(in_tensors, out_tensors);
+    }
+
+    /** @brief Evict the given model, returns false if it's in use */
+    bool evict(const std::string &name)
+    {
+      std::vector<SharedRtModHolder> unloaded;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Model &model = at(name);
+        if (!model.module || model.module.use_count() > 1)
+          return false;
+        unloaded.push_back(unload(model));
+        ++stats_.evictions;
+      }
+      destroy(unloaded);
+      return true;
+    }
+
+    /** @brief Return the memory used by the given model by category, empty
+        if it isn't resident */
+    MemoryUsage get_memory_usage(const std::string &name)
+    {
+      SharedRtModHolder rt_mod;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        rt_mod = at(name).module;
+      }
+      return rt_mod ? rt_mod->get_memory_usage() : MemoryUsage();
+    }
+
+    size_t resident_size() const
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return resident_size_;
+    }
+
+    /** @brief Return the resident models from most to least recently used */
+    std::vector<std::string> resident_models() const
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return std::vector<std::string>(lru_.begin(), lru_.end());
+    }
+
+    ModelManagerStats get_stats() const
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return stats_;
+    }
+
+  private:
+    struct Model {
+      LoaderFuncType loader;
+      size_t size = 0;
+      SharedRtModHolder module;
+      /** @brief Whether the model is being loaded outside of the lock */
+      bool loading = false;
+      std::list<std::string>::iterator lru_it;
+    };
+
+    Model &at(const std::string &name)
+    {
+      auto it = models_.find(name);
+      if (it == models_.end())
+        throw std::invalid_argument("ModelManager: unknown model " + name);
+      return it->second;
+    }
+
+    /** @brief Evict least recently used modules that are not in use until
+        a model of the given size fits in the memory budget, returns whether
+        it fits. The evicted modules are added to `unloaded` to be destroyed
+        outside of the lock. Expects the lock to be held. */
+    bool make_room(size_t size, const std::string &name,
+                   std::vector<SharedRtModHolder> &unloaded)
+    {
+      if (options_.memory_budget == 0)
+        return true;
+      auto it = lru_.end();
+      while (resident_size_ + size > options_.memory_budget
+             && it != lru_.begin()) {
+        --it;
+        Model &victim = models_.at(*it);
+        if (victim.module.use_count() > 1)
+          continue;
+        // unload erases the list entry, continue from the next one
+        auto next = std::next(it);
+        unloaded.push_back(unload(victim));
+        ++stats_.evictions;
+        it = next;
+      }
+      if (resident_size_ + size > options_.memory_budget) {
+        ++stats_.over_budget;
+        pxWarning("ModelManager: loading model " + name + " exceeds the "
+                  "memory budget as all resident models are in use");
+        return false;
+      }
+      return true;
+    }
+
+    /** @brief Make the model non-resident and return its module, which
+        is destroyed by the caller after releasing the lock. Evictions are
+        counted by the callers. */
+    SharedRtModHolder unload(Model &model)
+    {
+      SharedRtModHolder module = std::move(model.module);
+      lru_.erase(model.lru_it);
+      resident_size_ -= model.size;
+      return module;
+    }
+
+    /** @brief Destroy evicted modules, expects the lock not to be held */
+    void destroy(std::vector<SharedRtModHolder> &unloaded)
+    {
+      for (SharedRtModHolder &module : unloaded) {
+        Clock::time_point start = Clock::now();
+        module.reset();
+        double evict_us = elapsed_us(start);
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats_.evict_time.add(evict_us);
+      }
+      unloaded.clear();
+    }
+
+    static double elapsed_us(Clock::time_point start)
+    {
+      return std::chrono::duration<double, std::micro>(
+        Clock::now() - start).count();
+    }
+
+    ModelManagerOptions options_;
+    mutable std::mutex mtx_;
+    /** @brief Signals the end of a model load */
+    std::condition_variable load_cv_;
+    std::unordered_map<std::string, Model> models_;
+    /** @brief Resident models, most recently used first */
+    std::list<std::string> lru_;
+    size_t resident_size_ = 0;
+    ModelManagerStats stats_;
+};
+
+} // namespace runtime
+} // namespace pyxir
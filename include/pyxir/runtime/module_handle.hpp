@@ -0,0 +1,240 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <condition_variable>
+
+#include "async.hpp"
+#include "runtime_module.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+/**
+ * @brief Handle to a runtime module which can be replaced without dropping
+ *  requests. Every request runs on the module that was active when it
+ *  started. On a swap, the replacement module is warmed up first, then new
+ *  requests are routed to it while in-flight requests drain on the old
+ *  module, which is destroyed by the swapping thread once they're done.
+ *  Holders returned by get() count as in-flight requests.
+ *
+ * NOTE Runtime modules with online quantization compute funcs loaded from
+ *  a file only share their build directory with the active module if it
+ *  was extracted from the same contents, otherwise they extract into a
+ *  directory of their own. Directories are removed when the last module
+ *  using them is destroyed.
+ */
+class ModuleHandle {
+
+  public:
+    typedef std::function<RtModHolder()> LoaderFuncType;
+
+    explicit ModuleHandle(SharedRtModHolder rt_mod)
+    {
+      if (!rt_mod)
+        throw std::invalid_argument("ModuleHandle: invalid runtime module");
+      current_ = activate(rt_mod);
+    }
+
+    ~ModuleHandle()
+    {
+      std::lock_guard<std::mutex> lock(swap_mtx_);
+      if (swap_thread_.joinable())
+        swap_thread_.join();
+    }
+
+    ModuleHandle(const ModuleHandle &) = delete;
+    ModuleHandle &operator=(const ModuleHandle &) = delete;
+
+    /**
+     * @brief Return the active runtime module. A module that was swapped
+     *  out is only destroyed when all returned holders are released
+     */
+    SharedRtModHolder get() const { return std::atomic_load(&current_); }
+
+    /** @brief The number of completed swaps */
+    uint64_t generation() const { return generation_; }
+
+    /**
+     * @brief Execute a request on the active runtime module. Concurrent
+     *  requests are serialized by the module if its compute func isn't
+     *  reentrant (see IComputeFunc::is_reentrant)
+     */
+    void execute(std::vector<XBufferHolder> &in_tensors,
+                 std::vector<XBufferHolder> &out_tensors)
+    {
+      SharedRtModHolder rt_mod = get();
+      rt_mod->execute(in_tensors, out_tensors);
+    }
+
+    /**
+     * @brief Submit a request to the active runtime module, which is kept
+     *  alive until the request completes. Like execute, requests are
+     *  serialized if the module isn't reentrant (see
+     *  RuntimeModule::execute_async)
+     */
+    CompletionHolder execute_async(
+      std::vector<XBufferHolder> &in_tensors,
+      std::vector<XBufferHolder> &out_tensors,
+      CompletionExecutor &executor = CompletionExecutor::Global())
+    {
+      SharedRtModHolder rt_mod = get();
+      CompletionHolder completion = rt_mod->execute_async(in_tensors,
+                                                          out_tensors,
+                                                          executor);
+      completion->then([rt_mod]() {});
+      return completion;
+    }
+
+    /**
+     * @brief Replace the active runtime module. Blocks until the
+     *  replacement is warmed up and the requests in flight on the old module
+     *  have drained, or until the drain timeout expires. In the latter case
+     *  the old module is destroyed when its last request completes.
+     * @param rt_mod The replacement runtime module
+     * @param warmup_iterations The number of synthetic warmup iterations
+     *  run before the replacement receives traffic
+     * @param drain_timeout The maximum time to wait for the requests in
+     *  flight on the old module
+     * @returns Whether the old module drained and was destroyed
+     */
+    bool swap(SharedRtModHolder rt_mod, int warmup_iterations = 1,
+              std::chrono::milliseconds drain_timeout = std::chrono::seconds(30))
+    {
+      if (!rt_mod)
+        throw std::invalid_argument("ModuleHandle: invalid runtime module");
+      if (warmup_iterations > 0)
+        rt_mod->warmup(warmup_iterations);
+      std::shared_ptr<Retirement> retirement;
+      SharedRtModHolder lease = activate(rt_mod, &retirement);
+      SharedRtModHolder old;
+      std::shared_ptr<Retirement> old_retirement;
+      {
+        std::lock_guard<std::mutex> lock(state_mtx_);
+        old = std::atomic_exchange(&current_, lease);
+        old_retirement = std::move(retirement_);
+        retirement_ = retirement;
+        ++generation_;
+      }
+      // The handle's own lease on the old module is released here, the
+      //  in-flight requests release theirs when they complete
+      old.reset();
+      return retire(old_retirement, drain_timeout);
+    }
+
+    /**
+     * @brief Load, warm up and swap in a replacement runtime module on a
+     *  background thread. The active module keeps serving requests in the
+     *  meantime and stays active if loading fails, in which case the error
+     *  is reported through the returned completion.
+     */
+    CompletionHolder swap_async(LoaderFuncType loader, int warmup_iterations = 1)
+    {
+      CompletionHolder completion(new Completion());
+      std::lock_guard<std::mutex> lock(swap_mtx_);
+      // Swaps are applied in order
+      if (swap_thread_.joinable())
+        swap_thread_.join();
+      swap_thread_ = std::thread([this, loader, warmup_iterations, completion]() {
+        try {
+          SharedRtModHolder rt_mod(loader());
+          swap(rt_mod, warmup_iterations);
+        } catch (...) {
+          completion->set(std::current_exception());
+          return;
+        }
+        completion->set();
+      });
+      return completion;
+    }
+
+  private:
+    /** @brief Ownership of an active or swapped out module. The module is
+        destroyed by whoever releases the retirement last: the swapping
+        thread once all leases are released, or the last lease holder if
+        the swapping thread stopped waiting */
+    struct Retirement {
+      SharedRtModHolder module;
+      std::mutex mtx;
+      std::condition_variable cv;
+      bool drained = false;
+    };
+
+    /** @brief Return a lease on the module, which signals the retirement
+        when the lease and all of its copies are released */
+    SharedRtModHolder activate(SharedRtModHolder rt_mod,
+                               std::shared_ptr<Retirement> *retirement = nullptr)
+    {
+      std::shared_ptr<Retirement> r(new Retirement());
+      r->module = rt_mod;
+      if (retirement)
+        *retirement = r;
+      else
+        retirement_ = r;
+      return SharedRtModHolder(rt_mod.get(), [r](RuntimeModule *) {
+        {
+          std::lock_guard<std::mutex> lock(r->mtx);
+          r->drained = true;
+        }
+        r->cv.notify_all();
+      });
+    }
+
+    /** @brief Wait for the requests in flight on a swapped out module and
+        destroy it, returns false if they didn't drain within the timeout */
+    static bool retire(std::shared_ptr<Retirement> &retirement,
+                       std::chrono::milliseconds timeout)
+    {
+      SharedRtModHolder module;
+      {
+        std::unique_lock<std::mutex> lock(retirement->mtx);
+        if (!retirement->cv.wait_for(lock, timeout,
+                                     [&retirement]() { return retirement->drained; })) {
+          pxWarning("ModuleHandle: requests on the swapped out module didn't"
+                    " drain in time, it's destroyed when they complete");
+          retirement.reset();
+          return false;
+        }
+        module = std::move(retirement->module);
+      }
+      retirement.reset();
+      module.reset();
+      return true;
+    }
+
+    /** @brief Lease on the active module */
+    SharedRtModHolder current_;
+    /** @brief Ownership of the active module */
+    std::shared_ptr<Retirement> retirement_;
+    /** @brief Guards swapping the active module and its ownership */
+    std::mutex state_mtx_;
+    std::atomic<uint64_t> generation_{0};
+    std::mutex swap_mtx_;
+    std::thread swap_thread_;
+};
+
+} // namespace runtime
+} // namespace pyxir
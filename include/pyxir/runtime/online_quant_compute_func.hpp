@@ -16,12 +16,15 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "../common/xbuffer.hpp"
 #include "../graph/xgraph.hpp"
 #include "../io/io.hpp"
 #include "../opaque_func_registry.hpp"
 #include "../runtime/compute_func.hpp"
 #include "../runtime/run_options.hpp"
+#include "../runtime/shadow_compare.hpp"
 
 namespace pyxir {
 namespace runtime {
@@ -46,9 +49,13 @@ class OnlineQuantComputeFunc : public IComputeFunc {
         : xg_(other.xg_), target_(other.target_),
           in_tensor_names_(other.in_tensor_names_),
           out_tensor_names_(other.out_tensor_names_), runtime_(other.runtime_),
-          run_options_(other.run_options_), count_(other.count_),
+          run_options_(other.run_options_), count_(other.count_.load()),
           is_target_supported_(other.is_target_supported_),
-          cf_(std::move(other.cf_)), quant_of_(other.quant_of_) {}
+          cf_(std::move(other.cf_)), quant_of_(other.quant_of_),
+          ref_cf_(std::move(other.ref_cf_)), comparator_(other.comparator_),
+          build_files_size_(other.build_files_size_) {
+      acquire_dirs();
+    }
 
     OnlineQuantComputeFunc(XGraphHolder &xg, const std::string &target,
                            const std::vector<std::string> &in_tensor_names,
@@ -74,6 +81,51 @@ class OnlineQuantComputeFunc : public IComputeFunc {
     void operator()(std::vector<XBufferHolder> &in_tensors,
                     std::vector<XBufferHolder> &out_tensors) override;
 
+    /**
+     * @brief Submit the request to the quantized compute func once
+     *  calibration is done, calibration requests execute synchronously
+     */
+    WaitFuncType submit(std::vector<XBufferHolder> &in_tensors,
+                        std::vector<XBufferHolder> &out_tensors) override;
+
+    /**
+     * @brief Prepare the internal compute function, synthetic warmup
+     *  iterations are not allowed while calibrating as they would be
+     *  used as calibration inputs
+     */
+    bool warmup() override;
+
+    /**
+     * @brief Calibration and the switch to the quantized compute func have
+     *  to see the requests one at a time, afterwards this compute func is
+     *  reentrant if the quantized compute func is
+     */
+    bool is_reentrant() override;
+
+    /**
+     * @brief Return the input shapes of the XGraph with unknown (batch)
+     *  dimensions set to 1
+     */
+    std::vector<std::vector<ssize_t>> get_in_shapes() override;
+
+    /**
+     * @brief Return the statistics of the comparison against the CPU
+     *  calibration runtime after on-the-fly quantization
+     */
+    ComparisonStats get_comparison_stats() override;
+
+    /** @brief Move the layer weights of the XGraph into memory from the
+        allocator */
+    void move_weights(const AllocatorHolder &allocator) override;
+
+    /**
+     * @brief Return the memory of the weights and metadata of the XGraph,
+     *  the files in the work and build directories as measured after the
+     *  last build or extraction, and the memory reported by the internal
+     *  compute funcs
+     */
+    MemoryUsage get_memory_usage() override;
+
     /**
      * @brief Serialize this function
      */
@@ -85,6 +137,23 @@ class OnlineQuantComputeFunc : public IComputeFunc {
     void deserialize_px(PxIStringStream &pstream) override;
 
   private:
+    /**
+     * @brief Register the use of the work and build directories, they are
+     *  only removed when the last compute func using them is destroyed
+     */
+    void acquire_dirs();
+
+    /** @brief Measure the size of the files in the acquired directories */
+    void measure_dirs();
+
+    /**
+     * @brief Export a prebuilt runtime module for each of the cross targets
+     *  that were built from this calibration run
+     */
+    void export_cross_targets(const std::vector<std::string> &targets,
+                              const std::vector<std::string> &build_dirs,
+                              const std::vector<std::string> &work_dirs);
+
     /** @brief The XGraph */
     XGraphHolder xg_;
     /** @brief The target device */
@@ -97,14 +166,24 @@ class OnlineQuantComputeFunc : public IComputeFunc {
     std::vector<std::string> out_tensor_names_;
     /** @brief The run options */
     RunOptionsHolder run_options_;
-    /** @brief The counter for counting the number of provided inputs */
-    int count_ = 0;
+    /** @brief The counter for counting the number of provided inputs, stops
+        counting after the first request executed after calibration */
+    std::atomic<int> count_{0};
     /** @brief Whether the provided target is supported on this device */
     bool is_target_supported_;
     /** @brief The internal compute function */
     ComputeFuncHolder cf_; //= nullptr;
     /** @brief The inernal quantization function */
     OpaqueFuncHolder quant_of_;
+    /** @brief The CPU calibration compute function kept as reference */
+    ComputeFuncHolder ref_cf_;
+    /** @brief Compares the internal compute function against the reference,
+        declared after it so that it's destroyed first */
+    std::shared_ptr<ShadowComparator> comparator_;
+    /** @brief The directories registered by acquire_dirs */
+    std::vector<std::string> acquired_dirs_;
+    /** @brief The size of the files in the acquired directories */
+    size_t build_files_size_ = 0;
 };
 
 } // namespace runtime
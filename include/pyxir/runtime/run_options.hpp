@@ -19,6 +19,9 @@
 #include <cstdlib>
 #include <memory>
 #include <bitset>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "../common/serializable.hpp"
 
@@ -31,6 +34,38 @@ struct RunOptions : public ISerializable {
     const char *env_quant_size = std::getenv("PX_QUANT_SIZE");
     if (env_quant_size != NULL)
       nb_quant_inputs = std::atoi(env_quant_size);
+    const char *env_nb_dpu_runners = std::getenv("PX_NB_DPU_RUNNERS");
+    if (env_nb_dpu_runners != NULL && std::atoi(env_nb_dpu_runners) > 0)
+      nb_dpu_runners = std::atoi(env_nb_dpu_runners);
+    const char *env_warmup_iterations = std::getenv("PX_WARMUP_ITERATIONS");
+    if (env_warmup_iterations != NULL && std::atoi(env_warmup_iterations) >= 0)
+      warmup_iterations = std::atoi(env_warmup_iterations);
+    const char *env_trace_path = std::getenv("PX_TRACE_PATH");
+    if (env_trace_path != NULL)
+      trace_path = env_trace_path;
+    const char *env_trace_outputs = std::getenv("PX_TRACE_OUTPUTS");
+    if (env_trace_outputs != NULL)
+      trace_outputs = std::atoi(env_trace_outputs) != 0;
+    const char *env_compare_every = std::getenv("PX_COMPARE_EVERY");
+    if (env_compare_every != NULL && std::atoi(env_compare_every) >= 0)
+      compare_every = std::atoi(env_compare_every);
+    const char *env_numa_node = std::getenv("PX_NUMA_NODE");
+    if (env_numa_node != NULL)
+      numa_node = std::atoi(env_numa_node);
+    const char *env_huge_pages = std::getenv("PX_HUGE_PAGES");
+    if (env_huge_pages != NULL)
+      huge_pages = env_huge_pages;
+    const char *env_memory_budget = std::getenv("PX_MEMORY_BUDGET");
+    if (env_memory_budget != NULL)
+      memory_budget = std::strtoull(env_memory_budget, NULL, 10);
+    const char *env_cross_targets = std::getenv("PX_CROSS_TARGETS");
+    if (env_cross_targets != NULL) {
+      std::istringstream targets(env_cross_targets);
+      std::string target;
+      while (std::getline(targets, target, ','))
+        if (!target.empty())
+          cross_targets.push_back(target);
+    }
   }
 
   /** @brief Whether to use on-the-fly quantization */
@@ -50,6 +85,38 @@ struct RunOptions : public ISerializable {
         implementation is free to choose when this happens. */
   // std::string load_runtime_module_path = ""; 
 
+  // The options below are deployment specific and are not serialized, they
+  //  can be set through environment variables
+
+  /** @brief The number of DPU runners over which large batches are split */
+  int nb_dpu_runners = 1;
+  /** @brief The number of synthetic warmup iterations run when a runtime
+        module is created or loaded, 0 disables warmup */
+  int warmup_iterations = 0;
+  /** @brief Capture the requests of runtime modules created or loaded with
+        these options to trace files at `<trace_path>.<pid>.<n>`, one per
+        module, empty disables capture */
+  std::string trace_path = "";
+  /** @brief Whether to capture the outputs next to the inputs */
+  bool trace_outputs = false;
+  /** @brief Compare every n-th request after on-the-fly quantization against
+        the CPU calibration runtime, 0 disables comparison */
+  int compare_every = 0;
+  /** @brief Bind runtime modules created or loaded with these options to
+        this NUMA node, -1 leaves placement to the OS */
+  int numa_node = -1;
+  /** @brief Back the weights and activation buffers of runtime modules with
+        huge pages: "transparent", "explicit" or empty to disable */
+  std::string huge_pages = "";
+  /** @brief The memory budget in bytes of runtime modules created or loaded
+        with these options, 0 disables the budget */
+  size_t memory_budget = 0;
+  /** @brief Additional targets to build for from the same on-the-fly
+        calibration run, the runtime module of each target is exported to
+        `<export_runtime_module_path>.<target>`, or to
+        `<build_dir>_<target>.rtmod` if no export path is set */
+  std::vector<std::string> cross_targets;
+
   virtual void serialize_px(PxOStringStream &pstream)
   {
     pstream.write(on_the_fly_quantization);
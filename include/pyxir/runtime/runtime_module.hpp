@@ -16,12 +16,28 @@
 
 #pragma once
 
+#include <deque>
+#include <atomic>
+#include <chrono>
 #include <vector>
+#include <cstring>
 #include <fstream>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include <unistd.h>
 
+#include "../common/allocator.hpp"
+#include "../common/mapped_file.hpp"
 #include "../common/serializable.hpp"
 #include "../runtime/compute_func_registry.hpp"
 #include "compute_func.hpp"
+#include "async.hpp"
+#include "batch_dispatch.hpp"
+#include "input_stage.hpp"
+#include "run_options.hpp"
+#include "trace.hpp"
+#include "kernel_func_factory.hpp"
 
 namespace pyxir {
 namespace runtime {
@@ -38,6 +54,20 @@ namespace runtime {
 // };
 
 
+/** @brief Timings of a runtime module warmup in microseconds */
+struct WarmupStats {
+  /** @brief The number of synthetic iterations that were run */
+  int iterations = 0;
+  /** @brief Time spent preparing the compute func and pre-faulting buffers */
+  double prepare_us = 0.;
+  /** @brief The latency of the first synthetic iteration */
+  double first_iteration_us = 0.;
+  /** @brief The mean latency of the remaining synthetic iterations */
+  double steady_iteration_us = 0.;
+  /** @brief Time until the runtime module was ready */
+  double total_us = 0.;
+};
+
 class RuntimeModule : public ISerializable {
 
   public:
@@ -53,6 +83,7 @@ class RuntimeModule : public ISerializable {
     { 
       compute_func_ = std::move(compute_func);
       init();
+      on_load();
     }
 
     void init()
@@ -64,10 +95,449 @@ class RuntimeModule : public ISerializable {
       });
     }
 
+    /**
+     * @brief Execute the model on the provided input buffers. If output
+     *  buffers are provided, results are written into them in place. If no
+     *  output buffers are provided but outputs were bound with bind_outputs,
+     *  the results are written into the bound buffers which are returned.
+     *  Concurrent calls are serialized if the compute func isn't reentrant.
+     */
     virtual void execute(std::vector<XBufferHolder> &in_tensors,
                          std::vector<XBufferHolder> &out_tensors)
     {
-      (*compute_func_)(in_tensors, out_tensors);
+      ScopedAllocator scope(get_allocator());
+      if (out_tensors.empty() && !bound_out_tensors_.empty())
+        out_tensors = bound_out_tensors_;
+      std::shared_ptr<TraceWriter> capture = std::atomic_load(&capture_);
+      TraceWriter::Clock::time_point start;
+      if (capture)
+        start = TraceWriter::Clock::now();
+
+      // Under a memory budget, large batches may be split into smaller ones
+      //  executed one after the other
+      const ssize_t batch = get_batch_size(in_tensors);
+      const ssize_t max_batch = max_batch_size_;
+      const bool split = max_batch > 0 && batch > max_batch;
+      if (split)
+        run_split_batch(in_tensors, out_tensors, max_batch);
+      else
+        run_compute_func(in_tensors, out_tensors);
+
+      if (capture)
+        capture->record(in_tensors, out_tensors, start, elapsed_us(start));
+      if (memory_budget_ > 0)
+        enforce_memory_budget(split ? max_batch : batch,
+                              has_batch_dim(out_tensors, batch));
+    }
+
+    /**
+     * @brief Submit the model for execution without blocking on the
+     *  accelerator. The returned completion is set on the executor once the
+     *  results are available in out_tensors. The output vector and the input
+     *  and output buffers have to stay alive until then. Execution errors
+     *  are reported through the completion. Batches exceeding the memory
+     *  budget are split and executed sequentially on the executor. Requests
+     *  on compute funcs that aren't reentrant are queued: the first one is
+     *  submitted on the calling thread, the next ones by the thread
+     *  completing the previous request.
+     * @param in_tensors The input buffers
+     * @param out_tensors The output buffers, bound or allocated if empty
+     * @param executor The executor completing the request
+     */
+    CompletionHolder execute_async(
+      std::vector<XBufferHolder> &in_tensors,
+      std::vector<XBufferHolder> &out_tensors,
+      CompletionExecutor &executor = CompletionExecutor::Global())
+    {
+      // Batches exceeding the memory budget are split and executed
+      //  sequentially on the executor
+      const ssize_t max_batch = max_batch_size_;
+      if (max_batch > 0 && get_batch_size(in_tensors) > max_batch) {
+        std::vector<XBufferHolder> *inputs = &in_tensors, *outputs = &out_tensors;
+        if (compute_func_->is_reentrant())
+          return executor.submit([this, inputs, outputs]() {
+            execute(*inputs, *outputs);
+          });
+        // The queued request already holds the compute func
+        return enqueue_serial([this, inputs, outputs, &executor]() {
+          return executor.submit([this, inputs, outputs]() {
+            compute_func_holder() = this;
+            try {
+              execute(*inputs, *outputs);
+            } catch (...) {
+              compute_func_holder() = nullptr;
+              throw;
+            }
+            compute_func_holder() = nullptr;
+          });
+        });
+      }
+      AllocatorHolder allocator = get_allocator();
+      ScopedAllocator scope(allocator);
+      if (out_tensors.empty() && !bound_out_tensors_.empty())
+        out_tensors = bound_out_tensors_;
+      // Keep the (preprocessed) inputs alive while the request is in flight
+      std::shared_ptr<std::vector<XBufferHolder>> inputs(
+        new std::vector<XBufferHolder>(in_tensors));
+      std::shared_ptr<TraceWriter> capture = std::atomic_load(&capture_);
+      TraceWriter::Clock::time_point start = TraceWriter::Clock::now();
+      std::shared_ptr<const InputStage> stage = get_input_stage();
+      try {
+        if (stage) {
+          // In flight requests can't share the reused input stage buffers
+          inputs->clear();
+          for (const XBufferHolder &frame : in_tensors) {
+            std::vector<XBufferHolder> stage_in{frame}, stage_out;
+            (*stage->kernel)(stage_in, stage_out);
+            inputs->push_back(stage_out[0]);
+          }
+        }
+      } catch (...) {
+        return Completion::Ready(std::current_exception());
+      }
+      // Capture the original inputs once the outputs are available
+      std::vector<XBufferHolder> raw_inputs;
+      if (capture)
+        raw_inputs = in_tensors;
+      std::vector<XBufferHolder> *outputs = &out_tensors;
+      std::function<CompletionHolder()> submit_request =
+        [this, inputs, outputs, capture, raw_inputs, start, allocator,
+         &executor]() -> CompletionHolder {
+          ScopedAllocator scope(allocator);
+          WaitFuncType wait;
+          try {
+            wait = compute_func_->submit(*inputs, *outputs);
+          } catch (...) {
+            return Completion::Ready(std::current_exception());
+          }
+          if (capture)
+            return executor.submit([wait, inputs, capture, raw_inputs,
+                                    outputs, start, allocator]() {
+              ScopedAllocator scope(allocator);
+              if (wait)
+                wait();
+              capture->record(raw_inputs, *outputs, start, elapsed_us(start));
+            });
+          if (!wait)
+            return executor.submit(WaitFuncType());
+          return executor.submit([wait, inputs, allocator]() {
+            ScopedAllocator scope(allocator);
+            wait();
+          });
+        };
+      if (compute_func_->is_reentrant())
+        return submit_request();
+      return enqueue_serial(submit_request);
+    }
+
+    /**
+     * @brief Execute the model on the bound input buffers and write the
+     *  results in place into the bound output buffers
+     */
+    void execute()
+    {
+      if (bound_in_tensors_.empty() || bound_out_tensors_.empty())
+        throw std::runtime_error("RuntimeModule: execute without arguments"
+                                 " requires bound input and output buffers");
+      std::vector<XBufferHolder> out_tensors(bound_out_tensors_);
+      execute(bound_in_tensors_, out_tensors);
+      // Compute funcs may hand back different buffers than the ones provided,
+      //  in which case the results are copied into the bound buffers
+      for (size_t i = 0; i < bound_out_tensors_.size(); ++i) {
+        XBufferHolder &bound = bound_out_tensors_[i];
+        if (out_tensors[i]->data != bound->data) {
+          if (out_tensors[i]->size * out_tensors[i]->itemsize != bound->size * bound->itemsize)
+            throw std::runtime_error("RuntimeModule: bound output buffer " +
+                                     std::to_string(i) + " has wrong size");
+          copy_buffer(*out_tensors[i], *bound);
+        }
+      }
+    }
+
+    /**
+     * @brief Bind (pinned) input buffers to this runtime module. The
+     *  buffers are used by every subsequent call to execute() without
+     *  arguments, so callers only have to update the buffer contents
+     * @param in_tensors The input buffers in the order of the input tensor names
+     */
+    void bind_inputs(const std::vector<XBufferHolder> &in_tensors)
+    {
+      if (!in_tensor_names_.empty() && in_tensors.size() != in_tensor_names_.size())
+        throw std::invalid_argument("RuntimeModule: expected " +
+                                    std::to_string(in_tensor_names_.size()) +
+                                    " input buffers to be bound but got " +
+                                    std::to_string(in_tensors.size()));
+      bound_in_tensors_ = in_tensors;
+    }
+
+    /**
+     * @brief Bind (pinned) output buffers to this runtime module. Results of
+     *  subsequent calls to execute are written into these buffers in place
+     * @param out_tensors The output buffers in the order of the output tensor names
+     */
+    void bind_outputs(const std::vector<XBufferHolder> &out_tensors)
+    {
+      if (!out_tensor_names_.empty() && out_tensors.size() != out_tensor_names_.size())
+        throw std::invalid_argument("RuntimeModule: expected " +
+                                    std::to_string(out_tensor_names_.size()) +
+                                    " output buffers to be bound but got " +
+                                    std::to_string(out_tensors.size()));
+      bound_out_tensors_ = out_tensors;
+    }
+
+    /** @brief Remove all input and output buffer bindings */
+    void clear_bindings()
+    {
+      bound_in_tensors_.clear();
+      bound_out_tensors_.clear();
+    }
+
+    std::vector<XBufferHolder> &get_bound_inputs() { return bound_in_tensors_; }
+
+    std::vector<XBufferHolder> &get_bound_outputs() { return bound_out_tensors_; }
+
+    /**
+     * @brief Enable the native input stage. Afterwards, execute expects raw
+     *  uint8 NHWC frames which are resized, normalised, transposed and
+     *  (optionally) quantized in one pass before being passed to the compute
+     *  function. The reused stage outputs are passed to the compute func as
+     *  its inputs, so compute funcs wrapping them (e.g. as DPU runner input
+     *  buffers) read what the stage wrote without a copy. Requests which
+     *  already started finish with the previous input stage.
+     * @param options The input stage configuration
+     * @throws std::invalid_argument if the stage quantizes its output but
+     *  the compute func only accepts float inputs
+     */
+    void set_input_stage(const InputStageOptions &options)
+    {
+      if (options.quantize && !compute_func_->accepts_quantized_inputs())
+        throw std::invalid_argument("RuntimeModule: the compute func doesn't"
+                                    " accept quantized inputs, the input stage"
+                                    " can't quantize");
+      XLayerHolder X = options.to_xlayer();
+      std::shared_ptr<InputStage> stage(new InputStage());
+      stage->kernel = KernelFuncFactory::GetKernelFunc("cpu.Preprocess", X);
+      stage->nchw = options.layout == "NCHW";
+      swap_input_stage(stage);
+    }
+
+    /** @brief Disable the native input stage, requests which already
+        started finish with it */
+    void clear_input_stage()
+    {
+      swap_input_stage(nullptr);
+    }
+
+    bool has_input_stage() const { return get_input_stage() != nullptr; }
+
+    /**
+     * @brief Start capturing the requests passed to execute to a trace file,
+     *  which can be replayed with replay_trace
+     * @param path The trace file path
+     * @param options The capture options
+     */
+    void start_capture(const std::string &path,
+                       const TraceOptions &options = TraceOptions())
+    {
+      std::shared_ptr<TraceWriter> capture(new TraceWriter(path, options));
+      std::atomic_store(&capture_, capture);
+    }
+
+    /** @brief Stop capturing and write the remaining records */
+    void stop_capture()
+    {
+      std::shared_ptr<TraceWriter> capture =
+        std::atomic_exchange(&capture_, std::shared_ptr<TraceWriter>());
+      if (capture)
+        capture->flush();
+    }
+
+    /**
+     * @brief Return the statistics of the comparison of the compute func
+     *  against its reference on sampled requests, e.g. DPU against CPU
+     *  execution after on-the-fly quantization
+     */
+    ComparisonStats get_comparison_stats()
+    {
+      return compute_func_->get_comparison_stats();
+    }
+
+    /**
+     * @brief Bind this runtime module to a NUMA node. Buffers allocated while
+     *  executing requests and the weights of the compute func are placed on
+     *  the node and the bound buffers are migrated to it. The calling threads aren't bound, use
+     *  numa::bind_thread or the NUMA nodes of the RequestScheduler for that.
+     *  Bind before serving requests.
+     * @param node The NUMA node, -1 removes the binding
+     */
+    void bind_numa_node(int node)
+    {
+      numa_node_ = node;
+      update_allocator();
+      if (node < 0)
+        return;
+      compute_func_->move_weights(placement_);
+      for (XBufferHolder &xb : bound_in_tensors_)
+        numa::bind_memory(xb->data, xb->size * xb->itemsize, node, true);
+      for (XBufferHolder &xb : bound_out_tensors_)
+        numa::bind_memory(xb->data, xb->size * xb->itemsize, node, true);
+    }
+
+    /**
+     * @brief Back the buffers allocated while executing requests and the
+     *  weights of the compute func with huge pages, falling back to regular
+     *  pages if huge pages aren't available. Freed activation buffers are
+     *  kept for reuse by later requests. Set before serving requests.
+     * @param mode The huge page mode, NONE disables huge pages
+     */
+    void set_huge_page_mode(HugePageMode mode)
+    {
+      huge_page_mode_ = mode;
+      update_allocator();
+      if (huge_pages_)
+        compute_func_->move_weights(huge_pages_);
+    }
+
+    /** @brief Return the huge page coverage of the memory allocated for this
+        module, empty if huge pages aren't enabled */
+    HugePageStats get_huge_page_stats()
+    {
+      return huge_pages_ ? huge_pages_->get_stats() : HugePageStats();
+    }
+
+    /**
+     * @brief Set a memory budget for this module. If the module doesn't fit,
+     *  freed buffers that are cached for reuse are released and large
+     *  batches are split into smaller ones that are executed sequentially.
+     *  Requests after which the module still doesn't fit are reported.
+     * @param budget The budget in bytes, 0 disables the budget
+     */
+    void set_memory_budget(size_t budget)
+    {
+      memory_budget_ = budget;
+      max_batch_size_ = 0;
+      split_batches_ = true;
+      over_budget_ = 0;
+      static_memory_ = compute_func_->get_memory_usage().static_total();
+    }
+
+    /**
+     * @brief Return the memory used by this module by category. The buffers
+     *  allocated while executing requests are tracked, the other categories
+     *  are reported by the compute func.
+     */
+    MemoryUsage get_memory_usage()
+    {
+      MemoryUsage usage = compute_func_->get_memory_usage();
+      static_memory_ = usage.static_total();
+      usage.intermediates = memory_counter_->live;
+      usage.peak_intermediates = memory_counter_->peak;
+      if (huge_pages_)
+        usage.cached = huge_pages_->get_stats().cached_bytes;
+      usage.budget = memory_budget_;
+      usage.over_budget = over_budget_;
+      return usage;
+    }
+
+    /** @brief Return the maximum batch size chosen to meet the memory budget,
+        0 if batches aren't split */
+    ssize_t get_max_batch_size() const { return max_batch_size_; }
+
+    /** @brief Return the NUMA node this module is bound to, -1 if unbound */
+    int get_numa_node() const { return numa_node_; }
+
+    /**
+     * @brief Return where the pages of the bound and reused input stage
+     *  buffers reside relative to the NUMA node of this module, or to the
+     *  node of the calling thread if the module isn't bound
+     */
+    numa::PageLocality get_numa_locality()
+    {
+      int node = numa_node_ >= 0 ? numa_node_ : numa::get_current_node();
+      numa::PageLocality res;
+      for (XBufferHolder &xb : bound_in_tensors_)
+        res += numa::get_page_locality(xb->data, xb->size * xb->itemsize, node);
+      for (XBufferHolder &xb : bound_out_tensors_)
+        res += numa::get_page_locality(xb->data, xb->size * xb->itemsize, node);
+      std::lock_guard<std::mutex> lock(input_stage_mtx_);
+      for (std::unique_ptr<InputStageBuffers> &buffers : input_stage_pool_)
+        for (XBufferHolder &xb : buffers->out)
+          if (xb)
+            res += numa::get_page_locality(xb->data, xb->size * xb->itemsize, node);
+      return res;
+    }
+
+    /** @brief Return the active trace writer, null if not capturing */
+    std::shared_ptr<TraceWriter> get_capture() { return std::atomic_load(&capture_); }
+
+    /**
+     * @brief Warm up this runtime module so that the first request doesn't
+     *  pay for lazy initialization. The compute func is prepared, bound
+     *  buffers are pre-faulted and a number of synthetic iterations with
+     *  zero inputs is run. Synthetic iterations are skipped if the compute
+     *  func doesn't allow them, e.g. during on-the-fly quantization.
+     *  With an input stage, the synthetic inputs are uint8 NHWC frames
+     *  that are passed through the stage like regular requests.
+     * @param nb_iterations The number of synthetic iterations
+     * @param in_shapes The input shapes (frame shapes with an input stage),
+     *  by default the shapes of the bound inputs or the shapes declared by
+     *  the compute func are used
+     */
+    WarmupStats warmup(int nb_iterations = 1,
+                       const std::vector<std::vector<ssize_t>> &in_shapes =
+                         std::vector<std::vector<ssize_t>>())
+    {
+      typedef std::chrono::steady_clock Clock;
+      WarmupStats stats;
+      Clock::time_point start = Clock::now();
+
+      bool run_iterations = compute_func_->warmup();
+      for (XBufferHolder &xb : bound_in_tensors_)
+        prefault(*xb);
+      for (XBufferHolder &xb : bound_out_tensors_)
+        prefault(*xb);
+
+      std::vector<XBufferHolder> in_tensors;
+      if (run_iterations && nb_iterations > 0) {
+        std::vector<std::vector<ssize_t>> shapes(in_shapes);
+        if (shapes.empty() && !bound_in_tensors_.empty())
+          in_tensors = bound_in_tensors_;
+        else if (shapes.empty())
+          shapes = get_frame_shapes(compute_func_->get_in_shapes());
+        for (std::vector<ssize_t> &shape : shapes) {
+          XBufferHolder xb = has_input_stage() ? create_buffer(shape, 1, "B")
+                                               : create_buffer(shape);
+          std::memset(xb->data, 0, xb->size * xb->itemsize);
+          in_tensors.push_back(xb);
+        }
+        if (in_tensors.empty())
+          throw std::invalid_argument("RuntimeModule: warmup requires input"
+                                      " shapes or bound input buffers");
+      }
+      stats.prepare_us = elapsed_us(start);
+
+      if (!in_tensors.empty()) {
+        for (int i = 0; i < nb_iterations; ++i) {
+          std::vector<XBufferHolder> out_tensors;
+          Clock::time_point iter_start = Clock::now();
+          execute(in_tensors, out_tensors);
+          double iter_us = elapsed_us(iter_start);
+          if (i == 0)
+            stats.first_iteration_us = iter_us;
+          else
+            stats.steady_iteration_us += iter_us / (nb_iterations - 1);
+        }
+        stats.iterations = nb_iterations;
+      } else if (nb_iterations > 0) {
+        pxInfo("RuntimeModule: skipping synthetic warmup iterations as the"
+               " compute func doesn't allow them");
+      }
+      stats.total_us = elapsed_us(start);
+      pxDebug("RuntimeModule: warmup took " + std::to_string(stats.total_us)
+              + "us, first iteration: " + std::to_string(stats.first_iteration_us)
+              + "us, steady state: " + std::to_string(stats.steady_iteration_us)
+              + "us");
+      return stats;
     }
 
     std::vector<std::string> get_in_tensor_names() { return in_tensor_names_; }
@@ -127,25 +597,457 @@ class RuntimeModule : public ISerializable {
 
     static std::unique_ptr<RuntimeModule> Load(const std::string &file_path)
     {
-      std::ifstream in_file(file_path);
-      std::stringstream buffer;
-      buffer << in_file.rdbuf();
-      std::string serialized_rt_mod = buffer.str();
-      in_file.close();
-      std::istringstream sstream(serialized_rt_mod);
+      MappedFile file(file_path);
+      return LoadFromBuffer(file.data(), file.size());
+    }
+
+    /**
+     * @brief Load a runtime module from a serialized module in memory, e.g.
+     *  a memory mapped module file. The memory is read in place and has to
+     *  stay valid during the call only.
+     */
+    static std::unique_ptr<RuntimeModule> LoadFromBuffer(const char *data,
+                                                         size_t size)
+    {
+      // Read through a stream buffer over the memory instead of copying it
+      //  into the string stream
+      MemoryStreamBuf buffer(data, size);
+      std::istringstream sstream;
+      sstream.std::basic_ios<char>::rdbuf(&buffer);
       std::unique_ptr<RuntimeModule> rt_mod(new RuntimeModule());
       rt_mod->deserialize(sstream);
+      rt_mod->on_load();
       return rt_mod;
     }
 
     virtual ~RuntimeModule() {}
 
   protected:
+    /** @brief Run the warmup and start the capture requested through the
+        run options */
+    void on_load()
+    {
+      if (!run_options_)
+        return;
+      if (run_options_->numa_node >= 0)
+        bind_numa_node(run_options_->numa_node);
+      if (parse_huge_page_mode(run_options_->huge_pages) != HugePageMode::NONE)
+        set_huge_page_mode(parse_huge_page_mode(run_options_->huge_pages));
+      if (run_options_->memory_budget > 0)
+        set_memory_budget(run_options_->memory_budget);
+      if (run_options_->warmup_iterations > 0) {
+        try {
+          warmup(run_options_->warmup_iterations);
+        } catch (std::exception &e) {
+          pxWarning(std::string("RuntimeModule: warmup failed: ") + e.what());
+        }
+      }
+      if (!run_options_->trace_path.empty()) {
+        TraceOptions options;
+        options.capture_outputs = run_options_->trace_outputs;
+        start_capture(trace::unique_path(run_options_->trace_path), options);
+      }
+    }
+
+    /** @brief Touch every page of the buffer so that page faults happen
+        before the first request, the buffer contents are preserved */
+    static void prefault(XBuffer &xb)
+    {
+      if (!xb.is_contiguous())
+        return;
+      static const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+      volatile char *data = (volatile char *) xb.data;
+      size_t nb_bytes = xb.size * xb.itemsize;
+      for (size_t i = 0; i < nb_bytes; i += page_size)
+        data[i] = data[i];
+    }
+
+    /** @brief Return the shapes of the frames producing network inputs of
+        the given shapes, i.e. NHWC frame shapes if an input stage is set */
+    std::vector<std::vector<ssize_t>> get_frame_shapes(
+      std::vector<std::vector<ssize_t>> shapes) const
+    {
+      std::shared_ptr<const InputStage> stage = get_input_stage();
+      if (!stage || !stage->nchw)
+        return shapes;
+      for (std::vector<ssize_t> &shape : shapes)
+        if (shape.size() == 4)
+          shape = std::vector<ssize_t>{shape[0], shape[2], shape[3], shape[1]};
+      return shapes;
+    }
+
+    static ssize_t get_batch_size(const std::vector<XBufferHolder> &in_tensors)
+    {
+      return in_tensors.empty() || in_tensors[0]->shape.empty()
+        ? 1 : in_tensors[0]->shape[0];
+    }
+
+    /** @brief Whether all outputs have the given batch size as their
+        first dimension, i.e. whether batches can be split */
+    static bool has_batch_dim(const std::vector<XBufferHolder> &out_tensors,
+                              ssize_t batch)
+    {
+      for (const XBufferHolder &xb : out_tensors)
+        if (xb->shape.empty() || xb->shape[0] != batch)
+          return false;
+      return true;
+    }
+
+    /**
+     * @brief Execute the batch in chunks of at most max_batch samples. If no
+     *  outputs are provided, the first chunk allocates its outputs and the
+     *  batch outputs are created from their shapes. Batches are only split
+     *  once a request showed that the outputs have a batch dimension.
+     */
+    void run_split_batch(std::vector<XBufferHolder> &in_tensors,
+                         std::vector<XBufferHolder> &out_tensors,
+                         ssize_t max_batch)
+    {
+      const ssize_t batch = in_tensors[0]->shape[0];
+      ssize_t begin = 0;
+      if (out_tensors.empty()) {
+        std::vector<XBufferHolder> in_chunk, out_chunk;
+        for (const XBufferHolder &xb : in_tensors)
+          in_chunk.push_back(slice(xb, 0, 0, max_batch));
+        run_compute_func(in_chunk, out_chunk);
+        if (!has_batch_dim(out_chunk, max_batch)) {
+          // The output shapes changed since splitting was enabled
+          split_batches_ = false;
+          max_batch_size_ = 0;
+          throw std::runtime_error("RuntimeModule: can't split the batch to"
+                                   " meet the memory budget, the outputs"
+                                   " have no batch dimension");
+        }
+        for (const XBufferHolder &xb : out_chunk) {
+          std::vector<ssize_t> shape(xb->shape);
+          shape[0] = batch;
+          out_tensors.push_back(create_buffer(shape, xb->itemsize, xb->format));
+          copy_buffer(*xb, *slice(out_tensors.back(), 0, 0, max_batch));
+        }
+        begin = max_batch;
+      }
+
+      std::vector<XBufferHolder> in_rest, out_rest;
+      for (const XBufferHolder &xb : in_tensors)
+        in_rest.push_back(slice(xb, 0, begin, batch));
+      for (const XBufferHolder &xb : out_tensors)
+        out_rest.push_back(slice(xb, 0, begin, batch));
+      dispatch_batch(in_rest, out_rest, max_batch, 1,
+        [this](size_t, std::vector<XBufferHolder> &in_chunk,
+               std::vector<XBufferHolder> &out_chunk) {
+          std::vector<XBufferHolder> out_views(out_chunk);
+          run_compute_func(in_chunk, out_chunk);
+          for (size_t i = 0; i < out_views.size(); ++i)
+            if (out_chunk[i]->data != out_views[i]->data)
+              copy_buffer(*out_chunk[i], *out_views[i]);
+        });
+    }
+
+    void run_compute_func(std::vector<XBufferHolder> &in_tensors,
+                          std::vector<XBufferHolder> &out_tensors)
+    {
+      std::shared_ptr<const InputStage> stage = get_input_stage();
+      if (stage) {
+        // Concurrent requests each take their own set of stage buffers
+        std::unique_ptr<InputStageBuffers> buffers;
+        {
+          std::lock_guard<std::mutex> lock(input_stage_mtx_);
+          if (!input_stage_pool_.empty()) {
+            buffers = std::move(input_stage_pool_.back());
+            input_stage_pool_.pop_back();
+          }
+        }
+        if (!buffers)
+          buffers.reset(new InputStageBuffers());
+        run_input_stage(*stage->kernel, in_tensors, *buffers);
+        call_compute_func(buffers->out, out_tensors);
+        // Buffers of a replaced input stage aren't reused
+        std::lock_guard<std::mutex> lock(input_stage_mtx_);
+        if (stage == get_input_stage())
+          input_stage_pool_.push_back(std::move(buffers));
+      } else {
+        call_compute_func(in_tensors, out_tensors);
+      }
+    }
+
+    /** @brief Call the compute func, one call at a time if it isn't
+        reentrant */
+    void call_compute_func(std::vector<XBufferHolder> &in_tensors,
+                           std::vector<XBufferHolder> &out_tensors)
+    {
+      if (compute_func_->is_reentrant() || compute_func_holder() == this) {
+        (*compute_func_)(in_tensors, out_tensors);
+        return;
+      }
+      {
+        std::unique_lock<std::mutex> lock(serial_mtx_);
+        serial_cv_.wait(lock, [this]() { return !serial_busy_; });
+        serial_busy_ = true;
+      }
+      try {
+        (*compute_func_)(in_tensors, out_tensors);
+      } catch (...) {
+        run_serial_queue();
+        throw;
+      }
+      run_serial_queue();
+    }
+
+    /**
+     * @brief Queue a request on the compute func that isn't reentrant and
+     *  return the completion of the request. The request is submitted
+     *  right away if the compute func is idle, otherwise once the requests
+     *  before it completed.
+     * @param submit_request Submits the request and returns its completion,
+     *  reporting errors through the completion
+     */
+    CompletionHolder enqueue_serial(std::function<CompletionHolder()> submit_request)
+    {
+      CompletionHolder result(new Completion());
+      std::function<CompletionHolder()> job = [submit_request, result]() {
+        CompletionHolder done = submit_request();
+        done->then([result, done]() { result->set(done->error()); });
+        return done;
+      };
+      bool idle;
+      {
+        std::lock_guard<std::mutex> lock(serial_mtx_);
+        serial_queue_.push_back(std::move(job));
+        idle = !serial_busy_;
+        serial_busy_ = true;
+      }
+      if (idle)
+        run_serial_queue();
+      return result;
+    }
+
+    /**
+     * @brief Hand the compute func that isn't reentrant to the next queued
+     *  request, or release it if none is queued. Queued requests which
+     *  complete synchronously are run in a loop, the completion of a
+     *  pending one continues with the rest of the queue.
+     */
+    void run_serial_queue()
+    {
+      while (true) {
+        std::function<CompletionHolder()> next;
+        {
+          std::lock_guard<std::mutex> lock(serial_mtx_);
+          if (serial_queue_.empty()) {
+            serial_busy_ = false;
+            break;
+          }
+          next = std::move(serial_queue_.front());
+          serial_queue_.pop_front();
+        }
+        CompletionHolder done = next();
+        if (done->then_if_pending([this]() { run_serial_queue(); }))
+          return;
+      }
+      serial_cv_.notify_all();
+    }
+
+    /** @brief The runtime module whose compute func the current thread
+        holds while executing a queued request */
+    static const RuntimeModule *&compute_func_holder()
+    {
+      static thread_local const RuntimeModule *holder = nullptr;
+      return holder;
+    }
+
+    /**
+     * @brief Check the memory used by the last request of the given batch
+     *  size against the budget and pick lower memory strategies if it
+     *  doesn't fit: release the cached buffers and shrink the batch size if
+     *  the outputs of the request are splittable along the batch
+     */
+    void enforce_memory_budget(ssize_t batch, bool splittable)
+    {
+      const size_t budget = memory_budget_;
+      const size_t static_bytes = static_memory_;
+      const size_t peak = memory_counter_->peak;
+      memory_counter_->reset_peak();
+      const size_t headroom = budget > static_bytes ? budget - static_bytes : 0;
+      if (huge_pages_)
+        huge_pages_->set_max_cached_bytes(headroom > peak ? headroom - peak : 0);
+      if (peak <= headroom)
+        return;
+
+      // The request buffers grow with the batch size
+      if (batch > 1 && split_batches_ && !splittable) {
+        split_batches_ = false;
+        pxWarning("RuntimeModule: can't split batches to meet the memory"
+                  " budget, the outputs have no batch dimension");
+      }
+      if (batch > 1 && split_batches_) {
+        size_t per_sample = std::max<size_t>(peak / batch, 1);
+        ssize_t fit = std::max<ssize_t>((ssize_t) (headroom / per_sample), 1);
+        if (fit < batch) {
+          max_batch_size_ = fit;
+          pxInfo("RuntimeModule: splitting batches into batches of "
+                 + std::to_string(fit) + " to meet the memory budget");
+          return;
+        }
+      }
+      if (over_budget_++ == 0)
+        pxWarning("RuntimeModule: can't meet the memory budget of "
+                  + std::to_string(budget) + " bytes, using "
+                  + std::to_string(static_bytes + peak) + " bytes");
+    }
+
+    /** @brief Create the allocators for the NUMA node and huge page mode,
+        buffers allocated while executing are accounted to this module */
+    void update_allocator()
+    {
+      huge_pages_.reset();
+      if (huge_page_mode_ != HugePageMode::NONE) {
+        huge_pages_.reset(new HugePageAllocator(huge_page_mode_, numa_node_));
+        placement_ = huge_pages_;
+      } else if (numa_node_ >= 0) {
+        placement_.reset(new NumaAllocator(numa_node_));
+      } else {
+        placement_.reset();
+      }
+      allocator_.reset(new TrackingAllocator(memory_counter_, placement_));
+      std::lock_guard<std::mutex> lock(thread_allocators_mtx_);
+      thread_allocators_.clear();
+    }
+
+    /** @brief Return the allocator for buffers allocated while executing,
+        tracking the allocator of the calling thread if the module isn't
+        bound to a NUMA node or huge pages */
+    AllocatorHolder get_allocator()
+    {
+      const AllocatorHolder &thread_alloc = thread_allocator();
+      if (placement_ || !thread_alloc || thread_alloc == allocator_)
+        return allocator_;
+      // Reuse the tracking allocator wrapping the thread allocator, threads
+      //  usually install one of a few allocators, e.g. one per NUMA node
+      std::lock_guard<std::mutex> lock(thread_allocators_mtx_);
+      for (const std::shared_ptr<TrackingAllocator> &alloc : thread_allocators_)
+        if (alloc->get_inner() == thread_alloc)
+          return alloc;
+      if (thread_allocators_.size() >= MAX_THREAD_ALLOCATORS)
+        thread_allocators_.erase(thread_allocators_.begin());
+      thread_allocators_.emplace_back(
+        new TrackingAllocator(memory_counter_, thread_alloc));
+      return thread_allocators_.back();
+    }
+
+    static double elapsed_us(std::chrono::steady_clock::time_point start)
+    {
+      return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count();
+    }
+
+    /** @brief The native input stage, replaced as a whole so that running
+        requests keep using the one they started with */
+    struct InputStage {
+      KernelFuncHolder kernel;
+      /** @brief Whether the input stage produces NCHW network inputs */
+      bool nchw = true;
+    };
+
+    std::shared_ptr<const InputStage> get_input_stage() const
+    {
+      return std::atomic_load(&input_stage_);
+    }
+
+    void swap_input_stage(std::shared_ptr<const InputStage> stage)
+    {
+      std::lock_guard<std::mutex> lock(input_stage_mtx_);
+      std::atomic_store(&input_stage_, stage);
+      input_stage_pool_.clear();
+    }
+
+    /** @brief A set of reused input stage output buffers */
+    struct InputStageBuffers {
+      /** @brief The input stage output buffers */
+      std::vector<XBufferHolder> out;
+      /** @brief The frame shapes corresponding to the output buffers */
+      std::vector<std::vector<ssize_t>> in_shapes;
+    };
+
+    /**
+     * @brief Run the input stage on every provided frame buffer. The stage
+     *  output buffers are allocated once per buffer set and reused as long
+     *  as the frame shapes don't change
+     */
+    void run_input_stage(KernelFunc &stage,
+                         std::vector<XBufferHolder> &in_tensors,
+                         InputStageBuffers &buffers)
+    {
+      if (buffers.out.size() != in_tensors.size()
+          || buffers.in_shapes.size() != in_tensors.size()) {
+        buffers.out.assign(in_tensors.size(), nullptr);
+        buffers.in_shapes.assign(in_tensors.size(), std::vector<ssize_t>());
+      }
+      for (size_t i = 0; i < in_tensors.size(); ++i) {
+        std::vector<XBufferHolder> stage_in{in_tensors[i]};
+        std::vector<XBufferHolder> stage_out;
+        if (buffers.out[i] && buffers.in_shapes[i] == in_tensors[i]->shape)
+          stage_out.push_back(buffers.out[i]);
+        stage(stage_in, stage_out);
+        buffers.out[i] = stage_out[0];
+        buffers.in_shapes[i] = in_tensors[i]->shape;
+      }
+    }
+
     ComputeFuncHolder compute_func_ = nullptr;
+    /** @brief Serializes the requests on a compute func that isn't
+        reentrant: whether a request holds the compute func and the queued
+        asynchronous requests */
+    std::mutex serial_mtx_;
+    std::condition_variable serial_cv_;
+    bool serial_busy_ = false;
+    std::deque<std::function<CompletionHolder()>> serial_queue_;
     std::vector<std::string> in_tensor_names_;
     std::vector<std::string> out_tensor_names_;
     RunOptionsHolder run_options_;
+    /** @brief The bound input buffers */
+    std::vector<XBufferHolder> bound_in_tensors_;
+    /** @brief The bound output buffers */
+    std::vector<XBufferHolder> bound_out_tensors_;
+    /** @brief The optional native input stage, loaded and stored
+        atomically and only replaced under the input stage mutex */
+    std::shared_ptr<const InputStage> input_stage_;
+    /** @brief The idle input stage buffer sets of the current input stage,
+        one per concurrent request */
+    std::vector<std::unique_ptr<InputStageBuffers>> input_stage_pool_;
+    std::mutex input_stage_mtx_;
+    /** @brief The active request capture */
+    std::shared_ptr<TraceWriter> capture_;
+    /** @brief The NUMA node this module is bound to, -1 if unbound */
+    int numa_node_ = -1;
+    /** @brief The huge page mode */
+    HugePageMode huge_page_mode_ = HugePageMode::NONE;
+    /** @brief The huge page allocator, null if huge pages aren't enabled */
+    std::shared_ptr<HugePageAllocator> huge_pages_;
+    /** @brief The allocator placing buffers on the NUMA node and/or huge
+        pages, null for the heap */
+    AllocatorHolder placement_;
+    /** @brief The live and peak bytes allocated while executing */
+    std::shared_ptr<AllocationCounter> memory_counter_{new AllocationCounter()};
+    /** @brief The allocator for buffers allocated while executing */
+    AllocatorHolder allocator_{new TrackingAllocator(memory_counter_)};
+    /** @brief The tracking allocators wrapping thread allocators, least
+        recently created first */
+    std::vector<std::shared_ptr<TrackingAllocator>> thread_allocators_;
+    std::mutex thread_allocators_mtx_;
+    static const size_t MAX_THREAD_ALLOCATORS = 8;
+    /** @brief The memory budget in bytes, 0 if there is none */
+    size_t memory_budget_ = 0;
+    /** @brief The memory used independent of the requests */
+    std::atomic<size_t> static_memory_{0};
+    /** @brief The batch size that meets the memory budget, 0 if unlimited */
+    std::atomic<ssize_t> max_batch_size_{0};
+    /** @brief Whether batches can be split to meet the memory budget */
+    std::atomic<bool> split_batches_{true};
+    /** @brief Requests after which the module didn't fit in the budget */
+    std::atomic<uint64_t> over_budget_{0};
 };
+
+typedef std::shared_ptr<RuntimeModule> SharedRtModHolder;
     
 } // namespace runtime
 
@@ -0,0 +1,331 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <condition_variable>
+
+#include "async.hpp"
+#include "stats.hpp"
+#include "runtime_module.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+/** @brief Request priority classes, high priority requests are served first */
+enum class Priority { HIGH = 0, LOW = 1 };
+
+/** @brief Error reported for requests that are rejected or dropped */
+class RequestRejected : public std::runtime_error {
+  public:
+    explicit RequestRejected(const std::string &msg) : std::runtime_error(msg) {}
+};
+
+struct SchedulerOptions {
+  /** @brief The maximum number of queued requests. On a full queue, the
+      lowest priority queued request is evicted for a request of a higher
+      priority class, other requests are rejected (back-pressure) */
+  size_t max_queue_size = 64;
+  /** @brief The number of worker threads executing requests. Worker i
+      executes on runtime module i modulo the number of modules and calls
+      on the same module are serialized */
+  size_t nb_workers = 1;
+  /** @brief The NUMA nodes over which the workers are spread round robin.
+      Workers are bound to the CPUs of their node and allocate intermediate
+      buffers on it, empty leaves placement to the OS */
+  std::vector<int> numa_nodes;
+  /** @brief The smoothing factor of the service time moving average used
+      for admission control */
+  double ewma_alpha = 0.2;
+};
+
+struct SchedulerMetrics {
+  uint64_t submitted = 0;
+  uint64_t completed = 0;
+  uint64_t failed = 0;
+  /** @brief Requests rejected because the queue was full */
+  uint64_t rejected_queue_full = 0;
+  /** @brief Queued requests evicted for a higher priority request on a
+      full queue */
+  uint64_t evicted = 0;
+  /** @brief Requests rejected on admission because they couldn't meet
+      their deadline */
+  uint64_t rejected_deadline = 0;
+  /** @brief Requests dropped because their deadline passed while queued */
+  uint64_t expired = 0;
+  /** @brief Time between submission and start of execution */
+  LatencyStats queue_delay;
+  /** @brief Execution time */
+  LatencyStats service_time;
+  /** @brief The current service time estimate used for admission control */
+  double ewma_service_us = 0.;
+};
+
+/**
+ * @brief Scheduler in front of a runtime module supporting per request
+ *  deadlines and priorities. Requests are queued in a bounded queue ordered
+ *  by priority class and earliest deadline and executed by a number of
+ *  worker threads. Requests that can't meet their deadline given the
+ *  estimated queueing delay are rejected on submission, requests whose
+ *  deadline passes while queued are dropped. Workers sharing a runtime
+ *  module whose compute func isn't reentrant execute one after the other
+ *  (see IComputeFunc::is_reentrant); pass a module (clone) per worker for
+ *  concurrent execution.
+ */
+class RequestScheduler {
+
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    RequestScheduler(RuntimeModule &rt_mod,
+                     const SchedulerOptions &options = SchedulerOptions())
+      : RequestScheduler(std::vector<RuntimeModule *>{&rt_mod}, options) {}
+
+    /**
+     * @brief Create a scheduler over a number of equivalent runtime modules,
+     *  e.g. one module per worker
+     * @param rt_mods The runtime modules, which have to outlive the scheduler
+     * @param options The scheduler options
+     */
+    RequestScheduler(const std::vector<RuntimeModule *> &rt_mods,
+                     const SchedulerOptions &options = SchedulerOptions())
+      : rt_mods_(rt_mods), options_(options)
+    {
+      if (rt_mods_.empty())
+        throw std::invalid_argument("RequestScheduler: expected at least one"
+                                    " runtime module");
+      size_t nb_workers = options_.nb_workers > 0 ? options_.nb_workers : 1;
+      for (size_t i = 0; i < nb_workers; ++i) {
+        int node = options_.numa_nodes.empty() ? -1
+          : options_.numa_nodes[i % options_.numa_nodes.size()];
+        size_t mod_idx = i % rt_mods_.size();
+        workers_.emplace_back([this, node, mod_idx]() { run(node, mod_idx); });
+      }
+    }
+
+    ~RequestScheduler()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      for (auto &w : workers_)
+        w.join();
+      // Fail requests that were never started
+      for (auto &it : queue_)
+        it.second.completion->set(std::make_exception_ptr(
+          RequestRejected("RequestScheduler: scheduler was stopped")));
+    }
+
+    RequestScheduler(const RequestScheduler &) = delete;
+    RequestScheduler &operator=(const RequestScheduler &) = delete;
+
+    /**
+     * @brief Submit a request. The returned completion reports a
+     *  RequestRejected error if the request was rejected or dropped. The
+     *  input and output vectors have to stay alive until completion.
+     * @param in_tensors The input buffers
+     * @param out_tensors The output buffers
+     * @param priority The priority class
+     * @param deadline The time before which execution has to finish
+     */
+    CompletionHolder submit(std::vector<XBufferHolder> &in_tensors,
+                            std::vector<XBufferHolder> &out_tensors,
+                            Priority priority = Priority::LOW,
+                            Clock::time_point deadline = Clock::time_point::max())
+    {
+      CompletionHolder completion(new Completion());
+      CompletionHolder evicted;
+      Clock::time_point now = Clock::now();
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++metrics_.submitted;
+        if (deadline != Clock::time_point::max()
+            && estimate_completion(now, priority, deadline) > deadline) {
+          ++metrics_.rejected_deadline;
+          return reject(completion, "RequestScheduler: request can't meet"
+                                    " its deadline");
+        }
+        if (queue_.size() >= options_.max_queue_size) {
+          // Make room by evicting the least urgent request of a lower
+          //  priority class, if any
+          auto last = queue_.empty() ? queue_.end() : std::prev(queue_.end());
+          if (last == queue_.end() || std::get<0>(last->first) <= priority) {
+            ++metrics_.rejected_queue_full;
+            return reject(completion, "RequestScheduler: queue is full");
+          }
+          ++metrics_.evicted;
+          evicted = last->second.completion;
+          queue_.erase(last);
+        }
+        Request req;
+        req.in_tensors = &in_tensors;
+        req.out_tensors = &out_tensors;
+        req.deadline = deadline;
+        req.submitted = now;
+        req.completion = completion;
+        queue_.emplace(QueueKey(priority, deadline, seq_++), std::move(req));
+      }
+      cv_.notify_one();
+      if (evicted)
+        evicted->set(std::make_exception_ptr(RequestRejected(
+          "RequestScheduler: evicted for a higher priority request")));
+      return completion;
+    }
+
+    /** @brief Return a snapshot of the scheduler metrics */
+    SchedulerMetrics get_metrics()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return metrics_;
+    }
+
+    /** @brief Return the number of queued requests */
+    size_t queue_size()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return queue_.size();
+    }
+
+  private:
+    struct Request {
+      std::vector<XBufferHolder> *in_tensors;
+      std::vector<XBufferHolder> *out_tensors;
+      Clock::time_point deadline;
+      Clock::time_point submitted;
+      CompletionHolder completion;
+    };
+
+    // Ordered by priority class, then earliest deadline, then arrival
+    typedef std::tuple<Priority, Clock::time_point, uint64_t> QueueKey;
+
+    CompletionHolder reject(CompletionHolder &completion, const std::string &msg)
+    {
+      completion->set(std::make_exception_ptr(RequestRejected(msg)));
+      return completion;
+    }
+
+    /**
+     * @brief Estimate when a new request with the given priority and
+     *  deadline would finish, based on the number of requests served before
+     *  it in priority and earliest deadline order and the moving average
+     *  service time. Expects the lock to be held.
+     */
+    Clock::time_point estimate_completion(Clock::time_point now,
+                                          Priority priority,
+                                          Clock::time_point deadline)
+    {
+      // Queued requests with the same priority and deadline were submitted
+      //  earlier and are served first as well
+      size_t ahead = (size_t) std::distance(queue_.begin(), queue_.upper_bound(
+        QueueKey(priority, deadline, std::numeric_limits<uint64_t>::max())));
+      const size_t nb_workers = workers_.size();
+      // Requests ahead are served by all workers, plus the request itself
+      //  and the ones currently in service
+      double wait_us = metrics_.ewma_service_us
+        * ((double) (ahead + busy_) / nb_workers + 1.);
+      return now + std::chrono::microseconds((int64_t) wait_us);
+    }
+
+    void run(int node, size_t mod_idx)
+    {
+      AllocatorHolder allocator;
+      if (node >= 0) {
+        if (!numa::bind_thread(node))
+          pxWarning("RequestScheduler: can't bind worker to NUMA node "
+                    + std::to_string(node));
+        allocator.reset(new NumaAllocator(node));
+      }
+      ScopedAllocator scope(allocator);
+      while (true) {
+        Request req;
+        Clock::time_point start;
+        {
+          std::unique_lock<std::mutex> lock(mtx_);
+          cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+          if (stop_)
+            return;
+          req = std::move(queue_.begin()->second);
+          queue_.erase(queue_.begin());
+          start = Clock::now();
+          if (start > req.deadline) {
+            ++metrics_.expired;
+            lock.unlock();
+            req.completion->set(std::make_exception_ptr(RequestRejected(
+              "RequestScheduler: deadline passed while queued")));
+            continue;
+          }
+          metrics_.queue_delay.add(to_us(start - req.submitted));
+          ++busy_;
+        }
+
+        std::exception_ptr error = nullptr;
+        try {
+          rt_mods_[mod_idx]->execute(*req.in_tensors, *req.out_tensors);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        Clock::time_point stop = Clock::now();
+
+        {
+          std::lock_guard<std::mutex> lock(mtx_);
+          --busy_;
+          double service_us = to_us(stop - start);
+          metrics_.service_time.add(service_us);
+          metrics_.ewma_service_us = metrics_.service_time.count == 1 ? service_us :
+            options_.ewma_alpha * service_us
+            + (1. - options_.ewma_alpha) * metrics_.ewma_service_us;
+          if (error)
+            ++metrics_.failed;
+          else
+            ++metrics_.completed;
+        }
+        req.completion->set(error);
+      }
+    }
+
+    static double to_us(Clock::duration d)
+    {
+      return (double) std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+
+    std::vector<RuntimeModule *> rt_mods_;
+    SchedulerOptions options_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    uint64_t seq_ = 0;
+    size_t busy_ = 0;
+    std::map<QueueKey, Request> queue_;
+    SchedulerMetrics metrics_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,251 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include "../common/xbuffer.hpp"
+#include "../pyxir_api.hpp"
+#include "stats.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+/** @brief Errors of a single output compared against its reference */
+struct OutputError {
+  double max_abs = 0.;
+  double cosine = 1.;
+  double snr_db = 0.;
+};
+
+/**
+ * @brief Compare float32 data against a reference in a single pass. The
+ *  reductions are split over independent lanes so that they can be
+ *  vectorized. The signal to noise ratio is capped at 200dB for identical
+ *  data.
+ */
+inline OutputError compare_float(const float *ref, const float *data, size_t n)
+{
+  const size_t LANES = 8;
+  float max_abs[LANES] = {0};
+  double dot[LANES] = {0}, ref_sq[LANES] = {0}, data_sq[LANES] = {0},
+         err_sq[LANES] = {0};
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES) {
+    for (size_t l = 0; l < LANES; ++l) {
+      float r = ref[i + l], d = data[i + l], e = d - r;
+      max_abs[l] = std::max(max_abs[l], std::fabs(e));
+      dot[l] += (double) r * d;
+      ref_sq[l] += (double) r * r;
+      data_sq[l] += (double) d * d;
+      err_sq[l] += (double) e * e;
+    }
+  }
+  for (; i < n; ++i) {
+    float r = ref[i], d = data[i], e = d - r;
+    max_abs[0] = std::max(max_abs[0], std::fabs(e));
+    dot[0] += (double) r * d;
+    ref_sq[0] += (double) r * r;
+    data_sq[0] += (double) d * d;
+    err_sq[0] += (double) e * e;
+  }
+  for (size_t l = 1; l < LANES; ++l) {
+    max_abs[0] = std::max(max_abs[0], max_abs[l]);
+    dot[0] += dot[l];
+    ref_sq[0] += ref_sq[l];
+    data_sq[0] += data_sq[l];
+    err_sq[0] += err_sq[l];
+  }
+
+  OutputError res;
+  res.max_abs = max_abs[0];
+  if (ref_sq[0] > 0 && data_sq[0] > 0)
+    res.cosine = dot[0] / std::sqrt(ref_sq[0] * data_sq[0]);
+  else
+    res.cosine = (ref_sq[0] == data_sq[0]) ? 1. : 0.;
+  const double MAX_SNR_DB = 200.;
+  if (err_sq[0] == 0)
+    res.snr_db = MAX_SNR_DB;
+  else
+    res.snr_db = std::min(MAX_SNR_DB, 10. * std::log10(ref_sq[0] / err_sq[0]));
+  return res;
+}
+
+/**
+ * @brief Compares a primary compute func against a reference on sampled
+ *  requests. Sampled inputs and outputs are copied and the reference is run
+ *  on a background thread so that the primary path isn't blocked, samples
+ *  are dropped if the comparison can't keep up.
+ */
+class ShadowComparator {
+
+  public:
+    typedef std::function<void (std::vector<XBufferHolder> &,
+                                std::vector<XBufferHolder> &)> RefFuncType;
+
+    /**
+     * @param reference The reference compute function
+     * @param sample_every Compare every n-th request
+     * @param max_pending The maximum number of samples waiting for comparison
+     */
+    ShadowComparator(RefFuncType reference, int sample_every,
+                     size_t max_pending = 4)
+      : reference_(reference), sample_every_(std::max(sample_every, 1)),
+        max_pending_(max_pending)
+    {
+      worker_ = std::thread([this]() { run(); });
+    }
+
+    ~ShadowComparator()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      worker_.join();
+    }
+
+    ShadowComparator(const ShadowComparator &) = delete;
+    ShadowComparator &operator=(const ShadowComparator &) = delete;
+
+    /** @brief Sample a request executed by the primary compute func */
+    void sample(const std::vector<XBufferHolder> &in_tensors,
+                const std::vector<XBufferHolder> &out_tensors)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (count_++ % sample_every_ != 0)
+          return;
+        if (queue_.size() + copying_ >= max_pending_) {
+          ++stats_.dropped;
+          return;
+        }
+        ++copying_;
+      }
+      Sample s;
+      for (const XBufferHolder &xb : in_tensors)
+        s.inputs.push_back(XBufferHolder(new XBuffer(*xb)));
+      for (const XBufferHolder &xb : out_tensors)
+        s.outputs.push_back(XBufferHolder(new XBuffer(*xb)));
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        --copying_;
+        queue_.push_back(std::move(s));
+      }
+      cv_.notify_one();
+    }
+
+    /** @brief Block until all queued samples are compared */
+    void flush()
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      idle_cv_.wait(lock, [this]() { return queue_.empty() && !busy_; });
+    }
+
+    ComparisonStats get_stats()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return stats_;
+    }
+
+  private:
+    struct Sample {
+      std::vector<XBufferHolder> inputs;
+      std::vector<XBufferHolder> outputs;
+    };
+
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      while (true) {
+        cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (stop_)
+          break;
+        Sample s = std::move(queue_.front());
+        queue_.pop_front();
+        busy_ = true;
+        lock.unlock();
+        std::vector<OutputError> errors;
+        bool failed = !compare(s, errors);
+        lock.lock();
+        busy_ = false;
+        ++stats_.sampled;
+        if (failed)
+          ++stats_.failed;
+        if (stats_.outputs.size() < errors.size())
+          stats_.outputs.resize(errors.size());
+        for (size_t i = 0; i < errors.size(); ++i)
+          stats_.outputs[i].add(errors[i].max_abs, errors[i].cosine,
+                                errors[i].snr_db);
+        idle_cv_.notify_all();
+      }
+    }
+
+    bool compare(Sample &s, std::vector<OutputError> &errors)
+    {
+      std::vector<XBufferHolder> ref_outputs;
+      for (const XBufferHolder &xb : s.outputs) {
+        std::vector<ssize_t> shape(xb->shape);
+        ref_outputs.push_back(create_buffer(shape, xb->itemsize, xb->format));
+      }
+      try {
+        reference_(s.inputs, ref_outputs);
+      } catch (std::exception &e) {
+        pxWarning("ShadowComparator: reference failed: " + std::string(e.what()));
+        return false;
+      }
+      if (ref_outputs.size() != s.outputs.size())
+        return false;
+      for (size_t i = 0; i < s.outputs.size(); ++i) {
+        XBufferHolder ref = ascontiguous(ref_outputs[i]);
+        const XBufferHolder &out = s.outputs[i];
+        if (ref->format != "f" || out->format != "f" || ref->size != out->size)
+          return false;
+        errors.push_back(compare_float((float *) ref->data,
+                                       (float *) out->data, out->size));
+      }
+      return true;
+    }
+
+    RefFuncType reference_;
+    int sample_every_;
+    size_t max_pending_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::condition_variable idle_cv_;
+    std::deque<Sample> queue_;
+    uint64_t count_ = 0;
+    /** @brief Samples being copied on the primary path */
+    size_t copying_ = 0;
+    bool busy_ = false;
+    bool stop_ = false;
+    ComparisonStats stats_;
+    std::thread worker_;
+};
+
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,95 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../pyxir_api.hpp"
+#include "../common/xbuffer.hpp"
+#include "kernel_func.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+/** @brief Entry point executing a kernel, see invoke_kernel */
+typedef void (*KernelInvokeFunc)(KernelFunc *,
+                                 std::vector<XBufferHolder> &,
+                                 std::vector<XBufferHolder> &);
+
+/** @brief Entry point creating a kernel for the given XLayer */
+typedef KernelFunc *(*KernelCreateFunc)(XLayerHolder &);
+
+/**
+ * @brief Execute a kernel of the given concrete type. The qualified call
+ *  bypasses the virtual KernelFunc::operator() so executors can dispatch
+ *  through a flat table of these entry points.
+ */
+template <typename Kernel>
+void invoke_kernel(KernelFunc *kernel,
+                   std::vector<XBufferHolder> &in_tensors,
+                   std::vector<XBufferHolder> &out_tensors)
+{
+  static_cast<Kernel *>(kernel)->Kernel::operator()(in_tensors, out_tensors);
+}
+
+/** @brief Execute a kernel of unknown type through the virtual call */
+inline void invoke_virtual_kernel(KernelFunc *kernel,
+                                  std::vector<XBufferHolder> &in_tensors,
+                                  std::vector<XBufferHolder> &out_tensors)
+{
+  (*kernel)(in_tensors, out_tensors);
+}
+
+template <typename Kernel>
+KernelFunc *create_kernel(XLayerHolder &xl)
+{
+  return new Kernel(xl);
+}
+
+/** @brief Compile time registration of a built-in kernel */
+struct StaticKernelEntry {
+  /** @brief The operation type, i.e. XLayer::xtype[0] */
+  const char *op_type;
+  KernelCreateFunc create;
+  KernelInvokeFunc invoke;
+};
+
+template <typename Kernel>
+constexpr StaticKernelEntry make_static_kernel(const char *op_type)
+{
+  return StaticKernelEntry{op_type, &create_kernel<Kernel>, &invoke_kernel<Kernel>};
+}
+
+/**
+ * @brief Table of the built-in CPU kernels which is fixed at compile time.
+ *  Kernels registered at runtime through REGISTER_KERNEL_FUNC are found
+ *  through the KernelFuncFactory and override the built-in kernel of the
+ *  same operation type.
+ */
+class StaticKernelRegistry {
+
+  public:
+    /** @brief Return the entry for the operation type, null if there is no
+        built-in kernel for it */
+    PX_API static const StaticKernelEntry *Find(const std::string &op_type);
+
+    PX_API static std::vector<std::string> GetOpTypes();
+};
+
+} // namespace runtime
+} // namespace pyxir
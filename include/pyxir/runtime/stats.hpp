@@ -0,0 +1,127 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace pyxir {
+namespace runtime {
+
+/** @brief Latency statistics in microseconds */
+struct LatencyStats {
+  uint64_t count = 0;
+  double total_us = 0.;
+  double max_us = 0.;
+
+  void add(double us)
+  {
+    ++count;
+    total_us += us;
+    max_us = std::max(max_us, us);
+  }
+
+  double mean_us() const { return count > 0 ? total_us / count : 0.; }
+};
+
+/** @brief Error statistics of an output compared against a reference */
+struct OutputErrorStats {
+  uint64_t count = 0;
+  /** @brief The largest absolute difference over all samples */
+  double max_abs = 0.;
+  double min_cosine = 1.;
+  double cosine_sum = 0.;
+  /** @brief The sum of the signal to noise ratios in dB */
+  double snr_db_sum = 0.;
+
+  void add(double sample_max_abs, double cosine, double snr_db)
+  {
+    ++count;
+    max_abs = std::max(max_abs, sample_max_abs);
+    min_cosine = std::min(min_cosine, cosine);
+    cosine_sum += cosine;
+    snr_db_sum += snr_db;
+  }
+
+  double mean_cosine() const { return count > 0 ? cosine_sum / count : 1.; }
+
+  double mean_snr_db() const { return count > 0 ? snr_db_sum / count : 0.; }
+};
+
+/** @brief Statistics of the comparison of a compute func against a
+    reference on sampled requests */
+struct ComparisonStats {
+  /** @brief Requests compared against the reference */
+  uint64_t sampled = 0;
+  /** @brief Sampled requests dropped because the comparison fell behind */
+  uint64_t dropped = 0;
+  /** @brief Sampled requests that failed on the reference */
+  uint64_t failed = 0;
+  std::vector<OutputErrorStats> outputs;
+};
+
+/** @brief Memory used by a runtime module in bytes, by category */
+struct MemoryUsage {
+  /** @brief Layer weights, i.e. XLayer::data */
+  size_t weights = 0;
+  /** @brief The XGraph structure (layers, names, shapes), estimated */
+  size_t metadata = 0;
+  /** @brief Files in the extracted build and work directories, which
+      usually live on a memory backed file system */
+  size_t build_files = 0;
+  /** @brief Buffers held by accelerator runners */
+  size_t runner_buffers = 0;
+  /** @brief Live buffers allocated while executing requests */
+  size_t intermediates = 0;
+  /** @brief The peak of the live request buffers */
+  size_t peak_intermediates = 0;
+  /** @brief Freed request buffers kept for reuse */
+  size_t cached = 0;
+  /** @brief The memory budget, 0 if there is none */
+  size_t budget = 0;
+  /** @brief Requests after which the module didn't fit in the budget even
+      with the lower memory strategies */
+  uint64_t over_budget = 0;
+
+  size_t total() const
+  {
+    return weights + metadata + build_files + runner_buffers + intermediates
+      + cached;
+  }
+
+  /** @brief Memory that doesn't depend on the requests */
+  size_t static_total() const
+  {
+    return weights + metadata + build_files + runner_buffers;
+  }
+
+  MemoryUsage &operator+=(const MemoryUsage &other)
+  {
+    weights += other.weights;
+    metadata += other.metadata;
+    build_files += other.build_files;
+    runner_buffers += other.runner_buffers;
+    intermediates += other.intermediates;
+    peak_intermediates += other.peak_intermediates;
+    cached += other.cached;
+    return *this;
+  }
+};
+
+} // namespace runtime
+} // namespace pyxir
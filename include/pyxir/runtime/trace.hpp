@@ -0,0 +1,368 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <condition_variable>
+#include <unistd.h>
+
+#include "../pyxir_api.hpp"
+#include "../common/xbuffer.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+struct TraceOptions {
+  /** @brief Whether to capture the outputs next to the inputs */
+  bool capture_outputs = false;
+  /** @brief The maximum number of bytes waiting to be written, records are
+      dropped instead of blocking execution when the writer can't keep up */
+  size_t max_pending_bytes = 64 << 20;
+};
+
+/** @brief A captured request */
+struct TraceRecord {
+  /** @brief Time since the start of the capture in microseconds */
+  double timestamp_us = 0.;
+  /** @brief The execution latency in microseconds */
+  double latency_us = 0.;
+  std::vector<XBufferHolder> inputs;
+  /** @brief The outputs, empty if they weren't captured */
+  std::vector<XBufferHolder> outputs;
+};
+
+namespace trace {
+
+// Trace format: the magic string followed by records, every record starts
+//  with its size in bytes, the timestamp and latency, and the number of
+//  input and output tensors. Tensors are stored as format, item size, shape
+//  and the packed tensor data.
+
+const char MAGIC[8] = {'P', 'X', 'T', 'R', 'A', 'C', 'E', '1'};
+
+template <typename T>
+inline void append(std::string &buf, const T &t)
+{
+  buf.append((const char *) &t, sizeof(T));
+}
+
+inline void append_tensor(std::string &buf, const XBufferHolder &xb)
+{
+  XBufferHolder packed = ascontiguous(xb);
+  append(buf, (uint8_t) packed->format.size());
+  buf.append(packed->format);
+  append(buf, (uint32_t) packed->itemsize);
+  append(buf, (uint32_t) packed->shape.size());
+  for (const ssize_t &d : packed->shape)
+    append(buf, (int64_t) d);
+  buf.append((const char *) packed->data, packed->size * packed->itemsize);
+}
+
+/** @brief The number of bytes append_tensor adds for the tensor */
+inline size_t tensor_size(const XBufferHolder &xb)
+{
+  return sizeof(uint8_t) + xb->format.size() + 2 * sizeof(uint32_t)
+    + xb->shape.size() * sizeof(int64_t) + xb->size * xb->itemsize;
+}
+
+/**
+ * @brief Return a trace path unique to this process and call by suffixing
+ *  the given path with the process id and a counter, so runtime modules
+ *  capturing to the same configured path don't overwrite each other
+ */
+inline std::string unique_path(const std::string &path)
+{
+  static std::atomic<uint64_t> counter(0);
+  return path + "." + std::to_string(getpid()) + "." + std::to_string(counter++);
+}
+
+template <typename T>
+inline T consume(const std::string &buf, size_t &pos)
+{
+  if (pos + sizeof(T) > buf.size())
+    throw std::runtime_error("Trace: corrupt trace record");
+  T t;
+  std::memcpy(&t, buf.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return t;
+}
+
+inline XBufferHolder consume_tensor(const std::string &buf, size_t &pos)
+{
+  uint8_t format_size = consume<uint8_t>(buf, pos);
+  if (pos + format_size > buf.size())
+    throw std::runtime_error("Trace: corrupt trace record");
+  std::string format = buf.substr(pos, format_size);
+  pos += format_size;
+  uint32_t itemsize = consume<uint32_t>(buf, pos);
+  uint32_t ndim = consume<uint32_t>(buf, pos);
+  std::vector<ssize_t> shape;
+  for (uint32_t i = 0; i < ndim; ++i)
+    shape.push_back((ssize_t) consume<int64_t>(buf, pos));
+  XBufferHolder xb = create_buffer(shape, itemsize, format);
+  size_t nb_bytes = xb->size * xb->itemsize;
+  if (pos + nb_bytes > buf.size())
+    throw std::runtime_error("Trace: corrupt trace record");
+  std::memcpy(xb->data, buf.data() + pos, nb_bytes);
+  pos += nb_bytes;
+  return xb;
+}
+
+} // namespace trace
+
+/**
+ * @brief Writes captured requests to a binary trace file. Records are
+ *  serialized on the calling thread and written by a background thread.
+ *  Once a write fails, further records are dropped and flush throws.
+ */
+class TraceWriter {
+
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    TraceWriter(const std::string &path,
+                const TraceOptions &options = TraceOptions())
+      : options_(options), path_(path),
+        file_(path, std::ios::binary | std::ios::trunc), start_(Clock::now())
+    {
+      if (!file_)
+        throw std::runtime_error("TraceWriter: can't open " + path);
+      file_.write(trace::MAGIC, sizeof(trace::MAGIC));
+      writer_ = std::thread([this]() { run(); });
+    }
+
+    ~TraceWriter()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      writer_.join();
+    }
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    const TraceOptions &get_options() const { return options_; }
+
+    const std::string &path() const { return path_; }
+
+    /**
+     * @brief Capture a request, the tensors are only serialized if the
+     *  record isn't dropped
+     * @param in_tensors The input buffers
+     * @param out_tensors The output buffers, ignored if outputs aren't
+     *  captured
+     * @param start The time at which the request started
+     * @param latency_us The execution latency
+     */
+    void record(const std::vector<XBufferHolder> &in_tensors,
+                const std::vector<XBufferHolder> &out_tensors,
+                Clock::time_point start, double latency_us)
+    {
+      bool with_outputs = options_.capture_outputs;
+      size_t nb_bytes = sizeof(uint64_t) + 2 * sizeof(double)
+        + 2 * sizeof(uint32_t);
+      for (const XBufferHolder &xb : in_tensors)
+        nb_bytes += trace::tensor_size(xb);
+      if (with_outputs)
+        for (const XBufferHolder &xb : out_tensors)
+          nb_bytes += trace::tensor_size(xb);
+      // Reserve the pending bytes up front so that dropped records are
+      //  never copied
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (failed_ || pending_bytes_ + nb_bytes > options_.max_pending_bytes) {
+          ++nb_dropped_;
+          return;
+        }
+        pending_bytes_ += nb_bytes;
+        ++nb_records_;
+      }
+
+      std::string buf;
+      try {
+        buf.reserve(nb_bytes);
+        trace::append(buf, (uint64_t) 0);
+        trace::append(buf, std::chrono::duration<double, std::micro>(
+          start - start_).count());
+        trace::append(buf, latency_us);
+        trace::append(buf, (uint32_t) in_tensors.size());
+        trace::append(buf, (uint32_t) (with_outputs ? out_tensors.size() : 0));
+        for (const XBufferHolder &xb : in_tensors)
+          trace::append_tensor(buf, xb);
+        if (with_outputs)
+          for (const XBufferHolder &xb : out_tensors)
+            trace::append_tensor(buf, xb);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        pending_bytes_ -= nb_bytes;
+        --nb_records_;
+        flushed_cv_.notify_all();
+        throw;
+      }
+      uint64_t size = buf.size() - sizeof(uint64_t);
+      std::memcpy(&buf[0], &size, sizeof(size));
+
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        queue_.push_back(std::move(buf));
+      }
+      cv_.notify_one();
+    }
+
+    /** @brief Block until all captured records are written, throws if
+        writing the trace failed */
+    void flush()
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      flushed_cv_.wait(lock, [this]() { return pending_bytes_ == 0; });
+      if (failed_)
+        throw std::runtime_error("TraceWriter: failed to write " + path_);
+    }
+
+    /** @brief Whether writing the trace failed */
+    bool failed()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return failed_;
+    }
+
+    uint64_t nb_records()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return nb_records_;
+    }
+
+    /** @brief The number of records dropped because the writer fell behind
+        or failed */
+    uint64_t nb_dropped()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return nb_dropped_;
+    }
+
+  private:
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      while (true) {
+        cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty() && stop_)
+          break;
+        std::string buf = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        file_.write(buf.data(), buf.size());
+        if (queue_empty())
+          file_.flush();
+        lock.lock();
+        check_stream();
+        pending_bytes_ -= buf.size();
+        flushed_cv_.notify_all();
+      }
+      file_.flush();
+      check_stream();
+    }
+
+    /** @brief Record and report the first write error, requires mtx_ */
+    void check_stream()
+    {
+      if (file_ || failed_)
+        return;
+      failed_ = true;
+      pxWarning("TraceWriter: failed to write " + path_
+                + ", further records are dropped");
+    }
+
+    bool queue_empty()
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return queue_.empty();
+    }
+
+    TraceOptions options_;
+    std::string path_;
+    std::ofstream file_;
+    Clock::time_point start_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::condition_variable flushed_cv_;
+    std::deque<std::string> queue_;
+    size_t pending_bytes_ = 0;
+    uint64_t nb_records_ = 0;
+    uint64_t nb_dropped_ = 0;
+    bool failed_ = false;
+    bool stop_ = false;
+    std::thread writer_;
+};
+
+/** @brief Reads the records of a binary trace file in order */
+class TraceReader {
+
+  public:
+    TraceReader(const std::string &path)
+      : file_(path, std::ios::binary)
+    {
+      char magic[sizeof(trace::MAGIC)];
+      if (!file_ || !file_.read(magic, sizeof(magic))
+          || std::memcmp(magic, trace::MAGIC, sizeof(magic)) != 0)
+        throw std::runtime_error("TraceReader: " + path
+                                 + " is not a pyxir trace");
+    }
+
+    /** @brief Read the next record, returns false at the end of the trace */
+    bool next(TraceRecord &record)
+    {
+      uint64_t size;
+      if (!file_.read((char *) &size, sizeof(size)))
+        return false;
+      std::string buf(size, '\0');
+      if (!file_.read(&buf[0], size))
+        throw std::runtime_error("TraceReader: truncated trace record");
+      size_t pos = 0;
+      record.timestamp_us = trace::consume<double>(buf, pos);
+      record.latency_us = trace::consume<double>(buf, pos);
+      uint32_t nb_in = trace::consume<uint32_t>(buf, pos);
+      uint32_t nb_out = trace::consume<uint32_t>(buf, pos);
+      record.inputs.clear();
+      record.outputs.clear();
+      for (uint32_t i = 0; i < nb_in; ++i)
+        record.inputs.push_back(trace::consume_tensor(buf, pos));
+      for (uint32_t i = 0; i < nb_out; ++i)
+        record.outputs.push_back(trace::consume_tensor(buf, pos));
+      return true;
+    }
+
+  private:
+    std::ifstream file_;
+};
+
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,272 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+
+#include "stats.hpp"
+#include "trace.hpp"
+#include "runtime_module.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+struct ReplayOptions {
+  /** @brief The replay rate relative to the recorded rate, e.g. 2 replays
+      twice as fast, 0 issues the requests back to back whenever an
+      execution slot is free */
+  double speedup = 1.;
+  /** @brief The number of requests executed concurrently, values above 1
+      require a runtime module supporting concurrent executions */
+  size_t concurrency = 1;
+  /** @brief Whether to compare the outputs against the captured outputs */
+  bool compare_outputs = true;
+  /** @brief The absolute tolerance for float32 output comparison */
+  double atol = 1e-5;
+  /** @brief The output shapes used if the trace doesn't contain outputs,
+      if empty the runtime module provides the output buffers */
+  std::vector<std::vector<ssize_t>> out_shapes;
+  /** @brief The number of records buffered to restore the arrival order,
+      records are written when requests complete so concurrent requests
+      are captured out of order */
+  size_t reorder_window = 32;
+};
+
+struct ReplayStats {
+  uint64_t requests = 0;
+  uint64_t failed = 0;
+  /** @brief Requests whose outputs differ from the captured outputs */
+  uint64_t mismatches = 0;
+  /** @brief The largest absolute difference between float32 outputs */
+  double max_abs_diff = 0.;
+  /** @brief The replayed latencies from the time each request was issued,
+      including the time it waited for an execution slot */
+  LatencyStats latency;
+  /** @brief The captured execution latencies */
+  LatencyStats recorded_latency;
+};
+
+namespace trace {
+
+/** @brief Compare two buffers, returns the maximum absolute difference for
+    float32 buffers and 0 or infinity for other buffers */
+inline double compare(const XBuffer &a, const XBuffer &b)
+{
+  if (a.shape != b.shape || a.format != b.format || a.itemsize != b.itemsize)
+    return INFINITY;
+  if (a.format == "f" && a.itemsize == 4) {
+    double max_diff = 0.;
+    for (ssize_t i = 0; i < a.size; ++i)
+      max_diff = std::max(max_diff, (double) std::fabs(
+        ((float *) a.data)[i] - ((float *) b.data)[i]));
+    return max_diff;
+  }
+  return std::memcmp(a.data, b.data, a.size * a.itemsize) == 0 ? 0. : INFINITY;
+}
+
+struct ReplayRequest {
+  /** @brief The position of the request in the trace, starting at 1 */
+  uint64_t index = 0;
+  TraceRecord record;
+  std::chrono::steady_clock::time_point issued;
+};
+
+/** @brief Execute a replayed request and add it to the stats */
+inline void replay_request(RuntimeModule &rt_mod, ReplayRequest &request,
+                           const ReplayOptions &options, ReplayStats &stats,
+                           std::mutex &stats_mtx)
+{
+  typedef std::chrono::steady_clock Clock;
+  const TraceRecord &record = request.record;
+  std::vector<XBufferHolder> out_tensors;
+  if (!record.outputs.empty()) {
+    for (const XBufferHolder &xb : record.outputs) {
+      std::vector<ssize_t> shape(xb->shape);
+      out_tensors.push_back(create_buffer(shape, xb->itemsize, xb->format));
+    }
+  } else {
+    for (const std::vector<ssize_t> &s : options.out_shapes) {
+      std::vector<ssize_t> shape(s);
+      out_tensors.push_back(create_buffer(shape));
+    }
+  }
+
+  bool failed = false;
+  try {
+    rt_mod.execute(request.record.inputs, out_tensors);
+  } catch (std::exception &e) {
+    pxWarning("replay_trace: request " + std::to_string(request.index)
+              + " failed: " + e.what());
+    failed = true;
+  }
+  double latency_us = std::chrono::duration<double, std::micro>(
+    Clock::now() - request.issued).count();
+
+  bool mismatch = false;
+  double max_abs_diff = 0.;
+  if (!failed && options.compare_outputs && !record.outputs.empty()) {
+    mismatch = out_tensors.size() != record.outputs.size();
+    for (size_t i = 0; !mismatch && i < out_tensors.size(); ++i) {
+      double diff = trace::compare(*ascontiguous(out_tensors[i]),
+                                   *record.outputs[i]);
+      if (std::isfinite(diff))
+        max_abs_diff = std::max(max_abs_diff, diff);
+      mismatch = !(diff <= options.atol);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mtx);
+  ++stats.requests;
+  stats.recorded_latency.add(record.latency_us);
+  if (failed) {
+    ++stats.failed;
+    return;
+  }
+  stats.latency.add(latency_us);
+  stats.max_abs_diff = std::max(stats.max_abs_diff, max_abs_diff);
+  if (mismatch)
+    ++stats.mismatches;
+}
+
+} // namespace trace
+
+/**
+ * @brief Replay a captured trace against a runtime module, reissuing the
+ *  requests at the captured or an accelerated rate, and compare latencies
+ *  and outputs. Requests are issued at their recorded offsets whether or
+ *  not earlier requests completed, so the recorded arrival rate and the
+ *  resulting queueing are reproduced.
+ * @param rt_mod The runtime module, possibly from a different build than
+ *  the one the trace was captured with
+ * @param path The trace file path
+ * @param options The replay options
+ */
+inline ReplayStats replay_trace(RuntimeModule &rt_mod, const std::string &path,
+                                const ReplayOptions &options = ReplayOptions())
+{
+  typedef std::chrono::steady_clock Clock;
+  ReplayStats stats;
+  TraceReader reader(path);
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<trace::ReplayRequest> queue;
+  bool done = false;
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < std::max<size_t>(options.concurrency, 1); ++i) {
+    workers.emplace_back([&]() {
+      std::unique_lock<std::mutex> lock(mtx);
+      while (true) {
+        cv.wait(lock, [&]() { return done || !queue.empty(); });
+        if (queue.empty())
+          break;
+        trace::ReplayRequest request = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        cv.notify_all();
+        if (options.speedup <= 0)
+          request.issued = Clock::now();
+        trace::replay_request(rt_mod, request, options, stats, mtx);
+        lock.lock();
+      }
+    });
+  }
+
+  // Dispatch the requests at their recorded offsets, independent of the
+  //  completion of earlier requests. Records are ordered by completion, so
+  //  they are dispatched in timestamp order from a window of records and
+  //  the earliest timestamp of the first window is the replay origin.
+  std::exception_ptr error;
+  try {
+    auto later = [](const trace::ReplayRequest &a,
+                    const trace::ReplayRequest &b) {
+      return a.record.timestamp_us > b.record.timestamp_us
+        || (a.record.timestamp_us == b.record.timestamp_us
+            && a.index > b.index);
+    };
+    const size_t window_size = std::max<size_t>(options.reorder_window, 1);
+    std::vector<trace::ReplayRequest> window;
+    Clock::time_point replay_start = Clock::now();
+    double origin_us = 0.;
+    bool has_origin = false;
+    uint64_t index = 0;
+    bool more = true;
+    while (true) {
+      while (more && window.size() < window_size) {
+        trace::ReplayRequest request;
+        if (!(more = reader.next(request.record)))
+          break;
+        request.index = ++index;
+        window.push_back(std::move(request));
+        std::push_heap(window.begin(), window.end(), later);
+      }
+      if (window.empty())
+        break;
+      std::pop_heap(window.begin(), window.end(), later);
+      trace::ReplayRequest request = std::move(window.back());
+      window.pop_back();
+      if (!has_origin) {
+        origin_us = request.record.timestamp_us;
+        has_origin = true;
+      }
+
+      if (options.speedup > 0) {
+        // Records out of order by more than the window are issued
+        //  immediately
+        double offset_us = std::max(
+          request.record.timestamp_us - origin_us, 0.) / options.speedup;
+        request.issued = replay_start + std::chrono::microseconds(
+          (int64_t) offset_us);
+        std::this_thread::sleep_until(request.issued);
+      }
+
+      std::unique_lock<std::mutex> lock(mtx);
+      if (options.speedup <= 0)
+        cv.wait(lock, [&]() { return queue.empty(); });
+      queue.push_back(std::move(request));
+      lock.unlock();
+      cv.notify_all();
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    done = true;
+  }
+  cv.notify_all();
+  for (std::thread &t : workers)
+    t.join();
+  if (error)
+    std::rethrow_exception(error);
+  return stats;
+}
+
+} // namespace runtime
+} // namespace pyxir
@@ -20,6 +20,7 @@ import os
 import re
 import copy
 import json
+import time
 import warnings
 
 import numpy as np
@@ -36,6 +37,10 @@ from .opaque_func_registry import register_opaque_func
 from .opaque_func import OpaqueFunc
 
 from pyxir.shared.xbuffer import XBuffer
+from pyxir.shared.artifact_store import ArtifactStore, fingerprint_layers
+from pyxir.compiler.orchestrator import CompileJob, CompileOrchestrator,\
+    CompileReport, JobTiming, compile_cached, compile_partitioned,\
+    get_max_workers_from_env
 from pyxir.graph.xgraph import XGraph
 from pyxir.graph.io.xgraph_io import XGraphIO
 from pyxir.io.api import visualize, save, load, get_xgraph_str
@@ -158,6 +163,68 @@ def compile(xgraph: XGraph, target: str, **kwargs) -> XGraph:
     return c_xgraph
 
 
+def _compile_and_schedule(opt_xgraph: XGraph,
+                          target: str,
+                          build_dir: str,
+                          work_dir: str) -> XGraph:
+    """
+    Compile the optimized XGraph, schedule it and store the scheduled XGraph
+    in the build directory next to the compiler meta file
+    """
+    # Reuse the compiled partitions of an earlier build if the
+    #   PX_ARTIFACT_STORE environment variable points to an artifact store
+    artifact_store = ArtifactStore.from_env()
+    # Target compilers only compile the first partition, so graphs with
+    #   multiple partitions are compiled one job per partition, concurrently
+    #   unless PX_COMPILE_WORKERS is set to zero
+    max_workers = get_max_workers_from_env()
+    partitions = xgraph_partitioner.get_subgraphs(opt_xgraph)
+    nb_partitions = len([Xp for Xp in partitions
+                         if Xp.attrs['target'] == target])
+    if nb_partitions > 1 and max_workers != 0:
+        fancy_logger.banner("START GRAPH COMPILATION OF {} PARTITIONS FOR"
+                            " TARGET: {}".format(nb_partitions, target))
+        c_xgraph = compile_partitioned(opt_xgraph, target, work_dir=work_dir,
+                                       build_dir=build_dir,
+                                       max_workers=max_workers,
+                                       artifact_store=artifact_store)
+    elif artifact_store is None:
+        c_xgraph = compile(opt_xgraph, target, work_dir=work_dir,
+                           build_dir=build_dir)
+    else:
+        fancy_logger.banner("START GRAPH COMPILATION FOR TARGET: {}"
+                            .format(target))
+        c_xgraph = compile_cached(opt_xgraph, target, work_dir=work_dir,
+                                  build_dir=build_dir,
+                                  artifact_store=artifact_store)
+    # full_graph_input_names = xgraph.get_input_names()
+
+    # Create scheduled XGraph
+    # TODO: work_dir <-> build_dir
+    scheduled_xgraph = schedule(c_xgraph, target, work_dir=build_dir)
+
+    # Save and add to meta file
+    model_file = os.path.join(build_dir, 'px_model')
+    save(scheduled_xgraph, model_file)
+
+    meta_file = os.path.join(build_dir, 'meta.json')
+
+    if (not os.path.isfile(meta_file)):
+        raise ValueError("Could not find meta file at: {}"
+                         .format(meta_file))
+
+    with open(meta_file, 'r') as json_file:
+        meta_d = json.load(json_file)
+
+    meta_d['px_model'] = 'px_model.json'
+    meta_d['px_params'] = 'px_model.h5'
+
+    with open(meta_file, 'w') as f:
+        json.dump(meta_d, f, indent=4, sort_keys=True)
+
+    return scheduled_xgraph
+
+
 @register_opaque_func('pyxir.compile', [TypeCode.XGraph, TypeCode.Str,
                                         TypeCode.vStr, TypeCode.vStr,
                                         TypeCode.Str, TypeCode.Str,
@@ -204,32 +271,8 @@ def compile_opaque_func(xgraph: XGraph,
         build_dir = os.path.abspath(os.path.join(os.getcwd(), target + "_build"))
 
     opt_xgraph = optimize(xgraph, target)
-    c_xgraph = compile(opt_xgraph, target, work_dir=work_dir,
-                       build_dir=build_dir)
-    # full_graph_input_names = xgraph.get_input_names()
-
-    # Create scheduled XGraph
-    # TODO: work_dir <-> build_dir
-    scheduled_xgraph = schedule(c_xgraph, target, work_dir=build_dir)
-
-    # Save and add to meta file
-    model_file = os.path.join(build_dir, 'px_model')
-    save(scheduled_xgraph, model_file)
-
-    meta_file = os.path.join(build_dir, 'meta.json')
-
-    if (not os.path.isfile(meta_file)):
-        raise ValueError("Could not find meta file at: {}"
-                         .format(meta_file))
-
-    with open(meta_file, 'r') as json_file:
-        meta_d = json.load(json_file)
-
-    meta_d['px_model'] = 'px_model.json'
-    meta_d['px_params'] = 'px_model.h5'
-
-    with open(meta_file, 'w') as f:
-        json.dump(meta_d, f, indent=4, sort_keys=True)
+    scheduled_xgraph = _compile_and_schedule(opt_xgraph, target, build_dir,
+                                             work_dir)
 
     # Set callback
     cb_scheduled_xgraph.copy_from(scheduled_xgraph)
@@ -348,6 +391,106 @@ def build(xgraph: XGraph,
     )
 
 
+def get_quantization_key(opt_xgraph: XGraph, target: str) -> str:
+    """
+    Return the key identifying the quantization result of the optimized
+    XGraph for the given target. Targets with the same key (e.g. the
+    DPUCZDX8G variants) share the same quantizer and optimized graph and can
+    therefore share a single quantization result.
+    """
+    quantizer = target_registry.get_target_quantizer(target)
+    return fingerprint_layers(opt_xgraph.get_layers(), [
+        quantizer.__module__, getattr(quantizer, '__qualname__', repr(quantizer))
+    ])
+
+
+def _build_target_job(target: str,
+                      graph_str: bytes,
+                      data_str: bytes,
+                      q_output,
+                      build_dir: str,
+                      work_dir: str) -> str:
+    """ Compile job for build_targets, runs in a worker process """
+    opt_xgraph = XGraphIO.from_string(graph_str, data_str)
+    if q_output is not None:
+        opt_xgraph.set_quantizer_output(q_output)
+    _compile_and_schedule(opt_xgraph, target, build_dir, work_dir)
+    return build_dir
+
+
+def build_targets(xgraph: XGraph,
+                  targets: List[str],
+                  inputs_func: Callable,
+                  build_dirs: List[str],
+                  work_dirs: List[str],
+                  quantized: Dict[str, XGraph] = None,
+                  max_workers: int = None) -> CompileReport:
+    """
+    Build the partitioned XGraph for several targets from a single
+    calibration run. Targets that share a quantization key are quantized
+    once, after which all targets are compiled and scheduled concurrently.
+    Every target build directory can be used as a prebuilt build directory.
+
+    Arguments
+    ---------
+    xgraph: XGraph
+        the partitioned (not yet quantized) XGraph model
+    targets: List[str]
+        the targets to build for, they should support the partitioned ops
+    inputs_func: Callable
+        the function returning the (already collected) calibration inputs
+    build_dirs: List[str]
+        the build directory for every target
+    work_dirs: List[str]
+        the work directory for every target
+    quantized: Dict[str, XGraph]
+        quantized XGraphs by quantization key, e.g. the result for the
+        target the calibration was done for
+    max_workers: int
+        the maximum number of concurrent compilations
+
+    Returns
+    -------
+    The CompileReport of the build with a job per target
+    """
+    if len(build_dirs) != len(targets) or len(work_dirs) != len(targets):
+        raise ValueError("Expected a build and work directory for each of"
+                         " the {} targets but got: {} and {}".format(
+                             len(targets), len(build_dirs), len(work_dirs)))
+
+    quantized = dict(quantized) if quantized is not None else {}
+    report = CompileReport()
+    jobs = []
+    for target, build_dir, work_dir in zip(targets, build_dirs, work_dirs):
+        opt_xgraph = optimize(xgraph, target)
+        q_key = get_quantization_key(opt_xgraph, target)
+        q_job = "quantize/{}".format(q_key[:8])
+        if q_key not in quantized:
+            start = time.time()
+            quantized[q_key] = _quantize(opt_xgraph, target, inputs_func,
+                                         work_dir=work_dir)
+            report.add(JobTiming(q_job, start, time.time()))
+        else:
+            logger.info("Reuse quantization result for target: {}"
+                        .format(target))
+            if q_job not in report.timings:
+                now = time.time()
+                report.add(JobTiming(q_job, now, now))
+
+        # The optimized graphs are identical for a shared quantization key so
+        #   the quantized graph can be compiled for every target
+        q_xgraph = quantized[q_key]
+        q_output = q_xgraph.get_quantizer_output() \
+            if q_xgraph.is_quantized() else None
+        graph_str, data_str = XGraphIO.to_string(q_xgraph)
+        jobs.append(CompileJob(
+            target, _build_target_job,
+            (target, graph_str, data_str, q_output, build_dir, work_dir),
+            [q_job]))
+
+    return CompileOrchestrator(max_workers).run(jobs, report)
+
+
 @register_opaque_func('pyxir.build_rt', [TypeCode.XGraph, TypeCode.Str,
                                          TypeCode.Str, TypeCode.vStr,
                                          TypeCode.vStr, TypeCode.OpaqueFunc])
@@ -457,7 +600,10 @@ def build_online_quant_rt_opaque_func(xgraph: XGraph,
         the directory to be used for temporary work files
     quantization_callback: OpaqueFunc
         the callback to be used for starting calibration based
-        quantization using the collected input data
+        quantization using the collected input data and compiling the
+        result into build_dir. It takes a list of additional targets and
+        their build and work directories to which the calibration result is
+        fanned out, see `build_targets`
     rt_cpu_callback: OpaqueFunc
         The callback function to be initialized with an opaque runtime
         function that takes a list of input buffers and output buffers and
@@ -476,14 +622,27 @@ def build_online_quant_rt_opaque_func(xgraph: XGraph,
     def inputs_func(iter):
         return calibration_inputs
 
-    def quant_func():
+    def quant_func(cross_targets: List[str],
+                   cross_build_dirs: List[str],
+                   cross_work_dirs: List[str]):
         opt_xgraph = optimize(xgraph, target)
+        q_key = get_quantization_key(opt_xgraph, target)
         q_xgraph = _quantize(opt_xgraph, target, inputs_func, work_dir=work_dir)
+
+        # Compile for the target and fan out the calibration inputs to the
+        #   requested cross compilation targets in a single build, the
+        #   runtime loads the target build from build_dir afterwards
+        build_targets(xgraph, [target] + list(cross_targets), inputs_func,
+                      [build_dir] + list(cross_build_dirs),
+                      [work_dir] + list(cross_work_dirs),
+                      quantized={q_key: q_xgraph})
+
         # TODO
         xgraph.meta_attrs = q_xgraph.meta_attrs.to_dict()
         # xgraph.copy_from(q_xgraph)
 
-    quantization_callback.set_func(quant_func, [])
+    quantization_callback.set_func(
+        quant_func, [TypeCode.vStr, TypeCode.vStr, TypeCode.vStr])
 
     # CPU runtime function to be used during online quantization
     rt_mod = build(
@@ -0,0 +1,677 @@
+# Copyright 2020 Xilinx Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Module for compiling independent partitions and targets concurrently
+
+The target compilers under `pyxir.contrib.target.components` handle a
+single partition per call. The orchestrator splits a partitioned XGraph
+into one job per (partition, target) pair, runs those jobs in worker
+processes and records when every job ran so the critical path of the
+build can be reported.
+"""
+
+import os
+import ast
+import sys
+import json
+import time
+import shutil
+import filecmp
+import logging
+import importlib
+import multiprocessing
+import multiprocessing.spawn
+import concurrent.futures
+
+from typing import List, Dict, Callable
+
+from pyxir.graph.xgraph import XGraph
+from pyxir.graph.io.xgraph_io import XGraphIO
+from pyxir.target_registry import TargetRegistry
+from pyxir.shared.compiler_output import CompilerOutput
+from pyxir.shared.artifact_store import ArtifactStore, fingerprint_layers,\
+    fingerprint_files, relocate
+from pyxir.graph.partitioning.xgraph_partitioner import XGraphPartitioner
+
+logger = logging.getLogger("pyxir")
+
+target_registry = TargetRegistry()
+xgraph_partitioner = XGraphPartitioner()
+
+
+class CompileJob(object):
+
+    """
+    A unit of work for the CompileOrchestrator
+
+    Attributes
+    ----------
+    name: str
+        the unique name of this job
+    func: Callable
+        the function to be executed, must be picklable (module level) when
+        the orchestrator runs jobs in worker processes
+    args: tuple
+        the positional arguments for `func`
+    deps: List[str]
+        the names of the jobs that have to finish before this job can start
+    """
+
+    def __init__(self, name: str, func: Callable, args: tuple = (),
+                 deps: List[str] = None):
+        self.name = name
+        self.func = func
+        self.args = args
+        self.deps = deps if deps is not None else []
+
+
+class JobTiming(object):
+
+    """ Timing information of a single finished job """
+
+    def __init__(self, name: str, start: float, end: float,
+                 deps: List[str] = None, worker: int = 0):
+        self.name = name
+        self.start = start
+        self.end = end
+        self.deps = deps if deps is not None else []
+        self.worker = worker
+
+    @property
+    def duration(self) -> float:
+        return self.end - self.start
+
+
+class CompileReport(object):
+
+    """ Collects job timings and computes the critical path of a build """
+
+    def __init__(self):
+        self.timings = {}
+        self.results = {}
+        self.reused = []
+
+    def add(self, timing: JobTiming, result=None) -> None:
+        self.timings[timing.name] = timing
+        self.results[timing.name] = result
+
+    def get(self, name: str):
+        return self.results[name]
+
+    def get_wall_time(self) -> float:
+        """ Return the time between the first job start and last job end """
+        if not self.timings:
+            return 0.
+        return max(t.end for t in self.timings.values()) -\
+            min(t.start for t in self.timings.values())
+
+    def get_total_time(self) -> float:
+        """ Return the sum of all job durations, i.e. the serial build time """
+        return sum(t.duration for t in self.timings.values())
+
+    def critical_path(self) -> List[str]:
+        """
+        Return the chain of dependent jobs with the largest summed duration.
+        No schedule can finish the build faster than this chain.
+        """
+        longest = {}
+
+        def visit(name):
+            if name not in longest:
+                timing = self.timings[name]
+                best_len, best_path = 0., []
+                for dep in timing.deps:
+                    dep_len, dep_path = visit(dep)
+                    if dep_len > best_len:
+                        best_len, best_path = dep_len, dep_path
+                longest[name] = (best_len + timing.duration,
+                                 best_path + [name])
+            return longest[name]
+
+        path_len, path = 0., []
+        for name in self.timings:
+            name_len, name_path = visit(name)
+            if name_len > path_len:
+                path_len, path = name_len, name_path
+        return path
+
+    def get_critical_path_time(self) -> float:
+        return sum(self.timings[n].duration for n in self.critical_path())
+
+    def summary(self) -> str:
+        lines = ["{:<40} {:>10} {:>10} {:>8}"
+                 .format("job", "start (s)", "time (s)", "worker")]
+        t0 = min([t.start for t in self.timings.values()] or [0.])
+        for t in sorted(self.timings.values(), key=lambda t: t.start):
+            lines.append("{:<40} {:>10.3f} {:>10.3f} {:>8}"
+                         .format(t.name, t.start - t0, t.duration, t.worker))
+        lines.append("critical path: {} ({:.3f} s)"
+                     .format(" -> ".join(self.critical_path()),
+                             self.get_critical_path_time()))
+        lines.append("wall time: {:.3f} s, serial time: {:.3f} s"
+                     .format(self.get_wall_time(), self.get_total_time()))
+        return "\n".join(lines)
+
+
+def _import_modules(modules: List[str]) -> None:
+    """
+    Worker initializer, import the modules that registered targets in the
+    parent process so the targets are registered in the worker as well
+    """
+    for module in modules:
+        try:
+            importlib.import_module(module)
+        except Exception as e:
+            logger.debug("Can't import module: {} in compile worker: {}"
+                         .format(module, e))
+
+
+def _get_target_modules() -> List[str]:
+    """ Return the importable modules defining the registered targets """
+    modules = set()
+    for target in target_registry.get_targets():
+        for func in [target.get_xgraph_build_func(),
+                     target.get_xgraph_optimizer(),
+                     target.get_xgraph_quantizer(),
+                     target.get_xgraph_compiler()]:
+            module = getattr(func, '__module__', None)
+            if module is not None and module != '__main__':
+                modules.add(module)
+    return sorted(modules)
+
+
+def _is_main_guard(test) -> bool:
+    """ Whether the given if test is `__name__ == '__main__'` """
+    if not isinstance(test, ast.Compare) or len(test.ops) != 1 \
+            or not isinstance(test.ops[0], ast.Eq):
+        return False
+    operands = [test.left, test.comparators[0]]
+    names = [op.id for op in operands if isinstance(op, ast.Name)]
+    values = [getattr(op, 'value', getattr(op, 's', None)) for op in operands
+              if not isinstance(op, ast.Name)]
+    return names == ['__name__'] and values == ['__main__']
+
+
+def _get_process_fallback_reason():
+    """
+    Return why compile jobs can't run in worker processes, None if they
+    can. Worker processes are started with a Python interpreter and
+    re-import the __main__ module of this process.
+    """
+    # Embedding hosts (e.g. the C API or the inference server) aren't Python
+    #   interpreters, unless one was set with multiprocessing.set_executable
+    executable = os.fsdecode(multiprocessing.spawn.get_executable() or '')
+    name = os.path.basename(executable).lower()
+    if not os.path.isfile(executable) \
+            or not name.startswith(('python', 'pypy')):
+        return "'{}' isn't a Python interpreter".format(executable)
+
+    main_path = getattr(sys.modules.get('__main__'), '__file__', None)
+    if main_path is None:
+        # Interactive sessions, nothing is re-imported
+        return None
+    try:
+        with open(main_path) as f:
+            tree = ast.parse(f.read(), main_path)
+    except (OSError, SyntaxError, ValueError, UnicodeDecodeError):
+        return "the __main__ module '{}' can't be imported".format(main_path)
+    # Scripts without a main guard would run again in every worker
+    if not any(isinstance(node, ast.If) and _is_main_guard(node.test)
+               for node in tree.body):
+        return "the __main__ module '{}' has no `if __name__ == '__main__'`"\
+            " guard".format(main_path)
+    return None
+
+
+def _run_job(func: Callable, args: tuple):
+    """ Worker entry point, time the job where it actually runs """
+    start = time.time()
+    result = func(*args)
+    return result, start, time.time(), os.getpid()
+
+
+class CompileOrchestrator(object):
+
+    """
+    Run a DAG of CompileJobs, starting every job as soon as all its
+    dependencies have finished
+
+    Arguments
+    ---------
+    max_workers: int
+        the maximum number of concurrent jobs, defaults to the number of CPUs
+    use_processes: bool
+        whether to run jobs in worker processes or in threads. Worker
+        processes are started with the forkserver (or spawn) method as
+        forking a process with running threads isn't safe. Workers import
+        the modules of the targets registered in this process, so targets
+        registered in `__main__` aren't available to the jobs. Jobs run in
+        threads instead if workers can't be started safely: when Python is
+        embedded in a host that isn't a Python interpreter (see
+        multiprocessing.set_executable) or when the `__main__` script has no
+        main guard and would run again in every worker.
+    """
+
+    def __init__(self, max_workers: int = None, use_processes: bool = True):
+        self.max_workers = max_workers if max_workers is not None \
+            else (os.cpu_count() or 1)
+        self.use_processes = use_processes
+
+    def _create_executor(self):
+        fallback_reason = _get_process_fallback_reason() \
+            if self.use_processes else None
+        if fallback_reason is not None:
+            logger.info("Running compile jobs in threads as {}"
+                        .format(fallback_reason))
+        elif self.use_processes:
+            methods = multiprocessing.get_all_start_methods()
+            ctx = multiprocessing.get_context(
+                'forkserver' if 'forkserver' in methods else 'spawn')
+            return concurrent.futures.ProcessPoolExecutor(
+                max_workers=self.max_workers, mp_context=ctx,
+                initializer=_import_modules,
+                initargs=(_get_target_modules(),))
+        return concurrent.futures.ThreadPoolExecutor(
+            max_workers=self.max_workers)
+
+    def run(self, jobs: List[CompileJob],
+            report: CompileReport = None) -> CompileReport:
+        """
+        Run the given jobs and return the report. Jobs may depend on jobs
+        already recorded in the given report, e.g. steps that ran in the
+        calling process.
+        """
+        report = report if report is not None else CompileReport()
+        jobs = {job.name: job for job in jobs}
+        for job in jobs.values():
+            for dep in job.deps:
+                if dep not in jobs and dep not in report.timings:
+                    raise ValueError("Compile job: {} depends on unknown job:"
+                                     " {}".format(job.name, dep))
+
+        pending = dict(jobs)
+        running = {}
+
+        with self._create_executor() as executor:
+            while pending or running:
+                ready = [job for job in pending.values()
+                         if all(d in report.timings for d in job.deps)]
+                if not ready and not running:
+                    raise ValueError("Cyclic dependencies between compile"
+                                     " jobs: {}".format(list(pending.keys())))
+                for job in ready:
+                    del pending[job.name]
+                    logger.debug("Start compile job: {}".format(job.name))
+                    future = executor.submit(_run_job, job.func, job.args)
+                    running[future] = job
+
+                done, _ = concurrent.futures.wait(
+                    running.keys(),
+                    return_when=concurrent.futures.FIRST_COMPLETED)
+                for future in done:
+                    job = running.pop(future)
+                    # Re-raise worker errors in the calling process
+                    result, start, end, worker = future.result()
+                    report.add(JobTiming(job.name, start, end, job.deps,
+                                         worker), result)
+                    logger.debug("Finished compile job: {} in {:.3f} s"
+                                 .format(job.name, end - start))
+
+        logger.info("Compilation report:\n{}".format(report.summary()))
+        return report
+
+
+def get_compile_fingerprint(xgraph: XGraph, target: str,
+                            kwargs: dict = None) -> str:
+    """
+    Return the fingerprint of compiling the given XGraph for the given
+    target. It covers the structure and weights of all partitions, the
+    content of their quantization files and the compiler arguments, so CPU
+    only changes (e.g. a fine-tuned head) don't invalidate it. Partition
+    XGraphs still carry the quantization output of all partitions, only
+    the quantization files keyed by the remaining partitions are covered.
+    Quantization outputs that aren't keyed by partition are covered as a
+    whole.
+    """
+    partitions = xgraph_partitioner.get_subgraphs(xgraph)
+    layers = [X for Xp in partitions for X in Xp.subgraph_data]
+    q_files = []
+    if xgraph.is_quantized():
+        q_output = xgraph.get_quantizer_output()
+        q_keys = [Xp.name for Xp in partitions if Xp.name in q_output.keys()]
+        if len(q_keys) == 0:
+            q_keys = q_output.keys()
+        for q_key in sorted(q_keys):
+            q_files += [q_output.get_q_file(q_key),
+                        q_output.get_q_info(q_key),
+                        q_output.get_q_eval(q_key)]
+    extra = [target, fingerprint_files(q_files),
+             sorted((k, repr(v)) for k, v in (kwargs or {}).items())]
+    return fingerprint_layers(layers, extra)
+
+
+def _compile(xgraph: XGraph, target: str, work_dir: str, build_dir: str,
+             kwargs: dict):
+    """
+    Compile the XGraph and return the compiler output and the meta
+    attributes set by the target compiler
+    """
+    meta_before = xgraph.meta_attrs.to_dict()
+    c_xgraph = target_registry.get_target_compiler(target)(
+        xgraph, work_dir=work_dir, build_dir=build_dir, **kwargs)
+
+    c_output = c_xgraph.get_compiler_output() if c_xgraph.is_compiled() \
+        else None
+    meta_diff = {k: v for k, v in c_xgraph.meta_attrs.to_dict().items()
+                 if k not in meta_before or meta_before[k] != v}
+    return c_output, meta_diff
+
+
+def _restore_compiled(xgraph: XGraph, c_output, meta_diff: dict) -> XGraph:
+    """ Attach reused compilation results to the given XGraph """
+    if c_output is not None:
+        xgraph.set_compiler_output(c_output)
+    meta_attrs = xgraph.meta_attrs.to_dict()
+    meta_attrs.update(meta_diff)
+    xgraph.meta_attrs = meta_attrs
+    return xgraph
+
+
+def compile_cached(xgraph: XGraph,
+                   target: str,
+                   work_dir: str,
+                   build_dir: str,
+                   artifact_store: ArtifactStore = None,
+                   **kwargs) -> XGraph:
+    """
+    Compile the XGraph for the given target, reusing the build directory of
+    an earlier compilation with the same fingerprint from the artifact store
+    """
+    if artifact_store is None:
+        c_output, meta_diff = _compile(xgraph, target, work_dir, build_dir,
+                                       kwargs)
+        return _restore_compiled(xgraph, c_output, meta_diff)
+
+    key = get_compile_fingerprint(xgraph, target, kwargs)
+    if artifact_store.has(key):
+        logger.info("Reuse compilation of {} for target: {}"
+                    .format(xgraph.get_name(), target))
+        c_output, meta_diff = artifact_store.load(key, build_dir)
+        return _restore_compiled(xgraph, c_output, meta_diff)
+
+    c_output, meta_diff = _compile(xgraph, target, work_dir, build_dir,
+                                   kwargs)
+    artifact_store.save(key, build_dir, (c_output, meta_diff))
+    return _restore_compiled(xgraph, c_output, meta_diff)
+
+
+def _compile_partition(target: str,
+                       graph_str: bytes,
+                       data_str: bytes,
+                       q_output,
+                       work_dir: str,
+                       build_dir: str,
+                       kwargs: dict):
+    """ Compile a single partition XGraph for the given target """
+    xgraph = XGraphIO.from_string(graph_str, data_str)
+    if q_output is not None:
+        xgraph.set_quantizer_output(q_output)
+    return _compile(xgraph, target, work_dir, build_dir, kwargs)
+
+
+def get_partition_xgraph(xgraph: XGraph, partition: str) -> XGraph:
+    """
+    Return a copy of the XGraph in which only the given partition is
+    annotated for acceleration. All other partitions fall back to the CPU
+    so target compilers that compile the first partition only see this one.
+    """
+    p_xgraph = xgraph.copy()
+    p_xgraph.set_name(partition)
+    for X in p_xgraph.get_layers():
+        if X.subgraph is not None and X.subgraph != partition:
+            X.subgraph = None
+            X.target = 'cpu'
+    return p_xgraph
+
+
+def compile_partitions(xgraph: XGraph,
+                       targets: List[str] = None,
+                       work_dir: str = None,
+                       build_dir: str = None,
+                       max_workers: int = None,
+                       use_processes: bool = True,
+                       artifact_store: ArtifactStore = None,
+                       **kwargs) -> CompileReport:
+    """
+    Compile every partition of the given partitioned (and quantized) XGraph
+    concurrently, for every given target
+
+    Arguments
+    ---------
+    xgraph: XGraph
+        the partitioned XGraph
+    targets: List[str]
+        the targets to cross-compile every partition for. If None, every
+        partition is compiled for the target it was partitioned for
+    work_dir: str
+        the root directory for temporary work files, every job works in
+        `work_dir/<target>/<partition>`
+    build_dir: str
+        the root directory for build files, every job writes to
+        `build_dir/<target>/<partition>`
+    max_workers: int
+        the maximum number of concurrent compile jobs
+    use_processes: bool
+        whether to compile in worker processes or threads
+    artifact_store: ArtifactStore
+        if provided, partitions with an unchanged fingerprint are restored
+        from the store instead of being recompiled
+
+    Returns
+    -------
+    A CompileReport with a (CompilerOutput, meta attributes) result for
+    every job, named `<target>/<partition>`, and a merged CompilerOutput per
+    target under the `<target>` key. Reused jobs are listed in
+    `report.reused`.
+    """
+    if work_dir is None:
+        work_dir = os.path.abspath(os.path.join(os.getcwd(), "work"))
+    if build_dir is None:
+        build_dir = os.path.abspath(os.path.join(os.getcwd(), "build"))
+
+    # The quantization result is computed once and shared by every job
+    q_output = xgraph.get_quantizer_output() if xgraph.is_quantized() \
+        else None
+
+    partitions = xgraph_partitioner.get_subgraphs(xgraph)
+    if len(partitions) == 0:
+        raise ValueError("Can't compile XGraph: {} as it doesn't contain any"
+                         " partitions".format(xgraph.get_name()))
+
+    jobs = []
+    reused = {}
+    keys = {}
+    target_jobs = {}
+    for Xp in partitions:
+        p_targets = targets if targets is not None else [Xp.attrs['target']]
+        p_xgraph = get_partition_xgraph(xgraph, Xp.name)
+        graph_str, data_str = XGraphIO.to_string(p_xgraph)
+        for target in p_targets:
+            target_registry.check_target(target)
+            name = "{}/{}".format(target, Xp.name)
+            p_build_dir = os.path.join(build_dir, target, Xp.name)
+            target_jobs.setdefault(target, []).append(name)
+
+            if artifact_store is not None:
+                keys[name] = get_compile_fingerprint(p_xgraph, target, kwargs)
+                if artifact_store.has(keys[name]):
+                    reused[name] = artifact_store.load(keys[name],
+                                                       p_build_dir)
+                    continue
+
+            jobs.append(CompileJob(
+                name, _compile_partition,
+                (target, graph_str, data_str, q_output,
+                 os.path.join(work_dir, target, Xp.name),
+                 p_build_dir, kwargs)))
+
+    report = CompileOrchestrator(max_workers, use_processes).run(jobs)
+
+    report.reused = list(reused.keys())
+    for name, result in reused.items():
+        now = time.time()
+        report.add(JobTiming(name, now, now), result)
+    if artifact_store is not None:
+        for job in jobs:
+            artifact_store.save(keys[job.name], job.args[5],
+                                report.get(job.name))
+
+    for target, names in target_jobs.items():
+        c_output = CompilerOutput(name=xgraph.get_name())
+        for name in names:
+            p_output, _ = report.get(name)
+            if p_output is None:
+                continue
+            for c_key in p_output.keys():
+                c_output.add(c_key, p_output.get_code_files(c_key),
+                             p_output.get_in_map(c_key),
+                             p_output.get_out_map(c_key))
+        report.results[target] = c_output
+
+    return report
+
+
+def get_max_workers_from_env():
+    """
+    Return the maximum number of concurrent partition compilations set in
+    PX_COMPILE_WORKERS, None if it isn't set. Zero disables concurrent
+    partition compilation.
+    """
+    max_workers = os.environ.get('PX_COMPILE_WORKERS', '')
+    if not max_workers:
+        return None
+    try:
+        max_workers = int(max_workers)
+    except ValueError:
+        raise ValueError("PX_COMPILE_WORKERS should be an integer but got: {}"
+                         .format(max_workers))
+    if max_workers < 0:
+        raise ValueError("PX_COMPILE_WORKERS can't be negative but got: {}"
+                         .format(max_workers))
+    return max_workers
+
+
+def _merge_files(src_dir: str, dst_dir: str, name: str, merged: dict,
+                 exclude=()) -> None:
+    """
+    Copy the build files of partition `name` in src_dir into dst_dir.
+    merged maps every file written by the merge to the partition that wrote
+    it. Files which several partitions produced identically are kept once,
+    files of an earlier build are replaced.
+    """
+    for f in sorted(os.listdir(src_dir)):
+        if f in exclude:
+            continue
+        src, dst = os.path.join(src_dir, f), os.path.join(dst_dir, f)
+        if os.path.isdir(src):
+            os.makedirs(dst, exist_ok=True)
+            _merge_files(src, dst, name, merged)
+        elif dst not in merged:
+            shutil.copy2(src, dst)
+            merged[dst] = name
+        elif not filecmp.cmp(src, dst, shallow=False):
+            raise ValueError("Partitions {} and {} produced different build"
+                             " files: {}".format(merged[dst], name, dst))
+
+
+def _merge_build_dir(src_dir: str, dst_dir: str, name: str, meta_d: dict,
+                     merged: dict) -> bool:
+    """
+    Merge the build directory of partition `name` into the shared build
+    directory and its meta file into meta_d, returns whether there was one.
+    Raises a ValueError if an earlier partition wrote a different build file
+    or meta value under the same name, as a single compiler call couldn't
+    have produced both.
+    """
+    meta_file = os.path.join(src_dir, 'meta.json')
+    has_meta = os.path.isfile(meta_file)
+    if has_meta:
+        with open(meta_file, 'r') as json_file:
+            for k, v in json.load(json_file).items():
+                if k in meta_d and meta_d[k] != v:
+                    raise ValueError("Partition {} conflicts with an earlier"
+                                     " partition in meta.json key: {}"
+                                     .format(name, k))
+                meta_d[k] = v
+    _merge_files(src_dir, dst_dir, name, merged, exclude=('meta.json',))
+    return has_meta
+
+
+def compile_partitioned(xgraph: XGraph,
+                        target: str,
+                        work_dir: str,
+                        build_dir: str,
+                        max_workers: int = None,
+                        artifact_store: ArtifactStore = None) -> XGraph:
+    """
+    Compile every partition of the XGraph for the given target concurrently
+    and merge the partition builds into build_dir, as if a single compiler
+    call compiled all partitions. The runtimes find the build files of every
+    partition by partition name in build_dir. Partitions producing different
+    build files or meta values under the same name raise a ValueError.
+    """
+    # Absolute paths, so that the paths of compiled and reused partitions
+    #   can both be relocated into build_dir
+    build_dir = os.path.abspath(build_dir)
+    report = compile_partitions(xgraph, [target], work_dir=work_dir,
+                                build_dir=build_dir, max_workers=max_workers,
+                                artifact_store=artifact_store)
+
+    os.makedirs(build_dir, exist_ok=True)
+    c_output = CompilerOutput(name=xgraph.get_name())
+    meta_d, meta_diff, merged, has_meta = {}, {}, {}, False
+    p_build_dirs = []
+    for Xp in xgraph_partitioner.get_subgraphs(xgraph):
+        p_build_dir = os.path.join(build_dir, target, Xp.name)
+        p_build_dirs.append(p_build_dir)
+        # The results refer to the merged build instead of the partition one
+        p_output, p_meta_diff = relocate(
+            report.get("{}/{}".format(target, Xp.name)), p_build_dir,
+            build_dir)
+        for k, v in p_meta_diff.items():
+            meta_diff.setdefault(k, v)
+        if p_output is not None:
+            for c_key in p_output.keys():
+                c_output.add(c_key, p_output.get_code_files(c_key),
+                             p_output.get_in_map(c_key),
+                             p_output.get_out_map(c_key))
+        if os.path.isdir(p_build_dir):
+            has_meta |= _merge_build_dir(p_build_dir, build_dir, Xp.name,
+                                         meta_d, merged)
+    if has_meta:
+        with open(os.path.join(build_dir, 'meta.json'), 'w') as f:
+            json.dump(meta_d, f, indent=4, sort_keys=True)
+
+    # Only the merged build is kept
+    for p_build_dir in p_build_dirs:
+        shutil.rmtree(p_build_dir, ignore_errors=True)
+    try:
+        os.rmdir(os.path.join(build_dir, target))
+    except OSError:
+        # Not empty, e.g. the work directory of a partition is kept there
+        pass
+
+    return _restore_compiled(xgraph, c_output if len(c_output.keys()) > 0
+                             else None, meta_diff)
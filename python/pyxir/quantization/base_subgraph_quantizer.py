@@ -25,6 +25,8 @@ from pyxir.graph import XGraph
 from pyxir.graph.xgraph_factory import XGraphFactory
 from pyxir.graph.partitioning.xgraph_partitioner import XGraphPartitioner
 from pyxir.quantization.base_quantizer import XGraphBaseQuantizer
+from pyxir.shared.artifact_store import ArtifactStore, fingerprint_layers,\
+    fingerprint_inputs
 
 logger = logging.getLogger("pyxir")
 
@@ -44,13 +46,21 @@ class XGraphBaseSubgraphQuantizer(XGraphBaseQuantizer):
         the directory to be used for writing files
     quant_iter:
         the number of quantization iterations to be done
+    artifact_store: ArtifactStore
+        the store for reusing the quantization results of unchanged
+        subgraphs, defaults to the store in PX_ARTIFACT_STORE if set
     """
 
     xgraph_partitioner = XGraphPartitioner()
     xgraph_factory = XGraphFactory()
 
     def __init__(
-        self, xgraph, inputs_func, work_dir=os.path.join(os.getcwd()), quant_iter=1
+        self,
+        xgraph,
+        inputs_func,
+        work_dir=os.path.join(os.getcwd()),
+        quant_iter=1,
+        artifact_store=None,
     ):
         #
         super(XGraphBaseSubgraphQuantizer, self).__init__(xgraph)
@@ -86,6 +96,9 @@ class XGraphBaseSubgraphQuantizer(XGraphBaseQuantizer):
         self.work_dir = work_dir
         os.makedirs(self.work_dir, exist_ok=True)
         self.quant_iter = quant_iter
+        self.artifact_store = (
+            artifact_store if artifact_store is not None else ArtifactStore.from_env()
+        )
 
     def quantize_subgraph(
         self,
@@ -97,6 +110,23 @@ class XGraphBaseSubgraphQuantizer(XGraphBaseQuantizer):
         """Quantize a subgraph with given calibration inputs"""
         raise NotImplementedError("")
 
+    def get_fingerprint_extra(self) -> list:
+        """Return the quantizer settings that affect the subgraph results"""
+        return [type(self).__name__, self.quant_iter]
+
+    def get_subgraph_artifacts(self, xgraph: XGraph):
+        """
+        Return the files in the work directory and a picklable description
+        of the quantization result of the given subgraph so it can be reused
+        by later builds. Quantizers that return None for the description
+        always requantize.
+        """
+        return [], None
+
+    def restore_subgraph(self, xgraph: XGraph, meta) -> None:
+        """Restore a quantization result returned by get_subgraph_artifacts"""
+        raise NotImplementedError("")
+
     def quantize(self) -> XGraph:
         """Start quantization of the partitioned xgraph
         
@@ -141,8 +171,31 @@ class XGraphBaseSubgraphQuantizer(XGraphBaseQuantizer):
                 self.subgraph_input_map[Xp.name][in_name]: self.subgraph_inputs[in_name]
                 for in_name in original_input_names
             }
+
+            # Reuse the result of an earlier build if the subgraph structure,
+            #   weights and calibration inputs are unchanged
+            key = None
+            if self.artifact_store is not None:
+                key = fingerprint_layers(
+                    Xp.subgraph_data,
+                    self.get_fingerprint_extra() + [fingerprint_inputs(inputs)],
+                )
+                if self.artifact_store.has(key):
+                    logger.info("Reuse quantization of subgraph: {}".format(Xp.name))
+                    # The work directory is shared with the other partitions
+                    #   and the quantizer's own files, e.g. the frozen
+                    #   partition graphs, so only add the stored files
+                    meta = self.artifact_store.load(key, self.work_dir, merge=True)
+                    self.restore_subgraph(sub_xgraph, meta)
+                    continue
+
             self.quantize_subgraph(sub_xgraph, inputs, input_names, output_names)
 
+            if key is not None:
+                files, meta = self.get_subgraph_artifacts(sub_xgraph)
+                if meta is not None:
+                    self.artifact_store.save(key, self.work_dir, meta, files)
+
         logger.debug("STOP Subgraph quantization")
 
         return self.xgraph
@@ -69,10 +69,13 @@ class DECENTQuantizer(XGraphBaseSubgraphQuantizer):
         work_dir=os.path.join(os.getcwd(), "work"),
         quant_iter=1,
         compiler_target=None,
+        artifact_store=None,
         **kwargs
     ):
 
-        super(DECENTQuantizer, self).__init__(xgraph, inputs_func, work_dir)
+        super(DECENTQuantizer, self).__init__(
+            xgraph, inputs_func, work_dir, artifact_store=artifact_store
+        )
 
         self.quant_iter = quant_iter
         self.compiler_target = compiler_target
@@ -154,6 +157,52 @@ class DECENTQuantizer(XGraphBaseSubgraphQuantizer):
         # Add quantization info to corresponding XLayers
         self._add_quant_info_to_xgraph(netcfg)
 
+    def get_fingerprint_extra(self) -> list:
+        return super(DECENTQuantizer, self).get_fingerprint_extra() + [
+            self.compiler_target,
+            sorted((k, repr(v)) for k, v in self.kwargs.items()),
+        ]
+
+    def get_subgraph_artifacts(self, xgraph: XGraph):
+        q_key = xgraph.get_name()
+        files = [
+            f
+            for f in [
+                self.q_output.get_q_file(q_key),
+                self.q_output.get_q_info(q_key),
+                self.q_output.get_q_eval(q_key),
+            ]
+            if os.path.isfile(f)
+        ]
+        quant_attrs = {}
+        for X_name in xgraph.get_layer_names():
+            if X_name in self.xgraph:
+                X = self.xgraph.get(X_name)
+                quant_attrs[X_name] = {
+                    k: X.attrs[k] for k in X.attrs.keys() if k.startswith("vai_quant")
+                }
+        meta = {
+            "q_file": self.q_output.get_q_file(q_key),
+            "q_info": self.q_output.get_q_info(q_key),
+            "orig_pb": self.q_output.get_orig_pb(q_key),
+            "q_eval": self.q_output.get_q_eval(q_key),
+            "quant_attrs": quant_attrs,
+        }
+        return files, meta
+
+    def restore_subgraph(self, xgraph: XGraph, meta) -> None:
+        self.q_output.add(
+            xgraph.get_name(),
+            meta["q_file"],
+            meta["q_info"],
+            self.partition_graphs[xgraph.get_name()],
+            meta["q_eval"],
+        )
+        for X_name, attrs in meta["quant_attrs"].items():
+            X = self.xgraph.get(X_name)
+            for k, v in attrs.items():
+                X.attrs[k] = v
+
     def quantize(self) -> XGraph:
         """Quantize the XGraph model using the decent_q quantizer
         
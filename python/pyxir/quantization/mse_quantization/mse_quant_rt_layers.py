@@ -27,6 +27,8 @@ from pyxir.runtime.tensorflow.rt_layer_tf import RtLayerTF
 from pyxir.runtime.tensorflow.ops.tf_l1_basic_nn import ReluLayer
 from pyxir.runtime.tensorflow.runtime_tf import X_2_TF
 
+from .threshold_search import search_mse_thresholds
+
 logger = logging.getLogger("pyxir")
 
 # Suppress warnings
@@ -198,27 +200,18 @@ class MSEQuantizeLayer(MSEQuantizeLayerBase, RtLayerTF):
                 best_th = th_max
                 best_mse = mse_th_max
 
-            for _ in range(0, mse_opt_num):
-                ra = np.random.rand()  # np.random.rand(*th.shape)
-                while ra == 0.:
-                    ra = np.random.rand()
-                # ra[ra == 0.] = ra.mean() + 0.0001 # replace zeros
-                th_rand = ra * th_max
-                # TODO TEST
-                x_h = quantize_unquantize(x, th_rand)
-                # if beta is not None:
-                #     mean_axis = (0,2,3) if th.shape in [(), (1,)]
-                #       else (1,2,3)
-                #     #beta_est = (x - x_h).mean(axis=mean_axis)
-                #     beta_est = np.median(x - x_h, axis=mean_axis)
-                #     beta_est = np.expand_dims(beta_est, 1)
-                #     beta_est = np.expand_dims(beta_est, 1)
-                #     beta_est = np.expand_dims(beta_est, 0)
-                #     x_h += beta_est
-
-                mse_rand = MSE(x_h, x)
-                if mse_rand < best_mse:
-                    best_th, best_mse = th_rand, mse_rand
+            if mse_opt_num > 0:
+                # Evaluate all candidate thresholds on a histogram of x with
+                #   the native search engine, per output channel for OIHW
+                #   weights
+                th_search = search_mse_thresholds(
+                    [x], axes=[None if axis is None else 0],
+                    bitwidth=bitwidth,
+                    nb_candidates=mse_opt_num)[0].reshape(th_max.shape)
+                th_search = np.where(th_search > 0, th_search, th_max)
+                mse_search = MSE(quantize_unquantize(x, th_search), x)
+                if mse_search < best_mse:
+                    best_th, best_mse = th_search, mse_search
 
             return best_th.astype(np.float32)
 
@@ -32,6 +32,7 @@ from pyxir.quantization.quant_scaling_pass import XGraphQuantScalingPass
 import pyxir.contrib.tools.classification as xfdnn_classification
 
 from .xgraph_pass_add_mse_quant_layers import XGraphPassAddMSEQuantLayers
+from .threshold_search import search_mse_thresholds
 # from .pyxir_pass_add_eltwise_scale_layers import#
 #   XGraphPassAddEltwiseScaleLayers
 
@@ -58,8 +59,9 @@ class XGraphMSEThresholdQuantizer(XGraphBaseQuantizer):
     quant_iter: int
         the number of iterations for quantization
     mse_opt_num: int
-        the number of trials for optimizing mean squared (MSE) error between
-        full precision and quantized outputs
+        the number of candidate thresholds evaluated for optimizing the mean
+        squared (MSE) error between full precision and quantized outputs,
+        0 disables the search
     """
 
     def __init__(self,
@@ -135,6 +137,9 @@ class XGraphMSEThresholdQuantizer(XGraphBaseQuantizer):
         )
         xgraph = graph_pass.execute(xgraph=xgraph)
 
+        if self.mse_opt_num > 0:
+            self._search_param_thresholds(xgraph)
+
         self.quant_xgraph = xgraph
         self.runtime = pyxir.build(self.quant_xgraph, target='cpu')
 
@@ -152,6 +157,36 @@ class XGraphMSEThresholdQuantizer(XGraphBaseQuantizer):
 
         self._retrieve_quant_params(params, xgraph, subgraphs_only)
 
+    def _search_param_thresholds(self, xgraph):
+        # type: (XGraph) -> None
+        """
+        Search the weight thresholds of all convolutions at once with the
+        native threshold search engine, which processes the layers in
+        parallel. The found thresholds initialize the threshold variables
+        and the quantization layers of the weights only compare them with
+        the maximum thresholds at runtime.
+        """
+        conv_Xs = [X for X in xgraph.get_layers()
+                   if 'Convolution' in X.type
+                   and X.name + '_th_params' in xgraph
+                   and X.name + '_kernel_quantize' in xgraph]
+        if len(conv_Xs) == 0:
+            return
+
+        thresholds = search_mse_thresholds(
+            [X.data.weights for X in conv_Xs],
+            axes=[0] * len(conv_Xs),  # OIHW
+            bitwidth=self.bitwidth,
+            nb_candidates=self.mse_opt_num)
+
+        for X, th_params in zip(conv_Xs, thresholds):
+            # All zero channels keep the default threshold of 1
+            th_X = xgraph.get(X.name + '_th_params')
+            th_X.data = [np.where(th_params > 0, th_params, 1.)
+                         .astype(np.float32)]
+            k_quant_X = xgraph.get(X.name + '_kernel_quantize')
+            k_quant_X.attrs['mse_opt_num'] = 0
+
     def _retrieve_quant_params(self, thresholds, xgraph, subgraphs_only):
         # type: (dict, XGraph) -> None
         """ """
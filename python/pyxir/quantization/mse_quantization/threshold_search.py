@@ -0,0 +1,83 @@
+# Copyright 2020 Xilinx Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+"""
+Module for searching mean squared error (MSE) optimal quantization
+thresholds with the native threshold search engine
+"""
+
+import numpy as np
+
+from typing import List
+
+from pyxir.shared.xbuffer import XBuffer
+from pyxir.opaque_func_registry import OpaqueFuncRegistry
+
+# The axis value indicating that a single threshold should be searched
+PER_TENSOR = -1
+
+
+def search_mse_thresholds(tensors: List[np.ndarray],
+                          axes: List[int] = None,
+                          bitwidth: int = 8,
+                          nb_bins: int = 2048,
+                          nb_candidates: int = 256) -> List[np.ndarray]:
+    """
+    Search the MSE optimal symmetric quantization thresholds of the given
+    tensors. A histogram is built for every tensor (channel) and all
+    candidate thresholds are evaluated on it. The tensors are processed in
+    parallel.
+
+    Arguments
+    ---------
+    tensors: List[numpy.ndarray]
+        the tensors to search thresholds for
+    axes: List[int]
+        for every tensor the axis along which per channel thresholds are
+        searched or None for a single threshold (default: all None)
+    bitwidth: int
+        the quantization bitwidth
+    nb_bins: int
+        the number of histogram bins
+    nb_candidates: int
+        the number of candidate thresholds, evenly spaced up to the maximum
+        absolute value of the tensor (channel)
+
+    Returns
+    -------
+    thresholds: List[numpy.ndarray]
+        the float32 thresholds of every tensor, of size 1 for per tensor
+        thresholds. Thresholds of all zero tensors (channels) are 0.
+    """
+    if axes is None:
+        axes = [None] * len(tensors)
+    if len(axes) != len(tensors):
+        raise ValueError("Expected an axis for every tensor but got {} axes"
+                         " for {} tensors".format(len(axes), len(tensors)))
+
+    tensors = [np.ascontiguousarray(t, dtype=np.float32) for t in tensors]
+    axes = [PER_TENSOR if axis is None else axis % t.ndim
+            for t, axis in zip(tensors, axes)]
+    thresholds = [np.zeros(1 if axis == PER_TENSOR else t.shape[axis],
+                           dtype=np.float32)
+                  for t, axis in zip(tensors, axes)]
+    if len(tensors) == 0:
+        return thresholds
+
+    of = OpaqueFuncRegistry.Get("pyxir.quantization.search_mse_thresholds")
+    of([XBuffer(t, copy=False) for t in tensors],
+       [XBuffer(th, copy=False) for th in thresholds],
+       [bitwidth, nb_bins, nb_candidates] + axes)
+    return thresholds
@@ -21,6 +21,9 @@ Module for pyxir execution layers implemented on top of numpy
 import numpy as np
 import logging
 
+from pyxir.shared.xbuffer import XBuffer
+from pyxir.opaque_func_registry import OpaqueFuncRegistry
+
 from .. import rt_layer
 from . import nn
 
@@ -392,7 +395,10 @@ class ConvLayer(rt_layer.ConvLayer):
             raise NotImplementedError("Only 'NCHW' layout supported for"
                                       " numpy conv2d layer for now")
 
-        X, kernel, bias = inputs
+        # Quantization simulation provides int8 inputs and weights and int32
+        #   biases, accumulate in floating point like the tensorflow runtime
+        X, kernel, bias = [np.asarray(inpt, dtype=self.dtype)
+                           for inpt in inputs]
         kernel_layout, paddings, strides, dilations = \
             self.kernel_layout, self.paddings, self.strides, self.dilations
 
@@ -462,3 +468,113 @@ class PoolingLayer(rt_layer.PoolingLayer):
         X_res = pool_func(X, ksize=ksize, strides=strides[2:4])
 
         return X_res
+
+
+###########################
+# QUANTIZATION SIMULATION #
+###########################
+
+
+def fixpoint_exec(of, inputs, res, params):
+    # type: (OpaqueFunc, List[numpy.ndarray], numpy.ndarray, List[int])
+    #   -> numpy.ndarray
+    """
+    Execute a native fix point kernel on the given inputs and write the result
+    into res without copying
+    """
+    of([XBuffer(np.ascontiguousarray(inpt), copy=False) for inpt in inputs],
+       [XBuffer(res, copy=False)],
+       params)
+    return res
+
+
+class QuantizeLayer(rt_layer.QuantizeLayer):
+
+    def init(self):
+        logger.debug("Initializing QuantizeLayer with shape: {}"
+                     .format(self.shape))
+
+        if not self.do_rounding:
+            raise NotImplementedError("Numpy runtime quantize layer always"
+                                      " rounds to the nearest integer")
+        self.of = OpaqueFuncRegistry.Get('px.globals.Quantize')
+        self.threshold_ = np.array(self.threshold, dtype=np.float64)
+
+    def forward_exec(self, inputs):
+        # type: (List[numpy.ndarray]) -> numpy.ndarray
+        assert(len(inputs) == 1)
+
+        X = np.asarray(inputs[0], dtype=np.float32)
+        res = np.empty(X.shape, dtype=self.dtype)
+        return fixpoint_exec(self.of, [X, self.threshold_], res,
+                             [self.axis, self.bitwidth])
+
+
+class UnQuantizeLayer(rt_layer.UnQuantizeLayer):
+
+    def init(self):
+        logger.debug("Initializing UnQuantizeLayer with shape: {}"
+                     .format(self.shape))
+
+        self.of = OpaqueFuncRegistry.Get('px.globals.UnQuantize')
+        self.threshold_ = np.array(self.threshold, dtype=np.float64)
+
+    def forward_exec(self, inputs):
+        # type: (List[numpy.ndarray]) -> numpy.ndarray
+        assert(len(inputs) == 1)
+
+        X = inputs[0]
+        if X.dtype not in [np.int8, np.uint8, np.int32, np.float32]:
+            X = X.astype(np.float32)
+        res = np.empty(X.shape, dtype=self.dtype)
+        return fixpoint_exec(self.of, [X, self.threshold_], res,
+                             [self.axis, self.bitwidth])
+
+
+class QuantizeBiasLayer(rt_layer.QuantizeBiasLayer):
+
+    def init(self):
+        logger.debug("Initializing QuantizeBiasLayer with shape: {}"
+                     .format(self.shape))
+
+        if not self.do_rounding:
+            raise NotImplementedError("Numpy runtime quantize bias layer"
+                                      " always rounds to the nearest integer")
+        self.of = OpaqueFuncRegistry.Get('px.globals.QuantizeBias')
+        self.threshold_ext_ = np.array([self.threshold_ext], dtype=np.float64)
+        self.threshold_bias_ = np.array(self.threshold_bias, dtype=np.float64)
+
+    def forward_exec(self, inputs):
+        # type: (List[numpy.ndarray]) -> numpy.ndarray
+        assert(len(inputs) == 1)
+
+        X = np.asarray(inputs[0], dtype=np.float32)
+        res = np.empty(X.shape, dtype=self.dtype)
+        return fixpoint_exec(self.of,
+                             [X, self.threshold_ext_, self.threshold_bias_],
+                             res, [self.bitwidth])
+
+
+class QuantizeInterLayer(rt_layer.QuantizeInterLayer):
+
+    def init(self):
+        logger.debug("Initializing QuantizeInterLayer with shape: {}"
+                     .format(self.shape))
+
+        self.of = OpaqueFuncRegistry.Get('px.globals.QuantizeInter')
+        self.scale_ = np.array(self.scale, dtype=np.int64)
+        self.postscale_shift_ = np.array(self.postscale_shift, dtype=np.int64)
+
+    def forward_exec(self, inputs):
+        # type: (List[numpy.ndarray]) -> numpy.ndarray
+        assert(len(inputs) == 1)
+
+        # Accumulators are truncated to integers by the native kernel
+        X = inputs[0]
+        if X.dtype not in [np.int8, np.int32, np.float32]:
+            X = X.astype(np.int32 if np.issubdtype(X.dtype, np.integer)
+                         else np.float32)
+        res = np.empty(X.shape, dtype=self.dtype)
+        return fixpoint_exec(self.of,
+                             [X, self.scale_, self.postscale_shift_], res,
+                             [self.axis, self.bitwidth, int(self.relu)])
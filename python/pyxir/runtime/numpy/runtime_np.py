@@ -67,7 +67,15 @@ X_2_NP = {
     # CONVOLUTION
     'Convolution': base.get_conv2d_layer(rt_layer_np.ConvLayer,
                                          rt_layer_np.ConstantLayer),
-    'Pooling': base.get_pooling_layer(rt_layer_np.PoolingLayer)
+    'Pooling': base.get_pooling_layer(rt_layer_np.PoolingLayer),
+
+    # QUANTIZATION SIMULATION
+    'Quantize': base.get_quantize_layer(rt_layer_np.QuantizeLayer),
+    'UnQuantize': base.get_unquantize_layer(rt_layer_np.UnQuantizeLayer),
+    'QuantizeBias': base.get_quantize_bias_layer(
+        rt_layer_np.QuantizeBiasLayer),
+    'QuantizeInter': base.get_quantize_inter_layer(
+        rt_layer_np.QuantizeInterLayer)
 }
 
 
@@ -0,0 +1,254 @@
+# Copyright 2020 Xilinx Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Module for fingerprinting graph partitions and storing their quantization
+and compilation artifacts so unchanged partitions can be reused across
+rebuilds
+"""
+
+import os
+import copy
+import json
+import pickle
+import shutil
+import hashlib
+import logging
+import tempfile
+
+import numpy as np
+
+from typing import List, Dict
+
+logger = logging.getLogger("pyxir")
+
+
+def _update_hash(h, value) -> None:
+    """ Feed (nested) arrays, containers and scalars into the given hash """
+    if isinstance(value, np.ndarray):
+        h.update(str(value.dtype).encode('utf-8'))
+        h.update(str(value.shape).encode('utf-8'))
+        h.update(np.ascontiguousarray(value).tobytes())
+    elif isinstance(value, dict):
+        for key in sorted(value.keys()):
+            h.update(str(key).encode('utf-8'))
+            _update_hash(h, value[key])
+    elif isinstance(value, (list, tuple)):
+        h.update(str(len(value)).encode('utf-8'))
+        for elem in value:
+            _update_hash(h, elem)
+    else:
+        h.update(repr(value).encode('utf-8'))
+
+
+def fingerprint_layers(layers: List, extra=None) -> str:
+    """
+    Return a fingerprint of the structure and weights of the given XLayers
+
+    Arguments
+    ---------
+    layers: List[XLayer]
+        the layers to fingerprint, e.g. the subgraph_data of a partition
+    extra:
+        additional information that identifies the artifact, e.g. the target
+        or a fingerprint of the calibration inputs
+    """
+    h = hashlib.sha256()
+    for X in layers:
+        h.update(json.dumps(X.to_dict(data=False), sort_keys=True,
+                            default=str).encode('utf-8'))
+        _update_hash(h, list(X.data))
+    _update_hash(h, extra)
+    return h.hexdigest()
+
+
+def fingerprint_inputs(inputs: Dict[str, np.ndarray]) -> str:
+    """ Return a fingerprint of the given (calibration) inputs """
+    h = hashlib.sha256()
+    _update_hash(h, {k: np.asarray(v) for k, v in inputs.items()})
+    return h.hexdigest()
+
+
+def fingerprint_files(files: List[str]) -> str:
+    """ Return a fingerprint of the content of the given files """
+    h = hashlib.sha256()
+    for file_path in files:
+        if file_path and os.path.isfile(file_path):
+            with open(file_path, 'rb') as f:
+                for chunk in iter(lambda: f.read(1 << 20), b''):
+                    h.update(chunk)
+        else:
+            h.update(repr(file_path).encode('utf-8'))
+    return h.hexdigest()
+
+
+def relocate(value, src_dir: str, dst_dir: str):
+    """ Replace the src_dir prefix of all paths in the given (nested) value """
+    if isinstance(value, str):
+        if value == src_dir or value.startswith(src_dir + os.sep):
+            return dst_dir + value[len(src_dir):]
+        return value
+    if isinstance(value, dict):
+        return {k: relocate(v, src_dir, dst_dir) for k, v in value.items()}
+    if isinstance(value, (list, tuple)):
+        return type(value)(relocate(v, src_dir, dst_dir) for v in value)
+    if hasattr(value, '__dict__'):
+        # E.g. CompilerOutput and QuantizerOutput objects
+        value = copy.copy(value)
+        for k, v in vars(value).items():
+            setattr(value, k, relocate(v, src_dir, dst_dir))
+    return value
+
+
+class ArtifactStore(object):
+
+    """
+    Directory of build artifacts indexed by fingerprint
+
+    Every entry consists of the files produced by a quantization or
+    compilation step and a picklable meta object describing them. Entries
+    are written to a temporary directory first and renamed into place so
+    concurrent builds never observe partial entries.
+
+    Arguments
+    ---------
+    root: str
+        the root directory of the store
+    """
+
+    FILES = 'files'
+    META = 'meta.pkl'
+
+    def __init__(self, root: str):
+        self.root = os.path.abspath(root)
+        os.makedirs(self.root, exist_ok=True)
+
+    @classmethod
+    def from_env(cls):
+        """ Return the store configured in PX_ARTIFACT_STORE or None """
+        root = os.environ.get('PX_ARTIFACT_STORE', '')
+        return cls(root) if root else None
+
+    def _entry_dir(self, key: str) -> str:
+        return os.path.join(self.root, key)
+
+    def has(self, key: str) -> bool:
+        return os.path.isfile(os.path.join(self._entry_dir(key), self.META))
+
+    def save(self, key: str, src_dir: str, meta, files: List[str] = None):
+        """
+        Store the given meta object and artifacts under key
+
+        Arguments
+        ---------
+        key: str
+            the fingerprint of the artifacts
+        src_dir: str
+            the directory containing the artifacts. Paths to src_dir in meta
+            are relocated on load
+        meta:
+            a picklable object describing the artifacts
+        files: List[str]
+            the files in src_dir to be stored, all files if None
+        """
+        if self.has(key):
+            return
+        src_dir = os.path.abspath(src_dir)
+        tmp_dir = tempfile.mkdtemp(dir=self.root, prefix='.tmp_')
+        try:
+            files_dir = os.path.join(tmp_dir, self.FILES)
+            if files is None:
+                shutil.copytree(src_dir, files_dir)
+            else:
+                os.makedirs(files_dir)
+                for file_path in files:
+                    rel_path = os.path.relpath(file_path, src_dir)
+                    dst_path = os.path.join(files_dir, rel_path)
+                    os.makedirs(os.path.dirname(dst_path), exist_ok=True)
+                    shutil.copy2(file_path, dst_path)
+            with open(os.path.join(tmp_dir, self.META), 'wb') as f:
+                pickle.dump((src_dir, meta), f)
+            os.rename(tmp_dir, self._entry_dir(key))
+            logger.debug("Stored artifacts: {}".format(key))
+        except OSError:
+            # Another build stored the same entry in the meantime
+            shutil.rmtree(tmp_dir, ignore_errors=True)
+            if not self.has(key):
+                raise
+
+    def load(self, key: str, dst_dir: str, merge: bool = False):
+        """
+        Restore the artifacts stored under key into dst_dir and return the
+        meta object with all paths relocated to dst_dir
+
+        Arguments
+        ---------
+        key: str
+            the fingerprint of the artifacts
+        dst_dir: str
+            the directory to restore the artifacts into
+        merge: bool
+            if False, dst_dir is a dedicated build directory that is replaced
+            by the stored artifacts, so files of an earlier build can't be
+            mixed with the restored ones. If True, dst_dir is shared with
+            other build steps (e.g. a quantizer work directory) and only the
+            stored files are copied into it, all other files are kept.
+        """
+        entry_dir = self._entry_dir(key)
+        with open(os.path.join(entry_dir, self.META), 'rb') as f:
+            src_dir, meta = pickle.load(f)
+
+        dst_dir = os.path.abspath(dst_dir)
+        files_dir = os.path.join(entry_dir, self.FILES)
+        if merge:
+            self._merge_files(files_dir, dst_dir)
+        else:
+            self._replace_dir(files_dir, dst_dir)
+        logger.debug("Reused artifacts: {}".format(key))
+        return relocate(meta, src_dir, dst_dir)
+
+    @staticmethod
+    def _replace_dir(files_dir: str, dst_dir: str) -> None:
+        # Restore into a fresh directory next to dst_dir and move it into
+        #   place, so dst_dir never contains a partial restore
+        parent_dir = os.path.dirname(dst_dir)
+        os.makedirs(parent_dir, exist_ok=True)
+        tmp_dir = tempfile.mkdtemp(dir=parent_dir, prefix='.tmp_')
+        new_dir = os.path.join(tmp_dir, 'new')
+        old_dir = os.path.join(tmp_dir, 'old')
+        try:
+            shutil.copytree(files_dir, new_dir)
+            if os.path.exists(dst_dir):
+                os.rename(dst_dir, old_dir)
+            os.rename(new_dir, dst_dir)
+        finally:
+            shutil.rmtree(tmp_dir, ignore_errors=True)
+
+    @staticmethod
+    def _merge_files(files_dir: str, dst_dir: str) -> None:
+        # Every file is copied next to its destination and renamed into
+        #   place, so readers never observe a partially written file
+        for dir_path, _, file_names in os.walk(files_dir):
+            rel_dir = os.path.relpath(dir_path, files_dir)
+            out_dir = os.path.normpath(os.path.join(dst_dir, rel_dir))
+            os.makedirs(out_dir, exist_ok=True)
+            for file_name in file_names:
+                fd, tmp_path = tempfile.mkstemp(dir=out_dir, prefix='.tmp_')
+                os.close(fd)
+                try:
+                    shutil.copy2(os.path.join(dir_path, file_name), tmp_path)
+                    os.replace(tmp_path, os.path.join(out_dir, file_name))
+                except BaseException:
+                    os.remove(tmp_path)
+                    raise
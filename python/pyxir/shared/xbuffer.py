@@ -20,8 +20,13 @@ import libpyxir as lpx
 
 class XBuffer(object):
 
-    def __init__(self, ndarray: np.ndarray) -> None:
-        self._xb = lpx.XBuffer(ndarray)
+    def __init__(self, ndarray: np.ndarray, copy: bool = True) -> None:
+        """
+        Wrap the given array. If copy is False and the array is C-contiguous,
+        the buffer shares memory with the array and keeps it alive. Strided
+        arrays are always repacked into a contiguous buffer.
+        """
+        self._xb = lpx.XBuffer(ndarray, copy=copy)
 
     @classmethod
     def from_lib(cls, _xb: lpx.XBuffer) -> 'XBuffer':
@@ -29,6 +34,35 @@ class XBuffer(object):
         xb._xb = _xb
         return xb
 
+    @classmethod
+    def from_dlpack(cls, obj) -> 'XBuffer':
+        """
+        Create an XBuffer from an object implementing `__dlpack__` or from a
+        DLPack capsule without copying (if contiguous)
+        """
+        capsule = obj.__dlpack__() if hasattr(obj, '__dlpack__') else obj
+        return XBuffer.from_lib(lpx.XBuffer.from_dlpack(capsule))
+
+    def to_dlpack(self):
+        """ Export this buffer as a DLPack capsule without copying """
+        return self._xb.to_dlpack()
+
+    def __dlpack__(self, stream=None, **kwargs):
+        return self.to_dlpack()
+
+    def __dlpack_device__(self):
+        # (kDLCPU, 0)
+        return (1, 0)
+
+    @property
+    def is_contiguous(self) -> bool:
+        return self._xb.is_contiguous
+
+    @property
+    def shares_memory(self) -> bool:
+        """ Whether the buffer data is owned by another object """
+        return self._xb.shares_memory
+
     def to_numpy(self, copy=False):
         return np.array(self._xb, copy=copy)
 
@@ -88,6 +88,7 @@ else:
 ###############
 
 package_data = glob.glob("include/pyxir/**/*.hpp", recursive=True)
+package_data.extend(glob.glob("include/pyxir/**/*.h", recursive=True))
 headers = package_data
 static_data = glob.glob("python/pyxir/**/*.json", recursive=True)
 static_data.extend(glob.glob("python/pyxir/**/*.dcf", recursive=True))
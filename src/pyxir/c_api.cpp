@@ -0,0 +1,333 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+
+#include "pyxir/c_api.h"
+#include "pyxir/runtime/runtime_module.hpp"
+#include "pyxir/runtime/stats.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+struct px_module {
+  RtModHolder rt_mod;
+  std::mutex mtx;
+  /** @brief Reused buffer descriptions wrapping the caller memory */
+  std::vector<XBufferHolder> in_cache;
+  std::vector<XBufferHolder> out_cache;
+  std::vector<XBufferHolder> in_tensors;
+  std::vector<XBufferHolder> out_tensors;
+  uint64_t executions = 0;
+  uint64_t failures = 0;
+  // Updated without the module mutex as submits don't take it
+  std::atomic<uint64_t> async_submitted{0};
+  LatencyStats latency;
+};
+
+struct px_request {
+  std::vector<XBufferHolder> in_tensors;
+  std::vector<XBufferHolder> out_tensors;
+  /** @brief The buffers wrapping the caller output memory */
+  std::vector<XBufferHolder> out_targets;
+  CompletionHolder completion;
+  bool finalized = false;
+  px_status status = PX_PENDING;
+  std::string error;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+px_status fail(px_status status, const std::string &msg)
+{
+  last_error = msg;
+  return status;
+}
+
+/** @brief Run the given function and translate exceptions into statuses */
+template <typename Func>
+px_status guarded(Func func)
+{
+  try {
+    return func();
+  } catch (std::invalid_argument &e) {
+    return fail(PX_ERR_INVALID_ARGUMENT, e.what());
+  } catch (std::exception &e) {
+    return fail(PX_ERR_RUNTIME, e.what());
+  } catch (...) {
+    return fail(PX_ERR_RUNTIME, "unknown error");
+  }
+}
+
+void get_format(px_dtype dtype, ssize_t &itemsize, std::string &format)
+{
+  switch (dtype) {
+    case PX_FLOAT32: itemsize = 4; format = "f"; break;
+    case PX_INT8: itemsize = 1; format = "b"; break;
+    case PX_UINT8: itemsize = 1; format = "B"; break;
+    case PX_INT32: itemsize = 4; format = "i"; break;
+    default: throw std::invalid_argument("unknown dtype "
+                                         + std::to_string((int) dtype));
+  }
+}
+
+XBufferHolder create_tensor_buffer()
+{
+  XBufferHolder xb(new XBuffer(nullptr, 4, "f", 0, std::vector<ssize_t>(),
+                               false, false));
+  xb->shape.reserve(8);
+  xb->strides.reserve(8);
+  return xb;
+}
+
+/**
+ * @brief Point the buffer to the caller tensor, doesn't allocate for
+ *  tensors with up to 8 dimensions
+ */
+void bind_tensor(XBuffer &xb, const px_tensor &t)
+{
+  if (t.ndim < 0 || (t.ndim > 0 && !t.shape) || !t.data)
+    throw std::invalid_argument("invalid tensor description");
+  get_format(t.dtype, xb.itemsize, xb.format);
+  xb.data = t.data;
+  xb.ndim = t.ndim;
+  xb.shape.assign(t.shape, t.shape + t.ndim);
+  xb.strides.resize(t.ndim);
+  ssize_t stride = xb.itemsize;
+  for (int32_t i = t.ndim - 1; i >= 0; --i) {
+    xb.strides[i] = stride;
+    stride *= xb.shape[i];
+  }
+  xb.size = stride / xb.itemsize;
+}
+
+void bind_tensors(std::vector<XBufferHolder> &cache,
+                  std::vector<XBufferHolder> &tensors,
+                  const px_tensor *descs, size_t nb)
+{
+  if (nb > 0 && !descs)
+    throw std::invalid_argument("missing tensor descriptions");
+  if (cache.size() != nb) {
+    cache.clear();
+    for (size_t i = 0; i < nb; ++i)
+      cache.push_back(create_tensor_buffer());
+  }
+  tensors.resize(nb);
+  for (size_t i = 0; i < nb; ++i) {
+    bind_tensor(*cache[i], descs[i]);
+    tensors[i] = cache[i];
+  }
+}
+
+/**
+ * @brief Copy results of compute funcs that handed back their own output
+ *  buffers into the caller memory
+ */
+void sync_outputs(std::vector<XBufferHolder> &out_tensors,
+                  std::vector<XBufferHolder> &targets)
+{
+  if (out_tensors.size() != targets.size())
+    throw std::runtime_error("unexpected number of outputs");
+  for (size_t i = 0; i < targets.size(); ++i) {
+    if (out_tensors[i]->data != targets[i]->data)
+      copy_buffer(*out_tensors[i], *targets[i]);
+    out_tensors[i] = targets[i];
+  }
+}
+
+px_status load(std::function<RtModHolder()> loader, px_module **module)
+{
+  if (!module)
+    return fail(PX_ERR_INVALID_ARGUMENT, "module is null");
+  return guarded([&]() {
+    std::unique_ptr<px_module> m(new px_module());
+    m->rt_mod = loader();
+    *module = m.release();
+    return PX_OK;
+  });
+}
+
+} // namespace
+
+extern "C" {
+
+const char *px_last_error(void)
+{
+  return last_error.c_str();
+}
+
+px_status px_module_load(const char *path, px_module **module)
+{
+  if (!path)
+    return fail(PX_ERR_INVALID_ARGUMENT, "path is null");
+  return load([path]() { return RuntimeModule::Load(path); }, module);
+}
+
+px_status px_module_load_from_buffer(const char *data, size_t size,
+                                     px_module **module)
+{
+  if (!data)
+    return fail(PX_ERR_INVALID_ARGUMENT, "data is null");
+  return load([data, size]() {
+    return RuntimeModule::LoadFromBuffer(data, size);
+  }, module);
+}
+
+void px_module_free(px_module *module)
+{
+  delete module;
+}
+
+px_status px_module_num_inputs(px_module *module, size_t *nb_inputs)
+{
+  if (!module || !nb_inputs)
+    return fail(PX_ERR_INVALID_ARGUMENT, "module or nb_inputs is null");
+  *nb_inputs = module->rt_mod->get_in_tensor_names().size();
+  return PX_OK;
+}
+
+px_status px_module_num_outputs(px_module *module, size_t *nb_outputs)
+{
+  if (!module || !nb_outputs)
+    return fail(PX_ERR_INVALID_ARGUMENT, "module or nb_outputs is null");
+  *nb_outputs = module->rt_mod->get_out_tensor_names().size();
+  return PX_OK;
+}
+
+px_status px_module_warmup(px_module *module, int nb_iterations)
+{
+  if (!module)
+    return fail(PX_ERR_INVALID_ARGUMENT, "module is null");
+  return guarded([&]() {
+    std::lock_guard<std::mutex> lock(module->mtx);
+    module->rt_mod->warmup(nb_iterations);
+    return PX_OK;
+  });
+}
+
+px_status px_module_execute(px_module *module,
+                            const px_tensor *inputs, size_t nb_inputs,
+                            const px_tensor *outputs, size_t nb_outputs)
+{
+  if (!module)
+    return fail(PX_ERR_INVALID_ARGUMENT, "module is null");
+  std::lock_guard<std::mutex> lock(module->mtx);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  px_status status = guarded([&]() {
+    bind_tensors(module->in_cache, module->in_tensors, inputs, nb_inputs);
+    bind_tensors(module->out_cache, module->out_tensors, outputs, nb_outputs);
+    module->rt_mod->execute(module->in_tensors, module->out_tensors);
+    sync_outputs(module->out_tensors, module->out_cache);
+    return PX_OK;
+  });
+  ++module->executions;
+  if (status != PX_OK)
+    ++module->failures;
+  module->latency.add(std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now() - start).count());
+  return status;
+}
+
+px_status px_module_submit(px_module *module,
+                           const px_tensor *inputs, size_t nb_inputs,
+                           const px_tensor *outputs, size_t nb_outputs,
+                           px_request **request)
+{
+  if (!module || !request)
+    return fail(PX_ERR_INVALID_ARGUMENT, "module or request is null");
+  return guarded([&]() {
+    // In flight requests can't share the cached buffer descriptions
+    std::unique_ptr<px_request> r(new px_request());
+    std::vector<XBufferHolder> in_cache;
+    bind_tensors(in_cache, r->in_tensors, inputs, nb_inputs);
+    bind_tensors(r->out_targets, r->out_tensors, outputs, nb_outputs);
+    // Submits don't wait for running px_module_execute calls, the runtime
+    //  module serializes requests on compute funcs that aren't reentrant
+    ++module->async_submitted;
+    r->completion = module->rt_mod->execute_async(r->in_tensors,
+                                                  r->out_tensors);
+    *request = r.release();
+    return PX_OK;
+  });
+}
+
+px_status px_request_poll(px_request *request)
+{
+  if (!request)
+    return fail(PX_ERR_INVALID_ARGUMENT, "request is null");
+  if (!request->finalized) {
+    if (!request->completion->ready())
+      return PX_PENDING;
+    request->finalized = true;
+    request->status = guarded([request]() {
+      request->completion->wait();
+      sync_outputs(request->out_tensors, request->out_targets);
+      return PX_OK;
+    });
+    if (request->status != PX_OK)
+      request->error = last_error;
+  }
+  if (request->status != PX_OK)
+    last_error = request->error;
+  return request->status;
+}
+
+px_status px_request_wait(px_request *request)
+{
+  if (!request)
+    return fail(PX_ERR_INVALID_ARGUMENT, "request is null");
+  try {
+    request->completion->wait();
+  } catch (...) {
+    // Reported by poll
+  }
+  return px_request_poll(request);
+}
+
+void px_request_free(px_request *request)
+{
+  if (!request)
+    return;
+  try {
+    request->completion->wait();
+  } catch (...) {}
+  delete request;
+}
+
+px_status px_module_get_metrics(px_module *module, px_metrics *metrics)
+{
+  if (!module || !metrics)
+    return fail(PX_ERR_INVALID_ARGUMENT, "module or metrics is null");
+  std::lock_guard<std::mutex> lock(module->mtx);
+  metrics->executions = module->executions;
+  metrics->failures = module->failures;
+  metrics->async_submitted = module->async_submitted;
+  metrics->mean_latency_us = module->latency.mean_us();
+  metrics->max_latency_us = module->latency.max_us;
+  return PX_OK;
+}
+
+} // extern "C"
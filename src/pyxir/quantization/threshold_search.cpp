@@ -0,0 +1,220 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "pyxir/common/parallel.hpp"
+#include "pyxir/opaque_func_registry.hpp"
+#include "pyxir/quantization/threshold_search.hpp"
+
+namespace pyxir {
+namespace quantization {
+
+namespace {
+
+double half_range(int bitwidth)
+{
+  if (bitwidth < 2 || bitwidth > 32)
+    throw std::invalid_argument("Threshold search: unsupported bitwidth "
+                                + std::to_string(bitwidth));
+  return (double) ((int64_t(1) << (bitwidth - 1)) - 1);
+}
+
+} // namespace
+
+AbsHistogram build_abs_histogram(const float *data, ssize_t outer,
+                                 ssize_t inner, ssize_t stride, int nb_bins)
+{
+  if (nb_bins <= 0)
+    throw std::invalid_argument("Threshold search: the number of bins should"
+                                " be positive");
+  AbsHistogram hist;
+  hist.count.assign(nb_bins, 0.);
+  hist.sum.assign(nb_bins, 0.);
+  hist.sum_sq.assign(nb_bins, 0.);
+
+  float max_v = 0.f;
+  for (ssize_t o = 0; o < outer; ++o) {
+    const float *x = data + o * stride;
+    for (ssize_t i = 0; i < inner; ++i)
+      max_v = std::max(max_v, std::fabs(x[i]));
+  }
+  hist.max = max_v;
+  if (max_v == 0.f) {
+    hist.count[0] = (double) (outer * inner);
+    return hist;
+  }
+
+  const double scale = nb_bins / hist.max;
+  for (ssize_t o = 0; o < outer; ++o) {
+    const float *x = data + o * stride;
+    for (ssize_t i = 0; i < inner; ++i) {
+      double a = std::fabs(x[i]);
+      int b = std::min(nb_bins - 1, (int) (a * scale));
+      hist.count[b] += 1.;
+      hist.sum[b] += a;
+      hist.sum_sq[b] += a * a;
+    }
+  }
+  return hist;
+}
+
+double histogram_sse(const AbsHistogram &hist, double threshold, int bitwidth)
+{
+  const double factor = half_range(bitwidth) / threshold;
+  const double inv_factor = threshold / half_range(bitwidth);
+  double sse = 0.;
+  for (size_t b = 0; b < hist.count.size(); ++b) {
+    const double n = hist.count[b];
+    if (n == 0.)
+      continue;
+    // All values of a bin are quantized like its mean, values above the
+    //  threshold are clipped to it. See the header for the error bound.
+    const double m = std::min(hist.sum[b] / n, threshold);
+    const double q = std::nearbyint(m * factor) * inv_factor;
+    sse += hist.sum_sq[b] - 2. * q * hist.sum[b] + n * q * q;
+  }
+  return sse;
+}
+
+float search_mse_threshold(const AbsHistogram &hist,
+                           const ThresholdSearchOptions &options)
+{
+  if (hist.max == 0.)
+    return 0.f;
+  const int nb_candidates = std::max(1, options.nb_candidates);
+  const double h = half_range(options.bitwidth);
+  std::vector<double> th(nb_candidates), factor(nb_candidates),
+    inv_factor(nb_candidates), sse(nb_candidates, 0.);
+  for (int k = 0; k < nb_candidates; ++k) {
+    th[k] = k + 1 == nb_candidates
+      ? hist.max : hist.max * (k + 1) / nb_candidates;
+    factor[k] = h / th[k];
+    inv_factor[k] = th[k] / h;
+  }
+  // The histogram is traversed once and all candidates are evaluated per
+  //  bin. The candidate loop has independent accumulators and vectorizes.
+  for (size_t b = 0; b < hist.count.size(); ++b) {
+    const double n = hist.count[b];
+    if (n == 0.)
+      continue;
+    const double mean = hist.sum[b] / n;
+    const double s = hist.sum[b], s2 = hist.sum_sq[b];
+    for (int k = 0; k < nb_candidates; ++k) {
+      const double m = std::min(mean, th[k]);
+      const double q = std::nearbyint(m * factor[k]) * inv_factor[k];
+      sse[k] += s2 - 2. * q * s + n * q * q;
+    }
+  }
+  // Ties are resolved in favour of the largest threshold
+  int best = nb_candidates - 1;
+  for (int k = nb_candidates - 2; k >= 0; --k)
+    if (sse[k] < sse[best])
+      best = k;
+  return (float) th[best];
+}
+
+std::vector<std::vector<float>>
+search_mse_thresholds(const std::vector<std::shared_ptr<XBuffer>> &tensors,
+                      const std::vector<int> &axes,
+                      const ThresholdSearchOptions &options)
+{
+  if (tensors.size() != axes.size())
+    throw std::invalid_argument("Threshold search: expected an axis for every"
+                                " tensor");
+  half_range(options.bitwidth);
+
+  // A task per tensor channel, tasks of all tensors run in parallel
+  struct Task { size_t tensor; ssize_t channel; };
+  std::vector<XBufferHolder> xbs(tensors.size());
+  std::vector<ssize_t> outer(tensors.size()), channels(tensors.size()),
+    inner(tensors.size());
+  std::vector<std::vector<float>> res(tensors.size());
+  std::vector<Task> tasks;
+  for (size_t t = 0; t < tensors.size(); ++t) {
+    xbs[t] = ascontiguous(tensors[t]);
+    const XBuffer &xb = *xbs[t];
+    if (xb.format != "f" || xb.itemsize != 4)
+      throw std::invalid_argument("Threshold search: expects float32 tensors");
+    outer[t] = 1, channels[t] = 1, inner[t] = xb.size;
+    if (axes[t] != PER_TENSOR) {
+      int axis = axes[t];
+      if (axis < 0 || axis >= (int) xb.ndim)
+        throw std::invalid_argument("Threshold search: invalid axis "
+                                    + std::to_string(axis));
+      outer[t] = 1, inner[t] = 1;
+      for (int i = 0; i < axis; ++i)
+        outer[t] *= xb.shape[i];
+      channels[t] = xb.shape[axis];
+      for (int i = axis + 1; i < (int) xb.ndim; ++i)
+        inner[t] *= xb.shape[i];
+    }
+    res[t].resize(channels[t]);
+    for (ssize_t c = 0; c < channels[t]; ++c)
+      tasks.push_back(Task{t, c});
+  }
+
+  parallel_for((ssize_t) tasks.size(), 1, [&](ssize_t begin, ssize_t end) {
+    for (ssize_t i = begin; i < end; ++i) {
+      const size_t t = tasks[i].tensor;
+      const ssize_t c = tasks[i].channel;
+      const float *data = (const float *) xbs[t]->data + c * inner[t];
+      AbsHistogram hist = build_abs_histogram(
+        data, outer[t], inner[t], channels[t] * inner[t], options.nb_bins);
+      res[t][c] = search_mse_threshold(hist, options);
+    }
+  });
+  return res;
+}
+
+// Search thresholds: in [tensors], out [float32 thresholds per tensor],
+//  params [bitwidth, nb_bins, nb_candidates, axis per tensor]
+REGISTER_OPAQUE_FUNC("pyxir.quantization.search_mse_thresholds")
+  ->set_func([](pyxir::OpaqueArgs &args)
+    {
+      std::vector<XBufferHolder> &tensors = args[0]->get_xbuffers();
+      std::vector<XBufferHolder> &thresholds = args[1]->get_xbuffers();
+      std::vector<int64_t> &params = args[2]->get_ints();
+      if (params.size() != 3 + tensors.size()
+          || thresholds.size() != tensors.size())
+        throw std::invalid_argument("Threshold search: expected a threshold"
+                                    " buffer and an axis for every tensor");
+
+      ThresholdSearchOptions options;
+      options.bitwidth = (int) params[0];
+      options.nb_bins = (int) params[1];
+      options.nb_candidates = (int) params[2];
+      std::vector<int> axes(params.begin() + 3, params.end());
+
+      std::vector<std::vector<float>> res =
+        search_mse_thresholds(tensors, axes, options);
+      for (size_t t = 0; t < res.size(); ++t) {
+        XBuffer &th = *thresholds[t];
+        if (th.format != "f" || th.size != (ssize_t) res[t].size())
+          throw std::invalid_argument("Threshold search: invalid threshold"
+                                      " buffer");
+        std::copy(res[t].begin(), res[t].end(), (float *) th.data);
+      }
+    }, std::vector<pxTypeCode>{pxVXBufferHandle, pxVXBufferHandle, pxVInt});
+
+} // namespace quantization
+} // namespace pyxir
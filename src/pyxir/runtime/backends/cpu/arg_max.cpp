@@ -0,0 +1,75 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cassert>
+
+#include "pyxir/common/parallel.hpp"
+#include "typed_kernels.hpp"
+#include "arg_max.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+ArgMaxFunc::ArgMaxFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  if (xl_->has_attr("axis") && xl_->get_attr("axis").get_int() != -1)
+    throw std::invalid_argument("ArgMax: only the last axis (-1) is supported");
+}
+
+void ArgMaxFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  // Strided inputs (e.g. views) are packed first
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  if (get_dtype(*in) != DType::F32)
+    throw std::invalid_argument("ArgMax: expects float32 input");
+  const ssize_t len = in->shape[in->ndim - 1];
+  const ssize_t rows = len > 0 ? in->size / len : 0;
+
+  std::vector<ssize_t> out_shape(in->shape.begin(), in->shape.end() - 1);
+  if (out_shape.empty())
+    out_shape.push_back(1);
+  KernelOutput out(out_tensors, 0, out_shape, 4, "i", "ArgMax");
+
+  const float *in_data = (const float *) in->data;
+  int32_t *out_data = out.data<int32_t>();
+
+  parallel_for(rows, std::max<ssize_t>(1, 65536 / std::max<ssize_t>(len, 1)),
+               [&](ssize_t begin, ssize_t end) {
+    for (ssize_t r = begin; r < end; ++r) {
+      const float *x = in_data + r * len;
+      int32_t best = 0;
+      float best_v = x[0];
+      for (ssize_t i = 1; i < len; ++i) {
+        if (x[i] > best_v) {
+          best_v = x[i];
+          best = (int32_t) i;
+        }
+      }
+      out_data[r] = best;
+    }
+  });
+  out.commit();
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,176 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "pyxir/common/parallel.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+/**
+ * @brief A contiguous tensor viewed as [outer, channels, inner] around the
+ *  axis its fix point parameters are applied on
+ */
+struct ChannelBlocks {
+  ssize_t outer = 1;
+  ssize_t channels = 1;
+  ssize_t inner = 1;
+
+  ChannelBlocks() {}
+
+  ChannelBlocks(const std::vector<ssize_t> &shape, int axis)
+  {
+    if (shape.empty())
+      return;
+    if (axis < 0)
+      axis += (int) shape.size();
+    if (axis < 0 || axis >= (int) shape.size())
+      throw std::invalid_argument("Fix point kernels: invalid axis "
+                                  + std::to_string(axis) + " for input of rank "
+                                  + std::to_string(shape.size()));
+    for (int i = 0; i < axis; ++i)
+      outer *= shape[i];
+    channels = shape[axis];
+    for (size_t i = axis + 1; i < shape.size(); ++i)
+      inner *= shape[i];
+  }
+
+  ssize_t size() const { return outer * channels * inner; }
+};
+
+/**
+ * @brief Expand per channel parameters to the given number of channels. A
+ *  single value is broadcast and shorter parameter lists are tiled (e.g. for
+ *  depthwise convolutions), like the Python quantization simulation layers do.
+ */
+template <typename T, typename P>
+inline std::vector<T> expand_channel_params(const std::vector<P> &params,
+                                            ssize_t channels,
+                                            const std::string &op)
+{
+  ssize_t n = (ssize_t) params.size();
+  if (n == 0 || channels % n != 0)
+    throw std::invalid_argument(op + ": can't apply " + std::to_string(n)
+                                + " quantization parameters to "
+                                + std::to_string(channels) + " channels");
+  std::vector<T> res(channels);
+  for (ssize_t c = 0; c < channels; ++c)
+    res[c] = (T) params[c % n];
+  return res;
+}
+
+/** @brief The largest value of a signed fix point number of the given bitwidth */
+inline int64_t fixpoint_max(int bitwidth)
+{
+  return (int64_t(1) << (bitwidth - 1)) - 1;
+}
+
+/**
+ * @brief Run func(x, y, channel) on every contiguous inner row of a channel
+ *  block, the row loops in func are vectorized by the compiler
+ */
+template <typename I, typename O, typename Func>
+inline void for_each_channel_row(const I *in, O *out, const ChannelBlocks &b,
+                                 Func func)
+{
+  parallel_for(b.outer * b.channels, std::max<ssize_t>(1, 16384 / b.inner),
+               [&](ssize_t begin, ssize_t end) {
+    for (ssize_t oc = begin; oc < end; ++oc)
+      func(in + oc * b.inner, out + oc * b.inner, oc % b.channels);
+  });
+}
+
+/**
+ * @brief Quantize float values to fix point: clip to [-th, th], scale by
+ *  factor = (2^(bw-1) - 1) / th and round half to even
+ */
+template <typename O>
+inline void quantize(const float *in, O *out, const ChannelBlocks &b,
+                     const float *th, const float *factor)
+{
+  const ssize_t inner = b.inner;
+  for_each_channel_row(in, out, b, [&](const float *x, O *y, ssize_t c) {
+    const float t = th[c], f = factor[c];
+    for (ssize_t i = 0; i < inner; ++i)
+      y[i] = (O) std::nearbyint(std::min(std::max(x[i], -t), t) * f);
+  });
+}
+
+/** @brief Convert fix point values back to float: y = x * factor */
+template <typename I>
+inline void unquantize(const I *in, float *out, const ChannelBlocks &b,
+                       const float *factor)
+{
+  const ssize_t inner = b.inner;
+  for_each_channel_row(in, out, b, [&](const I *x, float *y, ssize_t c) {
+    const float f = factor[c];
+    for (ssize_t i = 0; i < inner; ++i)
+      y[i] = (float) x[i] * f;
+  });
+}
+
+/**
+ * @brief Quantize float biases to the accumulator scale sf of the layer they
+ *  are added in: clip to [-th_acc, th_acc], divide by sf and round
+ */
+inline void quantize_bias(const float *in, int32_t *out, const ChannelBlocks &b,
+                          const float *th_acc, const float *sf_acc)
+{
+  const ssize_t inner = b.inner;
+  for_each_channel_row(in, out, b, [&](const float *x, int32_t *y, ssize_t c) {
+    const float t = th_acc[c], sf = sf_acc[c];
+    for (ssize_t i = 0; i < inner; ++i)
+      y[i] = (int32_t) std::nearbyint(std::min(std::max(x[i], -t), t) / sf);
+  });
+}
+
+/**
+ * @brief Requantize accumulator values: multiply by the integer scale, shift
+ *  right by the postscale shift with rounding, saturate to the output
+ *  bitwidth and optionally apply a ReLU. Float accumulators are truncated
+ *  to integers first.
+ */
+template <typename I, typename O>
+inline void requantize(const I *in, O *out, const ChannelBlocks &b,
+                       const int64_t *scale, const int64_t *shift,
+                       int bitwidth, bool relu)
+{
+  const ssize_t inner = b.inner;
+  const int64_t hi = fixpoint_max(bitwidth);
+  const int64_t lo = relu ? 0 : -hi - 1;
+  for_each_channel_row(in, out, b, [&](const I *x, O *y, ssize_t c) {
+    const int64_t s = scale[c];
+    const int64_t sh = std::max<int64_t>(0, shift[c] - 1);
+    for (ssize_t i = 0; i < inner; ++i) {
+      int64_t v = (((int64_t) x[i] * s) >> sh) + 1;
+      y[i] = (O) std::min(std::max(v >> 1, lo), hi);
+    }
+  });
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cassert>
+
+#include "pyxir/common/parallel.hpp"
+#include "typed_kernels.hpp"
+#include "gs_tiling.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+GSTilingFunc::GSTilingFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  stride_ = xl_->get_attr("stride").get_int();
+  if (xl_->has_attr("reverse") && !xl_->get_attr("reverse").get_bool())
+    throw std::invalid_argument("GSTiling: only reverse=True is supported");
+}
+
+void GSTilingFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  // Strided inputs (e.g. views) are packed first
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  if (in->ndim != 4)
+    throw std::invalid_argument("GSTiling: expected NHWC input");
+  const ssize_t n = in->shape[0], h = in->shape[1], w = in->shape[2],
+                c = in->shape[3];
+  const ssize_t s = stride_;
+  if (c % (s * s) != 0)
+    throw std::invalid_argument("GSTiling: channels should be divisible by"
+                                " stride^2");
+  const ssize_t oc = c / (s * s);
+  const ssize_t oh = h * s, ow = w * s;
+
+  // Tiling only moves elements so any element type is supported
+  KernelOutput out(out_tensors, 0, {n, oh, ow, oc}, in->itemsize, in->format,
+                   "GSTiling");
+
+  const char *in_data = (const char *) in->data;
+  char *out_data = out.data<char>();
+  const ssize_t item = in->itemsize;
+  const ssize_t chunk = oc * item;
+
+  // Equivalent to reshape (n, h, w, s, s, oc) -> transpose (0, 1, 3, 2, 4, 5)
+  //  -> reshape (n, h * s, w * s, oc), every copy moves oc contiguous elements
+  parallel_for(n * h, 16, [&](ssize_t begin, ssize_t end) {
+    for (ssize_t nh = begin; nh < end; ++nh) {
+      const ssize_t b = nh / h, y = nh % h;
+      for (ssize_t x = 0; x < w; ++x) {
+        const char *src = in_data + ((b * h + y) * w + x) * c * item;
+        for (ssize_t si = 0; si < s; ++si) {
+          char *dst = out_data + ((b * oh + y * s + si) * ow + x * s) * chunk;
+          memcpy(dst, src + si * s * chunk, s * chunk);
+        }
+      }
+    }
+  });
+  out.commit();
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
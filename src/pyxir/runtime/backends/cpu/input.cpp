@@ -16,7 +16,6 @@
 
 #include <cassert>
 
-#include "pyxir/runtime/runtime.hpp"
 #include "input.hpp"
 
 namespace pyxir {
@@ -38,11 +37,6 @@ void InputFunc::operator()(
     out_tensors[0] = in_tensors[0];
 }
 
-REGISTER_KERNEL_FUNC("cpu.Input")
-  .set_impl([](XLayerHolder &xl, KernelFuncHolder &kfh) {
-    kfh = std::move(KernelFuncHolder(new InputFunc(xl)));
-  });
-
 } // namespace cpu
 } // namespace runtime
 } // namespace pyxir
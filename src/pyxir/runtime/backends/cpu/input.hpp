@@ -25,7 +25,7 @@ namespace pyxir {
 namespace runtime {
 namespace cpu {
 
-class InputFunc : public KernelFunc {
+class InputFunc final : public KernelFunc {
 
   public:
     InputFunc(XLayerHolder &xl);
@@ -0,0 +1,153 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cassert>
+#include <numeric>
+#include <algorithm>
+
+#include "pyxir/common/parallel.hpp"
+#include "typed_kernels.hpp"
+#include "nms.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+NMSFunc::NMSFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  if (xl_->has_attr("iou_threshold"))
+    iou_threshold_ = xl_->get_attr("iou_threshold").get_float();
+  if (xl_->has_attr("score_threshold"))
+    score_threshold_ = xl_->get_attr("score_threshold").get_float();
+  if (xl_->has_attr("max_output_size"))
+    max_output_size_ = xl_->get_attr("max_output_size").get_int();
+  if (xl_->has_attr("pixel_offset"))
+    pixel_offset_ = xl_->get_attr("pixel_offset").get_bool();
+}
+
+void NMSFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  // Strided inputs (e.g. views) are packed first
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  if (get_dtype(*in) != DType::F32)
+    throw std::invalid_argument("NMS: expects float32 input");
+  if (in->ndim != 3 || in->shape[2] < 5)
+    throw std::invalid_argument("NMS: expected input of shape (N, B, 5 + C)"
+                                " but got rank: " + std::to_string(in->ndim));
+  const ssize_t batch = in->shape[0];
+  const ssize_t nb_boxes = in->shape[1];
+  const ssize_t row_size = in->shape[2];
+  const ssize_t nb_classes = row_size - 5;
+  const ssize_t max_out = max_output_size_ < 0 ? nb_boxes : max_output_size_;
+
+  KernelOutput out(out_tensors, 0, {batch, max_out, 6}, 4, "f", "NMS");
+
+  const float *in_data = (const float *) in->data;
+  float *out_data = out.data<float>();
+  const float offset = pixel_offset_ ? 1.f : 0.f;
+  const float iou_threshold = iou_threshold_;
+  const float score_threshold = score_threshold_;
+
+  parallel_for(batch, 1, [&](ssize_t begin, ssize_t end) {
+    // Structure of arrays for the candidate boxes so that the IoU computation
+    //  of one kept box against all remaining candidates vectorizes
+    std::vector<float> x0, y0, x1, y1, area, score;
+    std::vector<int> cls;
+    std::vector<int> order;
+    std::vector<char> suppressed;
+
+    for (ssize_t n = begin; n < end; ++n) {
+      const float *boxes = in_data + n * nb_boxes * row_size;
+      float *out = out_data + n * max_out * 6;
+
+      x0.clear(); y0.clear(); x1.clear(); y1.clear();
+      area.clear(); score.clear(); cls.clear();
+      for (ssize_t b = 0; b < nb_boxes; ++b) {
+        const float *box = boxes + b * row_size;
+        if (box[4] <= score_threshold)
+          continue;
+        x0.push_back(box[0]);
+        y0.push_back(box[1]);
+        x1.push_back(box[2]);
+        y1.push_back(box[3]);
+        area.push_back((box[2] - box[0] + offset) * (box[3] - box[1] + offset));
+        score.push_back(box[4]);
+        cls.push_back(nb_classes > 0 ?
+          (int) (std::max_element(box + 5, box + row_size) - (box + 5)) : 0);
+      }
+
+      const ssize_t nb_cand = score.size();
+      order.resize(nb_cand);
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(),
+                       [&score](int a, int b) { return score[a] > score[b]; });
+
+      // Reorder candidates by descending score so that suppression is a
+      //  forward scan over contiguous memory
+      auto permute = [&order](std::vector<float> &v) {
+        std::vector<float> tmp(v.size());
+        for (size_t i = 0; i < order.size(); ++i)
+          tmp[i] = v[order[i]];
+        v.swap(tmp);
+      };
+      permute(x0); permute(y0); permute(x1); permute(y1);
+      permute(area); permute(score);
+      std::vector<int> cls_sorted(nb_cand);
+      for (ssize_t i = 0; i < nb_cand; ++i)
+        cls_sorted[i] = cls[order[i]];
+
+      suppressed.assign(nb_cand, 0);
+      ssize_t nb_out = 0;
+      for (ssize_t i = 0; i < nb_cand && nb_out < max_out; ++i) {
+        if (suppressed[i])
+          continue;
+        float *o = out + nb_out * 6;
+        o[0] = x0[i]; o[1] = y0[i]; o[2] = x1[i]; o[3] = y1[i];
+        o[4] = score[i];
+        o[5] = (float) cls_sorted[i];
+        ++nb_out;
+
+        const float bx0 = x0[i], by0 = y0[i], bx1 = x1[i], by1 = y1[i];
+        const float barea = area[i];
+        const int bcls = cls_sorted[i];
+        for (ssize_t j = i + 1; j < nb_cand; ++j) {
+          float w = std::max(0.f, std::min(bx1, x1[j]) - std::max(bx0, x0[j]) + offset);
+          float h = std::max(0.f, std::min(by1, y1[j]) - std::max(by0, y0[j]) + offset);
+          float inter = w * h;
+          // Small epsilon to avoid division by zero for degenerate boxes
+          float iou = inter / (barea + area[j] - inter + 1e-5f);
+          // Boxes are only kept below the threshold, like the Python reference
+          suppressed[j] |= (iou >= iou_threshold) & (cls_sorted[j] == bcls);
+        }
+      }
+      for (ssize_t i = nb_out; i < max_out; ++i) {
+        float *o = out + i * 6;
+        std::fill(o, o + 5, 0.f);
+        o[5] = -1.f;
+      }
+    }
+  });
+  out.commit();
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
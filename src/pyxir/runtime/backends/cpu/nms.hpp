@@ -0,0 +1,62 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include "pyxir/pyxir_api.hpp"
+#include "pyxir/graph/xlayer.hpp"
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/kernel_func.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+/**
+ * @brief NMSFunc for executing per-class greedy non-max suppression on a
+ *  batch of detections.
+ *
+ * The input has shape (N, B, 5 + C) with every box described as
+ *  [x0, y0, x1, y1, score, class_prob_0, ..., class_prob_C-1]. Boxes are
+ *  assigned the argmax class and only suppress boxes of the same class. If
+ *  C = 0, suppression is class agnostic. The output has shape
+ *  (N, max_output_size, 6) with rows [x0, y0, x1, y1, score, class] sorted
+ *  by descending score, unused rows have score 0 and class -1.
+ */ 
+class NMSFunc final : public KernelFunc {
+
+  public:
+    NMSFunc(XLayerHolder &xl);
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors);
+
+  private:
+    // Boxes overlapping a kept box with an IoU at or above this threshold are
+    //  removed, like in the Python reference (yolo_detection.py)
+    float iou_threshold_ = 0.4f;
+    // Boxes with a score lower than or equal to this threshold are discarded
+    float score_threshold_ = 0.f;
+    // The maximum number of boxes to be returned per image (-1 = all boxes)
+    int max_output_size_ = -1;
+    // Whether to compute areas with inclusive pixel coordinates (w = x1 - x0 + 1)
+    bool pixel_offset_ = false;
+};
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,185 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#include "pyxir/common/parallel.hpp"
+#include "typed_kernels.hpp"
+#include "preprocess.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+PreprocessFunc::PreprocessFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  if (xl_->has_attr("size"))
+    size_ = xl_->get_attr("size").get_ints();
+  if (!size_.empty() && size_.size() != 2)
+    throw std::invalid_argument("Preprocess: size should be (height, width)");
+  if (xl_->has_attr("mean")) {
+    std::vector<double> &mean = xl_->get_attr("mean").get_floats();
+    mean_.assign(mean.begin(), mean.end());
+  }
+  if (xl_->has_attr("scale")) {
+    std::vector<double> &scale = xl_->get_attr("scale").get_floats();
+    scale_.assign(scale.begin(), scale.end());
+  }
+  if (xl_->has_attr("layout")) {
+    std::string layout = xl_->get_attr("layout").get_string();
+    if (layout != "NCHW" && layout != "NHWC")
+      throw std::invalid_argument("Preprocess: unsupported layout: " + layout);
+    nchw_ = layout == "NCHW";
+  }
+  if (xl_->has_attr("swap_rb"))
+    swap_rb_ = xl_->get_attr("swap_rb").get_bool();
+  if (xl_->has_attr("quantize"))
+    quantize_ = xl_->get_attr("quantize").get_bool();
+  if (xl_->has_attr("fix_point"))
+    fix_point_ = xl_->get_attr("fix_point").get_int();
+}
+
+namespace {
+
+/** @brief Horizontal interpolation table, computed per call so concurrent
+    calls with different frame sizes don't share state */
+struct XTable {
+  std::vector<ssize_t> x0;
+  std::vector<ssize_t> x1;
+  std::vector<float> wx;
+
+  XTable(ssize_t in_w, ssize_t out_w) : x0(out_w), x1(out_w), wx(out_w)
+  {
+    const float ratio = (float) in_w / out_w;
+    for (ssize_t x = 0; x < out_w; ++x) {
+      // Half pixel centers, same as cv2.resize with INTER_LINEAR
+      float fx = std::max(0.f, (x + 0.5f) * ratio - 0.5f);
+      ssize_t sx = std::min<ssize_t>((ssize_t) fx, in_w - 1);
+      x0[x] = sx;
+      x1[x] = std::min<ssize_t>(sx + 1, in_w - 1);
+      wx[x] = fx - sx;
+    }
+  }
+};
+
+} // namespace
+
+void PreprocessFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  XBufferHolder in = in_tensors[0];
+  if (in->ndim != 4 || in->itemsize != 1)
+    throw std::invalid_argument("Preprocess: expected uint8 NHWC input frames");
+  // Batch and row strides are honoured directly (e.g. for crops or batch
+  //  views), only frames with non-packed pixels are repacked
+  if (in->strides[3] != 1 || in->strides[2] != in->shape[3])
+    in = ascontiguous(in);
+  const ssize_t batch_stride = in->strides[0], row_stride = in->strides[1];
+  const ssize_t n = in->shape[0], in_h = in->shape[1], in_w = in->shape[2],
+                c = in->shape[3];
+  const ssize_t out_h = size_.empty() ? in_h : size_[0];
+  const ssize_t out_w = size_.empty() ? in_w : size_[1];
+
+  std::vector<ssize_t> out_shape = nchw_ ?
+    std::vector<ssize_t>{n, c, out_h, out_w} :
+    std::vector<ssize_t>{n, out_h, out_w, c};
+  KernelOutput out(out_tensors, 0, out_shape, quantize_ ? 1 : 4,
+                   quantize_ ? "b" : "f", "Preprocess");
+
+  const XTable table(in_w, out_w);
+
+  // Fold mean and scale into one multiply-add: out = in * scale - mean * scale.
+  //  For quantization, the fix point scaling is folded in as well.
+  const float q_scale = quantize_ ? std::ldexp(1.f, fix_point_) : 1.f;
+  std::vector<float> mul(c), add(c);
+  for (ssize_t ch = 0; ch < c; ++ch) {
+    const ssize_t src_ch = (swap_rb_ && c == 3) ? 2 - ch : ch;
+    const float m = mean_.empty() ? 0.f :
+      mean_[mean_.size() == 1 ? 0 : src_ch];
+    const float s = scale_.empty() ? 1.f :
+      scale_[scale_.size() == 1 ? 0 : src_ch];
+    mul[ch] = s * q_scale;
+    add[ch] = -m * s * q_scale;
+  }
+
+  const uint8_t *in_data = (const uint8_t *) in->data;
+  const float ratio_y = (float) in_h / out_h;
+  const bool quantize = quantize_;
+  const bool nchw = nchw_;
+  const bool swap_rb = swap_rb_ && c == 3;
+  float *out_data = quantize ? nullptr : out.data<float>();
+  int8_t *q_out_data = quantize ? out.data<int8_t>() : nullptr;
+
+  parallel_for(n * out_h, 4, [&](ssize_t begin, ssize_t end) {
+    // One output row of interpolated values for all channels (NHWC order)
+    std::vector<float> row(out_w * c);
+    for (ssize_t ny = begin; ny < end; ++ny) {
+      const ssize_t b = ny / out_h, y = ny % out_h;
+      float fy = std::max(0.f, (y + 0.5f) * ratio_y - 0.5f);
+      const ssize_t y0 = std::min<ssize_t>((ssize_t) fy, in_h - 1);
+      const ssize_t y1 = std::min<ssize_t>(y0 + 1, in_h - 1);
+      const float wy = fy - y0;
+      const uint8_t *r0 = in_data + b * batch_stride + y0 * row_stride;
+      const uint8_t *r1 = in_data + b * batch_stride + y1 * row_stride;
+
+      for (ssize_t x = 0; x < out_w; ++x) {
+        const uint8_t *p00 = r0 + table.x0[x] * c, *p01 = r0 + table.x1[x] * c;
+        const uint8_t *p10 = r1 + table.x0[x] * c, *p11 = r1 + table.x1[x] * c;
+        const float wx = table.wx[x];
+        for (ssize_t ch = 0; ch < c; ++ch) {
+          const ssize_t sc = swap_rb ? 2 - ch : ch;
+          float top = p00[sc] + (p01[sc] - p00[sc]) * wx;
+          float bot = p10[sc] + (p11[sc] - p10[sc]) * wx;
+          row[x * c + ch] = (top + (bot - top) * wy) * mul[ch] + add[ch];
+        }
+      }
+
+      // Write the row to the output in the requested layout and type
+      if (!nchw && !quantize) {
+        memcpy(out_data + (b * out_h + y) * out_w * c, &row[0],
+               out_w * c * sizeof(float));
+        continue;
+      }
+      for (ssize_t ch = 0; ch < c; ++ch) {
+        const ssize_t out_offset = nchw ?
+          ((b * c + ch) * out_h + y) * out_w : ((b * out_h + y) * out_w) * c + ch;
+        const ssize_t step = nchw ? 1 : c;
+        if (quantize) {
+          int8_t *o = q_out_data + out_offset;
+          for (ssize_t x = 0; x < out_w; ++x) {
+            float v = std::nearbyint(row[x * c + ch]);
+            o[x * step] = (int8_t) std::min(127.f, std::max(-128.f, v));
+          }
+        } else {
+          float *o = out_data + out_offset;
+          for (ssize_t x = 0; x < out_w; ++x)
+            o[x * step] = row[x * c + ch];
+        }
+      }
+    }
+  });
+  out.commit();
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,60 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include "pyxir/pyxir_api.hpp"
+#include "pyxir/graph/xlayer.hpp"
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/kernel_func.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+/**
+ * @brief PreprocessFunc for converting raw uint8 NHWC frames into network
+ *  inputs in a single pass: bilinear resize, per channel mean/scale
+ *  normalisation, optional R/B channel swap, NHWC -> NCHW layout change and
+ *  optional int8 fix-point quantisation.
+ */ 
+class PreprocessFunc final : public KernelFunc {
+
+  public:
+    PreprocessFunc(XLayerHolder &xl);
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors);
+
+  private:
+    // The output (height, width), empty for no resizing
+    std::vector<int64_t> size_;
+    // Per channel mean and scale: out = (in - mean) * scale
+    std::vector<float> mean_;
+    std::vector<float> scale_;
+    // Whether to output NCHW (true) or NHWC (false) data
+    bool nchw_ = true;
+    // Whether to swap the first and third channel (BGR <-> RGB)
+    bool swap_rb_ = false;
+    // Whether to quantize the output to int8 with the given fix point
+    bool quantize_ = false;
+    int fix_point_ = 0;
+};
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,296 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+
+#include "fixpoint_kernels.hpp"
+#include "typed_kernels.hpp"
+#include "quantize.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+namespace {
+
+// Thresholds are stored as a single float or as a list of floats
+std::vector<double> get_thresholds(XLayerHolder &xl, const std::string &name)
+{
+  graph::XAttr &xa = xl->get_attr(name);
+  if (xa.type == "FLOAT")
+    return std::vector<double>{xa.f};
+  return xa.get_floats();
+}
+
+int get_bitwidth(XLayerHolder &xl)
+{
+  int bitwidth = xl->has_attr("quant_bitwidth")
+    ? xl->get_attr("quant_bitwidth").get_int() : 8;
+  if (bitwidth < 2 || bitwidth > 32)
+    throw std::invalid_argument("Fix point kernels: unsupported bitwidth "
+                                + std::to_string(bitwidth));
+  return bitwidth;
+}
+
+DType to_dtype(const std::string &dtype)
+{
+  if (dtype == "int8")
+    return DType::I8;
+  if (dtype == "int32")
+    return DType::I32;
+  if (dtype == "float32")
+    return DType::F32;
+  throw std::invalid_argument("Fix point kernels: unsupported dtype `"
+                              + dtype + "`");
+}
+
+// The output of the given type, allocated if it wasn't bound by the caller
+KernelOutput get_output(std::vector<XBufferHolder> &out_tensors,
+                        const std::vector<ssize_t> &shape, DType dtype,
+                        const std::string &op)
+{
+  switch (dtype) {
+    case DType::I8: return KernelOutput(out_tensors, 0, shape, 1, "b", op);
+    case DType::I32: return KernelOutput(out_tensors, 0, shape, 4, "i", op);
+    default: return KernelOutput(out_tensors, 0, shape, 4, "f", op);
+  }
+}
+
+} // namespace
+
+/*
+ * Quantize
+ */
+
+QuantizeFunc::QuantizeFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  threshold_ = get_thresholds(xl_, "quant_threshold");
+  bitwidth_ = get_bitwidth(xl_);
+  if (xl_->has_attr("axis"))
+    axis_ = xl_->get_attr("axis").get_int();
+  if (xl_->has_attr("dtype"))
+    dtype_ = xl_->get_attr("dtype").get_string();
+  to_dtype(dtype_);
+}
+
+void QuantizeFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  if (get_dtype(*in) != DType::F32)
+    throw std::invalid_argument("Quantize: expects float32 input");
+  DType dtype = to_dtype(dtype_);
+  KernelOutput out = get_output(out_tensors, in->shape, dtype, "Quantize");
+
+  ChannelBlocks b(in->shape, axis_);
+  std::vector<float> th = expand_channel_params<float>(threshold_, b.channels,
+                                                       "Quantize");
+  std::vector<float> factor(b.channels);
+  for (ssize_t c = 0; c < b.channels; ++c)
+    factor[c] = (float) (fixpoint_max(bitwidth_) / (double) th[c]);
+
+  const float *x = (const float *) in->data;
+  if (dtype == DType::I8)
+    quantize(x, out.data<int8_t>(), b, &th[0], &factor[0]);
+  else if (dtype == DType::I32)
+    quantize(x, out.data<int32_t>(), b, &th[0], &factor[0]);
+  else
+    throw std::invalid_argument("Quantize: expects int8 or int32 output");
+  out.commit();
+}
+
+/*
+ * UnQuantize
+ */
+
+UnQuantizeFunc::UnQuantizeFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  threshold_ = get_thresholds(xl_, "quant_threshold");
+  bitwidth_ = get_bitwidth(xl_);
+  if (xl_->has_attr("axis"))
+    axis_ = xl_->get_attr("axis").get_int();
+}
+
+void UnQuantizeFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  KernelOutput out = get_output(out_tensors, in->shape, DType::F32,
+                                "UnQuantize");
+
+  ChannelBlocks b(in->shape, axis_);
+  std::vector<double> th = expand_channel_params<double>(
+    threshold_, b.channels, "UnQuantize");
+  std::vector<float> factor(b.channels);
+  for (ssize_t c = 0; c < b.channels; ++c)
+    factor[c] = (float) (th[c] / fixpoint_max(bitwidth_));
+
+  float *y = out.data<float>();
+  switch (get_dtype(*in)) {
+    case DType::I8:
+      unquantize((const int8_t *) in->data, y, b, &factor[0]); break;
+    case DType::U8:
+      unquantize((const uint8_t *) in->data, y, b, &factor[0]); break;
+    case DType::I32:
+      unquantize((const int32_t *) in->data, y, b, &factor[0]); break;
+    case DType::F32:
+      unquantize((const float *) in->data, y, b, &factor[0]); break;
+    default:
+      throw std::invalid_argument("UnQuantize: unsupported input type");
+  }
+  out.commit();
+}
+
+/*
+ * QuantizeBias
+ */
+
+QuantizeBiasFunc::QuantizeBiasFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  threshold_ext_ = get_thresholds(xl_, "quant_threshold")[0];
+  threshold_params_ = get_thresholds(xl_, "quant_th_params");
+  bitwidth_ = get_bitwidth(xl_);
+  if (bitwidth_ != 8)
+    throw std::invalid_argument("QuantizeBias: only bitwidth 8 is supported");
+}
+
+void QuantizeBiasFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  if (get_dtype(*in) != DType::F32)
+    throw std::invalid_argument("QuantizeBias: expects float32 input");
+  KernelOutput out = get_output(out_tensors, in->shape, DType::I32,
+                                "QuantizeBias");
+
+  // Biases are added to the 24 bit accumulator
+  ChannelBlocks b(in->shape, 0);
+  std::vector<double> th = expand_channel_params<double>(
+    threshold_params_, b.channels, "QuantizeBias");
+  const double half_range = (double) fixpoint_max(bitwidth_);
+  const double macc_half_range = (double) fixpoint_max(24);
+  std::vector<float> sf_acc(b.channels), th_acc(b.channels);
+  for (ssize_t c = 0; c < b.channels; ++c) {
+    double sf = (threshold_ext_ / half_range) * (th[c] / half_range);
+    sf_acc[c] = (float) sf;
+    th_acc[c] = (float) (sf * macc_half_range);
+  }
+
+  quantize_bias((const float *) in->data, out.data<int32_t>(), b,
+                &th_acc[0], &sf_acc[0]);
+  out.commit();
+}
+
+/*
+ * QuantizeInter
+ */
+
+QuantizeInterFunc::QuantizeInterFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  scale_ = xl_->get_attr("quant_scale").get_ints();
+  postscale_shift_ = xl_->get_attr("quant_postscale_shift").get_ints();
+  bitwidth_ = get_bitwidth(xl_);
+  if (xl_->has_attr("axis"))
+    axis_ = xl_->get_attr("axis").get_int();
+  if (xl_->has_attr("dtype"))
+    dtype_ = xl_->get_attr("dtype").get_string();
+  to_dtype(dtype_);
+  relu_ = xl_->has_attr("activation")
+    && xl_->get_attr("activation").get_string() == "ReLU";
+
+  if (scale_.size() != postscale_shift_.size())
+    throw std::invalid_argument("QuantizeInter: scale and postscale shift"
+                                " should have the same size");
+  for (const int64_t &shift : postscale_shift_)
+    if (shift < 0)
+      throw std::invalid_argument("QuantizeInter: postscale shift should not"
+                                  " be less than 0 but was: "
+                                  + std::to_string(shift));
+  if (xl_->has_attr("quant_prescale_shift"))
+    for (const int64_t &shift : xl_->get_attr("quant_prescale_shift").get_ints())
+      if (shift != 0)
+        throw std::invalid_argument("QuantizeInter: prescale shift is not"
+                                    " supported");
+}
+
+namespace {
+
+template <typename O>
+void requantize_dispatch(XBuffer &in, O *y, const ChannelBlocks &b,
+                         const int64_t *scale, const int64_t *shift,
+                         int bitwidth, bool relu)
+{
+  switch (get_dtype(in)) {
+    case DType::F32:
+      requantize((const float *) in.data, y, b, scale, shift, bitwidth, relu);
+      break;
+    case DType::I32:
+      requantize((const int32_t *) in.data, y, b, scale, shift, bitwidth, relu);
+      break;
+    case DType::I8:
+      requantize((const int8_t *) in.data, y, b, scale, shift, bitwidth, relu);
+      break;
+    default:
+      throw std::invalid_argument("QuantizeInter: unsupported input type");
+  }
+}
+
+} // namespace
+
+void QuantizeInterFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  DType dtype = to_dtype(dtype_);
+  KernelOutput out = get_output(out_tensors, in->shape, dtype,
+                                "QuantizeInter");
+
+  ChannelBlocks b(in->shape, axis_);
+  std::vector<int64_t> scale = expand_channel_params<int64_t>(
+    scale_, b.channels, "QuantizeInter");
+  std::vector<int64_t> shift = expand_channel_params<int64_t>(
+    postscale_shift_, b.channels, "QuantizeInter");
+
+  if (dtype == DType::I8)
+    requantize_dispatch(*in, out.data<int8_t>(), b, &scale[0], &shift[0],
+                        bitwidth_, relu_);
+  else if (dtype == DType::I32)
+    requantize_dispatch(*in, out.data<int32_t>(), b, &scale[0], &shift[0],
+                        bitwidth_, relu_);
+  else
+    throw std::invalid_argument("QuantizeInter: expects int8 or int32 output");
+  out.commit();
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
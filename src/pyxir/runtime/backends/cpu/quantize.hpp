@@ -0,0 +1,110 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include "pyxir/pyxir_api.hpp"
+#include "pyxir/graph/xlayer.hpp"
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/kernel_func.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+/**
+ * @brief QuantizeFunc for simulating the fix point quantization of float
+ *  inputs with per channel thresholds along the provided axis
+ */ 
+class QuantizeFunc final : public KernelFunc {
+
+  public:
+    QuantizeFunc(XLayerHolder &xl);
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors);
+
+  private:
+    std::vector<double> threshold_;
+    int axis_ = 1;
+    int bitwidth_ = 8;
+    std::string dtype_ = "int8";
+};
+
+/**
+ * @brief UnQuantizeFunc for converting fix point inputs back to float with
+ *  per channel thresholds along the provided axis
+ */ 
+class UnQuantizeFunc final : public KernelFunc {
+
+  public:
+    UnQuantizeFunc(XLayerHolder &xl);
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors);
+
+  private:
+    std::vector<double> threshold_;
+    int axis_ = 1;
+    int bitwidth_ = 8;
+};
+
+/**
+ * @brief QuantizeBiasFunc for quantizing float biases to the 32 bit
+ *  accumulator scale of the layer they are added in
+ */ 
+class QuantizeBiasFunc final : public KernelFunc {
+
+  public:
+    QuantizeBiasFunc(XLayerHolder &xl);
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors);
+
+  private:
+    // The threshold of the input of the layer the bias is added in
+    double threshold_ext_ = 1.;
+    // The per output channel thresholds of the layer weights
+    std::vector<double> threshold_params_;
+    int bitwidth_ = 8;
+};
+
+/**
+ * @brief QuantizeInterFunc for requantizing accumulator values to the
+ *  output bitwidth with per channel integer scales and rounding shifts
+ */ 
+class QuantizeInterFunc final : public KernelFunc {
+
+  public:
+    QuantizeInterFunc(XLayerHolder &xl);
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors);
+
+  private:
+    std::vector<int64_t> scale_;
+    std::vector<int64_t> postscale_shift_;
+    int axis_ = 1;
+    int bitwidth_ = 8;
+    bool relu_ = false;
+    std::string dtype_ = "int8";
+};
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,103 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#include "pyxir/common/parallel.hpp"
+#include "typed_kernels.hpp"
+#include "softmax.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+SoftmaxFunc::SoftmaxFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  if (xl_->has_attr("axis"))
+    axis_ = xl_->get_attr("axis").get_int();
+}
+
+void SoftmaxFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  // Strided inputs (e.g. views) are packed first
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  if (get_dtype(*in) != DType::F32)
+    throw std::invalid_argument("Softmax: expects float32 input");
+  KernelOutput out(out_tensors, 0, in->shape, 4, "f", "Softmax");
+
+  int axis = axis_ < 0 ? in->ndim + axis_ : axis_;
+  if (axis < 0 || axis >= in->ndim)
+    throw std::invalid_argument("Softmax: invalid axis " + std::to_string(axis_)
+                                + " for input of rank " + std::to_string(in->ndim));
+  
+  ssize_t outer = 1, inner = 1;
+  for (int i = 0; i < axis; ++i)
+    outer *= in->shape[i];
+  for (int i = axis + 1; i < in->ndim; ++i)
+    inner *= in->shape[i];
+  const ssize_t len = in->shape[axis];
+  // Nothing to normalize for empty inputs
+  if (len * inner == 0)
+    return;
+
+  const float *in_data = (const float *) in->data;
+  float *out_data = out.data<float>();
+
+  parallel_for(outer, std::max<ssize_t>(1, 16384 / (len * inner)),
+               [&](ssize_t begin, ssize_t end) {
+    std::vector<float> max_v(inner), sum_v(inner);
+    for (ssize_t o = begin; o < end; ++o) {
+      const float *x = in_data + o * len * inner;
+      float *y = out_data + o * len * inner;
+      // Compute the maxima along the softmax axis for numerical stability.
+      //  The inner loops run over contiguous memory and vectorize.
+      std::copy(x, x + inner, max_v.begin());
+      for (ssize_t l = 1; l < len; ++l) {
+        const float *xl = x + l * inner;
+        for (ssize_t i = 0; i < inner; ++i)
+          max_v[i] = std::max(max_v[i], xl[i]);
+      }
+      std::fill(sum_v.begin(), sum_v.end(), 0.f);
+      for (ssize_t l = 0; l < len; ++l) {
+        const float *xl = x + l * inner;
+        float *yl = y + l * inner;
+        for (ssize_t i = 0; i < inner; ++i) {
+          yl[i] = std::exp(xl[i] - max_v[i]);
+          sum_v[i] += yl[i];
+        }
+      }
+      for (ssize_t i = 0; i < inner; ++i)
+        sum_v[i] = 1.f / sum_v[i];
+      for (ssize_t l = 0; l < len; ++l) {
+        float *yl = y + l * inner;
+        for (ssize_t i = 0; i < inner; ++i)
+          yl[i] *= sum_v[i];
+      }
+    }
+  });
+  out.commit();
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,76 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cstring>
+
+#include "pyxir/runtime/static_kernel_registry.hpp"
+#include "arg_max.hpp"
+#include "gs_tiling.hpp"
+#include "input.hpp"
+#include "nms.hpp"
+#include "preprocess.hpp"
+#include "quantize.hpp"
+#include "softmax.hpp"
+#include "top_k.hpp"
+#include "transpose.hpp"
+#include "tuple.hpp"
+#include "tuple_get_item.hpp"
+#include "yolo_decode.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+namespace {
+
+const StaticKernelEntry BUILTIN_KERNELS[] = {
+  make_static_kernel<cpu::InputFunc>("Input"),
+  make_static_kernel<cpu::TupleFunc>("Tuple"),
+  make_static_kernel<cpu::TupleGetItemFunc>("TupleGetItem"),
+  make_static_kernel<cpu::TransposeFunc>("Transpose"),
+  make_static_kernel<cpu::SoftmaxFunc>("Softmax"),
+  make_static_kernel<cpu::NMSFunc>("NMS"),
+  make_static_kernel<cpu::TopKFunc>("TopK"),
+  make_static_kernel<cpu::ArgMaxFunc>("ArgMax"),
+  make_static_kernel<cpu::GSTilingFunc>("GSTiling"),
+  make_static_kernel<cpu::YoloDecodeFunc>("YoloDecode"),
+  make_static_kernel<cpu::PreprocessFunc>("Preprocess"),
+  make_static_kernel<cpu::QuantizeFunc>("Quantize"),
+  make_static_kernel<cpu::UnQuantizeFunc>("UnQuantize"),
+  make_static_kernel<cpu::QuantizeBiasFunc>("QuantizeBias"),
+  make_static_kernel<cpu::QuantizeInterFunc>("QuantizeInter"),
+};
+
+} // namespace
+
+const StaticKernelEntry *StaticKernelRegistry::Find(const std::string &op_type)
+{
+  for (const StaticKernelEntry &entry : BUILTIN_KERNELS)
+    if (std::strcmp(entry.op_type, op_type.c_str()) == 0)
+      return &entry;
+  return nullptr;
+}
+
+std::vector<std::string> StaticKernelRegistry::GetOpTypes()
+{
+  std::vector<std::string> op_types;
+  for (const StaticKernelEntry &entry : BUILTIN_KERNELS)
+    op_types.push_back(entry.op_type);
+  return op_types;
+}
+
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,84 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cassert>
+#include <numeric>
+#include <algorithm>
+
+#include "pyxir/common/parallel.hpp"
+#include "typed_kernels.hpp"
+#include "top_k.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+TopKFunc::TopKFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  k_ = xl_->get_attr("k").get_int();
+  if (k_ <= 0)
+    throw std::invalid_argument("TopK: k should be positive but got: "
+                                + std::to_string(k_));
+}
+
+void TopKFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  // Strided inputs (e.g. views) are packed first
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  if (get_dtype(*in) != DType::F32)
+    throw std::invalid_argument("TopK: expects float32 input");
+  const ssize_t len = in->shape[in->ndim - 1];
+  const ssize_t rows = len > 0 ? in->size / len : 0;
+  const ssize_t k = std::min<ssize_t>(k_, len);
+
+  std::vector<ssize_t> out_shape(in->shape.begin(), in->shape.end());
+  out_shape[in->ndim - 1] = k;
+  KernelOutput values_out(out_tensors, 0, out_shape, 4, "f", "TopK");
+  KernelOutput indices_out(out_tensors, 1, out_shape, 4, "i", "TopK");
+
+  const float *in_data = (const float *) in->data;
+  float *values = values_out.data<float>();
+  int32_t *indices = indices_out.data<int32_t>();
+
+  parallel_for(rows, std::max<ssize_t>(1, 16384 / std::max<ssize_t>(len, 1)),
+               [&](ssize_t begin, ssize_t end) {
+    std::vector<int32_t> idx(len);
+    for (ssize_t r = begin; r < end; ++r) {
+      const float *x = in_data + r * len;
+      std::iota(idx.begin(), idx.end(), 0);
+      // Partial sort only orders the first k indices: O(len * log(k))
+      std::partial_sort(idx.begin(), idx.begin() + k, idx.end(),
+                        [x](int32_t a, int32_t b) {
+                          return x[a] > x[b] || (x[a] == x[b] && a < b);
+                        });
+      for (ssize_t i = 0; i < k; ++i) {
+        values[r * k + i] = x[idx[i]];
+        indices[r * k + i] = idx[i];
+      }
+    }
+  });
+  values_out.commit();
+  indices_out.commit();
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
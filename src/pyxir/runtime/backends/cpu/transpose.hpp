@@ -20,7 +20,7 @@
 #include "pyxir/graph/xlayer.hpp"
 #include "pyxir/common/xbuffer.hpp"
 #include "pyxir/runtime/kernel_func.hpp"
-#include "pyxir/opaque_func_registry.hpp"
+#include "transpose_kernels.hpp"
 
 namespace pyxir {
 namespace runtime {
@@ -29,7 +29,7 @@ namespace cpu {
 /**
  * @brief TransposeFunc for executing a Transpose layer
  */ 
-class TransposeFunc : public KernelFunc {
+class TransposeFunc final : public KernelFunc {
 
   public:
     TransposeFunc(XLayerHolder &xl);
@@ -39,7 +39,7 @@ class TransposeFunc : public KernelFunc {
 
   private:
     std::vector<int64_t> axes_;
-    OpaqueFunc transpose_of_;
+    Transposer transposer_;
 };
 
 } // namespace cpu
@@ -0,0 +1,358 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "typed_kernels.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+/** @brief The maximum rank of the specialised transpose plans, Transposer
+    falls back to a strided copy for higher ranks */
+constexpr int TRANSPOSE_MAX_RANK = 6;
+
+struct TransposePlan;
+
+typedef void (*TransposeImpl)(const void *, void *, const TransposePlan &);
+typedef void (*TransposeViewFunc)(TransposePlan &);
+
+/**
+ * @brief A transpose of a contiguous tensor, specialised for its item size,
+ *  rank and permutation when it is planned. The implementation doesn't
+ *  depend on the input shape, which is bound with set_shape before a call.
+ */
+struct TransposePlan {
+  ssize_t itemsize = 0;
+  int rank = 0;
+  int axes[TRANSPOSE_MAX_RANK];
+  ssize_t in_shape[TRANSPOSE_MAX_RANK];
+  /** @brief The [batch, rows, cols] -> [batch, cols, rows] view of the
+      transpose if its permutation has a fast path */
+  ssize_t batch = 0;
+  ssize_t rows = 0;
+  ssize_t cols = 0;
+  /** @brief Computes the view from the input shape, null if the permutation
+      has no fast path */
+  TransposeViewFunc set_view = nullptr;
+  TransposeImpl impl = nullptr;
+
+  /** @brief Bind the plan to the shape of the next input */
+  void set_shape(const std::vector<ssize_t> &shape)
+  {
+    if ((int) shape.size() != rank)
+      throw std::invalid_argument("Transpose: can't transpose a tensor of rank "
+                                  + std::to_string(shape.size()) + " with "
+                                  + std::to_string(rank) + " axes");
+    for (int i = 0; i < rank; ++i)
+      in_shape[i] = shape[i];
+    if (set_view)
+      set_view(*this);
+  }
+};
+
+/**
+ * @brief A compile time permutation which keeps the leading Batch dimensions
+ *  and swaps the dimension blocks [Batch, Split) and [Split, rank), i.e. a
+ *  batched 2D transpose
+ */
+template <int Batch, int Split, int... Axes>
+struct BlockPermutation {
+  static constexpr int rank = sizeof...(Axes);
+
+  static bool matches(const TransposePlan &plan)
+  {
+    static constexpr int expected[] = {Axes...};
+    if (plan.rank != rank)
+      return false;
+    for (int i = 0; i < rank; ++i)
+      if (plan.axes[i] != expected[i])
+        return false;
+    return true;
+  }
+
+  static void set_view(TransposePlan &plan)
+  {
+    plan.batch = 1;
+    plan.rows = 1;
+    plan.cols = 1;
+    for (int i = 0; i < Batch; ++i)
+      plan.batch *= plan.in_shape[i];
+    for (int i = Batch; i < Split; ++i)
+      plan.rows *= plan.in_shape[i];
+    for (int i = Split; i < rank; ++i)
+      plan.cols *= plan.in_shape[i];
+  }
+};
+
+typedef BlockPermutation<0, 1, 1, 0> Transpose2D;
+typedef BlockPermutation<1, 2, 0, 2, 1> BatchedTranspose2D;
+typedef BlockPermutation<1, 2, 0, 2, 3, 1> NCHWToNHWC;
+typedef BlockPermutation<1, 3, 0, 3, 1, 2> NHWCToNCHW;
+
+/** @brief Fast path for the block permutations using cache sized tiles */
+template <typename T>
+void transpose_batched_2d(const void *src, void *dst, const TransposePlan &p)
+{
+  const ssize_t TILE = 32;
+  const T *s = static_cast<const T *>(src);
+  T *d = static_cast<T *>(dst);
+  const ssize_t plane = p.rows * p.cols;
+  if (p.rows == 1 || p.cols == 1) {
+    std::copy(s, s + p.batch * plane, d);
+    return;
+  }
+  for (ssize_t b = 0; b < p.batch; ++b) {
+    const T *sb = s + b * plane;
+    T *db = d + b * plane;
+    for (ssize_t r0 = 0; r0 < p.rows; r0 += TILE) {
+      const ssize_t r1 = std::min(r0 + TILE, p.rows);
+      for (ssize_t c0 = 0; c0 < p.cols; c0 += TILE) {
+        const ssize_t c1 = std::min(c0 + TILE, p.cols);
+        for (ssize_t r = r0; r < r1; ++r)
+          for (ssize_t c = c0; c < c1; ++c)
+            db[c * p.rows + r] = sb[r * p.cols + c];
+      }
+    }
+  }
+}
+
+/** @brief Generic transpose walking the output in order */
+template <typename T, int Rank>
+void transpose_nd(const void *src, void *dst, const TransposePlan &p)
+{
+  const T *s = static_cast<const T *>(src);
+  T *d = static_cast<T *>(dst);
+
+  ssize_t in_strides[Rank];
+  ssize_t stride = 1;
+  for (int i = Rank - 1; i >= 0; --i) {
+    in_strides[i] = stride;
+    stride *= p.in_shape[i];
+  }
+  const ssize_t total = stride;
+  if (total == 0)
+    return;
+
+  ssize_t out_shape[Rank];
+  ssize_t src_strides[Rank];
+  for (int i = 0; i < Rank; ++i) {
+    out_shape[i] = p.in_shape[p.axes[i]];
+    src_strides[i] = in_strides[p.axes[i]];
+  }
+
+  const ssize_t inner = out_shape[Rank - 1];
+  const ssize_t inner_stride = src_strides[Rank - 1];
+  ssize_t idx[Rank] = {};
+  ssize_t offset = 0;
+  for (ssize_t o = 0; o < total; o += inner) {
+    for (ssize_t j = 0; j < inner; ++j)
+      d[o + j] = s[offset + j * inner_stride];
+    for (int k = Rank - 2; k >= 0; --k) {
+      offset += src_strides[k];
+      if (++idx[k] < out_shape[k])
+        break;
+      offset -= src_strides[k] * out_shape[k];
+      idx[k] = 0;
+    }
+  }
+}
+
+template <typename T>
+struct TransposeSelector {
+  static TransposeImpl get(const TransposePlan &plan)
+  {
+    if (plan.set_view)
+      return &transpose_batched_2d<T>;
+    switch (plan.rank) {
+      case 1: return &transpose_nd<T, 1>;
+      case 2: return &transpose_nd<T, 2>;
+      case 3: return &transpose_nd<T, 3>;
+      case 4: return &transpose_nd<T, 4>;
+      case 5: return &transpose_nd<T, 5>;
+      case 6: return &transpose_nd<T, 6>;
+    }
+    throw std::invalid_argument("Transpose: unsupported rank "
+                                + std::to_string(plan.rank));
+  }
+};
+
+/** @brief Check the permutation, negative axes count from the back */
+inline std::vector<int> normalize_transpose_axes(const std::vector<int64_t> &axes)
+{
+  const int rank = (int) axes.size();
+  if (rank == 0)
+    throw std::invalid_argument("Transpose: unsupported rank 0");
+  std::vector<int> res(rank);
+  std::vector<bool> seen(rank, false);
+  for (int i = 0; i < rank; ++i) {
+    int axis = (int) (axes[i] < 0 ? axes[i] + rank : axes[i]);
+    if (axis < 0 || axis >= rank || seen[axis])
+      throw std::invalid_argument("Transpose: axes are not a permutation");
+    seen[axis] = true;
+    res[i] = axis;
+  }
+  return res;
+}
+
+/** @brief Plan the transpose of tensors with the given item size and a rank
+    up to TRANSPOSE_MAX_RANK, negative axes count from the back */
+inline TransposePlan make_transpose_plan(ssize_t itemsize,
+                                         const std::vector<int64_t> &axes)
+{
+  const int rank = (int) axes.size();
+  if (rank > TRANSPOSE_MAX_RANK)
+    throw std::invalid_argument("Transpose: no specialised plan for rank "
+                                + std::to_string(rank));
+  std::vector<int> norm_axes = normalize_transpose_axes(axes);
+
+  TransposePlan plan;
+  plan.itemsize = itemsize;
+  plan.rank = rank;
+  std::copy(norm_axes.begin(), norm_axes.end(), plan.axes);
+
+  if (Transpose2D::matches(plan))
+    plan.set_view = &Transpose2D::set_view;
+  else if (BatchedTranspose2D::matches(plan))
+    plan.set_view = &BatchedTranspose2D::set_view;
+  else if (NCHWToNHWC::matches(plan))
+    plan.set_view = &NCHWToNHWC::set_view;
+  else if (NHWCToNCHW::matches(plan))
+    plan.set_view = &NHWCToNCHW::set_view;
+
+  plan.impl = dispatch_itemsize<TransposeSelector>(itemsize, plan);
+  return plan;
+}
+
+/**
+ * @brief Transpose with a fixed permutation. A transpose only moves
+ *  elements, so it's planned up front for every supported item size and a
+ *  call only binds the plan to the input shape, whatever the batch size.
+ *  Permutations of higher rank than TRANSPOSE_MAX_RANK copy the input with
+ *  permuted strides instead.
+ */
+class Transposer {
+
+  public:
+    Transposer() {}
+
+    /** @brief Create a transposer from the permutation */
+    explicit Transposer(const std::vector<int64_t> &axes)
+    {
+      if ((int) axes.size() > TRANSPOSE_MAX_RANK) {
+        axes_ = normalize_transpose_axes(axes);
+        return;
+      }
+      for (int i = 0; i < 4; ++i)
+        plans_[i] = make_transpose_plan((ssize_t) 1 << i, axes);
+    }
+
+    /** @brief Transpose the input into out_tensors[0], which is allocated
+        if it's not provided */
+    void operator()(const XBufferHolder &input,
+                    std::vector<XBufferHolder> &out_tensors) const
+    {
+      if (!axes_.empty()) {
+        transpose_strided(input, out_tensors);
+        return;
+      }
+      XBufferHolder in = ascontiguous(input);
+      TransposePlan plan = get_plan(in->itemsize);
+      plan.set_shape(in->shape);
+
+      std::vector<ssize_t> out_shape(plan.rank);
+      for (int i = 0; i < plan.rank; ++i)
+        out_shape[i] = plan.in_shape[plan.axes[i]];
+      if (out_tensors.empty())
+        out_tensors.push_back(create_buffer(out_shape, in->itemsize, in->format));
+
+      XBuffer &out = *out_tensors[0];
+      if (out.size != in->size || out.itemsize != in->itemsize)
+        throw std::invalid_argument("Transpose: provided output buffer has"
+                                    " wrong size or element type");
+      if (out.is_contiguous()) {
+        plan.impl(in->data, out.data, plan);
+      } else {
+        XBufferHolder tmp = create_buffer(out_shape, in->itemsize, in->format);
+        plan.impl(in->data, tmp->data, plan);
+        copy_buffer(*tmp, out);
+      }
+    }
+
+  private:
+    /** @brief Generic transpose for ranks without a specialised plan */
+    void transpose_strided(const XBufferHolder &in,
+                           std::vector<XBufferHolder> &out_tensors) const
+    {
+      const size_t rank = axes_.size();
+      if (in->shape.size() != rank)
+        throw std::invalid_argument("Transpose: can't transpose a tensor of"
+                                    " rank " + std::to_string(in->shape.size())
+                                    + " with " + std::to_string(rank)
+                                    + " axes");
+      std::vector<ssize_t> out_shape(rank), src_strides(rank);
+      for (size_t i = 0; i < rank; ++i) {
+        out_shape[i] = in->shape[axes_[i]];
+        src_strides[i] = in->strides[axes_[i]];
+      }
+      if (out_tensors.empty())
+        out_tensors.push_back(create_buffer(out_shape, in->itemsize, in->format));
+
+      XBuffer &out = *out_tensors[0];
+      if (out.size != in->size || out.itemsize != in->itemsize)
+        throw std::invalid_argument("Transpose: provided output buffer has"
+                                    " wrong size or element type");
+      if (out.is_contiguous()) {
+        copy_strided(in->data, src_strides, out.data,
+                     XBuffer::contiguous_strides(out_shape, in->itemsize),
+                     out_shape, in->itemsize);
+      } else {
+        if (out.shape != out_shape)
+          throw std::invalid_argument("Transpose: provided strided output"
+                                      " buffer has the wrong shape");
+        copy_strided(in->data, src_strides, out.data, out.strides, out_shape,
+                     in->itemsize);
+      }
+    }
+
+    const TransposePlan &get_plan(ssize_t itemsize) const
+    {
+      if (!plans_[0].impl)
+        throw std::runtime_error("Transpose: transposer has no permutation");
+      switch (itemsize) {
+        case 1: return plans_[0];
+        case 2: return plans_[1];
+        case 4: return plans_[2];
+        case 8: return plans_[3];
+      }
+      throw std::invalid_argument("Transpose: unsupported item size "
+                                  + std::to_string(itemsize));
+    }
+
+    /** @brief The plans for item sizes 1, 2, 4 and 8 */
+    TransposePlan plans_[4];
+    /** @brief The permutation if its rank has no specialised plans */
+    std::vector<int> axes_;
+};
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
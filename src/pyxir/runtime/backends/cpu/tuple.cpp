@@ -16,7 +16,6 @@
 
 #include <cassert>
 
-#include "pyxir/runtime/runtime.hpp"
 #include "tuple.hpp"
 
 namespace pyxir {
@@ -40,11 +39,6 @@ void TupleFunc::operator()(
   }
 }
 
-REGISTER_KERNEL_FUNC("cpu.Tuple")
-  .set_impl([](XLayerHolder &xl, KernelFuncHolder &kfh) {
-    kfh = std::move(KernelFuncHolder(new TupleFunc(xl)));
-  });
-
 } // namespace cpu
 } // namespace runtime
 } // namespace pyxir
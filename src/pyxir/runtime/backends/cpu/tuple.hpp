@@ -25,7 +25,7 @@ namespace pyxir {
 namespace runtime {
 namespace cpu {
 
-class TupleFunc : public KernelFunc {
+class TupleFunc final : public KernelFunc {
 
   public:
     TupleFunc(XLayerHolder &xl);
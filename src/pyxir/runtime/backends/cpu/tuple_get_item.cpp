@@ -15,14 +15,8 @@
  */
 
 #include <cassert>
-#include <pybind11/pybind11.h>
-#include <pybind11/embed.h>
 
-#include "pyxir/runtime/runtime.hpp"
 #include "tuple_get_item.hpp"
-#include "pyxir/opaque_func_registry.hpp"
-
-namespace py = pybind11;
 
 namespace pyxir {
 namespace runtime {
@@ -37,16 +31,7 @@ TupleGetItemFunc::TupleGetItemFunc(XLayerHolder &xl)
 
   if (transpose_) {
     axes_ = xl_->get_attr("axes").get_ints();
-
-    // Import Python global Transpose function for now
-    // auto transpose = py::module::import("pyxir.runtime.globals.transpose");
-
-    if (!pyxir::OpaqueFuncRegistry::Exists("px.globals.Transpose"))
-      throw std::runtime_error("Cannot import global Transpose function because"
-                              " `px.global.Transpose` opaque function is"
-                              " not registered");
-
-    transpose_of_ = pyxir::OpaqueFuncRegistry::Get("px.globals.Transpose");
+    transposer_ = Transposer(axes_);
   }
 }
 
@@ -54,42 +39,19 @@ void TupleGetItemFunc::operator()(
   std::vector<XBufferHolder> &in_tensors,
   std::vector<XBufferHolder> &out_tensors)
 {
-  if (out_tensors.size() == 0) {
-    if (transpose_) {
-      // Create new output XBuffer
-      for (const auto &shape : xl_->shapes) {
-        std::vector<ssize_t> buffer_shape = shape;
-        buffer_shape[0] = in_tensors[0]->shape[0];
-        out_tensors.push_back(create_buffer(buffer_shape));
-      }
-      
-      std::vector<XBufferHolder> transpose_in {in_tensors[index_]};
-      // Execute transpose
-      transpose_of_(transpose_in, out_tensors, axes_);
-    } else {
-      out_tensors.push_back(in_tensors[index_]);
-    }
+  if (transpose_) {
+    transposer_(in_tensors[index_], out_tensors);
+  } else if (out_tensors.size() == 0) {
+    out_tensors.push_back(in_tensors[index_]);
   } else {
     // Out tensors are already provided
     assert(out_tensors[0]->size == in_tensors[index_]->size);
     assert(out_tensors[0]->itemsize == in_tensors[index_]->itemsize);
-
-    if (transpose_) {
-      std::vector<XBufferHolder> transpose_in {in_tensors[index_]};
-      transpose_of_(transpose_in, out_tensors, axes_);
-    } else {
-      memcpy(out_tensors[0]->data, in_tensors[index_]->data,
-             out_tensors[0]->size * out_tensors[0]->itemsize);
-    }
+    // Both the tuple element and the provided output can be strided views
+    copy_buffer(*in_tensors[index_], *out_tensors[0]);
   }
-    
 }
 
-REGISTER_KERNEL_FUNC("cpu.TupleGetItem")
-  .set_impl([](XLayerHolder &xl, KernelFuncHolder &kfh) {
-    kfh = std::move(KernelFuncHolder(new TupleGetItemFunc(xl)));
-  });
-
 } // namespace cpu
 } // namespace runtime
 } // namespace pyxir
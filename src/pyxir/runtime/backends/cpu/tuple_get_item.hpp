@@ -20,6 +20,7 @@
 #include "pyxir/graph/xlayer.hpp"
 #include "pyxir/common/xbuffer.hpp"
 #include "pyxir/runtime/kernel_func.hpp"
+#include "transpose_kernels.hpp"
 
 namespace pyxir {
 namespace runtime {
@@ -29,7 +30,7 @@ namespace cpu {
  * @brief TupleGetItemFunc for executing a TupleGetItem layer, possibly including a transpose
  *  operation.
  */ 
-class TupleGetItemFunc : public KernelFunc {
+class TupleGetItemFunc final : public KernelFunc {
 
   public:
     TupleGetItemFunc(XLayerHolder &xl);
@@ -44,8 +45,8 @@ class TupleGetItemFunc : public KernelFunc {
     bool transpose_;
     // The transpose axes
     std::vector<int64_t> axes_;
-    // Opaque Transpose function for execution
-    OpaqueFunc transpose_of_;
+    // Transpose kernel planned for the transpose axes
+    Transposer transposer_;
 };
 
 } // namespace cpu
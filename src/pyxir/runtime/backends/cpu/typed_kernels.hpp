@@ -0,0 +1,140 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "pyxir/common/xbuffer.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+/** @brief The element types supported by the typed CPU kernels */
+enum class DType { F32, F64, F16, BF16, I8, U8, I32, I64 };
+
+/**
+ * @brief Return the element type of a buffer from its Python struct style
+ *  format descriptor, bfloat16 uses the "E" descriptor of ml_dtypes
+ */
+inline DType get_dtype(const std::string &format, ssize_t itemsize)
+{
+  std::string f = format;
+  if (!f.empty() && (f[0] == '<' || f[0] == '=' || f[0] == '@'))
+    f = f.substr(1);
+  if (f == "f" && itemsize == 4)
+    return DType::F32;
+  if (f == "d" && itemsize == 8)
+    return DType::F64;
+  if (f == "e" && itemsize == 2)
+    return DType::F16;
+  if (f == "E" && itemsize == 2)
+    return DType::BF16;
+  if (f == "b" && itemsize == 1)
+    return DType::I8;
+  if (f == "B" && itemsize == 1)
+    return DType::U8;
+  if ((f == "i" || f == "l") && itemsize == 4)
+    return DType::I32;
+  if ((f == "q" || f == "l") && itemsize == 8)
+    return DType::I64;
+  throw std::invalid_argument("CPU kernels: unsupported element type with"
+                              " format `" + format + "` and itemsize "
+                              + std::to_string(itemsize));
+}
+
+inline DType get_dtype(const XBuffer &xb)
+{
+  return get_dtype(xb.format, xb.itemsize);
+}
+
+/**
+ * @brief Output of a kernel which writes contiguous memory. Allocates the
+ *  output if the caller didn't provide it and otherwise checks the size and
+ *  element type of the provided buffer. Strided outputs (e.g. views) are
+ *  written through a contiguous temporary which commit() copies into them.
+ */
+class KernelOutput {
+
+  public:
+    KernelOutput(std::vector<XBufferHolder> &out_tensors, size_t index,
+                 std::vector<ssize_t> shape, ssize_t itemsize,
+                 const std::string &format, const std::string &op)
+    {
+      if (out_tensors.size() == index)
+        out_tensors.push_back(create_buffer(shape, itemsize, format));
+      else if (out_tensors.size() < index)
+        throw std::invalid_argument(op + ": missing output buffers before"
+                                    " output " + std::to_string(index));
+      out_ = out_tensors[index];
+      ssize_t size = 1;
+      for (const ssize_t &e : shape)
+        size *= e;
+      if (out_->size != size
+          || get_dtype(*out_) != get_dtype(format, itemsize))
+        throw std::invalid_argument(op + ": expected an output buffer of "
+                                    + std::to_string(size) + " `" + format
+                                    + "` elements but got "
+                                    + std::to_string(out_->size) + " `"
+                                    + out_->format + "` elements");
+      if (!out_->is_contiguous())
+        tmp_ = create_buffer(out_->shape, itemsize, format);
+    }
+
+    /** @brief The contiguous memory the kernel writes to */
+    template <typename T>
+    T *data() { return (T *) (tmp_ ? tmp_->data : out_->data); }
+
+    /** @brief Copy the result into a strided output */
+    void commit()
+    {
+      if (tmp_)
+        copy_buffer(*tmp_, *out_);
+    }
+
+  private:
+    XBufferHolder out_;
+    XBufferHolder tmp_;
+};
+
+/**
+ * @brief Instantiate Fn for the unsigned storage type with the given item
+ *  size and return the result of Fn<T>::get(args...). Kernels which only
+ *  move elements (e.g. transposes) use this to pick their specialised
+ *  implementation once, when they are planned.
+ */
+template <template <typename> class Fn, typename... Args>
+auto dispatch_itemsize(ssize_t itemsize, Args &&... args)
+  -> decltype(Fn<uint8_t>::get(args...))
+{
+  switch (itemsize) {
+    case 1: return Fn<uint8_t>::get(args...);
+    case 2: return Fn<uint16_t>::get(args...);
+    case 4: return Fn<uint32_t>::get(args...);
+    case 8: return Fn<uint64_t>::get(args...);
+  }
+  throw std::invalid_argument("CPU kernels: unsupported item size "
+                              + std::to_string(itemsize));
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,100 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cmath>
+#include <cassert>
+
+#include "pyxir/common/parallel.hpp"
+#include "typed_kernels.hpp"
+#include "yolo_decode.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+YoloDecodeFunc::YoloDecodeFunc(XLayerHolder &xl)
+  : KernelFunc(xl)
+{
+  std::vector<int64_t> &anchors = xl_->get_attr("anchors").get_ints();
+  if (anchors.size() == 0 || anchors.size() % 2 != 0)
+    throw std::invalid_argument("YoloDecode: anchors should contain (width,"
+                                " height) pairs");
+  anchors_.assign(anchors.begin(), anchors.end());
+  nb_classes_ = xl_->get_attr("nb_classes").get_int();
+  input_size_ = xl_->get_attr("input_size").get_ints();
+  if (input_size_.size() != 2)
+    throw std::invalid_argument("YoloDecode: input_size should be (height,"
+                                " width)");
+}
+
+static inline float sigmoid(float x) { return 1.f / (1.f + std::exp(-x)); }
+
+void YoloDecodeFunc::operator()(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  assert(in_tensors.size() == 1);
+  // Strided inputs (e.g. views) are packed first
+  XBufferHolder in = ascontiguous(in_tensors[0]);
+  if (get_dtype(*in) != DType::F32)
+    throw std::invalid_argument("YoloDecode: expects float32 input");
+  const ssize_t nb_anchors = anchors_.size() / 2;
+  const ssize_t box_size = 5 + nb_classes_;
+  if (in->ndim != 4 || in->shape[3] != nb_anchors * box_size)
+    throw std::invalid_argument("YoloDecode: expected NHWC input with "
+                                + std::to_string(nb_anchors * box_size)
+                                + " channels");
+  const ssize_t n = in->shape[0], h = in->shape[1], w = in->shape[2];
+
+  KernelOutput out(out_tensors, 0, {n, h * w * nb_anchors, box_size}, 4, "f",
+                   "YoloDecode");
+
+  const float *in_data = (const float *) in->data;
+  float *out_data = out.data<float>();
+  const float stride_y = (float) input_size_[0] / h;
+  const float stride_x = (float) input_size_[1] / w;
+
+  // Input and output have the same memory layout: every (n, y, x, anchor)
+  //  cell maps to one contiguous box of box_size elements
+  parallel_for(n * h, 8, [&](ssize_t begin, ssize_t end) {
+    for (ssize_t nh = begin; nh < end; ++nh) {
+      const ssize_t y = nh % h;
+      for (ssize_t x = 0; x < w; ++x) {
+        for (ssize_t a = 0; a < nb_anchors; ++a) {
+          const ssize_t offset = ((nh * w + x) * nb_anchors + a) * box_size;
+          const float *src = in_data + offset;
+          float *dst = out_data + offset;
+          const float bx = (sigmoid(src[0]) + x) * stride_x;
+          const float by = (sigmoid(src[1]) + y) * stride_y;
+          const float bw = std::exp(src[2]) * anchors_[2 * a];
+          const float bh = std::exp(src[3]) * anchors_[2 * a + 1];
+          dst[0] = bx - bw / 2;
+          dst[1] = by - bh / 2;
+          dst[2] = bx + bw / 2;
+          dst[3] = by + bh / 2;
+          for (ssize_t c = 4; c < box_size; ++c)
+            dst[c] = sigmoid(src[c]);
+        }
+      }
+    }
+  });
+  out.commit();
+}
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,55 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include "pyxir/pyxir_api.hpp"
+#include "pyxir/graph/xlayer.hpp"
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/kernel_func.hpp"
+
+namespace pyxir {
+namespace runtime {
+namespace cpu {
+
+/**
+ * @brief YoloDecodeFunc for decoding a YOLOv3 style output feature map into
+ *  boxes. The input is NHWC with shape (N, H, W, A * (5 + C)) for A anchors and
+ *  C classes. The output has shape (N, H * W * A, 5 + C) with every box
+ *  described as [x0, y0, x1, y1, objectness, class_prob_0, ...] in input
+ *  image coordinates, which is the input format of the NMS kernel.
+ */ 
+class YoloDecodeFunc final : public KernelFunc {
+
+  public:
+    YoloDecodeFunc(XLayerHolder &xl);
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors);
+
+  private:
+    // The anchor (width, height) pairs in input image pixels
+    std::vector<float> anchors_;
+    // The number of classes
+    int nb_classes_;
+    // The network input size as (height, width)
+    std::vector<int64_t> input_size_;
+};
+
+} // namespace cpu
+} // namespace runtime
+} // namespace pyxir
@@ -26,7 +26,8 @@ namespace pyxir {
 namespace runtime {
 namespace vai_rt {
 
-DpuFunc::DpuFunc(XLayerHolder &xl, const std::string &build_dir) : KernelFunc(xl)
+DpuFunc::DpuFunc(XLayerHolder &xl, const std::string &build_dir,
+                 size_t nb_runners) : KernelFunc(xl)
 {
   std::vector<std::string> dpu_in_tensor_names = xl->bottoms;
   std::vector<std::string> dpu_internal_in_tensor_names
@@ -51,6 +52,10 @@ DpuFunc::DpuFunc(XLayerHolder &xl, const std::string &build_dir) : KernelFunc(xl
     model_path = xl->get_attr("work_dir").get_string();
   }
 
+  // Runner pools are only supported through the VART API
+  if (nb_runners > 1)
+    pxWarning("DPU runner pools are not supported with the Vitis AI"
+              " DpuRunner API, using a single runner");
   auto dpu_runners = vitis::ai::DpuRunner::create_dpu_runner(model_path);
   dpu_runner_ = std::move(dpu_runners[0]);
 
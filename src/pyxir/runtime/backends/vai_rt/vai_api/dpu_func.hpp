@@ -28,11 +28,12 @@ namespace pyxir {
 namespace runtime {
 namespace vai_rt {
 
-class DpuFunc : public KernelFunc {
+class DpuFunc final : public KernelFunc {
 
   public:
     DpuFunc() {}
-    DpuFunc(XLayerHolder &xl, const std::string &build_dir);
+    DpuFunc(XLayerHolder &xl, const std::string &build_dir,
+            size_t nb_runners = 1);
     ~DpuFunc();
 
     void operator()(std::vector<XBufferHolder> &in_tensors,
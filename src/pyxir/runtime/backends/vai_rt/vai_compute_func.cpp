@@ -23,10 +23,7 @@
 #include "vai_compute_func.hpp"
 
 #include "pyxir/common/util.hpp"
-#include "../cpu/input.hpp"
-#include "../cpu/transpose.hpp"
-#include "../cpu/tuple_get_item.hpp"
-#include "../cpu/tuple.hpp"
+#include "pyxir/runtime/kernel_func_factory.hpp"
 
 
 namespace pyxir {
@@ -38,8 +35,9 @@ VaiComputeFunc::VaiComputeFunc(
   const std::string &target,
   const std::vector<std::string> &in_tensor_names,
   const std::vector<std::string> &out_tensor_names,
-  const std::string &build_dir)
-  : xg_(xg), target_(target), build_dir_(build_dir)
+  const std::string &build_dir,
+  RunOptionsHolder const &run_options)
+  : xg_(xg), target_(target), build_dir_(build_dir), run_options_(run_options)
 {
   pxDebug("Initialize VaiComputeFunc");
 
@@ -55,40 +53,83 @@ VaiComputeFunc::VaiComputeFunc(
   {
     XLayerHolder X = xg->get(xl_name);
 
+    KernelPlan plan;
+    const StaticKernelEntry *entry = nullptr;
     if (X->xtype[0] == "DPU" || X->xtype[0] == "DPUV1" || X->xtype[0] == "DPUV2") {
-      std::unique_ptr<KernelFunc> dpu_func(new DpuFunc(X, build_dir_)); 
+      size_t nb_dpu_runners = run_options_ ? run_options_->nb_dpu_runners : 1;
+      std::unique_ptr<KernelFunc> dpu_func(new DpuFunc(X, build_dir_, nb_dpu_runners));
       kernel_funcs_.push_back(std::move(dpu_func));
-    } else if (X->xtype[0] == "Input") {
-      // Skip input as it's an identity operation
-      std::unique_ptr<KernelFunc> input_func(new cpu::InputFunc(X));
-      kernel_funcs_.push_back(std::move(input_func));
-    } else if (X->xtype[0] == "TupleGetItem") {
-      std::unique_ptr<KernelFunc> tgi_func(new cpu::TupleGetItemFunc(X));
-      kernel_funcs_.push_back(std::move(tgi_func));
-    } else if (X->xtype[0] == "Tuple") {
-      std::unique_ptr<KernelFunc> tuple_func(new cpu::TupleFunc(X));
-      kernel_funcs_.push_back(std::move(tuple_func));
-    } else if (X->xtype[0] == "Transpose") {
-      std::unique_ptr<KernelFunc> transpose_func(new cpu::TransposeFunc(X));
-      kernel_funcs_.push_back(std::move(transpose_func));
+      plan.invoke = &invoke_kernel<DpuFunc>;
+      plan.async = true;
+    } else if (KernelFuncFactory::IsRegistered("cpu." + X->xtype[0])) {
+      // Kernels registered at runtime override the built-in ones
+      kernel_funcs_.push_back(
+        KernelFuncFactory::GetKernelFunc("cpu." + X->xtype[0], X));
+      plan.invoke = &invoke_virtual_kernel;
+      plan.async = true;
+    } else if ((entry = StaticKernelRegistry::Find(X->xtype[0]))) {
+      // Built-in CPU kernels are dispatched through the static table
+      kernel_funcs_.emplace_back(entry->create(X));
+      plan.invoke = entry->invoke;
+      plan.async = false;
     } else {
       throw std::invalid_argument("VAI Runtime got unsupported operation of"
                                   " type: " + X->xtype[0]);
     }
+
+    // Input layers read the tensor with their own name
+    if (X->bottoms.empty())
+      plan.in_slots.push_back(get_slot(X->name));
+    for (const std::string &itn : X->bottoms)
+      plan.in_slots.push_back(get_slot(itn));
+    plan.out_slot = get_slot(X->name);
+    kernel_plans_.push_back(std::move(plan));
+
     Xs_.push_back(X);
     // For timing tracking
-    total_kernel_times_.push_back(0);
+    total_kernel_times_.emplace_back(0);
   }
+
+  for (const std::string &itn : in_tensor_names_)
+    in_slots_.push_back(get_slot(itn));
+  for (const std::string &otn : out_tensor_names_)
+    out_slots_.push_back(get_slot(otn));
+}
+
+size_t VaiComputeFunc::get_slot(const std::string &tensor_name)
+{
+  auto it = slots_.find(tensor_name);
+  if (it != slots_.end())
+    return it->second;
+  size_t slot = slots_.size();
+  slots_[tensor_name] = slot;
+  return slot;
+}
+
+bool VaiComputeFunc::accepts_quantized_inputs()
+{
+#if defined(USE_VAI_RT_DPUCAHX8H) || (defined(USE_VAI_RT_DPUCZDX8G) && defined(USE_DPUCZDX8G_VART))
+  for (size_t i = 0; i < Xs_.size(); ++i) {
+    const std::string &op_type = Xs_[i]->xtype[0];
+    if (op_type == "DPU" || op_type == "DPUV1" || op_type == "DPUV2")
+      return static_cast<DpuFunc *>(kernel_funcs_[i].get())
+        ->accepts_quantized_inputs();
+    if (op_type != "Input" && op_type != "Transpose")
+      return false;
+  }
+#endif
+  // The DPU function of the older Vitis-AI API takes float inputs
+  return false;
 }
 
 VaiComputeFunc::~VaiComputeFunc() {
   if (is_verbose()) {
     std::cout << "---------------------" << std::endl;
     std::cout << "PX VAI COMPUTE FUNC TIMINGS: " << std::endl;
-    std::cout << "Total compute time: " << std::to_string(total_compute_time_) << std::endl;
+    std::cout << "Total compute time: " << std::to_string(total_compute_time_.load()) << std::endl;
     for (int i = 0; i < Xs_.size(); ++i) {
       std::cout << "Kernel " << std::to_string(i) << " time: " <<
-        std::to_string(total_kernel_times_[i]) << std::endl;
+        std::to_string(total_kernel_times_[i].load()) << std::endl;
     }
     std::cout << "---------------------" << std::endl;
   }
@@ -98,67 +139,109 @@ void VaiComputeFunc::operator()(
   std::vector<XBufferHolder> &in_tensors,
   std::vector<XBufferHolder> &out_tensors)
 {
-  auto start_vai = std::chrono::high_resolution_clock::now();
-  pxDebug("Inside VaiComputeFunc::()");
+  WaitFuncType wait = submit(in_tensors, out_tensors);
+  if (wait)
+    wait();
+}
 
-  std::unordered_map<std::string, std::vector<XBufferHolder>> int_res;
+WaitFuncType VaiComputeFunc::submit(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  auto start_vai = std::chrono::high_resolution_clock::now();
+  pxDebug("Inside VaiComputeFunc::submit");
 
-  for (int i = 0; i < in_tensors.size(); ++i) {
-    std::vector<XBufferHolder> in_v{in_tensors[i]};
-    int_res[in_tensor_names_[i]] = std::move(in_v);
-  }
+  // The intermediate results are shared with the completion function
+  std::shared_ptr<IntResSlots> int_res(new IntResSlots(slots_.size()));
 
-  for (int i = 0; i < out_tensors.size(); ++i) {
-    std::vector<XBufferHolder> out_v{out_tensors[i]};
-    int_res[out_tensor_names_[i]] = std::move(out_v);
-  }
+  for (size_t i = 0; i < in_tensors.size(); ++i)
+    (*int_res)[in_slots_[i]].assign(1, in_tensors[i]);
 
-  std::vector<XBufferHolder> dpu_in;
-  std::vector<XBufferHolder> dpu_out;
+  for (size_t i = 0; i < out_tensors.size(); ++i)
+    (*int_res)[out_slots_[i]].assign(1, out_tensors[i]);
 
   auto stop_init = std::chrono::high_resolution_clock::now();
   std::chrono::microseconds duration_init = std::chrono::duration_cast<std::chrono::microseconds>(stop_init-start_vai);
   pxDebug(("Init time: " + std::to_string(duration_init.count())).c_str());
 
-  for (int i = 0; i < Xs_.size(); ++i) {
-    auto start_k_begin = std::chrono::high_resolution_clock::now();
-    dpu_in.clear();
-    dpu_out.clear();
-    auto stop_clear = std::chrono::high_resolution_clock::now();
-    std::chrono::microseconds duration_clear = std::chrono::duration_cast<std::chrono::microseconds>(stop_clear-start_k_begin);
-    pxDebug(("Clear time: " + std::to_string(duration_clear.count())).c_str());
+  // Execute the kernels up to and including the first one that hands its
+  //  work to the accelerator, the remaining kernels run on completion
+  WaitFuncType kernel_wait;
+  size_t k = 0;
+  while (k < Xs_.size() && !kernel_wait)
+    kernel_wait = run_kernel(k++, *int_res, true);
+
+  std::vector<XBufferHolder> *out_ptr = &out_tensors;
+  auto complete = [this, int_res, out_ptr, k, start_vai]() {
+    for (size_t i = k; i < Xs_.size(); ++i)
+      run_kernel(i, *int_res, false);
+    sync_outputs(*int_res, *out_ptr);
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::chrono::microseconds vai_compute_time = std::chrono::duration_cast<std::chrono::microseconds>(stop-start_vai);
+    total_compute_time_ += vai_compute_time.count();
+    pxDebug(("Vai Compute Func Time: " + std::to_string(vai_compute_time.count())).c_str());
+  };
+
+  if (!kernel_wait) {
+    complete();
+    return WaitFuncType();
+  }
+  return [kernel_wait, complete]() {
+    kernel_wait();
+    complete();
+  };
+}
 
-    XLayerHolder &X = Xs_[i];
+WaitFuncType VaiComputeFunc::run_kernel(size_t i, IntResSlots &int_res,
+                                        bool async)
+{
+  auto start_k_begin = std::chrono::high_resolution_clock::now();
+  std::vector<XBufferHolder> dpu_in;
+  std::vector<XBufferHolder> dpu_out;
 
-    if (X->bottoms.empty())
-      dpu_in.insert(dpu_in.end(), int_res[X->name].begin(),  int_res[X->name].end());
+  const KernelPlan &plan = kernel_plans_[i];
+  for (size_t slot : plan.in_slots)
+    dpu_in.insert(dpu_in.end(), int_res[slot].begin(), int_res[slot].end());
+  dpu_out = int_res[plan.out_slot];
+
+  auto start_k = std::chrono::high_resolution_clock::now();
+  WaitFuncType wait;
+  if (async && plan.async)
+    wait = kernel_funcs_[i]->submit(dpu_in, dpu_out);
+  else
+    plan.invoke(kernel_funcs_[i].get(), dpu_in, dpu_out);
+  auto stop_k = std::chrono::high_resolution_clock::now();
+
+  std::chrono::microseconds duration_kernel = std::chrono::duration_cast<std::chrono::microseconds>(stop_k-start_k);
+  pxDebug(("Kernel time: " + std::to_string(duration_kernel.count())).c_str());
+  std::chrono::microseconds duration = std::chrono::duration_cast<std::chrono::microseconds>(stop_k-start_k_begin);
+  pxDebug(("Time: " + std::to_string(duration.count())).c_str());
+  total_kernel_times_[i] += duration.count();
+
+  // Asynchronous kernels allocate their outputs on submission
+  int_res[plan.out_slot] = std::move(dpu_out);
+  return wait;
+}
 
-    for (const std::string &itn : X->bottoms)
-      dpu_in.insert(dpu_in.end(), int_res[itn].begin(),  int_res[itn].end());
-
-    // for (const std::string &otn : X->tops) {
-    const std::string &otn = X->name;
-    if (int_res.find(otn) != int_res.end())
-      dpu_out.insert(dpu_out.end(), int_res[otn].begin(), int_res[otn].end());
-    
-    auto start_k = std::chrono::high_resolution_clock::now();
-    kernel_funcs_[i]->operator()(dpu_in, dpu_out);
-    auto stop_k = std::chrono::high_resolution_clock::now();
-
-    std::chrono::microseconds duration_kernel = std::chrono::duration_cast<std::chrono::microseconds>(stop_k-start_k);
-    pxDebug(("Kernel time: " + std::to_string(duration_kernel.count())).c_str());
-    std::chrono::microseconds duration = std::chrono::duration_cast<std::chrono::microseconds>(stop_k-start_k_begin);
-    pxDebug(("Time: " + std::to_string(duration.count())).c_str());
-    total_kernel_times_[i] += duration.count();
-
-    int_res[otn] = dpu_out;
+void VaiComputeFunc::sync_outputs(IntResSlots &int_res,
+                                  std::vector<XBufferHolder> &out_tensors)
+{
+  // Results should end up in place in the caller provided output buffers. If
+  //  a kernel returned a different buffer (e.g. identity operations), we copy
+  //  the data. If no output buffers were provided, we return the result buffers.
+  const size_t nb_provided = out_tensors.size();
+  for (size_t i = 0; i < out_tensor_names_.size(); ++i) {
+    XBufferHolder &res = int_res[out_slots_[i]][0];
+    if (i >= nb_provided) {
+      out_tensors.push_back(res);
+    } else if (res->data != out_tensors[i]->data) {
+      if (res->size * res->itemsize != out_tensors[i]->size * out_tensors[i]->itemsize)
+        throw std::invalid_argument("VAI Runtime: provided output buffer for `"
+                                    + out_tensor_names_[i] + "` has wrong size");
+      copy_buffer(*res, *out_tensors[i]);
+    }
   }
-
-  auto stop = std::chrono::high_resolution_clock::now();
-
-  std::chrono::microseconds vai_compute_time = std::chrono::duration_cast<std::chrono::microseconds>(stop-start_vai);
-  total_compute_time_ += vai_compute_time.count();
-  pxDebug(("Vai Compute Func Time: " + std::to_string(vai_compute_time.count())).c_str());
 }
 
 } // vai_rt
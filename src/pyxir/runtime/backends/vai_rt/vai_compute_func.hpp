@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
 
 #if defined(USE_VAI_RT_DPUCADX8G) || (defined(USE_VAI_RT_DPUCZDX8G) && !defined(USE_DPUCZDX8G_VART))
@@ -28,6 +31,8 @@
 
 #include "pyxir/graph/xgraph.hpp"
 #include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/run_options.hpp"
+#include "pyxir/runtime/static_kernel_registry.hpp"
 
 void vaiDebugMsg(const char *, const char *, const char *, int);
 #ifdef DEBUG
@@ -47,12 +52,27 @@ class VaiComputeFunc {
                    const std::string &target,
                    const std::vector<std::string> &in_tensor_names,
                    const std::vector<std::string> &out_tensor_names,
-                   const std::string &build_dir);
+                   const std::string &build_dir,
+                   RunOptionsHolder const &run_options = nullptr);
     ~VaiComputeFunc();
 
     void operator()(std::vector<XBufferHolder> &in_tensors,
                     std::vector<XBufferHolder> &out_tensors);
 
+    /**
+     * @brief Execute the kernels up to the DPU, submit the DPU work and return
+     *  a function that waits for the DPU and runs the remaining kernels
+     */
+    WaitFuncType submit(std::vector<XBufferHolder> &in_tensors,
+                        std::vector<XBufferHolder> &out_tensors);
+
+    /**
+     * @brief Return whether the inputs may be int8 fix point data, i.e.
+     *  whether they reach DPU runners taking int8 inputs through data
+     *  movement kernels only
+     */
+    bool accepts_quantized_inputs();
+
     /** @brief Return whether the give operation type is supported */
     bool is_op_supported(const std::string &op_type)
     {
@@ -60,6 +80,31 @@ class VaiComputeFunc {
     }
 
   private:
+    /** @brief The intermediate results, indexed by tensor slot */
+    typedef std::vector<std::vector<XBufferHolder>> IntResSlots;
+
+    /**
+     * @brief The precomputed execution step of a kernel: the slots of its
+     *  input and output tensors, the entry point to invoke it with and
+     *  whether it may hand off its work asynchronously
+     */
+    struct KernelPlan {
+      std::vector<size_t> in_slots;
+      size_t out_slot;
+      KernelInvokeFunc invoke;
+      bool async;
+    };
+
+    /** @brief Return the slot of the given tensor, adding it if needed */
+    size_t get_slot(const std::string &tensor_name);
+
+    /** @brief Execute kernel i on the intermediate results, asynchronously
+        if the kernel supports it */
+    WaitFuncType run_kernel(size_t i, IntResSlots &int_res, bool async);
+
+    /** @brief Move the final results into the output buffers */
+    void sync_outputs(IntResSlots &int_res, std::vector<XBufferHolder> &out_tensors);
+
     /** @brief The XGraph */
     XGraphHolder xg_;
     /** @brief The target */
@@ -70,27 +115,39 @@ class VaiComputeFunc {
     std::vector<std::string> out_tensor_names_;
     /** @brief The build directory containing the DPU build files */
     std::string build_dir_;
+    /** @brief The runtime options */
+    RunOptionsHolder run_options_;
     /** @brief The connection between outside and internal input tensor order */
     std::vector<int> in_tensor_order_;
     /** @brief The connection between outside and internal output tensor order */
     std::vector<int> out_tensor_order_;
     /** @brief The supported operations by this VAI compute function */
     std::unordered_set<std::string> supported_ops_ =
-      {"Input", "Output", "DPUV1", "DPUV2", "DPU", "Tuple", "TupleGetItem", "Transpose"};
+      {"Input", "Output", "DPUV1", "DPUV2", "DPU", "Tuple", "TupleGetItem", "Transpose",
+       "Softmax", "NMS", "TopK", "ArgMax", "GSTiling", "YoloDecode"};
     /** @brief In order container for the internal kernel functions */
     std::vector<std::unique_ptr<KernelFunc>> kernel_funcs_;
     /** @brief In order container for the XLayers */
     std::vector<XLayerHolder> Xs_;
+    /** @brief In order container for the kernel execution plans */
+    std::vector<KernelPlan> kernel_plans_;
+    /** @brief The tensor slots, only used while building the plans */
+    std::unordered_map<std::string, size_t> slots_;
+    /** @brief The slots of the input tensors */
+    std::vector<size_t> in_slots_;
+    /** @brief The slots of the output tensors */
+    std::vector<size_t> out_slots_;
     /** @brief The DPU function wrapping Vitis-AI runtime APIs*/
     DpuFunc dpu_func_;
     /** @brief The DPU layer */
     XLayerHolder dpu_X_;
 
     // VERBOSE
-    /** @brief Keep track of total time spent in operator() */
-    int64_t total_compute_time_ = 0;
+    /** @brief Keep track of total time spent in operator(), updated from
+        concurrent requests and completion threads */
+    std::atomic<int64_t> total_compute_time_{0};
     /** @brief Keep track of kernel timings */
-    std::vector<int64_t> total_kernel_times_;
+    std::deque<std::atomic<int64_t>> total_kernel_times_;
 };
 
 } // vai_rt
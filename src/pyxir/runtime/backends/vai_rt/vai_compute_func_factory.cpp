@@ -73,7 +73,8 @@ ComputeFuncHolder VaiComputeFuncFactoryImpl::get_compute_func(
                     &out_tensor_names, &run_options](FuncState *state) 
   {
     auto *vai_cf = new VaiComputeFunc(
-      scheduled_xg, target, in_tensor_names, out_tensor_names, run_options->build_dir
+      scheduled_xg, target, in_tensor_names, out_tensor_names, run_options->build_dir,
+      run_options
     );
     *state = vai_cf;
     return 0;
@@ -94,6 +95,28 @@ ComputeFuncHolder VaiComputeFuncFactoryImpl::get_compute_func(
     (*vai_cf)(in_tensors, out_tensors);
   };
 
+  cfi.submit_func = [](FuncState state,
+                       std::vector<pyxir::XBufferHolder> &in_tensors,
+                       std::vector<pyxir::XBufferHolder> &out_tensors)
+  {
+    VaiComputeFunc* vai_cf =
+      reinterpret_cast<VaiComputeFunc*>(state);
+    return vai_cf->submit(in_tensors, out_tensors);
+  };
+
+#if defined(USE_VAI_RT_DPUCAHX8H) || (defined(USE_VAI_RT_DPUCZDX8G) && defined(USE_DPUCZDX8G_VART))
+  // Concurrent requests take their own DPU runners and scratch buffers, the
+  //  DPU function of the older Vitis-AI API shares a single runner
+  cfi.reentrant = true;
+#endif
+
+  cfi.quantized_inputs_func = [](FuncState state)
+  {
+    VaiComputeFunc* vai_cf =
+      reinterpret_cast<VaiComputeFunc*>(state);
+    return vai_cf->accepts_quantized_inputs();
+  };
+
   ComputeFuncHolder cf(new StatefulComputeFunc(cfi));
 
   return cf;
@@ -26,7 +26,8 @@ namespace pyxir {
 namespace runtime {
 namespace vai_rt {
 
-DpuFunc::DpuFunc(XLayerHolder &xl, const std::string &build_dir) : KernelFunc(xl)
+DpuFunc::DpuFunc(XLayerHolder &xl, const std::string &build_dir,
+                 size_t nb_runners) : KernelFunc(xl)
 {
   std::vector<std::string> dpu_in_tensor_names = xl->bottoms;
   std::vector<std::string> dpu_internal_in_tensor_names = xl->get_attr("input_names").get_strings();
@@ -58,11 +59,20 @@ DpuFunc::DpuFunc(XLayerHolder &xl, const std::string &build_dir) : KernelFunc(xl
       << "model should have one and only one dpu subgraph.";
 
   LOG(INFO) << "create running for subgraph: " << subgraph_[0]->get_name();
-  /*create runner*/
-  runner_ = vart::Runner::create_runner(subgraph_[0], "run");
+  /*create runners*/
+  nb_runners = std::max<size_t>(nb_runners, 1);
+  for (size_t i = 0; i < nb_runners; ++i)
+    runners_.push_back(vart::Runner::create_runner(subgraph_[0], "run"));
 
-  dpu_runner_in_tensors_ = runner_->get_input_tensors();
-  dpu_runner_out_tensors_ = runner_->get_output_tensors();
+  dpu_runner_in_tensors_ = runners_[0]->get_input_tensors();
+  dpu_runner_out_tensors_ = runners_[0]->get_output_tensors();
+  runner_batch_ = dpu_runner_in_tensors_[0]->get_shape()[0];
+  quantized_inputs_ = std::all_of(
+    dpu_runner_in_tensors_.begin(), dpu_runner_in_tensors_.end(),
+    [](const xir::Tensor *t) {
+      return t->get_data_type().type == xir::DataType::XINT
+        && t->get_data_type().bit_width == 8;
+    });
   assert(dpu_runner_in_tensors_.size() == dpu_in_tensor_names.size());
   assert(dpu_runner_out_tensors_.size() == dpu_out_tensor_names.size());
 
@@ -145,9 +155,9 @@ DpuFunc::~DpuFunc() {
   {
     std::cout << "---------------------" << std::endl;
     std::cout << "PX DPU FUNC TIMINGS: " << std::endl;
-    std::cout << "Total DPU time: " << std::to_string(total_dpu_time_) << std::endl;
-    std::cout << "Total async time: " << std::to_string(total_async_time_) << std::endl;
-    std::cout << "Total wait time: " << std::to_string(total_wait_time_) << std::endl;
+    std::cout << "Total DPU time: " << std::to_string(total_dpu_time_.load()) << std::endl;
+    std::cout << "Total async time: " << std::to_string(total_async_time_.load()) << std::endl;
+    std::cout << "Total wait time: " << std::to_string(total_wait_time_.load()) << std::endl;
     std::cout << "---------------------" << std::endl;
   }
 }
@@ -156,64 +166,192 @@ void DpuFunc::operator()(
   std::vector<XBufferHolder> &in_tensors,
   std::vector<XBufferHolder> &out_tensors)
 {
-  auto inputTensors = runner_->get_input_tensors();
-  auto outputTensors = runner_->get_output_tensors();
+  auto start = std::chrono::high_resolution_clock::now();
+  const ssize_t batch = in_tensors[0]->shape[0];
 
-  std::vector<std::unique_ptr<vart::TensorBuffer>> inputs, outputs;
+  // Results are written in place into the provided (bound) output buffers,
+  //  output buffers are only allocated if none are provided
+  if (out_tensors.empty()) {
+    for (const auto &shape : xl_->shapes) {
+      std::vector<ssize_t> buffer_shape = shape;
+      buffer_shape[0] = batch;
+      out_tensors.push_back(create_buffer(buffer_shape));
+    }
+  }
+
+  // Split large batches in runner sized chunks that are executed
+  //  concurrently over the runner pool. The chunks are batch views on the
+  //  provided buffers so the results are gathered in place. Concurrent
+  //  small requests are spread over the runners like in submit.
+  dispatch_to_runners(in_tensors, out_tensors, runner_batch_, runners_.size(),
+    [this](size_t runner_idx, std::vector<XBufferHolder> &in_chunk,
+           std::vector<XBufferHolder> &out_chunk) {
+      run_chunk(runner_idx, in_chunk, out_chunk);
+    }, next_runner_++ % runners_.size(), dispatch_workers_);
+
+  auto stop = std::chrono::high_resolution_clock::now();
+  total_dpu_time_ += std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+}
+
+WaitFuncType DpuFunc::submit(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  const ssize_t batch = in_tensors[0]->shape[0];
+  // Large batches are split over the runner pool synchronously
+  if (batch > runner_batch_) {
+    (*this)(in_tensors, out_tensors);
+    return WaitFuncType();
+  }
+  if (out_tensors.empty()) {
+    for (const auto &shape : xl_->shapes) {
+      std::vector<ssize_t> buffer_shape = shape;
+      buffer_shape[0] = batch;
+      out_tensors.push_back(create_buffer(buffer_shape));
+    }
+  }
+  // Spread in flight requests over the runner pool
+  size_t runner_idx = next_runner_++ % runners_.size();
+  return submit_chunk(runner_idx, in_tensors, out_tensors);
+}
+
+void DpuFunc::run_chunk(
+  size_t runner_idx,
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  submit_chunk(runner_idx, in_tensors, out_tensors)();
+}
+
+std::shared_ptr<DpuFunc::ScratchBuffers> DpuFunc::acquire_scratch(
+  vart::Runner *runner)
+{
+  {
+    std::lock_guard<std::mutex> lock(scratch_mtx_);
+    if (!scratch_pool_.empty()) {
+      std::shared_ptr<ScratchBuffers> scratch = scratch_pool_.back();
+      scratch_pool_.pop_back();
+      return scratch;
+    }
+  }
+  std::shared_ptr<ScratchBuffers> scratch(new ScratchBuffers());
+  for (const auto &iTensor : runner->get_input_tensors()) {
+    const auto &dims = iTensor->get_shape();
+    scratch->in.push_back(create_buffer(std::vector<ssize_t>(dims.begin(), dims.end())));
+  }
+  for (const auto &oTensor : runner->get_output_tensors()) {
+    const auto &dims = oTensor->get_shape();
+    scratch->out.push_back(create_buffer(std::vector<ssize_t>(dims.begin(), dims.end())));
+  }
+  return scratch;
+}
+
+void DpuFunc::release_scratch(const std::shared_ptr<ScratchBuffers> &scratch)
+{
+  std::lock_guard<std::mutex> lock(scratch_mtx_);
+  scratch_pool_.push_back(scratch);
+}
+
+WaitFuncType DpuFunc::submit_chunk(
+  size_t runner_idx,
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  vart::Runner *runner = runners_[runner_idx].get();
+  auto inputTensors = runner->get_input_tensors();
+  auto outputTensors = runner->get_output_tensors();
+  const ssize_t batch = in_tensors[0]->shape[0];
+
+  // If the provided batch doesn't match the runner batch size, we go through
+  //  runner sized scratch buffers. Every chunk takes its own set from the
+  //  scratch pool and hands it back once the job is done
+  const bool use_scratch = batch != runner_batch_;
+  std::shared_ptr<ScratchBuffers> scratch;
+  if (use_scratch)
+    scratch = acquire_scratch(runner);
+
+  std::vector<std::shared_ptr<vart::TensorBuffer>> inputs, outputs;
   std::vector<vart::TensorBuffer*> inputsPtr, outputsPtr;
   std::vector<std::shared_ptr<xir::Tensor>> batchTensors;
+  // Inputs can be strided views (e.g. a batch slice) and are only packed if
+  //  they are not contiguous
+  std::vector<XBufferHolder> packed_in;
   int in_idx = 0;
-  for(const auto& iTensor: inputTensors) {
-	  const auto& in_dims = iTensor->get_shape();
-	  batchTensors.push_back(std::shared_ptr<xir::Tensor>(xir::Tensor::create(iTensor->get_name(), in_dims, xir::DataType{xir::DataType::FLOAT, sizeof(float) * 8u})));
-    inputsPtr.push_back(new CpuFlatTensorBuffer(in_tensors[in_idx]->data, batchTensors.back().get()));
-    in_idx++;
-  }
-  std::vector<XBufferHolder> out_tensors_local;
-  if (out_tensors_local.empty())
-  {
-    for (const auto &shape : xl_->shapes)
-    {
-      std::vector<ssize_t> buffer_shape = shape;
-      buffer_shape[0] = inputTensors[0]->get_shape()[0];
-      out_tensors_local.push_back(create_buffer(buffer_shape));
+  for (const auto &iTensor : inputTensors) {
+    const auto &in_dims = iTensor->get_shape();
+    // Float inputs are converted by the runner, int8 inputs (e.g. quantized
+    //  by the input stage) are already in the runner's fix point format
+    const ssize_t in_itemsize = in_tensors[in_idx]->itemsize;
+    if (in_itemsize == 1 && !quantized_inputs_)
+      throw std::invalid_argument("DPU in tensor: " + iTensor->get_name()
+                                  + " doesn't take int8 data");
+    if (in_itemsize != 1 && in_itemsize != sizeof(float))
+      throw std::invalid_argument("DPU in tensor: " + iTensor->get_name()
+                                  + " expects float or int8 data");
+    xir::DataType in_type = in_itemsize == 1 ? iTensor->get_data_type()
+      : xir::DataType{xir::DataType::FLOAT, sizeof(float) * 8u};
+    batchTensors.push_back(std::shared_ptr<xir::Tensor>(xir::Tensor::create(iTensor->get_name(), in_dims, in_type)));
+    // Contiguous inputs, e.g. the input stage outputs, are wrapped as the
+    //  runner input buffers so the runner reads them in place
+    packed_in.push_back(ascontiguous(in_tensors[in_idx]));
+    void *in_data = packed_in.back()->data;
+    if (use_scratch) {
+      XBufferHolder &in_scratch = scratch->in[in_idx];
+      size_t valid = std::min(in_scratch->size, in_tensors[in_idx]->size)
+        * in_itemsize;
+      memcpy(in_scratch->data, in_data, valid);
+      in_data = in_scratch->data;
     }
+    inputs.push_back(std::make_shared<CpuFlatTensorBuffer>(in_data, batchTensors.back().get()));
+    inputsPtr.push_back(inputs.back().get());
+    in_idx++;
   }
 
+  // Strided output views are written through a contiguous buffer
+  std::vector<XBufferHolder> packed_out(outputTensors.size());
+  std::vector<XBufferHolder> outs(outputTensors.size());
   int out_idx = 0;
   for (const auto &oTensor : outputTensors)
   {
     const auto &out_dims = oTensor->get_shape();
     batchTensors.push_back(std::shared_ptr<xir::Tensor>(xir::Tensor::create(oTensor->get_name(), out_dims, xir::DataType{xir::DataType::FLOAT, sizeof(float) * 8u})));
-    outputsPtr.push_back(new CpuFlatTensorBuffer(out_tensors_local[out_tensor_order_[out_idx]]->data, batchTensors.back().get()));
+    XBufferHolder &out = out_tensors[out_tensor_order_[out_idx]];
+    outs[out_idx] = out;
+    if (!out->is_contiguous())
+      packed_out[out_idx] = create_buffer(out->shape, out->itemsize, out->format);
+    void *out_data = use_scratch ? scratch->out[out_idx]->data
+                                 : (packed_out[out_idx] ? packed_out[out_idx]
+                                                        : out)->data;
+    outputs.push_back(std::make_shared<CpuFlatTensorBuffer>(out_data, batchTensors.back().get()));
+    outputsPtr.push_back(outputs.back().get());
     out_idx++;
   }
-  auto job_id = runner_->execute_async(inputsPtr, outputsPtr);
-  runner_->wait(job_id.first, -1);
-  out_idx = 0;
-  if (out_tensors.empty())
-  {
-    for (const auto &shape : xl_->shapes)
-    {
-      std::vector<ssize_t> buffer_shape = shape;
-      buffer_shape[0] = in_tensors[0]->shape[0];
-      pyxir::XBufferHolder xb_out = std::shared_ptr<pyxir::XBuffer>(new pyxir::XBuffer((void *)out_tensors_local[out_idx]->data, 4, "f", buffer_shape.size(), buffer_shape, true, true));
-      out_tensors.push_back(xb_out);
-      out_idx++;
-    }
-  }
-  for (int i = 0; i < inputsPtr.size(); ++i)
-  {
-    delete inputsPtr[i];
-  }
+  auto start_async = std::chrono::high_resolution_clock::now();
+  auto job_id = runner->execute_async(inputsPtr, outputsPtr);
+  auto stop_async = std::chrono::high_resolution_clock::now();
+  total_async_time_ += std::chrono::duration_cast<std::chrono::microseconds>(stop_async - start_async).count();
 
-  for (int i = 0; i < outputsPtr.size(); ++i)
-  {
-    delete outputsPtr[i];
-  }
+  // The returned function keeps all buffers alive until the job is done
+  return [this, runner, job_id, inputs, outputs, batchTensors, packed_in,
+          packed_out, outs, scratch, stop_async]() {
+    runner->wait(job_id.first, -1);
+    auto stop_wait = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < outs.size(); ++i) {
+      const XBufferHolder &dst = packed_out[i] ? packed_out[i] : outs[i];
+      if (scratch) {
+        size_t valid = std::min(dst->size, scratch->out[i]->size) * 4;
+        memcpy(dst->data, scratch->out[i]->data, valid);
+      }
+      if (packed_out[i])
+        copy_buffer(*packed_out[i], *outs[i]);
+    }
+    if (scratch)
+      release_scratch(scratch);
+    total_wait_time_ += std::chrono::duration_cast<std::chrono::microseconds>(stop_wait - stop_async).count();
+  };
 }
 
 } // vai_rt
 } // namespace runtime
 } // namespace pyxir
-
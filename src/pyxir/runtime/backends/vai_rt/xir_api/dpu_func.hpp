@@ -16,29 +16,66 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <unordered_set>
 
 #include "pyxir/pyxir_api.hpp"
 #include "pyxir/graph/xlayer.hpp"
 #include "pyxir/common/xbuffer.hpp"
 #include "pyxir/runtime/kernel_func.hpp"
+#include "pyxir/runtime/batch_dispatch.hpp"
 #include "common.hpp"
 
 namespace pyxir {
 namespace runtime {
 namespace vai_rt {
 
-class DpuFunc : public KernelFunc {
+class DpuFunc final : public KernelFunc {
 
   public:
     DpuFunc() {}
-    DpuFunc(XLayerHolder &xl, const std::string &build_dir);
+    DpuFunc(XLayerHolder &xl, const std::string &build_dir,
+            size_t nb_runners = 1);
     ~DpuFunc();
 
     void operator()(std::vector<XBufferHolder> &in_tensors,
                     std::vector<XBufferHolder> &out_tensors);
 
+    /** @brief Submit the DPU job and return a function waiting for it */
+    WaitFuncType submit(std::vector<XBufferHolder> &in_tensors,
+                        std::vector<XBufferHolder> &out_tensors);
+
+    /** @brief Return whether the runners take int8 fix point inputs, which
+        are then passed to them without conversion */
+    bool accepts_quantized_inputs() const { return quantized_inputs_; }
+
   private:
+    /** @brief Runner sized input and output buffers for chunks that don't
+        match the runner batch size */
+    struct ScratchBuffers {
+      std::vector<XBufferHolder> in;
+      std::vector<XBufferHolder> out;
+    };
+
+    /** @brief Execute a batch of at most the runner batch size on the given runner */
+    void run_chunk(size_t runner_idx,
+                   std::vector<XBufferHolder> &in_tensors,
+                   std::vector<XBufferHolder> &out_tensors);
+
+    /** @brief Submit a batch of at most the runner batch size to the given
+        runner and return a function waiting for its completion */
+    WaitFuncType submit_chunk(size_t runner_idx,
+                              std::vector<XBufferHolder> &in_tensors,
+                              std::vector<XBufferHolder> &out_tensors);
+
+    /** @brief Take a set of scratch buffers from the pool, allocating a new
+        set if all of them are in use */
+    std::shared_ptr<ScratchBuffers> acquire_scratch(vart::Runner *runner);
+
+    /** @brief Return a set of scratch buffers to the pool */
+    void release_scratch(const std::shared_ptr<ScratchBuffers> &scratch);
+
 
     /** @brief The names of the input tensor in the order that they will be provided */
     std::vector<std::string> in_tensor_names_;
@@ -58,16 +95,29 @@ class DpuFunc : public KernelFunc {
     std::unique_ptr<xir::Graph> graph_;
     /** @brief Holder for Subgraph. This will be extracted from XIR graph*/
     std::vector<const xir::Subgraph*> subgraph_;
-    /** @brief Holder for the DPU runner that will be created using Vitis AI API's */
-    std::unique_ptr<vart::Runner> runner_;
+    /** @brief The pool of DPU runners created using Vitis AI API's. Large
+        batches are split in runner sized chunks over these runners */
+    std::vector<std::unique_ptr<vart::Runner>> runners_;
+    /** @brief The batch size of the DPU runners */
+    ssize_t runner_batch_;
+    /** @brief Whether all DPU input tensors are int8 fix point tensors */
+    bool quantized_inputs_ = false;
+    /** @brief Round robin counter for assigning in flight requests to runners */
+    std::atomic<size_t> next_runner_{0};
+    /** @brief The persistent threads executing the chunks of large batches */
+    DispatchWorkers dispatch_workers_;
+    /** @brief The idle scratch buffer sets, concurrent chunks each use
+        their own set */
+    std::vector<std::shared_ptr<ScratchBuffers>> scratch_pool_;
+    std::mutex scratch_mtx_;
 
     // VERBOSE
     /** @brief The total time spent in async DPU call */
-    int64_t total_async_time_ = 0;
+    std::atomic<int64_t> total_async_time_{0};
     /** @brief The total time spent in wait DPU call */
-    int64_t total_wait_time_ = 0;
+    std::atomic<int64_t> total_wait_time_{0};
     /** @brief The total time spent in operator() call */
-    int64_t total_dpu_time_ = 0;
+    std::atomic<int64_t> total_dpu_time_{0};
 };
 
 } // vai_rt
@@ -0,0 +1,170 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+// Register the fix point quantization simulation kernels as Opaque Functions
+//  so the Python runtimes can execute quantization simulation layers natively
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "pyxir/opaque_func_registry.hpp"
+#include "pyxir/runtime/kernel_func_factory.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+using graph::XAttr;
+using graph::XLayer;
+
+namespace {
+
+// Read a small parameter buffer (e.g. thresholds) as doubles
+std::vector<double> get_float_params(const XBuffer &xb)
+{
+  std::vector<double> res(xb.size);
+  for (ssize_t i = 0; i < xb.size; ++i) {
+    if (xb.format == "d" && xb.itemsize == 8)
+      res[i] = ((const double *) xb.data)[i];
+    else if (xb.format == "f" && xb.itemsize == 4)
+      res[i] = ((const float *) xb.data)[i];
+    else
+      throw std::invalid_argument("Fix point opaque funcs: expected float"
+                                  " parameters but got format `"
+                                  + xb.format + "`");
+  }
+  return res;
+}
+
+// Read a small parameter buffer (e.g. scales and shifts) as int64
+std::vector<int64_t> get_int_params(const XBuffer &xb)
+{
+  std::vector<int64_t> res(xb.size);
+  for (ssize_t i = 0; i < xb.size; ++i) {
+    if (xb.itemsize == 8 && xb.format != "d")
+      res[i] = ((const int64_t *) xb.data)[i];
+    else if (xb.itemsize == 4 && xb.format != "f")
+      res[i] = ((const int32_t *) xb.data)[i];
+    else
+      throw std::invalid_argument("Fix point opaque funcs: expected integer"
+                                  " parameters but got format `"
+                                  + xb.format + "`");
+  }
+  return res;
+}
+
+// The dtype attribute of a fix point layer writing to the given buffer
+std::string get_dtype_attr(const XBuffer &xb)
+{
+  if (xb.itemsize == 1)
+    return "int8";
+  if (xb.itemsize == 4 && xb.format != "f")
+    return "int32";
+  return "float32";
+}
+
+// Run the kernel of the given fix point layer on the data input and write
+//  the result into the provided output buffer
+void run_kernel(const std::string &op_type, XLayerHolder &X,
+                std::vector<XBufferHolder> &in_tensors,
+                std::vector<XBufferHolder> &out_tensors)
+{
+  if (in_tensors.empty() || out_tensors.size() != 1)
+    throw std::invalid_argument(op_type + ": expects data inputs and one"
+                                " output buffer");
+  X->shapes = {std::vector<int64_t>(in_tensors[0]->shape.begin(),
+                                    in_tensors[0]->shape.end())};
+  X->set_attr("dtype", XAttr("dtype", get_dtype_attr(*out_tensors[0])));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu." + op_type, X);
+  std::vector<XBufferHolder> in {in_tensors[0]};
+  (*kf)(in, out_tensors);
+}
+
+XLayerHolder make_xlayer(const std::string &op_type)
+{
+  return XLayerHolder(new XLayer("px_globals_" + op_type,
+                                 std::vector<std::string>{op_type}));
+}
+
+} // namespace
+
+// Quantize: in [data, thresholds], params [axis, bitwidth]
+REGISTER_OPAQUE_FUNC("px.globals.Quantize")
+  ->set_func([](pyxir::OpaqueArgs &args)
+    {
+      std::vector<XBufferHolder> &in = args[0]->get_xbuffers();
+      std::vector<int64_t> &params = args[2]->get_ints();
+      XLayerHolder X = make_xlayer("Quantize");
+      X->set_attr("quant_threshold",
+                  XAttr("quant_threshold", get_float_params(*in.at(1))));
+      X->set_attr("axis", XAttr("axis", (int) params.at(0)));
+      X->set_attr("quant_bitwidth", XAttr("quant_bitwidth", (int) params.at(1)));
+      run_kernel("Quantize", X, in, args[1]->get_xbuffers());
+    }, std::vector<pxTypeCode>{pxVXBufferHandle, pxVXBufferHandle, pxVInt});
+
+// UnQuantize: in [data, thresholds], params [axis, bitwidth]
+REGISTER_OPAQUE_FUNC("px.globals.UnQuantize")
+  ->set_func([](pyxir::OpaqueArgs &args)
+    {
+      std::vector<XBufferHolder> &in = args[0]->get_xbuffers();
+      std::vector<int64_t> &params = args[2]->get_ints();
+      XLayerHolder X = make_xlayer("UnQuantize");
+      X->set_attr("quant_threshold",
+                  XAttr("quant_threshold", get_float_params(*in.at(1))));
+      X->set_attr("axis", XAttr("axis", (int) params.at(0)));
+      X->set_attr("quant_bitwidth", XAttr("quant_bitwidth", (int) params.at(1)));
+      run_kernel("UnQuantize", X, in, args[1]->get_xbuffers());
+    }, std::vector<pxTypeCode>{pxVXBufferHandle, pxVXBufferHandle, pxVInt});
+
+// QuantizeBias: in [bias, input threshold, weight thresholds],
+//  params [bitwidth]
+REGISTER_OPAQUE_FUNC("px.globals.QuantizeBias")
+  ->set_func([](pyxir::OpaqueArgs &args)
+    {
+      std::vector<XBufferHolder> &in = args[0]->get_xbuffers();
+      std::vector<int64_t> &params = args[2]->get_ints();
+      XLayerHolder X = make_xlayer("QuantizeBias");
+      X->set_attr("quant_threshold",
+                  XAttr("quant_threshold", get_float_params(*in.at(1))));
+      X->set_attr("quant_th_params",
+                  XAttr("quant_th_params", get_float_params(*in.at(2))));
+      X->set_attr("quant_bitwidth", XAttr("quant_bitwidth", (int) params.at(0)));
+      run_kernel("QuantizeBias", X, in, args[1]->get_xbuffers());
+    }, std::vector<pxTypeCode>{pxVXBufferHandle, pxVXBufferHandle, pxVInt});
+
+// QuantizeInter: in [accumulators, scales, postscale shifts],
+//  params [axis, bitwidth, relu]
+REGISTER_OPAQUE_FUNC("px.globals.QuantizeInter")
+  ->set_func([](pyxir::OpaqueArgs &args)
+    {
+      std::vector<XBufferHolder> &in = args[0]->get_xbuffers();
+      std::vector<int64_t> &params = args[2]->get_ints();
+      XLayerHolder X = make_xlayer("QuantizeInter");
+      X->set_attr("quant_scale",
+                  XAttr("quant_scale", get_int_params(*in.at(1))));
+      X->set_attr("quant_postscale_shift",
+                  XAttr("quant_postscale_shift", get_int_params(*in.at(2))));
+      X->set_attr("axis", XAttr("axis", (int) params.at(0)));
+      X->set_attr("quant_bitwidth", XAttr("quant_bitwidth", (int) params.at(1)));
+      if (params.at(2))
+        X->set_attr("activation", XAttr("activation", std::string("ReLU")));
+      run_kernel("QuantizeInter", X, in, args[1]->get_xbuffers());
+    }, std::vector<pxTypeCode>{pxVXBufferHandle, pxVXBufferHandle, pxVInt});
+
+} // namespace runtime
+} // namespace pyxir
@@ -0,0 +1,585 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "pyxir/pyxir_api.hpp"
+#include "pyxir/runtime/inference_server.hpp"
+
+namespace pyxir {
+namespace runtime {
+
+namespace {
+
+// Protocol: on connection the server sends the input and output shapes,
+//  the client creates a shared memory ring of request slots and sends the
+//  number of slots and the segment path, the server maps the segment and
+//  acknowledges. Afterwards the client sends slot indices of submitted
+//  requests and the server replies with the slot index and a status.
+
+const size_t SLOT_ALIGNMENT = 64;
+
+enum ReplyStatus : int32_t { STATUS_OK = 0, STATUS_FAILED = 1, STATUS_INVALID = 2 };
+
+struct Reply {
+  uint32_t slot;
+  int32_t status;
+};
+
+bool write_all(int fd, const void *buf, size_t nb_bytes)
+{
+  const char *ptr = (const char *) buf;
+  while (nb_bytes > 0) {
+    ssize_t n = ::send(fd, ptr, nb_bytes, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    ptr += n;
+    nb_bytes -= n;
+  }
+  return true;
+}
+
+bool read_all(int fd, void *buf, size_t nb_bytes)
+{
+  char *ptr = (char *) buf;
+  while (nb_bytes > 0) {
+    ssize_t n = ::recv(fd, ptr, nb_bytes, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    ptr += n;
+    nb_bytes -= n;
+  }
+  return true;
+}
+
+bool write_shapes(int fd, const std::vector<std::vector<ssize_t>> &shapes)
+{
+  uint32_t nb_shapes = shapes.size();
+  if (!write_all(fd, &nb_shapes, sizeof(nb_shapes)))
+    return false;
+  for (const std::vector<ssize_t> &shape : shapes) {
+    uint32_t ndim = shape.size();
+    std::vector<int64_t> dims(shape.begin(), shape.end());
+    if (!write_all(fd, &ndim, sizeof(ndim))
+        || !write_all(fd, dims.data(), ndim * sizeof(int64_t)))
+      return false;
+  }
+  return true;
+}
+
+bool read_shapes(int fd, std::vector<std::vector<ssize_t>> &shapes)
+{
+  uint32_t nb_shapes;
+  if (!read_all(fd, &nb_shapes, sizeof(nb_shapes)))
+    return false;
+  for (uint32_t i = 0; i < nb_shapes; ++i) {
+    uint32_t ndim;
+    if (!read_all(fd, &ndim, sizeof(ndim)))
+      return false;
+    std::vector<int64_t> dims(ndim);
+    if (!read_all(fd, dims.data(), ndim * sizeof(int64_t)))
+      return false;
+    shapes.push_back(std::vector<ssize_t>(dims.begin(), dims.end()));
+  }
+  return true;
+}
+
+size_t nb_bytes(const std::vector<ssize_t> &shape)
+{
+  size_t size = sizeof(float);
+  for (const ssize_t &d : shape)
+    size *= d;
+  return size;
+}
+
+size_t aligned(size_t size)
+{
+  return (size + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+}
+
+size_t slot_size(const std::vector<std::vector<ssize_t>> &in_shapes,
+                 const std::vector<std::vector<ssize_t>> &out_shapes)
+{
+  size_t size = 0;
+  for (const std::vector<ssize_t> &shape : in_shapes)
+    size += aligned(nb_bytes(shape));
+  for (const std::vector<ssize_t> &shape : out_shapes)
+    size += aligned(nb_bytes(shape));
+  return size;
+}
+
+/**
+ * @brief Create the input and output buffer views of every slot in the
+ *  shared memory ring, the views keep the segment alive
+ */
+void create_slot_buffers(std::shared_ptr<SharedMemory> shm, size_t nb_slots,
+                         const std::vector<std::vector<ssize_t>> &in_shapes,
+                         const std::vector<std::vector<ssize_t>> &out_shapes,
+                         std::vector<std::vector<XBufferHolder>> &inputs,
+                         std::vector<std::vector<XBufferHolder>> &outputs)
+{
+  size_t size = slot_size(in_shapes, out_shapes);
+  // The number of slots comes from the client, check for overflow
+  if (size > 0 && nb_slots > SIZE_MAX / size)
+    throw std::runtime_error("InferenceServer: too many slots: "
+                             + std::to_string(nb_slots));
+  if (shm->size() < nb_slots * size)
+    throw std::runtime_error("InferenceServer: shared memory segment is too"
+                             " small for " + std::to_string(nb_slots) + " slots");
+  inputs.assign(nb_slots, std::vector<XBufferHolder>());
+  outputs.assign(nb_slots, std::vector<XBufferHolder>());
+  for (size_t s = 0; s < nb_slots; ++s) {
+    char *ptr = shm->data() + s * size;
+    for (size_t k = 0; k < in_shapes.size() + out_shapes.size(); ++k) {
+      bool is_input = k < in_shapes.size();
+      const std::vector<ssize_t> &shape =
+        is_input ? in_shapes[k] : out_shapes[k - in_shapes.size()];
+      XBufferHolder xb(new XBuffer((void *) ptr, sizeof(float), "f",
+                                   shape.size(), shape, false, false));
+      xb->base = shm;
+      (is_input ? inputs : outputs)[s].push_back(xb);
+      ptr += aligned(nb_bytes(shape));
+    }
+  }
+}
+
+} // namespace
+
+struct InferenceServer::Client {
+  int fd = -1;
+  std::thread thread;
+  std::vector<std::vector<XBufferHolder>> inputs;
+  std::vector<std::vector<XBufferHolder>> outputs;
+  std::mutex write_mtx;
+
+  // Queued requests keep the client alive, so the descriptor can't be
+  //  reused for another connection while replies are pending
+  ~Client()
+  {
+    if (fd >= 0)
+      ::close(fd);
+  }
+
+  void reply(uint32_t slot, int32_t status)
+  {
+    Reply r{slot, status};
+    std::lock_guard<std::mutex> lock(write_mtx);
+    // Replies to disconnected clients are dropped
+    write_all(fd, &r, sizeof(r));
+  }
+};
+
+InferenceServer::InferenceServer(SharedRtModHolder rt_mod,
+                                 const std::string &socket_path,
+                                 const InferenceServerOptions &options)
+  : rt_mod_(rt_mod), socket_path_(socket_path), options_(options)
+{
+  if (options_.in_shapes.empty() || options_.out_shapes.empty())
+    throw std::invalid_argument("InferenceServer: input and output shapes"
+                                " have to be provided");
+  for (auto *shapes : {&options_.in_shapes, &options_.out_shapes})
+    for (const std::vector<ssize_t> &shape : *shapes)
+      if (shape.empty() || shape[0] != 1)
+        throw std::invalid_argument("InferenceServer: request shapes should"
+                                    " have a batch dimension of 1");
+  if (options_.max_batch_size == 0)
+    options_.max_batch_size = 1;
+}
+
+InferenceServer::~InferenceServer()
+{
+  stop();
+}
+
+void InferenceServer::start()
+{
+  if (listen_fd_ >= 0)
+    return;
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path_.size() >= sizeof(addr.sun_path))
+    throw std::invalid_argument("InferenceServer: socket path is too long: "
+                                + socket_path_);
+  std::strcpy(addr.sun_path, socket_path_.c_str());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    throw std::runtime_error("InferenceServer: can't create socket: "
+                             + std::string(std::strerror(errno)));
+  ::unlink(socket_path_.c_str());
+  if (::bind(fd, (sockaddr *) &addr, sizeof(addr)) != 0
+      || ::listen(fd, 64) != 0) {
+    int err = errno;
+    ::close(fd);
+    throw std::runtime_error("InferenceServer: can't listen on " + socket_path_
+                             + ": " + std::strerror(err));
+  }
+  listen_fd_ = fd;
+  stop_ = false;
+  batch_thread_ = std::thread([this]() { batch_loop(); });
+  accept_thread_ = std::thread([this]() { accept_loop(); });
+}
+
+void InferenceServer::stop()
+{
+  if (listen_fd_ < 0)
+    return;
+  stop_ = true;
+  // Unblock the accepting and reading threads
+  ::shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.join();
+  ::close(listen_fd_);
+  listen_fd_ = -1;
+  ::unlink(socket_path_.c_str());
+
+  std::vector<std::shared_ptr<Client>> clients;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    clients.swap(clients_);
+    stats_.connected = 0;
+  }
+  for (auto &c : clients)
+    ::shutdown(c->fd, SHUT_RDWR);
+  for (auto &c : clients)
+    c->thread.join();
+  std::thread finished;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    finished.swap(finished_thread_);
+  }
+  if (finished.joinable())
+    finished.join();
+
+  cv_.notify_all();
+  batch_thread_.join();
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.failed += queue_.size();
+    queue_.clear();
+  }
+}
+
+InferenceServerStats InferenceServer::get_stats()
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return stats_;
+}
+
+void InferenceServer::accept_loop()
+{
+  while (!stop_) {
+    int fd = ::accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (!stop_)
+        pxWarning("InferenceServer: accept failed: "
+                  + std::string(std::strerror(errno)));
+      break;
+    }
+    std::shared_ptr<Client> client(new Client());
+    client->fd = fd;
+    std::lock_guard<std::mutex> lock(mtx_);
+    clients_.push_back(client);
+    ++stats_.clients;
+    ++stats_.connected;
+    client->thread = std::thread([this, client]() {
+      client_loop(client);
+      finish_client(client);
+    });
+  }
+}
+
+void InferenceServer::finish_client(const std::shared_ptr<Client> &client)
+{
+  std::thread previous;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = std::find(clients_.begin(), clients_.end(), client);
+    // Clients that are being stopped are joined by stop
+    if (it == clients_.end())
+      return;
+    clients_.erase(it);
+    --stats_.connected;
+    // A thread can't join itself, hand it over to the next one to finish
+    previous.swap(finished_thread_);
+    finished_thread_.swap(client->thread);
+  }
+  if (previous.joinable())
+    previous.join();
+  // Unblock a pending reply, the descriptor is closed with the last
+  //  reference to the client
+  ::shutdown(client->fd, SHUT_RDWR);
+}
+
+void InferenceServer::client_loop(std::shared_ptr<Client> client)
+{
+  // Handshake
+  uint32_t nb_slots, path_size;
+  std::string shm_path;
+  if (!write_shapes(client->fd, options_.in_shapes)
+      || !write_shapes(client->fd, options_.out_shapes)
+      || !read_all(client->fd, &nb_slots, sizeof(nb_slots))
+      || !read_all(client->fd, &path_size, sizeof(path_size)))
+    return;
+  if (path_size == 0 || path_size >= PATH_MAX) {
+    pxWarning("InferenceServer: invalid shared memory path size: "
+              + std::to_string(path_size));
+    int32_t status = STATUS_INVALID;
+    write_all(client->fd, &status, sizeof(status));
+    return;
+  }
+  shm_path.resize(path_size);
+  if (!read_all(client->fd, &shm_path[0], path_size))
+    return;
+  int32_t status = STATUS_OK;
+  try {
+    std::shared_ptr<SharedMemory> shm(SharedMemory::Open(shm_path));
+    create_slot_buffers(shm, nb_slots, options_.in_shapes, options_.out_shapes,
+                        client->inputs, client->outputs);
+  } catch (std::exception &e) {
+    pxWarning("InferenceServer: " + std::string(e.what()));
+    status = STATUS_INVALID;
+  }
+  if (!write_all(client->fd, &status, sizeof(status)) || status != STATUS_OK)
+    return;
+
+  uint32_t slot;
+  while (!stop_ && read_all(client->fd, &slot, sizeof(slot))) {
+    if (slot >= nb_slots) {
+      client->reply(slot, STATUS_INVALID);
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      queue_.push_back(Request{client, slot});
+    }
+    cv_.notify_all();
+  }
+}
+
+void InferenceServer::batch_loop()
+{
+  typedef std::chrono::steady_clock Clock;
+  while (true) {
+    std::vector<Request> batch;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_)
+        return;
+      // Wait for requests of other clients to fill up the batch
+      Clock::time_point deadline =
+        Clock::now() + std::chrono::microseconds(options_.batch_timeout_us);
+      cv_.wait_until(lock, deadline, [this]() {
+        return stop_ || queue_.size() >= options_.max_batch_size;
+      });
+      if (stop_)
+        return;
+      while (!queue_.empty() && batch.size() < options_.max_batch_size) {
+        batch.push_back(queue_.front());
+        queue_.pop_front();
+      }
+    }
+    execute_batch(batch);
+  }
+}
+
+void InferenceServer::execute_batch(std::vector<Request> &batch)
+{
+  size_t n = batch.size();
+  std::vector<XBufferHolder> in_tensors, out_tensors;
+  if (n == 1) {
+    // Execute directly on the shared memory buffers
+    Client &c = *batch[0].client;
+    in_tensors = c.inputs[batch[0].slot];
+    out_tensors = c.outputs[batch[0].slot];
+  } else {
+    for (size_t i = 0; i < options_.in_shapes.size(); ++i) {
+      std::vector<ssize_t> shape(options_.in_shapes[i]);
+      shape[0] = n;
+      XBufferHolder xb = create_buffer(shape);
+      size_t size = nb_bytes(options_.in_shapes[i]);
+      for (size_t j = 0; j < n; ++j)
+        std::memcpy((char *) xb->data + j * size,
+                    batch[j].client->inputs[batch[j].slot][i]->data, size);
+      in_tensors.push_back(xb);
+    }
+    for (size_t i = 0; i < options_.out_shapes.size(); ++i) {
+      std::vector<ssize_t> shape(options_.out_shapes[i]);
+      shape[0] = n;
+      out_tensors.push_back(create_buffer(shape));
+    }
+  }
+
+  int32_t status = STATUS_OK;
+  try {
+    rt_mod_->execute(in_tensors, out_tensors);
+    if (out_tensors.size() != options_.out_shapes.size())
+      throw std::runtime_error("unexpected number of outputs");
+    for (size_t i = 0; i < out_tensors.size(); ++i) {
+      size_t size = nb_bytes(options_.out_shapes[i]);
+      XBufferHolder out = ascontiguous(out_tensors[i]);
+      if ((size_t) (out->size * out->itemsize) != n * size)
+        throw std::runtime_error("unexpected size of output "
+                                 + std::to_string(i));
+      // Compute funcs may hand back different buffers than the ones provided
+      for (size_t j = 0; j < n; ++j) {
+        void *dst = batch[j].client->outputs[batch[j].slot][i]->data;
+        if ((char *) out->data + j * size != dst)
+          std::memcpy(dst, (char *) out->data + j * size, size);
+      }
+    }
+  } catch (std::exception &e) {
+    pxWarning("InferenceServer: execution failed: " + std::string(e.what()));
+    status = STATUS_FAILED;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.requests += n;
+    stats_.batches += 1;
+    if (status != STATUS_OK)
+      stats_.failed += n;
+  }
+  for (Request &r : batch)
+    r.client->reply(r.slot, status);
+}
+
+InferenceClient::InferenceClient(const std::string &socket_path, size_t nb_slots)
+{
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path))
+    throw std::invalid_argument("InferenceClient: socket path is too long: "
+                                + socket_path);
+  std::strcpy(addr.sun_path, socket_path.c_str());
+  fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0 || ::connect(fd_, (sockaddr *) &addr, sizeof(addr)) != 0) {
+    int err = errno;
+    if (fd_ >= 0)
+      ::close(fd_);
+    throw std::runtime_error("InferenceClient: can't connect to " + socket_path
+                             + ": " + std::strerror(err));
+  }
+
+  std::vector<std::vector<ssize_t>> in_shapes, out_shapes;
+  bool ok = read_shapes(fd_, in_shapes) && read_shapes(fd_, out_shapes);
+  if (ok) {
+    shm_ = std::shared_ptr<SharedMemory>(
+      SharedMemory::Create(nb_slots * slot_size(in_shapes, out_shapes)));
+    create_slot_buffers(shm_, nb_slots, in_shapes, out_shapes, slot_inputs_,
+                        slot_outputs_);
+    uint32_t slots = nb_slots, path_size = shm_->path().size();
+    int32_t status;
+    ok = write_all(fd_, &slots, sizeof(slots))
+      && write_all(fd_, &path_size, sizeof(path_size))
+      && write_all(fd_, shm_->path().data(), path_size)
+      && read_all(fd_, &status, sizeof(status)) && status == STATUS_OK;
+    // Both processes mapped the segment, the backing file isn't needed anymore
+    shm_->unlink();
+  }
+  if (!ok) {
+    ::close(fd_);
+    throw std::runtime_error("InferenceClient: handshake with " + socket_path
+                             + " failed");
+  }
+  slot_states_.assign(nb_slots, 0);
+}
+
+InferenceClient::~InferenceClient()
+{
+  ::close(fd_);
+}
+
+void InferenceClient::submit(size_t slot)
+{
+  if (slot >= slot_states_.size() || slot_states_[slot] == 1)
+    throw std::invalid_argument("InferenceClient: invalid or busy slot "
+                                + std::to_string(slot));
+  uint32_t s = slot;
+  slot_states_[slot] = 1;
+  if (!write_all(fd_, &s, sizeof(s)))
+    throw std::runtime_error("InferenceClient: connection to server lost");
+}
+
+void InferenceClient::wait(size_t slot)
+{
+  if (slot >= slot_states_.size() || slot_states_[slot] == 0)
+    throw std::invalid_argument("InferenceClient: no request in slot "
+                                + std::to_string(slot));
+  while (slot_states_[slot] == 1) {
+    Reply r;
+    if (!read_all(fd_, &r, sizeof(r)))
+      throw std::runtime_error("InferenceClient: connection to server lost");
+    if (r.slot < slot_states_.size())
+      slot_states_[r.slot] = r.status == STATUS_OK ? 2 : 3;
+  }
+  int state = slot_states_[slot];
+  slot_states_[slot] = 0;
+  if (state == 3)
+    throw std::runtime_error("InferenceClient: request in slot "
+                             + std::to_string(slot) + " failed");
+}
+
+void InferenceClient::execute(std::vector<XBufferHolder> &in_tensors,
+                              std::vector<XBufferHolder> &out_tensors)
+{
+  size_t slot = 0;
+  while (slot < slot_states_.size() && slot_states_[slot] != 0)
+    ++slot;
+  if (slot == slot_states_.size())
+    throw std::runtime_error("InferenceClient: no free request slot");
+  std::vector<XBufferHolder> &inputs = slot_inputs_[slot];
+  std::vector<XBufferHolder> &outputs = slot_outputs_[slot];
+  if (in_tensors.size() != inputs.size())
+    throw std::invalid_argument("InferenceClient: expected "
+                                + std::to_string(inputs.size()) + " inputs");
+  for (size_t i = 0; i < inputs.size(); ++i)
+    copy_buffer(*in_tensors[i], *inputs[i]);
+  submit(slot);
+  wait(slot);
+  if (out_tensors.empty()) {
+    for (XBufferHolder &out : outputs) {
+      std::vector<ssize_t> shape(out->shape);
+      out_tensors.push_back(create_buffer(shape));
+    }
+  }
+  if (out_tensors.size() != outputs.size())
+    throw std::invalid_argument("InferenceClient: expected "
+                                + std::to_string(outputs.size()) + " outputs");
+  for (size_t i = 0; i < outputs.size(); ++i)
+    copy_buffer(*outputs[i], *out_tensors[i]);
+}
+
+} // namespace runtime
+} // namespace pyxir
@@ -17,6 +17,7 @@
 #include <unordered_map>
 
 #include "pyxir/runtime/kernel_func_factory.hpp"
+#include "pyxir/runtime/static_kernel_registry.hpp"
 
 
 namespace pyxir {
@@ -99,7 +100,28 @@ KernelFuncFactory::RegisterImpl(const std::string &kernel_id)
   return *Manager::GetInstance().get(kernel_id);
 }
 
+namespace {
+
+/**
+ * @brief Return the built-in kernel for a "cpu.<op_type>" kernel id, null
+ *  if there is none
+ */
+const StaticKernelEntry *find_builtin(const std::string &kernel_id)
+{
+  const std::string prefix = "cpu.";
+  if (kernel_id.compare(0, prefix.size(), prefix) != 0)
+    return nullptr;
+  return StaticKernelRegistry::Find(kernel_id.substr(prefix.size()));
+}
+
+} // namespace
+
 bool KernelFuncFactory::Exists(const std::string &kernel_id)
+{
+  return IsRegistered(kernel_id) || find_builtin(kernel_id) != nullptr;
+}
+
+bool KernelFuncFactory::IsRegistered(const std::string &kernel_id)
 {
   return Manager::GetInstance().exists(kernel_id);
 }
@@ -109,16 +131,17 @@ KernelFuncFactory::GetKernelFunc(
   const std::string &kernel_id,
   XLayerHolder &xl)
 {
+  // Kernels registered at runtime take precedence over the built-in ones
   if (Manager::GetInstance().exists(kernel_id))
   {
     KernelFuncHolder kfh;
     Manager::GetInstance().get(kernel_id)->get_impl()(xl, kfh);
     return kfh;
-  }  
-	else
-  {
-    throw std::runtime_error("Kernel func: " + kernel_id + " doesn't exist.");
   }
+  const StaticKernelEntry *entry = find_builtin(kernel_id);
+  if (entry)
+    return KernelFuncHolder(entry->create(xl));
+  throw std::runtime_error("Kernel func: " + kernel_id + " doesn't exist.");
 }
 
 } // namespace runtime
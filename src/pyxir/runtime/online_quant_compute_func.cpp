@@ -14,8 +14,15 @@
  *  limitations under the License.
  */
 
+#include <mutex>
+#include <cstdio>
 #include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unistd.h>
 
+#include "pyxir/common/util.hpp"
 #include "pyxir/ffi/str_container.hpp"
 #include "pyxir/runtime/runtime_module_factory.hpp"
 #include "pyxir/runtime/compute_func_factory.hpp"
@@ -26,6 +33,80 @@
 namespace pyxir {
 namespace runtime {
 
+namespace {
+
+/** @brief A work or build directory used by compute funcs in this process */
+struct DirUse {
+  /** @brief The number of compute funcs using the directory, e.g. when a
+      module is replaced by a module built with the same options */
+  int refs = 0;
+  /** @brief The hash of the serialized build directory the compute funcs
+      were loaded from, empty if unknown */
+  std::string hash;
+};
+
+std::mutex dir_uses_mtx;
+std::unordered_map<std::string, DirUse> dir_uses;
+
+/**
+ * @brief Start using a directory. With `hash` set, the directory is used by
+ *  a compute func loaded from a serialized build directory with that hash:
+ *  if the directory exists and isn't in use for the same contents, a
+ *  directory specific to this process and these contents is used instead.
+ * @param dir The requested directory
+ * @param hash The hash of the serialized contents, empty if unknown
+ * @param in_use Set to whether the returned directory was already in use
+ * @returns The directory to be used
+ */
+std::string acquire_dir(const std::string &dir, const std::string &hash,
+                        bool &in_use)
+{
+  std::lock_guard<std::mutex> lock(dir_uses_mtx);
+  std::string res = dir;
+  auto it = dir_uses.find(dir);
+  bool used = it != dir_uses.end();
+  if (!hash.empty() && (used ? it->second.hash != hash : pyxir::is_dir(dir)))
+    res = dir + "_" + std::to_string(getpid()) + "_" + hash;
+  DirUse &use = dir_uses[res];
+  in_use = use.refs > 0;
+  if (!in_use)
+    use.hash = hash;
+  ++use.refs;
+  return res;
+}
+
+/** @brief Release the directory, returns whether it's no longer in use */
+bool release_dir(const std::string &dir)
+{
+  std::lock_guard<std::mutex> lock(dir_uses_mtx);
+  auto it = dir_uses.find(dir);
+  if (it == dir_uses.end())
+    return true;
+  if (--it->second.refs > 0)
+    return false;
+  dir_uses.erase(it);
+  return true;
+}
+
+/** @brief Record the hash of the contents of a directory in use */
+void set_dir_hash(const std::string &dir, const std::string &hash)
+{
+  std::lock_guard<std::mutex> lock(dir_uses_mtx);
+  auto it = dir_uses.find(dir);
+  if (it != dir_uses.end())
+    it->second.hash = hash;
+}
+
+std::string hash_contents(const std::string &contents)
+{
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llx",
+                (unsigned long long) std::hash<std::string>()(contents));
+  return std::string(buf);
+}
+
+} // namespace
+
 OnlineQuantComputeFunc::OnlineQuantComputeFunc(
     XGraphHolder &xg, const std::string &target,
     const std::vector<std::string> &in_tensor_names,
@@ -70,6 +151,30 @@ void OnlineQuantComputeFunc::init()
       quant_of_, rt_func_of);
 	  cf_ = ComputeFuncHolder(new OpaqueComputeFunc(rt_func_of));
   }
+  acquire_dirs();
+  measure_dirs();
+}
+
+void OnlineQuantComputeFunc::acquire_dirs()
+{
+  for (const std::string &dir : {run_options_->work_dir, run_options_->build_dir}) {
+    // Directories may already be acquired on deserialization
+    if (dir.empty() || std::find(acquired_dirs_.begin(), acquired_dirs_.end(),
+                                 dir) != acquired_dirs_.end())
+      continue;
+    bool in_use;
+    acquire_dir(dir, "", in_use);
+    acquired_dirs_.push_back(dir);
+  }
+}
+
+void OnlineQuantComputeFunc::measure_dirs()
+{
+  // Walking the directories is too slow for every get_memory_usage call,
+  //  they only change when the runtime is built
+  build_files_size_ = 0;
+  for (const std::string &dir : acquired_dirs_)
+    build_files_size_ += get_dir_size(dir);
 }
 
 void OnlineQuantComputeFunc::operator()(
@@ -78,7 +183,11 @@ void OnlineQuantComputeFunc::operator()(
 {
   if (cf_) {
     (*cf_)(in_tensors, out_tensors);
-    ++count_;
+    // Reentrant calls only happen after calibration and don't count
+    if (count_ <= run_options_->nb_quant_inputs)
+      ++count_;
+    if (comparator_)
+      comparator_->sample(in_tensors, out_tensors);
   } else if (!is_target_supported_) {
     throw std::runtime_error("Trying to run on unsupported target: " + target_);
   } else {
@@ -86,29 +195,32 @@ void OnlineQuantComputeFunc::operator()(
   }
 
   if (count_ == run_options_->nb_quant_inputs) {
-    // Call quantization function
-    OpaqueArgs args = OpaqueArgs();
-    quant_of_->call(args);
+    // Call quantization function, it compiles the target into the build
+    //  directory and fans out the calibration inputs to the cross targets,
+    //  all of which are compiled concurrently
+    std::vector<std::string> cross_targets, cross_build_dirs, cross_work_dirs;
+    for (const std::string &target : run_options_->cross_targets) {
+      if (target == target_)
+        continue;
+      cross_targets.push_back(target);
+      cross_build_dirs.push_back(run_options_->build_dir + "_" + target);
+      cross_work_dirs.push_back(run_options_->work_dir + "_" + target);
+    }
+    (*quant_of_)(cross_targets, cross_build_dirs, cross_work_dirs);
+    if (!cross_targets.empty())
+      export_cross_targets(cross_targets, cross_build_dirs, cross_work_dirs);
+    // The final runtime is loaded from the build directory instead of being
+    //  compiled again
+    run_options_->is_prebuilt = true;
+    // The CPU calibration compute func, possibly kept as reference
+    ComputeFuncHolder calib_cf;
 
     if (!is_target_supported_) {
       // Just do cross compilation
-      if (!OpaqueFuncRegistry::Exists("pyxir.compile"))
-        throw std::runtime_error("Cannot compile the Vitis-AI compute func because the "
-                                " `pyxir.compile` opaque function is not "
-                                " registered. Check if Pyxir python module"
-                                " is imported correctly.");
-
-      XGraphHolder scheduled_xg =
-        std::make_shared<pyxir::graph::XGraph>("scheduled_xgraph"); 
-
-      OpaqueFunc compile_func = OpaqueFuncRegistry::Get("pyxir.compile");
-      
-      compile_func(xg_, target_, in_tensor_names_, out_tensor_names_,
-                   run_options_->build_dir, run_options_->work_dir, scheduled_xg);
-
       pxInfo("Not switching to specified runtime: `" + runtime_ + "` after on-the-fly" +
              " quantization as the model is compiled for a different target device.");
     } else {
+      calib_cf = std::move(cf_);
       cf_ = ComputeFuncFactory::GetComputeFunc(
         xg_, target_, in_tensor_names_, out_tensor_names_, runtime_, run_options_
       );
@@ -121,13 +233,29 @@ void OnlineQuantComputeFunc::operator()(
       std::string px_debug_runtime = std::string(px_debug_runtime_flag);
       std::string px_debug_target = std::string(px_debug_target_flag);
       pxWarning("Switching to debug runtime: " + px_debug_runtime + ", with target: " + px_debug_target);
+      if (!calib_cf)
+        calib_cf = std::move(cf_);
+      // The build directory holds the build for the target, compile for the
+      //  debug target
+      RunOptionsHolder debug_options(new RunOptions(*run_options_));
+      debug_options->is_prebuilt = false;
       cf_ = ComputeFuncFactory::GetComputeFunc(
-        xg_, px_debug_target, in_tensor_names_, out_tensor_names_, px_debug_runtime, run_options_
+        xg_, px_debug_target, in_tensor_names_, out_tensor_names_, px_debug_runtime, debug_options
       );
     }
     
-    // The final runtime has been built now
-    run_options_->is_prebuilt = true;
+    if (calib_cf && run_options_->compare_every > 0) {
+      ref_cf_ = std::move(calib_cf);
+      IComputeFunc *ref_cf = ref_cf_.get();
+      comparator_ = std::make_shared<ShadowComparator>(
+        [ref_cf](std::vector<XBufferHolder> &in, std::vector<XBufferHolder> &out) {
+          (*ref_cf)(in, out);
+        }, run_options_->compare_every);
+      pxInfo("Comparing every " + std::to_string(run_options_->compare_every) +
+             "th request against the CPU calibration runtime");
+    }
+    
+    measure_dirs();
     // We possibly save the runtime module using a callback function
     //  Currently necessary for ONNX Runtime flow. TODO: remove this requirement
     if (run_options_ && !run_options_->export_runtime_module_path.empty()) {
@@ -139,6 +267,128 @@ void OnlineQuantComputeFunc::operator()(
   }
 }
 
+void OnlineQuantComputeFunc::export_cross_targets(
+  const std::vector<std::string> &targets,
+  const std::vector<std::string> &build_dirs,
+  const std::vector<std::string> &work_dirs)
+{
+  for (size_t i = 0; i < targets.size(); ++i) {
+    // The exported module is prebuilt and shouldn't inherit the deployment
+    //  options of this module
+    RunOptionsHolder run_options(new RunOptions(*run_options_));
+    run_options->build_dir = build_dirs[i];
+    run_options->work_dir = work_dirs[i];
+    run_options->is_prebuilt = true;
+    run_options->export_runtime_module_path = "";
+    run_options->cross_targets.clear();
+    run_options->warmup_iterations = 0;
+    run_options->trace_path = "";
+    run_options->compare_every = 0;
+    run_options->numa_node = -1;
+    run_options->huge_pages = "";
+    run_options->memory_budget = 0;
+
+    ComputeFuncHolder cf(new OnlineQuantComputeFunc(
+      xg_, targets[i], in_tensor_names_, out_tensor_names_, runtime_, run_options));
+    RuntimeModule rt_mod(cf, in_tensor_names_, out_tensor_names_, run_options);
+
+    std::string path = run_options_->export_runtime_module_path.empty()
+      ? build_dirs[i] + ".rtmod"
+      : run_options_->export_runtime_module_path + "." + targets[i];
+    rt_mod.save(path);
+    pxInfo("Exported runtime module for target: " + targets[i] + " to: " + path);
+  }
+}
+
+ComparisonStats OnlineQuantComputeFunc::get_comparison_stats()
+{
+  if (!comparator_)
+    return ComparisonStats();
+  return comparator_->get_stats();
+}
+
+void OnlineQuantComputeFunc::move_weights(const AllocatorHolder &allocator)
+{
+  for (const std::string &xl_name : xg_->get_layer_names())
+    for (XBuffer &xb : xg_->get(xl_name)->data)
+      if (xb.size > 0)
+        move_to_allocator(xb, allocator);
+}
+
+MemoryUsage OnlineQuantComputeFunc::get_memory_usage()
+{
+  MemoryUsage usage;
+  for (const std::string &xl_name : xg_->get_layer_names()) {
+    XLayerHolder X = xg_->get(xl_name);
+    for (const XBuffer &xb : X->data)
+      usage.weights += xb.size * xb.itemsize;
+    usage.metadata += sizeof(graph::XLayer) + X->name.size();
+    for (const std::vector<int64_t> &shape : X->shapes)
+      usage.metadata += shape.size() * sizeof(int64_t);
+    for (const std::string &s : X->bottoms)
+      usage.metadata += s.size();
+    for (const std::string &s : X->tops)
+      usage.metadata += s.size();
+  }
+  usage.build_files += build_files_size_;
+  if (cf_)
+    usage += cf_->get_memory_usage();
+  if (ref_cf_ && ref_cf_ != cf_)
+    usage += ref_cf_->get_memory_usage();
+  return usage;
+}
+
+WaitFuncType OnlineQuantComputeFunc::submit(
+  std::vector<XBufferHolder> &in_tensors,
+  std::vector<XBufferHolder> &out_tensors)
+{
+  // Same condition as is_reentrant, the quantized compute func is final
+  if (!cf_ || count_ <= run_options_->nb_quant_inputs)
+    return IComputeFunc::submit(in_tensors, out_tensors);
+  WaitFuncType wait = cf_->submit(in_tensors, out_tensors);
+  if (!comparator_)
+    return wait;
+  // Compare once the outputs are available
+  std::shared_ptr<ShadowComparator> comparator = comparator_;
+  std::vector<XBufferHolder> inputs(in_tensors);
+  std::vector<XBufferHolder> *outputs = &out_tensors;
+  if (!wait) {
+    comparator->sample(inputs, *outputs);
+    return wait;
+  }
+  return [wait, comparator, inputs, outputs]() {
+    wait();
+    comparator->sample(inputs, *outputs);
+  };
+}
+
+bool OnlineQuantComputeFunc::is_reentrant()
+{
+  // The quantized compute func is final once a request was executed on it
+  return count_ > run_options_->nb_quant_inputs && cf_ && cf_->is_reentrant();
+}
+
+bool OnlineQuantComputeFunc::warmup()
+{
+  if (!cf_ || count_ < run_options_->nb_quant_inputs)
+    return false;
+  return cf_->warmup();
+}
+
+std::vector<std::vector<ssize_t>> OnlineQuantComputeFunc::get_in_shapes()
+{
+  std::vector<std::vector<ssize_t>> in_shapes;
+  for (const std::string &in_name : in_tensor_names_) {
+    if (!xg_->contains(in_name) || xg_->get(in_name)->shapes.empty())
+      return std::vector<std::vector<ssize_t>>();
+    std::vector<ssize_t> shape;
+    for (const int64_t &d : xg_->get(in_name)->shapes[0])
+      shape.push_back(d > 0 ? d : 1);
+    in_shapes.push_back(shape);
+  }
+  return in_shapes;
+}
+
 void OnlineQuantComputeFunc::serialize_px(PxOStringStream &pstream)
 {
   // Serialize XGraph
@@ -166,7 +416,11 @@ void OnlineQuantComputeFunc::serialize_px(PxOStringStream &pstream)
     pyxir::OpaqueFuncRegistry::Get("pyxir.io.serialize_dir");
   BytesContainerHolder zip_bytes_c = BytesContainerHolder(new BytesContainer());
   serialize_dir(run_options_->build_dir, zip_bytes_c);
-  pstream.write(zip_bytes_c->get_string());
+  std::string zip_str = zip_bytes_c->get_string();
+  // Modules loaded from these contents may share the build directory
+  if (!zip_str.empty())
+    set_dir_hash(run_options_->build_dir, hash_contents(zip_str));
+  pstream.write(zip_str);
 }
 
 void OnlineQuantComputeFunc::deserialize_px(PxIStringStream &pstream)
@@ -200,6 +454,21 @@ void OnlineQuantComputeFunc::deserialize_px(PxIStringStream &pstream)
   // Deserialize build directory
   std::string zip_str;
   pstream.read(zip_str);
+  // Every loaded module gets directories of its own unless they are in use
+  //  for the same build already, so that modules never run the artifacts
+  //  of another build. Leftovers are removed before extracting.
+  if (!zip_str.empty()) {
+    std::string hash = hash_contents(zip_str);
+    for (std::string *dir : {&run_options_->work_dir, &run_options_->build_dir}) {
+      if (dir->empty())
+        continue;
+      bool in_use;
+      *dir = acquire_dir(*dir, hash, in_use);
+      acquired_dirs_.push_back(*dir);
+      if (!in_use && pyxir::is_dir(*dir))
+        pyxir::rmrf(*dir);
+    }
+  }
   pyxir::OpaqueFunc deserialize_dir =
     pyxir::OpaqueFuncRegistry::Get("pyxir.io.deserialize_dir");
   deserialize_dir(run_options_->build_dir, zip_str);
@@ -210,11 +479,11 @@ void OnlineQuantComputeFunc::deserialize_px(PxIStringStream &pstream)
 
 OnlineQuantComputeFunc::~OnlineQuantComputeFunc()
 {
-  // Remove work and build directories
-  if (!run_options_->work_dir.empty() && pyxir::is_dir(run_options_->work_dir))
-    pyxir::rmrf(run_options_->work_dir);
-  if (!run_options_->build_dir.empty() && pyxir::is_dir(run_options_->build_dir))
-    pyxir::rmrf(run_options_->build_dir);
+  // Remove work and build directories if no other compute func uses them
+  for (const std::string &dir : acquired_dirs_) {
+    if (release_dir(dir) && pyxir::is_dir(dir))
+      pyxir::rmrf(dir);
+  }
 }
 
 REGISTER_COMPUTE_FUNC_TYPE("online_quant_compute_func")
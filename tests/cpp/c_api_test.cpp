@@ -0,0 +1,217 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/c_api.h"
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/compute_func_registry.hpp"
+#include "pyxir/runtime/runtime_module.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/** @brief Serializable compute func adding one to its float input */
+class AddOneComputeFunc : public IComputeFunc {
+
+  public:
+    std::string get_type() { return "test_c_api_compute_func"; }
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors)
+    {
+      float *in = (float *) in_tensors[0]->data;
+      if (in[0] < 0)
+        throw std::runtime_error("negative input");
+      for (ssize_t i = 0; i < in_tensors[0]->size; ++i)
+        ((float *) out_tensors[0]->data)[i] = in[i] + 1;
+    }
+
+    void serialize_px(PxOStringStream &pstream) {}
+
+    void deserialize_px(PxIStringStream &pstream) {}
+};
+
+REGISTER_COMPUTE_FUNC_TYPE("test_c_api_compute_func")
+  .set_factory_func([]() -> ComputeFuncHolder {
+    ComputeFuncHolder cf(new AddOneComputeFunc());
+    return cf;
+  });
+
+/** @brief Reentrant version which blocks inputs starting with 100 until
+    the gate is opened */
+std::atomic<bool> gate_open{false};
+std::atomic<int> gated{0};
+
+class GatedComputeFunc : public AddOneComputeFunc {
+
+  public:
+    std::string get_type() { return "test_c_api_gated_compute_func"; }
+
+    bool is_reentrant() override { return true; }
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors)
+    {
+      if (((float *) in_tensors[0]->data)[0] == 100.f) {
+        ++gated;
+        while (!gate_open)
+          std::this_thread::yield();
+      }
+      AddOneComputeFunc::operator()(in_tensors, out_tensors);
+    }
+};
+
+REGISTER_COMPUTE_FUNC_TYPE("test_c_api_gated_compute_func")
+  .set_factory_func([]() -> ComputeFuncHolder {
+    ComputeFuncHolder cf(new GatedComputeFunc());
+    return cf;
+  });
+
+std::string get_serialized_rt_mod(bool gated = false)
+{
+  ComputeFuncHolder cf(gated ? new GatedComputeFunc()
+                             : new AddOneComputeFunc());
+  RunOptionsHolder run_options(new RunOptions());
+  RuntimeModule rt_mod(cf, std::vector<std::string>{"x"},
+                       std::vector<std::string>{"y"}, run_options);
+  std::ostringstream sstream;
+  rt_mod.serialize(sstream);
+  return sstream.str();
+}
+
+} // namespace
+
+TEST_CASE("Test C API load and execute with caller-owned buffers")
+{
+  std::string serialized = get_serialized_rt_mod();
+  px_module *module = nullptr;
+  REQUIRE(px_module_load_from_buffer(serialized.data(), serialized.size(),
+                                     &module) == PX_OK);
+  size_t nb_inputs, nb_outputs;
+  REQUIRE(px_module_num_inputs(module, &nb_inputs) == PX_OK);
+  REQUIRE(px_module_num_outputs(module, &nb_outputs) == PX_OK);
+  REQUIRE(nb_inputs == 1);
+  REQUIRE(nb_outputs == 1);
+
+  float in[6] = {0, 1, 2, 3, 4, 5};
+  float out[6] = {0};
+  int64_t shape[2] = {2, 3};
+  px_tensor in_t = {in, PX_FLOAT32, 2, shape};
+  px_tensor out_t = {out, PX_FLOAT32, 2, shape};
+  for (int i = 0; i < 3; ++i)
+    REQUIRE(px_module_execute(module, &in_t, 1, &out_t, 1) == PX_OK);
+  for (int i = 0; i < 6; ++i)
+    REQUIRE(out[i] == in[i] + 1);
+
+  // Errors are reported through statuses and the last error message
+  in[0] = -1;
+  REQUIRE(px_module_execute(module, &in_t, 1, &out_t, 1) == PX_ERR_RUNTIME);
+  REQUIRE(std::string(px_last_error()) == "negative input");
+  px_tensor bad_t = {in, (px_dtype) 42, 2, shape};
+  REQUIRE(px_module_execute(module, &bad_t, 1, &out_t, 1)
+          == PX_ERR_INVALID_ARGUMENT);
+
+  px_metrics metrics;
+  REQUIRE(px_module_get_metrics(module, &metrics) == PX_OK);
+  REQUIRE(metrics.executions == 5);
+  REQUIRE(metrics.failures == 2);
+  REQUIRE(metrics.max_latency_us >= metrics.mean_latency_us);
+  px_module_free(module);
+
+  REQUIRE(px_module_load("non_existing.rtmod", &module) == PX_ERR_RUNTIME);
+}
+
+TEST_CASE("Test C API asynchronous submit and poll")
+{
+  std::string serialized = get_serialized_rt_mod();
+  px_module *module = nullptr;
+  REQUIRE(px_module_load_from_buffer(serialized.data(), serialized.size(),
+                                     &module) == PX_OK);
+
+  float in[4] = {1, 2, 3, 4};
+  float out[4] = {0};
+  int64_t shape[1] = {4};
+  px_tensor in_t = {in, PX_FLOAT32, 1, shape};
+  px_tensor out_t = {out, PX_FLOAT32, 1, shape};
+  px_request *request = nullptr;
+  REQUIRE(px_module_submit(module, &in_t, 1, &out_t, 1, &request) == PX_OK);
+  REQUIRE(px_request_wait(request) == PX_OK);
+  REQUIRE(px_request_poll(request) == PX_OK);
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(out[i] == in[i] + 1);
+  px_request_free(request);
+
+  in[0] = -1;
+  REQUIRE(px_module_submit(module, &in_t, 1, &out_t, 1, &request) == PX_OK);
+  px_status status;
+  while ((status = px_request_poll(request)) == PX_PENDING) {}
+  REQUIRE(status == PX_ERR_RUNTIME);
+  px_request_free(request);
+
+  px_metrics metrics;
+  REQUIRE(px_module_get_metrics(module, &metrics) == PX_OK);
+  REQUIRE(metrics.async_submitted == 2);
+  px_module_free(module);
+}
+
+TEST_CASE("Test C API submits don't wait for running executions")
+{
+  std::string serialized = get_serialized_rt_mod(true);
+  px_module *module = nullptr;
+  REQUIRE(px_module_load_from_buffer(serialized.data(), serialized.size(),
+                                     &module) == PX_OK);
+  gate_open = false;
+  gated = 0;
+
+  int64_t shape[1] = {2};
+  float blocked_in[2] = {100, 1};
+  float blocked_out[2] = {0};
+  px_tensor blocked_in_t = {blocked_in, PX_FLOAT32, 1, shape};
+  px_tensor blocked_out_t = {blocked_out, PX_FLOAT32, 1, shape};
+  std::thread executing([&]() {
+    px_module_execute(module, &blocked_in_t, 1, &blocked_out_t, 1);
+  });
+  while (gated == 0)
+    std::this_thread::yield();
+
+  // The module is reentrant, so the request completes while the
+  //  synchronous execution is still running
+  float in[2] = {1, 2};
+  float out[2] = {0};
+  px_tensor in_t = {in, PX_FLOAT32, 1, shape};
+  px_tensor out_t = {out, PX_FLOAT32, 1, shape};
+  px_request *request = nullptr;
+  REQUIRE(px_module_submit(module, &in_t, 1, &out_t, 1, &request) == PX_OK);
+  REQUIRE(px_request_wait(request) == PX_OK);
+  REQUIRE(out[1] == 3.f);
+  REQUIRE(!gate_open);
+  px_request_free(request);
+
+  gate_open = true;
+  executing.join();
+  REQUIRE(blocked_out[0] == 101.f);
+  px_module_free(module);
+}
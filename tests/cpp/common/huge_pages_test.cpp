@@ -0,0 +1,94 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/common/allocator.hpp"
+#include "pyxir/common/xbuffer.hpp"
+
+using namespace pyxir;
+
+TEST_CASE("Test HugePageAllocator alignment, coverage and reuse")
+{
+  std::shared_ptr<HugePageAllocator> allocator(
+    new HugePageAllocator(HugePageMode::TRANSPARENT));
+  const size_t size = 3 * 1024 * 1024;
+  void *ptr = allocator->allocate(size);
+  REQUIRE(((uintptr_t) ptr % HugePageAllocator::HUGE_PAGE_SIZE) == 0);
+  std::memset(ptr, 1, size);
+
+  HugePageStats stats = allocator->get_stats();
+  REQUIRE(stats.requested_bytes == size);
+  REQUIRE(stats.transparent_bytes + stats.fallback_bytes == 4 * 1024 * 1024);
+  REQUIRE(get_transparent_huge_bytes(ptr, size) <= 4 * 1024 * 1024);
+
+  // Freed mappings are reused
+  allocator->deallocate(ptr, size);
+  REQUIRE(allocator->get_stats().cached_bytes == 4 * 1024 * 1024);
+  void *ptr2 = allocator->allocate(size - 100);
+  REQUIRE(ptr2 == ptr);
+  REQUIRE(allocator->get_stats().cache_hits == 1);
+  REQUIRE(allocator->get_stats().cached_bytes == 0);
+  allocator->deallocate(ptr2, size - 100);
+  allocator->trim();
+  REQUIRE(allocator->get_stats().cached_bytes == 0);
+
+  // Small allocations come from the heap
+  void *small = allocator->allocate(64);
+  REQUIRE(allocator->get_stats().fallback_bytes == 64);
+  allocator->deallocate(small, 64);
+  REQUIRE(allocator->get_stats().requested_bytes == 0);
+}
+
+TEST_CASE("Test HugePageAllocator explicit mode falls back")
+{
+  HugePageAllocator allocator(HugePageMode::EXPLICIT);
+  const size_t size = 2 * 1024 * 1024;
+  void *ptr = allocator.allocate(size);
+  std::memset(ptr, 0, size);
+  HugePageStats stats = allocator.get_stats();
+  REQUIRE(stats.explicit_bytes + stats.transparent_bytes + stats.fallback_bytes
+          == size);
+  REQUIRE(stats.coverage() >= 0.);
+  allocator.deallocate(ptr, size);
+}
+
+TEST_CASE("Test move buffer data to an allocator")
+{
+  std::vector<float> x(1024 * 1024, 2.f);
+  std::vector<ssize_t> shape {1024, 1024};
+  XBuffer xb((void *) &x[0], 4, "f", 2, shape, true, true);
+  std::shared_ptr<HugePageAllocator> allocator(new HugePageAllocator());
+  move_to_allocator(xb, allocator);
+  REQUIRE(!xb.own_data);
+  REQUIRE(((float *) xb.data)[1024 * 1024 - 1] == 2.f);
+  REQUIRE(allocator->get_stats().requested_bytes == 4 * 1024 * 1024);
+  REQUIRE(allocator->get_stats().coverage() >= 0.);
+
+  // Buffers created on a thread with the allocator use it as well
+  {
+    ScopedAllocator scope(allocator);
+    XBufferHolder act = create_buffer(shape);
+    REQUIRE(allocator->get_stats().requested_bytes == 8 * 1024 * 1024);
+  }
+  REQUIRE(allocator->get_stats().requested_bytes == 4 * 1024 * 1024);
+}
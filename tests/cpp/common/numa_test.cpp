@@ -0,0 +1,108 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/common/allocator.hpp"
+#include "pyxir/common/numa.hpp"
+#include "pyxir/common/xbuffer.hpp"
+
+using namespace pyxir;
+
+class CountingAllocator : public HeapAllocator {
+
+  public:
+    void *allocate(size_t size) override
+    {
+      allocated += size;
+      return HeapAllocator::allocate(size);
+    }
+
+    void deallocate(void *ptr, size_t size) override
+    {
+      released += size;
+      HeapAllocator::deallocate(ptr, size);
+    }
+
+    size_t allocated = 0;
+    size_t released = 0;
+};
+
+TEST_CASE("Test NUMA topology")
+{
+  REQUIRE(numa::parse_list("0-3,8,10-11\n")
+          == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+  REQUIRE(numa::parse_list("").empty());
+  std::vector<int> nodes = numa::get_nodes();
+  REQUIRE(!nodes.empty());
+  REQUIRE(numa::nb_nodes() == (int) nodes.size());
+  int node = numa::get_current_node();
+  REQUIRE(std::find(nodes.begin(), nodes.end(), node) != nodes.end());
+}
+
+TEST_CASE("Test create_buffer uses the thread allocator")
+{
+  std::shared_ptr<CountingAllocator> counting(new CountingAllocator());
+  std::vector<ssize_t> shape {2, 8};
+  {
+    ScopedAllocator scope(counting);
+    XBufferHolder xb = create_buffer(shape);
+    REQUIRE(counting->allocated == 64);
+    REQUIRE(!xb->own_data);
+    std::memset(xb->data, 0, 64);
+    // Other threads keep their own allocator
+    std::thread t([&shape]() { create_buffer(shape); });
+    t.join();
+    REQUIRE(counting->allocated == 64);
+  }
+  REQUIRE(counting->released == 64);
+  REQUIRE(!thread_allocator());
+
+  XBufferHolder heap = create_buffer(shape);
+  REQUIRE(heap->own_data);
+  REQUIRE(counting->allocated == 64);
+}
+
+TEST_CASE("Test NUMA allocator placement")
+{
+  int node = numa::get_current_node();
+  AllocatorHolder allocator(new NumaAllocator(node, 4096));
+  ScopedAllocator scope(allocator);
+
+  std::vector<ssize_t> shape {1024, 1024};
+  XBufferHolder xb = create_buffer(shape);
+  std::memset(xb->data, 1, xb->size * xb->itemsize);
+  numa::PageLocality loc =
+    numa::get_page_locality(xb->data, xb->size * xb->itemsize, node);
+  size_t nb_pages = (xb->size * xb->itemsize) / sysconf(_SC_PAGESIZE);
+  REQUIRE(loc.local + loc.remote + loc.absent >= nb_pages);
+  if (numa::nb_nodes() == 1)
+    REQUIRE(loc.remote == 0);
+  REQUIRE(loc.local_fraction() >= 0.);
+
+  // Small allocations come from the heap
+  std::vector<ssize_t> small_shape {4};
+  XBufferHolder small = create_buffer(small_shape);
+  ((float *) small->data)[3] = 1.f;
+}
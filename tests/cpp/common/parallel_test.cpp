@@ -0,0 +1,66 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/common/parallel.hpp"
+
+using namespace pyxir;
+
+TEST_CASE("Test parallel_for covers the full range")
+{
+  std::vector<int> hits(10000, 0);
+  for (int iter = 0; iter < 50; ++iter)
+    parallel_for((ssize_t) hits.size(), 16, [&](ssize_t begin, ssize_t end) {
+      for (ssize_t i = begin; i < end; ++i)
+        hits[i]++;
+    });
+  for (auto h : hits)
+    REQUIRE(h == 50);
+}
+
+TEST_CASE("Test nested parallel_for runs inline")
+{
+  std::atomic<int> total(0);
+  parallel_for(64, 1, [&](ssize_t begin, ssize_t end) {
+    for (ssize_t i = begin; i < end; ++i)
+      parallel_for(100, 1, [&](ssize_t b, ssize_t e) {
+        total += (int) (e - b);
+      });
+  });
+  REQUIRE(total == 6400);
+}
+
+TEST_CASE("Test parallel_for propagates exceptions")
+{
+  REQUIRE_THROWS_AS(
+    parallel_for(1000, 1, [](ssize_t begin, ssize_t end) {
+      if (end == 1000)
+        throw std::runtime_error("last chunk");
+    }),
+    std::runtime_error);
+  // The pool stays usable after an exception
+  std::atomic<int> count(0);
+  parallel_for(1000, 1, [&](ssize_t begin, ssize_t end) {
+    count += (int) (end - begin);
+  });
+  REQUIRE(count == 1000);
+}
@@ -133,3 +133,65 @@ TEST_CASE("Test XBuffer FFI")
 }
 
 
+
+TEST_CASE("Test XBuffer views")
+{
+  std::vector<float> x(24);
+  for (size_t i = 0; i < 24; ++i) x[i] = (float) i;
+  std::vector<ssize_t> shape = {4, 2, 3};
+  pyxir::XBufferHolder xb = pyxir::create_buffer(shape);
+  memcpy(xb->data, &x[0], 24 * sizeof(float));
+
+  // Batch slice shares the parent storage
+  pyxir::XBufferHolder s = pyxir::slice(xb, 0, 1, 3);
+  REQUIRE(s->shape == std::vector<ssize_t>{2, 2, 3});
+  REQUIRE(!s->own_data);
+  REQUIRE(s->is_contiguous());
+  REQUIRE(s->data == (void *) ((float *) xb->data + 6));
+
+  // Selecting a channel results in a strided view
+  pyxir::XBufferHolder c = pyxir::select(xb, 2, 1);
+  REQUIRE(c->shape == std::vector<ssize_t>{4, 2});
+  REQUIRE(!c->is_contiguous());
+  pyxir::XBufferHolder packed = pyxir::ascontiguous(c);
+  REQUIRE(packed->is_contiguous());
+  float *p = (float *) packed->data;
+  for (size_t i = 0; i < 8; ++i)
+    REQUIRE(p[i] == (float) (i * 3 + 1));
+
+  // Contiguous buffers aren't copied
+  REQUIRE(pyxir::ascontiguous(s) == s);
+
+  // Views keep the parent storage alive
+  pyxir::XBufferHolder r = pyxir::reshape(s, std::vector<ssize_t>{-1, 3});
+  xb.reset();
+  s.reset();
+  REQUIRE(r->shape == std::vector<ssize_t>{4, 3});
+  REQUIRE(((float *) r->data)[0] == 6.f);
+  REQUIRE_THROWS(pyxir::reshape(c, std::vector<ssize_t>{8}));
+
+  // Strided copy into a strided destination
+  std::vector<ssize_t> dst_shape = {4, 2, 3};
+  pyxir::XBufferHolder dst = pyxir::create_buffer(dst_shape);
+  memset(dst->data, 0, 24 * sizeof(float));
+  pyxir::XBufferHolder dst_c = pyxir::select(dst, 2, 0);
+  pyxir::copy_buffer(*c, *dst_c);
+  float *d = (float *) dst->data;
+  for (size_t i = 0; i < 8; ++i) {
+    REQUIRE(d[i * 3] == (float) (i * 3 + 1));
+    REQUIRE(d[i * 3 + 1] == 0.f);
+  }
+}
+
+TEST_CASE("Test XBuffer strided copy construction")
+{
+  // Transposed 2x3 view on a 3x2 array
+  std::vector<float> x = {0.f, 1.f, 2.f, 3.f, 4.f, 5.f};
+  pyxir::XBuffer xb((void *) &x[0], 4, "f", 2, std::vector<ssize_t>{2, 3},
+                    std::vector<ssize_t>{4, 8}, true, true);
+  REQUIRE(xb.is_contiguous());
+  REQUIRE(xb.strides == std::vector<ssize_t>{12, 4});
+  float *y = (float *) xb.data;
+  REQUIRE(std::vector<float>(y, y + 6) ==
+          std::vector<float>{0.f, 2.f, 4.f, 1.f, 3.f, 5.f});
+}
@@ -0,0 +1,120 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/quantization/threshold_search.hpp"
+
+using namespace pyxir;
+using namespace pyxir::quantization;
+
+// Reference sum of squared quantization errors
+static double ref_sse(const std::vector<float> &x, double th)
+{
+  double sse = 0.;
+  for (const float &v : x) {
+    double c = std::min(std::max((double) v, -th), th);
+    double q = std::nearbyint(c * 127. / th) * th / 127.;
+    sse += (v - q) * (v - q);
+  }
+  return sse;
+}
+
+static XBufferHolder wrap(std::vector<float> &v, std::vector<ssize_t> shape)
+{
+  return XBufferHolder(new XBuffer((void *) &v[0], 4, "f", shape.size(),
+                                   shape, false, false));
+}
+
+TEST_CASE("Test histogram quantization error")
+{
+  // Few distinct values end up in separate bins and the error is exact
+  std::vector<float> x {0.f, -1.f, 3.f, 4.f, -4.f, 2.5f};
+  AbsHistogram hist = build_abs_histogram(&x[0], 1, x.size(), x.size(), 2048);
+  REQUIRE(hist.max == 4.);
+  for (double th : {4., 3.5, 2., 1.})
+    REQUIRE(histogram_sse(hist, th, 8) == Approx(ref_sse(x, th)).margin(1e-9));
+}
+
+TEST_CASE("Test histogram quantization error bound")
+{
+  // Many values share bins, the error stays within the documented bound
+  std::mt19937 gen(7);
+  std::normal_distribution<float> dist(0.f, 1.f);
+  std::vector<float> x(10000);
+  for (float &v : x)
+    v = dist(gen);
+  const int nb_bins = 512;
+  AbsHistogram hist = build_abs_histogram(&x[0], 1, x.size(), x.size(), nb_bins);
+  const double w = hist.max / nb_bins;
+  for (double th : {hist.max, hist.max / 2, hist.max / 8}) {
+    const double step = th / 127.;
+    const double bound = x.size() * (w + step / 2) * (w + step / 2);
+    REQUIRE(std::fabs(histogram_sse(hist, th, 8) - ref_sse(x, th)) <= bound);
+  }
+}
+
+TEST_CASE("Test MSE threshold search")
+{
+  std::mt19937 gen(0);
+  std::normal_distribution<float> dist(0.f, 1.f);
+  std::vector<float> x(20000);
+  for (float &v : x)
+    v = dist(gen);
+  x[0] = 40.f;
+
+  ThresholdSearchOptions options;
+  AbsHistogram hist = build_abs_histogram(&x[0], 1, x.size(), x.size(),
+                                          options.nb_bins);
+  float th = search_mse_threshold(hist, options);
+
+  // The outlier is clipped and the result is close to the best candidate
+  REQUIRE(th < 40.f);
+  double best = ref_sse(x, 40.);
+  for (int k = 1; k <= options.nb_candidates; ++k)
+    best = std::min(best, ref_sse(x, 40. * k / options.nb_candidates));
+  REQUIRE(ref_sse(x, th) <= best * 1.01);
+}
+
+TEST_CASE("Test batched per channel and per tensor threshold search")
+{
+  // OIHW weights with thresholds along the output channels
+  std::vector<float> w {1.f, 1.f, 0.f, 1.f, 3.f, 4.f, -1.f, 0.f,
+                        0.f, 0.f, 0.f, 0.f};
+  std::vector<float> a {0.5f, -2.f, 1.f, 0.25f};
+  std::vector<XBufferHolder> tensors {wrap(w, {3, 1, 2, 2}), wrap(a, {1, 4})};
+
+  std::vector<std::vector<float>> res =
+    search_mse_thresholds(tensors, {0, PER_TENSOR}, ThresholdSearchOptions());
+
+  REQUIRE(res.size() == 2);
+  REQUIRE(res[0] == std::vector<float>{1.f, 4.f, 0.f});
+  REQUIRE(res[1].size() == 1);
+  REQUIRE(res[1][0] == 2.f);
+
+  REQUIRE_THROWS_AS(
+    search_mse_thresholds(tensors, {4, PER_TENSOR}, ThresholdSearchOptions()),
+    std::invalid_argument);
+}
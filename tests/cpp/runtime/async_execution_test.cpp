@@ -0,0 +1,253 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/async.hpp"
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/runtime_module.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/**
+ * @brief Compute func mocking an accelerator with a fixed latency. Submission
+ *  returns immediately and the job is executed on a separate device thread.
+ */
+RtModHolder get_mock_accelerator_rt_mod(int latency_ms)
+{
+  ComputeFuncInfo cfi = get_mock_compute_func_info(
+    [](FuncState state,
+       std::vector<XBufferHolder> &in_tensors,
+       std::vector<XBufferHolder> &out_tensors) {});
+  cfi.submit_func = [latency_ms](FuncState state,
+                                 std::vector<XBufferHolder> &in_tensors,
+                                 std::vector<XBufferHolder> &out_tensors)
+  {
+    if (in_tensors[0]->size == 0)
+      throw std::invalid_argument("empty input");
+    XBufferHolder in = in_tensors[0], out = out_tensors[0];
+    std::shared_future<void> job = std::async(std::launch::async,
+      [in, out, latency_ms]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms));
+        for (ssize_t i = 0; i < in->size; ++i)
+          ((float *) out->data)[i] = ((float *) in->data)[i] + 1;
+        if (((float *) in->data)[0] < 0)
+          throw std::runtime_error("device error");
+      }).share();
+    return WaitFuncType([job]() { job.get(); });
+  };
+  return get_mock_rt_mod(cfi);
+}
+
+} // namespace
+
+TEST_CASE("Test RuntimeModule execute_async keeps requests in flight")
+{
+  const int latency_ms = 50;
+  const size_t nb_requests = 8;
+  RtModHolder rt_mod = get_mock_accelerator_rt_mod(latency_ms);
+  CompletionExecutor executor(1);
+
+  std::vector<std::vector<XBufferHolder>> ins(nb_requests), outs(nb_requests);
+  std::vector<CompletionHolder> completions;
+  std::vector<ssize_t> shape = {1, 4};
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < nb_requests; ++r) {
+    ins[r].push_back(create_buffer(shape));
+    outs[r].push_back(create_buffer(shape));
+    for (ssize_t i = 0; i < 4; ++i)
+      ((float *) ins[r][0]->data)[i] = (float) r;
+    completions.push_back(rt_mod->execute_async(ins[r], outs[r], executor));
+  }
+  auto submitted = std::chrono::steady_clock::now();
+  for (auto &c : completions)
+    c->wait();
+  auto stop = std::chrono::steady_clock::now();
+
+  // Submission doesn't block on the accelerator
+  REQUIRE(std::chrono::duration<double, std::milli>(submitted - start).count()
+          < latency_ms);
+  // Requests overlap instead of executing back to back
+  REQUIRE(std::chrono::duration<double, std::milli>(stop - start).count()
+          < nb_requests * latency_ms / 2);
+  REQUIRE(executor.in_flight() == 0);
+  for (size_t r = 0; r < nb_requests; ++r)
+    REQUIRE(((float *) outs[r][0]->data)[3] == (float) r + 1);
+}
+
+TEST_CASE("Test RuntimeModule execute_async queues requests on compute funcs"
+          " that aren't reentrant")
+{
+  const int latency_ms = 20;
+  const size_t nb_requests = 6;
+  std::atomic<int> running{0}, max_running{0};
+  std::vector<int> order;
+  ComputeFuncFType compute =
+    [&running, &max_running, &order](FuncState state,
+                                     std::vector<XBufferHolder> &in_tensors,
+                                     std::vector<XBufferHolder> &out_tensors) {
+      int r = ++running;
+      if (r > max_running)
+        max_running = r;
+      order.push_back((int) ((float *) in_tensors[0]->data)[0]);
+      for (ssize_t i = 0; i < in_tensors[0]->size; ++i)
+        ((float *) out_tensors[0]->data)[i] = ((float *) in_tensors[0]->data)[i] + 1;
+      --running;
+    };
+  ComputeFuncInfo cfi = get_mock_compute_func_info(compute);
+  cfi.reentrant = false;
+  // The device executes the request after submission returned
+  cfi.submit_func = [compute, latency_ms](FuncState state,
+                                          std::vector<XBufferHolder> &in_tensors,
+                                          std::vector<XBufferHolder> &out_tensors)
+  {
+    std::vector<XBufferHolder> in(in_tensors), out(out_tensors);
+    std::shared_future<void> job = std::async(std::launch::async,
+      [state, in, out, compute, latency_ms]() mutable {
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms));
+        compute(state, in, out);
+      }).share();
+    return WaitFuncType([job]() { job.get(); });
+  };
+  RtModHolder rt_mod = get_mock_rt_mod(cfi);
+  CompletionExecutor executor(1);
+
+  std::vector<std::vector<XBufferHolder>> ins(nb_requests), outs(nb_requests);
+  std::vector<CompletionHolder> completions;
+  std::vector<ssize_t> shape = {1, 4};
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < nb_requests; ++r) {
+    ins[r].push_back(create_buffer(shape));
+    outs[r].push_back(create_buffer(shape));
+    for (ssize_t i = 0; i < 4; ++i)
+      ((float *) ins[r][0]->data)[i] = (float) r;
+    completions.push_back(rt_mod->execute_async(ins[r], outs[r], executor));
+  }
+  auto submitted = std::chrono::steady_clock::now();
+
+  // Neither the caller nor the executor waits for the queued requests
+  REQUIRE(std::chrono::duration<double, std::milli>(submitted - start).count()
+          < latency_ms);
+  REQUIRE(!completions.back()->ready());
+
+  // Synchronous calls wait for the compute func as well
+  std::vector<XBufferHolder> in {create_buffer(shape)};
+  std::vector<XBufferHolder> out {create_buffer(shape)};
+  ((float *) in[0]->data)[0] = 100.f;
+  rt_mod->execute(in, out);
+  REQUIRE(((float *) out[0]->data)[0] == 101.f);
+
+  for (auto &c : completions)
+    c->wait();
+  REQUIRE(max_running == 1);
+  REQUIRE(order.size() == nb_requests + 1);
+  REQUIRE(order.back() == 100);
+  for (size_t r = 0; r < nb_requests; ++r) {
+    REQUIRE(order[r] == (int) r);
+    REQUIRE(((float *) outs[r][0]->data)[3] == (float) r + 1);
+  }
+}
+
+TEST_CASE("Test RuntimeModule execute_async error reporting")
+{
+  RtModHolder rt_mod = get_mock_accelerator_rt_mod(1);
+  CompletionExecutor executor(1);
+
+  // Error on submission
+  std::vector<ssize_t> empty_shape = {0};
+  std::vector<XBufferHolder> in {create_buffer(empty_shape)};
+  std::vector<XBufferHolder> out {create_buffer(empty_shape)};
+  CompletionHolder c = rt_mod->execute_async(in, out, executor);
+  REQUIRE(c->ready());
+  REQUIRE_THROWS(c->wait());
+
+  // Error on completion
+  std::vector<ssize_t> shape = {1};
+  std::vector<XBufferHolder> in2 {create_buffer(shape)};
+  std::vector<XBufferHolder> out2 {create_buffer(shape)};
+  ((float *) in2[0]->data)[0] = -1.f;
+  CompletionHolder c2 = rt_mod->execute_async(in2, out2, executor);
+  REQUIRE_THROWS(c2->wait());
+}
+
+TEST_CASE("Test Completion continuations")
+{
+  CompletionExecutor executor(1);
+  std::atomic<int> calls{0};
+  CompletionHolder c = executor.submit([]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  });
+  c->then([&calls]() { ++calls; });
+  c->wait();
+  REQUIRE(calls == 1);
+  // Continuations on completed requests run immediately
+  c->then([&calls]() { ++calls; });
+  REQUIRE(calls == 2);
+
+  // Synchronous work results in a ready completion
+  REQUIRE(executor.submit(WaitFuncType())->ready());
+}
+
+TEST_CASE("Test Completion waiters observe finished continuations")
+{
+  CompletionExecutor executor(1);
+  std::atomic<bool> release{false};
+  std::atomic<bool> finished{false};
+  CompletionHolder c = executor.submit([&release]() {
+    while (!release)
+      std::this_thread::yield();
+  });
+  c->then([&finished]() {
+    // A slow continuation must still be done when wait returns
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    finished = true;
+  });
+  release = true;
+  c->wait();
+  REQUIRE(finished);
+  REQUIRE(c->ready());
+}
+
+TEST_CASE("Test Completion reports continuation errors")
+{
+  CompletionExecutor executor(1);
+  std::atomic<bool> release{false};
+  CompletionHolder c = executor.submit([&release]() {
+    while (!release)
+      std::this_thread::yield();
+  });
+  REQUIRE(c->then_if_pending([]() { throw std::runtime_error("continuation"); }));
+  release = true;
+  REQUIRE_THROWS_AS(c->wait(), std::runtime_error);
+  // Continuations aren't registered on completed requests
+  REQUIRE(!c->then_if_pending([]() {}));
+
+  // The executor keeps running after a failing continuation
+  CompletionHolder c2 = executor.submit([]() {});
+  c2->wait();
+  REQUIRE(c2->ready());
+}
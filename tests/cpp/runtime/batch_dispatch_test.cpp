@@ -0,0 +1,265 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/batch_dispatch.hpp"
+#include "pyxir/runtime/run_options.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/** @brief A chunk as seen by a runner: its first sample and its size */
+struct Job {
+  ssize_t begin;
+  ssize_t size;
+};
+
+/**
+ * @brief Mocked runner pool with a fixed batch size that doubles its input
+ *  and records the chunks every runner received, in order. Runners are
+ *  called from worker threads so we don't use REQUIRE inside them.
+ */
+class MockRunnerPool {
+
+  public:
+    MockRunnerPool(size_t nb_runners, ssize_t batch)
+      : jobs_(nb_runners), busy_(nb_runners, false), batch_(batch) {}
+
+    void run(size_t runner_idx, const XBufferHolder &base,
+             std::vector<XBufferHolder> &in_chunk,
+             std::vector<XBufferHolder> &out_chunk)
+    {
+      XBufferHolder &in = in_chunk[0];
+      XBufferHolder &out = out_chunk[0];
+      if (in->shape[0] > batch_)
+        throw std::runtime_error("MockRunner: chunk exceeds runner batch size");
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (busy_[runner_idx])
+          throw std::runtime_error("MockRunner: runner used concurrently");
+        busy_[runner_idx] = true;
+      }
+      const ssize_t row = base->size / base->shape[0];
+      ssize_t begin = ((float *) in->data - (float *) base->data) / row;
+      for (ssize_t i = 0; i < in->size; ++i)
+        ((float *) out->data)[i] = 2 * ((float *) in->data)[i];
+      std::lock_guard<std::mutex> lock(mtx_);
+      jobs_[runner_idx].push_back(Job{begin, in->shape[0]});
+      busy_[runner_idx] = false;
+    }
+
+    std::vector<std::vector<Job>> jobs_;
+
+  private:
+    std::vector<bool> busy_;
+    ssize_t batch_;
+    std::mutex mtx_;
+};
+
+void run_pool(MockRunnerPool &pool, size_t nb_runners, XBufferHolder &in,
+              XBufferHolder &out, ssize_t runner_batch)
+{
+  std::vector<XBufferHolder> in_tensors {in}, out_tensors {out};
+  dispatch_to_runners(in_tensors, out_tensors, runner_batch, nb_runners,
+    [&pool, &in](size_t runner_idx, std::vector<XBufferHolder> &in_chunk,
+                 std::vector<XBufferHolder> &out_chunk) {
+      pool.run(runner_idx, in, in_chunk, out_chunk);
+    });
+}
+
+} // namespace
+
+TEST_CASE("Test batch dispatch over a runner pool")
+{
+  const ssize_t runner_batch = 4;
+  std::vector<ssize_t> shape = {30, 3};
+  XBufferHolder in = create_buffer(shape);
+  XBufferHolder out = create_buffer(shape);
+  for (ssize_t i = 0; i < in->size; ++i)
+    ((float *) in->data)[i] = (float) i;
+
+  // 30 samples result in 8 chunks, the last one being partial
+  MockRunnerPool single(1, runner_batch);
+  run_pool(single, 1, in, out, runner_batch);
+  REQUIRE(single.jobs_[0].size() == 8);
+  for (size_t c = 0; c < 8; ++c) {
+    REQUIRE(single.jobs_[0][c].begin == (ssize_t) c * runner_batch);
+    REQUIRE(single.jobs_[0][c].size == (c < 7 ? runner_batch : 2));
+  }
+  for (ssize_t i = 0; i < out->size; ++i)
+    REQUIRE(((float *) out->data)[i] == 2.f * i);
+
+  // With 4 runners, runner r handles chunks r and r + 4 in that order
+  memset(out->data, 0, out->size * out->itemsize);
+  MockRunnerPool pool(4, runner_batch);
+  run_pool(pool, 4, in, out, runner_batch);
+  for (size_t r = 0; r < 4; ++r) {
+    REQUIRE(pool.jobs_[r].size() == 2);
+    REQUIRE(pool.jobs_[r][0].begin == (ssize_t) r * runner_batch);
+    REQUIRE(pool.jobs_[r][1].begin == (ssize_t) (r + 4) * runner_batch);
+  }
+  REQUIRE(pool.jobs_[3][1].size == 2);
+  for (ssize_t i = 0; i < out->size; ++i)
+    REQUIRE(((float *) out->data)[i] == 2.f * i);
+}
+
+TEST_CASE("Test batch dispatch of batches fitting in one runner")
+{
+  std::vector<ssize_t> shape = {3, 2};
+  XBufferHolder in = create_buffer(shape);
+  XBufferHolder out = create_buffer(shape);
+  MockRunnerPool pool(4, 4);
+  run_pool(pool, 4, in, out, 4);
+  REQUIRE(pool.jobs_[0].size() == 1);
+  REQUIRE(pool.jobs_[0][0].begin == 0);
+  REQUIRE(pool.jobs_[0][0].size == 3);
+  for (size_t r = 1; r < 4; ++r)
+    REQUIRE(pool.jobs_[r].empty());
+}
+
+TEST_CASE("Test batch dispatch runs the runners concurrently")
+{
+  // Every runner waits until all runners have started, which only
+  //  completes if the chunks are executed concurrently
+  std::vector<ssize_t> shape = {8, 1};
+  std::vector<XBufferHolder> in {create_buffer(shape)};
+  std::vector<XBufferHolder> out {create_buffer(shape)};
+  std::mutex mtx;
+  std::condition_variable cv;
+  size_t started = 0;
+  bool all_started = true;
+  dispatch_to_runners(in, out, 2, 4,
+    [&](size_t, std::vector<XBufferHolder> &, std::vector<XBufferHolder> &) {
+      std::unique_lock<std::mutex> lock(mtx);
+      ++started;
+      cv.notify_all();
+      if (!cv.wait_for(lock, std::chrono::seconds(30),
+                       [&started]() { return started == 4; }))
+        all_started = false;
+    });
+  REQUIRE(all_started);
+}
+
+TEST_CASE("Test batch dispatch throughput scales with the number of runners")
+{
+  // 32 samples result in 8 chunks of the runner batch size
+  const ssize_t runner_batch = 4;
+  const int latency_ms = 10;
+  const int nb_requests = 3;
+  std::vector<ssize_t> shape = {32, 3};
+  std::vector<XBufferHolder> in {create_buffer(shape)};
+  for (ssize_t i = 0; i < in[0]->size; ++i)
+    ((float *) in[0]->data)[i] = (float) i;
+
+  std::vector<double> throughput;
+  for (size_t nb_runners : {1, 2, 4}) {
+    std::vector<std::shared_ptr<MockRunner>> runners;
+    for (size_t r = 0; r < nb_runners; ++r)
+      runners.emplace_back(new MockRunner(runner_batch, latency_ms));
+    RtModHolder rt_mod = get_mock_runner_pool_rt_mod(runners, runner_batch);
+
+    std::vector<XBufferHolder> out {create_buffer(shape)};
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < nb_requests; ++r)
+      rt_mod->execute(in, out);
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    throughput.push_back(nb_requests * shape[0] / seconds);
+    WARN(nb_runners << " runner(s): " << throughput.back() << " samples/s");
+
+    for (const std::shared_ptr<MockRunner> &runner : runners)
+      REQUIRE(runner->nb_jobs() == nb_requests * 8 / (int) nb_runners);
+    for (ssize_t i = 0; i < out[0]->size; ++i)
+      REQUIRE(((float *) out[0]->data)[i] == 2.f * i);
+  }
+  // Wall clock timings vary on loaded machines, so only loosely check that
+  //  runners executing concurrently increase the throughput
+  REQUIRE(throughput[2] > throughput[0]);
+}
+
+TEST_CASE("Test batch dispatch error propagation")
+{
+  std::vector<ssize_t> shape = {8, 1};
+  std::vector<XBufferHolder> in {create_buffer(shape)};
+  std::vector<XBufferHolder> out {create_buffer(shape)};
+  REQUIRE_THROWS(dispatch_batch(in, out, 2, 4,
+    [](size_t w, std::vector<XBufferHolder> &in_chunk,
+       std::vector<XBufferHolder> &out_chunk) {
+      if (w == 3)
+        throw std::runtime_error("runner failure");
+    }));
+}
+
+TEST_CASE("Test batch dispatch starting at a given runner")
+{
+  // Small batches run on the first runner, large batches start at it
+  std::vector<ssize_t> shape = {3, 2};
+  std::vector<XBufferHolder> in {create_buffer(shape)};
+  std::vector<XBufferHolder> out {create_buffer(shape)};
+  std::vector<size_t> runners;
+  std::mutex mtx;
+  auto record = [&](size_t runner_idx, std::vector<XBufferHolder> &,
+                    std::vector<XBufferHolder> &) {
+    std::lock_guard<std::mutex> lock(mtx);
+    runners.push_back(runner_idx);
+  };
+  for (size_t r = 0; r < 4; ++r)
+    dispatch_to_runners(in, out, 4, 3, record, r);
+  REQUIRE(runners == std::vector<size_t>{0, 1, 2, 0});
+
+  runners.clear();
+  dispatch_to_runners(in, out, 1, 2, record, 1);
+  std::sort(runners.begin(), runners.end());
+  REQUIRE(runners == std::vector<size_t>{0, 1, 1});
+}
+
+TEST_CASE("Test batch dispatch reuses its worker threads")
+{
+  DispatchWorkers workers;
+  std::vector<ssize_t> shape = {8, 1};
+  std::vector<XBufferHolder> in {create_buffer(shape)};
+  std::vector<XBufferHolder> out {create_buffer(shape)};
+  std::vector<std::vector<std::thread::id>> ids(2, std::vector<std::thread::id>(4));
+  for (size_t call = 0; call < 2; ++call)
+    dispatch_batch(in, out, 2, 4,
+      [&ids, call](size_t w, std::vector<XBufferHolder> &,
+                   std::vector<XBufferHolder> &) {
+        ids[call][w] = std::this_thread::get_id();
+      }, workers);
+  // Worker w runs on the same thread for every call
+  REQUIRE(ids[0] == ids[1]);
+  REQUIRE(ids[0][0] == std::this_thread::get_id());
+  REQUIRE(ids[0][1] != ids[0][2]);
+}
+
+TEST_CASE("Test RunOptions number of DPU runners")
+{
+  RunOptions run_options;
+  REQUIRE(run_options.nb_dpu_runners == 1);
+}
@@ -0,0 +1,170 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Built as part of the C++20 coroutine test target, see tests/CMakeLists.txt
+
+#include "pyxir/runtime/async.hpp"
+
+#ifdef PX_HAS_COROUTINES
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/runtime_module.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/** @brief Eagerly started coroutine which nobody waits on */
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+/**
+ * @brief Await the completion and record whether the coroutine got past the
+ *  co_await, on which thread it continued and whether the request failed
+ */
+DetachedTask await_completion(CompletionHolder completion,
+                              std::atomic<bool> &resumed,
+                              std::promise<std::thread::id> &resumed_on,
+                              bool &failed)
+{
+  try {
+    co_await completion;
+  } catch (const std::runtime_error &) {
+    failed = true;
+  }
+  resumed = true;
+  resumed_on.set_value(std::this_thread::get_id());
+}
+
+DetachedTask execute_and_await(RuntimeModule *rt_mod,
+                               std::vector<XBufferHolder> &in_tensors,
+                               std::vector<XBufferHolder> &out_tensors,
+                               CompletionExecutor &executor,
+                               std::promise<void> &done)
+{
+  co_await rt_mod->execute_async(in_tensors, out_tensors, executor);
+  done.set_value();
+}
+
+} // namespace
+
+TEST_CASE("Test co_await suspends on pending completions")
+{
+  CompletionExecutor executor(1);
+  std::atomic<bool> release{false};
+  std::promise<std::thread::id> job_thread;
+  CompletionHolder c = executor.submit([&release, &job_thread]() {
+    job_thread.set_value(std::this_thread::get_id());
+    while (!release)
+      std::this_thread::yield();
+  });
+
+  std::atomic<bool> resumed{false};
+  std::promise<std::thread::id> resumed_on;
+  bool failed = false;
+  await_completion(c, resumed, resumed_on, failed);
+  // The coroutine is suspended until the request completes
+  REQUIRE(!resumed);
+  REQUIRE(!c->ready());
+
+  release = true;
+  std::thread::id resumed_id = resumed_on.get_future().get();
+  REQUIRE(resumed);
+  REQUIRE(!failed);
+  // and is resumed on the executor thread which completed it
+  REQUIRE(resumed_id == job_thread.get_future().get());
+  REQUIRE(resumed_id != std::this_thread::get_id());
+  c->wait();
+}
+
+TEST_CASE("Test co_await on ready completions doesn't suspend")
+{
+  std::atomic<bool> resumed{false};
+  std::promise<std::thread::id> resumed_on;
+  bool failed = false;
+  await_completion(Completion::Ready(), resumed, resumed_on, failed);
+  REQUIRE(resumed);
+  REQUIRE(!failed);
+  REQUIRE(resumed_on.get_future().get() == std::this_thread::get_id());
+}
+
+TEST_CASE("Test co_await rethrows request errors")
+{
+  CompletionExecutor executor(1);
+  std::atomic<bool> release{false};
+  CompletionHolder c = executor.submit([&release]() {
+    while (!release)
+      std::this_thread::yield();
+    throw std::runtime_error("device error");
+  });
+
+  std::atomic<bool> resumed{false};
+  std::promise<std::thread::id> resumed_on;
+  bool failed = false;
+  await_completion(c, resumed, resumed_on, failed);
+  REQUIRE(!resumed);
+  release = true;
+  REQUIRE(resumed_on.get_future().get() != std::this_thread::get_id());
+  REQUIRE(failed);
+}
+
+TEST_CASE("Test co_await on RuntimeModule execute_async")
+{
+  RtModHolder rt_mod = get_mock_rt_mod(get_mock_compute_func_info(
+    [](FuncState state,
+       std::vector<XBufferHolder> &in_tensors,
+       std::vector<XBufferHolder> &out_tensors) {
+      for (ssize_t i = 0; i < in_tensors[0]->size; ++i)
+        ((float *) out_tensors[0]->data)[i] =
+          ((float *) in_tensors[0]->data)[i] * 2;
+    }));
+  CompletionExecutor executor(2);
+
+  const size_t nb_requests = 16;
+  std::vector<ssize_t> shape = {1, 4};
+  std::vector<std::vector<XBufferHolder>> ins(nb_requests), outs(nb_requests);
+  std::vector<std::promise<void>> done(nb_requests);
+  for (size_t r = 0; r < nb_requests; ++r) {
+    ins[r].push_back(create_buffer(shape));
+    outs[r].push_back(create_buffer(shape));
+    for (ssize_t i = 0; i < 4; ++i)
+      ((float *) ins[r][0]->data)[i] = (float) r;
+    execute_and_await(rt_mod.get(), ins[r], outs[r], executor, done[r]);
+  }
+  for (size_t r = 0; r < nb_requests; ++r) {
+    done[r].get_future().get();
+    REQUIRE(((float *) outs[r][0]->data)[3] == 2.f * r);
+  }
+}
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/graph/xlayer.hpp"
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/kernel_func_factory.hpp"
+
+using namespace pyxir;
+using namespace pyxir::graph;
+using namespace pyxir::runtime;
+
+template <typename T>
+static XBufferHolder wrap(std::vector<T> &v, std::vector<ssize_t> shape,
+                          const std::string &format)
+{
+  return XBufferHolder(new XBuffer((void *) &v[0], sizeof(T), format,
+                                   shape.size(), shape, false, false));
+}
+
+static XLayerHolder make_xlayer(const std::string &op_type)
+{
+  return XLayerHolder(new XLayer("q", std::vector<std::string>{op_type}));
+}
+
+TEST_CASE("Test Quantize kernel func with per channel thresholds")
+{
+  XLayerHolder X = make_xlayer("Quantize");
+  X->set_attr("quant_threshold",
+              XAttr("quant_threshold", std::vector<double>{1., 2.}));
+  X->set_attr("quant_bitwidth", XAttr("quant_bitwidth", 8));
+  X->set_attr("axis", XAttr("axis", 1));
+  X->set_attr("dtype", XAttr("dtype", std::string("int8")));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Quantize", X);
+
+  // Channel 0 has factor 127, channel 1 has factor 63.5
+  std::vector<float> x {-2.f, -0.5f, 0.5f, 1.5f, -4.f, 1.f, 0.5f, 3.f};
+  std::vector<XBufferHolder> in {wrap(x, {1, 2, 4}, "f")};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->format == "b");
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 2, 4});
+  // Halfway cases are rounded to even like tf.round
+  std::vector<int8_t> ref {-127, -64, 64, 127, -127, 64, 32, 127};
+  int8_t *y = (int8_t *) out[0]->data;
+  for (size_t i = 0; i < ref.size(); ++i)
+    REQUIRE(y[i] == ref[i]);
+}
+
+TEST_CASE("Test Quantize kernel func into a strided output view")
+{
+  XLayerHolder X = make_xlayer("Quantize");
+  X->set_attr("quant_threshold", XAttr("quant_threshold", 1.));
+  X->set_attr("dtype", XAttr("dtype", std::string("int8")));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Quantize", X);
+
+  std::vector<float> x {-1.f, -0.5f, 0.f, 0.5f, 1.f, 2.f};
+  std::vector<XBufferHolder> in {wrap(x, {3, 2}, "f")};
+  // Every row of the output view skips two elements of its parent
+  std::vector<ssize_t> parent_shape {3, 4};
+  XBufferHolder parent = create_buffer(parent_shape, 1, "b");
+  std::memset(parent->data, 0, 12);
+  std::vector<ssize_t> view_shape {3, 2};
+  std::vector<XBufferHolder> out {
+    create_view(parent, parent->data, view_shape, parent->strides)};
+  (*kf)(in, out);
+
+  std::vector<int8_t> ref {-127, -64, 0, 0, 0, 64, 0, 0, 127, 127, 0, 0};
+  int8_t *y = (int8_t *) parent->data;
+  for (size_t i = 0; i < ref.size(); ++i)
+    REQUIRE(y[i] == ref[i]);
+
+  // Outputs of the wrong size are rejected
+  std::vector<ssize_t> wrong_shape {3, 3};
+  std::vector<XBufferHolder> wrong {create_buffer(wrong_shape, 1, "b")};
+  REQUIRE_THROWS_AS((*kf)(in, wrong), std::invalid_argument);
+}
+
+TEST_CASE("Test UnQuantize kernel func")
+{
+  XLayerHolder X = make_xlayer("UnQuantize");
+  X->set_attr("quant_threshold",
+              XAttr("quant_threshold", std::vector<double>{2.}));
+  X->set_attr("quant_bitwidth", XAttr("quant_bitwidth", 8));
+  X->set_attr("axis", XAttr("axis", 1));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.UnQuantize", X);
+
+  std::vector<int8_t> x {-127, 0, 64, 127};
+  std::vector<XBufferHolder> in {wrap(x, {1, 2, 2}, "b")};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->format == "f");
+  float *y = (float *) out[0]->data;
+  REQUIRE(y[0] == Approx(-2.f));
+  REQUIRE(y[1] == 0.f);
+  REQUIRE(y[2] == Approx(128.f / 127.f));
+  REQUIRE(y[3] == Approx(2.f));
+}
+
+TEST_CASE("Test QuantizeBias kernel func")
+{
+  XLayerHolder X = make_xlayer("QuantizeBias");
+  X->set_attr("quant_threshold", XAttr("quant_threshold", 127.));
+  X->set_attr("quant_th_params",
+              XAttr("quant_th_params", std::vector<double>{127., 254.}));
+  X->set_attr("quant_bitwidth", XAttr("quant_bitwidth", 8));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.QuantizeBias", X);
+
+  // The accumulator scales are 1 and 2, thresholds are tiled over 4 channels
+  std::vector<float> x {3.4f, 5.f, -1e8f, 1e8f};
+  std::vector<XBufferHolder> in {wrap(x, {4}, "f")};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->format == "i");
+  int32_t *y = (int32_t *) out[0]->data;
+  REQUIRE(y[0] == 3);
+  REQUIRE(y[1] == 2);
+  REQUIRE(y[2] == -8388607);
+  REQUIRE(y[3] == 8388607);
+}
+
+TEST_CASE("Test QuantizeInter kernel func")
+{
+  XLayerHolder X = make_xlayer("QuantizeInter");
+  X->set_attr("quant_scale", XAttr("quant_scale", std::vector<int64_t>{3}));
+  X->set_attr("quant_postscale_shift",
+              XAttr("quant_postscale_shift", std::vector<int64_t>{2}));
+  X->set_attr("quant_prescale_shift",
+              XAttr("quant_prescale_shift", std::vector<int64_t>{0}));
+  X->set_attr("quant_bitwidth", XAttr("quant_bitwidth", 8));
+  X->set_attr("axis", XAttr("axis", 1));
+  X->set_attr("dtype", XAttr("dtype", std::string("int8")));
+
+  // Float accumulators are truncated before scaling
+  std::vector<float> x {100.f, -100.f, 1000.f, 7.9f};
+  std::vector<XBufferHolder> in {wrap(x, {1, 2, 2}, "f")};
+
+  SECTION("Without activation")
+  {
+    KernelFuncHolder kf =
+      KernelFuncFactory::GetKernelFunc("cpu.QuantizeInter", X);
+    std::vector<XBufferHolder> out;
+    (*kf)(in, out);
+    std::vector<int8_t> ref {75, -75, 127, 5};
+    for (size_t i = 0; i < ref.size(); ++i)
+      REQUIRE(((int8_t *) out[0]->data)[i] == ref[i]);
+  }
+
+  SECTION("With ReLU into a provided output")
+  {
+    X->set_attr("activation", XAttr("activation", std::string("ReLU")));
+    KernelFuncHolder kf =
+      KernelFuncFactory::GetKernelFunc("cpu.QuantizeInter", X);
+    std::vector<int8_t> y(4, 1);
+    std::vector<XBufferHolder> out {wrap(y, {1, 2, 2}, "b")};
+    (*kf)(in, out);
+    std::vector<int8_t> ref {75, 0, 127, 5};
+    for (size_t i = 0; i < ref.size(); ++i)
+      REQUIRE(y[i] == ref[i]);
+  }
+
+  SECTION("Negative postscale shifts are rejected")
+  {
+    X->set_attr("quant_postscale_shift",
+                XAttr("quant_postscale_shift", std::vector<int64_t>{-1}));
+    REQUIRE_THROWS_AS(KernelFuncFactory::GetKernelFunc("cpu.QuantizeInter", X),
+                      std::invalid_argument);
+  }
+}
@@ -0,0 +1,177 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <unistd.h>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/inference_server.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/** @brief Mock model doubling its [N, 4] input and recording batch sizes */
+SharedRtModHolder get_double_rt_mod(std::shared_ptr<std::vector<ssize_t>> batch_sizes)
+{
+  std::shared_ptr<std::mutex> mtx(new std::mutex());
+  return get_mock_rt_mod([batch_sizes, mtx](FuncState state,
+                                            std::vector<XBufferHolder> &in_tensors,
+                                            std::vector<XBufferHolder> &out_tensors)
+  {
+    float *in = (float *) in_tensors[0]->data;
+    if (in[0] < 0)
+      throw std::runtime_error("negative input");
+    for (ssize_t i = 0; i < in_tensors[0]->size; ++i)
+      ((float *) out_tensors[0]->data)[i] = 2 * in[i];
+    std::lock_guard<std::mutex> lock(*mtx);
+    batch_sizes->push_back(in_tensors[0]->shape[0]);
+  });
+}
+
+InferenceServerOptions get_options()
+{
+  InferenceServerOptions options;
+  options.in_shapes = {{1, 4}};
+  options.out_shapes = {{1, 4}};
+  options.max_batch_size = 4;
+  options.batch_timeout_us = 20000;
+  return options;
+}
+
+std::string get_socket_path()
+{
+  return "/tmp/pyxir_server_test_" + std::to_string(getpid()) + ".sock";
+}
+
+} // namespace
+
+TEST_CASE("Test InferenceServer batches requests across clients")
+{
+  std::shared_ptr<std::vector<ssize_t>> batch_sizes(new std::vector<ssize_t>());
+  std::string path = get_socket_path();
+  InferenceServer server(get_double_rt_mod(batch_sizes), path, get_options());
+  server.start();
+
+  std::atomic<int> errors(0);
+  std::vector<std::thread> clients;
+  for (int c = 0; c < 4; ++c) {
+    clients.emplace_back([c, &path, &errors]() {
+      InferenceClient client(path);
+      for (int r = 0; r < 5; ++r) {
+        std::vector<ssize_t> shape = {1, 4};
+        std::vector<XBufferHolder> in{create_buffer(shape)}, out;
+        for (int i = 0; i < 4; ++i)
+          ((float *) in[0]->data)[i] = c * 100 + r * 10 + i;
+        client.execute(in, out);
+        for (int i = 0; i < 4; ++i)
+          if (((float *) out[0]->data)[i] != 2 * (c * 100 + r * 10 + i))
+            ++errors;
+      }
+    });
+  }
+  for (auto &c : clients)
+    c.join();
+  REQUIRE(errors == 0);
+
+  InferenceServerStats stats = server.get_stats();
+  REQUIRE(stats.clients == 4);
+  REQUIRE(stats.requests == 20);
+  REQUIRE(stats.failed == 0);
+  REQUIRE(stats.batches == batch_sizes->size());
+  REQUIRE(stats.batches < 20);
+  server.stop();
+}
+
+TEST_CASE("Test InferenceClient shared memory slots")
+{
+  std::shared_ptr<std::vector<ssize_t>> batch_sizes(new std::vector<ssize_t>());
+  std::string path = get_socket_path();
+  InferenceServerOptions options = get_options();
+  options.batch_timeout_us = 0;
+  InferenceServer server(get_double_rt_mod(batch_sizes), path, options);
+  server.start();
+
+  InferenceClient client(path, 2);
+  REQUIRE(client.nb_slots() == 2);
+  for (size_t s = 0; s < 2; ++s) {
+    float *in = (float *) client.get_inputs(s)[0]->data;
+    for (int i = 0; i < 4; ++i)
+      in[i] = s * 10 + i;
+    client.submit(s);
+  }
+  client.wait(1);
+  client.wait(0);
+  for (size_t s = 0; s < 2; ++s) {
+    float *out = (float *) client.get_outputs(s)[0]->data;
+    for (int i = 0; i < 4; ++i)
+      REQUIRE(out[i] == 2 * (s * 10 + i));
+  }
+
+  // Execution errors are reported to the client
+  ((float *) client.get_inputs(0)[0]->data)[0] = -1;
+  client.submit(0);
+  REQUIRE_THROWS_AS(client.wait(0), std::runtime_error);
+  REQUIRE(server.get_stats().failed >= 1);
+  REQUIRE_THROWS_AS(client.wait(0), std::invalid_argument);
+}
+
+TEST_CASE("Test InferenceServer reaps disconnected clients")
+{
+  std::shared_ptr<std::vector<ssize_t>> batch_sizes(new std::vector<ssize_t>());
+  std::string path = get_socket_path();
+  InferenceServer server(get_double_rt_mod(batch_sizes), path, get_options());
+  server.start();
+
+  for (int c = 0; c < 3; ++c) {
+    InferenceClient client(path);
+    std::vector<ssize_t> shape = {1, 4};
+    std::vector<XBufferHolder> in{create_buffer(shape)}, out;
+    for (int i = 0; i < 4; ++i)
+      ((float *) in[0]->data)[i] = i;
+    client.execute(in, out);
+  }
+  for (int i = 0; i < 200 && server.get_stats().connected > 0; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  InferenceServerStats stats = server.get_stats();
+  REQUIRE(stats.clients == 3);
+  REQUIRE(stats.connected == 0);
+  server.stop();
+}
+
+TEST_CASE("Test SharedMemory only opens segments")
+{
+  REQUIRE_THROWS_AS(SharedMemory::Open("/etc/passwd"), std::invalid_argument);
+  REQUIRE_THROWS_AS(SharedMemory::Open(SharedMemory::Prefix() + "x/../y"),
+                    std::invalid_argument);
+  std::unique_ptr<SharedMemory> shm(SharedMemory::Create(64));
+  REQUIRE(SharedMemory::IsSegmentPath(shm->path()));
+  std::unique_ptr<SharedMemory> other(SharedMemory::Open(shm->path()));
+  REQUIRE(other->size() == 64);
+}
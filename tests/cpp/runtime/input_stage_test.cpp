@@ -0,0 +1,294 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/input_stage.hpp"
+#include "pyxir/runtime/runtime_module.hpp"
+#include "pyxir/runtime/kernel_func_factory.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+TEST_CASE("Test Preprocess kernel func normalisation and layout")
+{
+  InputStageOptions options;
+  options.mean = std::vector<double>{1., 2., 3.};
+  options.scale = std::vector<double>{0.5};
+  options.swap_rb = true;
+  XLayerHolder X = options.to_xlayer();
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Preprocess", X);
+
+  // One 1x2 BGR frame
+  std::vector<uint8_t> frame = {10, 20, 30, 40, 50, 60};
+  std::vector<XBufferHolder> in {XBufferHolder(
+    new XBuffer((void *) &frame[0], 1, "B", 4, std::vector<ssize_t>{1, 1, 2, 3},
+                false, false))};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 3, 1, 2});
+  float *y = (float *) out[0]->data;
+  // R channel comes from the third input channel and uses the third mean
+  REQUIRE(y[0] == Approx((30 - 3) * 0.5));
+  REQUIRE(y[1] == Approx((60 - 3) * 0.5));
+  REQUIRE(y[2] == Approx((20 - 2) * 0.5));
+  REQUIRE(y[4] == Approx((10 - 1) * 0.5));
+  REQUIRE(y[5] == Approx((40 - 1) * 0.5));
+}
+
+TEST_CASE("Test Preprocess kernel func resize")
+{
+  InputStageOptions options;
+  options.size = std::vector<int64_t>{2, 2};
+  options.layout = "NHWC";
+  XLayerHolder X = options.to_xlayer();
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Preprocess", X);
+
+  // Constant 4x4 single channel frame
+  std::vector<uint8_t> frame(16, 20);
+  std::vector<XBufferHolder> in {XBufferHolder(
+    new XBuffer((void *) &frame[0], 1, "B", 4, std::vector<ssize_t>{1, 4, 4, 1},
+                false, false))};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 2, 2, 1});
+  float *y = (float *) out[0]->data;
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(y[i] == Approx(20.f));
+}
+
+TEST_CASE("Test Preprocess kernel func quantization")
+{
+  InputStageOptions options;
+  options.mean = std::vector<double>{100.};
+  options.quantize = true;
+  options.fix_point = 1;
+  XLayerHolder X = options.to_xlayer();
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Preprocess", X);
+
+  std::vector<uint8_t> frame = {120, 20, 255, 101};
+  std::vector<XBufferHolder> in {XBufferHolder(
+    new XBuffer((void *) &frame[0], 1, "B", 4, std::vector<ssize_t>{1, 1, 2, 2},
+                false, false))};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  // q = (x - mean) * 2^fix_point, saturated to the int8 range
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 2, 1, 2});
+  REQUIRE(out[0]->format == "b");
+  int8_t *y = (int8_t *) out[0]->data;
+  REQUIRE(std::vector<int8_t>(y, y + 4) == std::vector<int8_t>{40, 127, -128, 2});
+}
+
+TEST_CASE("Test RuntimeModule input stage")
+{
+  RtModHolder rt_mod = get_mock_rt_mod([](FuncState state,
+                                           std::vector<XBufferHolder> &in_tensors,
+                                           std::vector<XBufferHolder> &out_tensors)
+  {
+    // Identity compute func checking that it receives the preprocessed input
+    REQUIRE(in_tensors[0]->shape == std::vector<ssize_t>{1, 1, 2, 2});
+    memcpy(out_tensors[0]->data, in_tensors[0]->data, 4 * sizeof(float));
+  });
+
+  InputStageOptions options;
+  options.scale = std::vector<double>{1. / 255};
+  rt_mod->set_input_stage(options);
+  REQUIRE(rt_mod->has_input_stage());
+
+  std::vector<uint8_t> frame = {0, 255, 255, 0};
+  std::vector<float> res(4, -1.f);
+  std::vector<XBufferHolder> in {XBufferHolder(
+    new XBuffer((void *) &frame[0], 1, "B", 4, std::vector<ssize_t>{1, 2, 2, 1},
+                false, false))};
+  std::vector<XBufferHolder> out {XBufferHolder(
+    new XBuffer((void *) &res[0], 4, "f", 4, std::vector<ssize_t>{1, 1, 2, 2},
+                false, false))};
+  rt_mod->execute(in, out);
+  REQUIRE(res == std::vector<float>{0.f, 1.f, 1.f, 0.f});
+
+  rt_mod->clear_input_stage();
+  REQUIRE(!rt_mod->has_input_stage());
+}
+
+TEST_CASE("Test RuntimeModule input stage rejects quantization for float compute funcs")
+{
+  RtModHolder rt_mod = get_mock_rt_mod([](FuncState state,
+                                           std::vector<XBufferHolder> &in_tensors,
+                                           std::vector<XBufferHolder> &out_tensors) {});
+  InputStageOptions options;
+  options.quantize = true;
+  REQUIRE_THROWS_AS(rt_mod->set_input_stage(options), std::invalid_argument);
+  REQUIRE(!rt_mod->has_input_stage());
+}
+
+TEST_CASE("Test RuntimeModule input stage quantizes into the compute func inputs")
+{
+  // Compute func taking int8 inputs like a DPU runner, recording the
+  //  buffer it reads from
+  std::vector<void *> in_data;
+  ComputeFuncInfo cfi = get_mock_compute_func_info(
+    [&in_data](FuncState state,
+               std::vector<XBufferHolder> &in_tensors,
+               std::vector<XBufferHolder> &out_tensors) {
+      REQUIRE(in_tensors[0]->format == "b");
+      in_data.push_back(in_tensors[0]->data);
+      for (ssize_t i = 0; i < 4; ++i)
+        ((float *) out_tensors[0]->data)[i] = ((int8_t *) in_tensors[0]->data)[i];
+    });
+  cfi.quantized_inputs_func = [](FuncState state) { return true; };
+  RtModHolder rt_mod = get_mock_rt_mod(cfi);
+
+  InputStageOptions options;
+  options.scale = std::vector<double>{1. / 64};
+  options.quantize = true;
+  options.fix_point = 6;
+  rt_mod->set_input_stage(options);
+
+  std::vector<uint8_t> frame = {0, 1, 100, 127};
+  std::vector<float> res(4, -1.f);
+  std::vector<XBufferHolder> in {XBufferHolder(
+    new XBuffer((void *) &frame[0], 1, "B", 4, std::vector<ssize_t>{1, 2, 2, 1},
+                false, false))};
+  std::vector<XBufferHolder> out {XBufferHolder(
+    new XBuffer((void *) &res[0], 4, "f", 4, std::vector<ssize_t>{1, 1, 2, 2},
+                false, false))};
+  rt_mod->execute(in, out);
+  REQUIRE(res == std::vector<float>{0.f, 1.f, 100.f, 127.f});
+
+  // The stage writes every request into the same compute func input buffer
+  frame[0] = 3;
+  rt_mod->execute(in, out);
+  REQUIRE(res[0] == 3.f);
+  REQUIRE(in_data.size() == 2);
+  REQUIRE(in_data[0] == in_data[1]);
+}
+
+TEST_CASE("Test Preprocess kernel func validates provided output buffers")
+{
+  InputStageOptions options;
+  options.layout = "NHWC";
+  XLayerHolder X = options.to_xlayer();
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Preprocess", X);
+
+  std::vector<uint8_t> frame(4, 20);
+  std::vector<XBufferHolder> in {XBufferHolder(
+    new XBuffer((void *) &frame[0], 1, "B", 4, std::vector<ssize_t>{1, 2, 2, 1},
+                false, false))};
+  // An int8 buffer can't hold the float output
+  std::vector<ssize_t> shape = {1, 2, 2, 1};
+  std::vector<XBufferHolder> out {create_buffer(shape, 1, "b")};
+  REQUIRE_THROWS_AS((*kf)(in, out), std::invalid_argument);
+
+  // Neither can an undersized float buffer
+  std::vector<ssize_t> small_shape = {1, 2, 1, 1};
+  out[0] = create_buffer(small_shape);
+  REQUIRE_THROWS_AS((*kf)(in, out), std::invalid_argument);
+}
+
+TEST_CASE("Test RuntimeModule input stage with concurrent requests")
+{
+  RtModHolder rt_mod = get_mock_rt_mod([](FuncState state,
+                                           std::vector<XBufferHolder> &in_tensors,
+                                           std::vector<XBufferHolder> &out_tensors)
+  {
+    // Give concurrent requests the chance to overwrite the stage output
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    memcpy(out_tensors[0]->data, in_tensors[0]->data, 4 * sizeof(float));
+  });
+  rt_mod->set_input_stage(InputStageOptions());
+
+  std::vector<std::thread> threads;
+  std::vector<int> mismatches(4, 0);
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&rt_mod, &mismatches, t]() {
+      std::vector<uint8_t> frame(4, (uint8_t) (10 * (t + 1)));
+      std::vector<float> res(4, -1.f);
+      std::vector<XBufferHolder> in {XBufferHolder(
+        new XBuffer((void *) &frame[0], 1, "B", 4,
+                    std::vector<ssize_t>{1, 2, 2, 1}, false, false))};
+      std::vector<XBufferHolder> out {XBufferHolder(
+        new XBuffer((void *) &res[0], 4, "f", 4,
+                    std::vector<ssize_t>{1, 1, 2, 2}, false, false))};
+      for (int i = 0; i < 20; ++i) {
+        rt_mod->execute(in, out);
+        if (res != std::vector<float>(4, (float) frame[0]))
+          mismatches[t]++;
+      }
+    });
+  }
+  for (std::thread &t : threads)
+    t.join();
+  REQUIRE(mismatches == std::vector<int>(4, 0));
+}
+
+TEST_CASE("Test RuntimeModule input stage replaced while serving requests")
+{
+  RtModHolder rt_mod = get_mock_rt_mod([](FuncState state,
+                                           std::vector<XBufferHolder> &in_tensors,
+                                           std::vector<XBufferHolder> &out_tensors)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    memcpy(out_tensors[0]->data, in_tensors[0]->data, 4 * sizeof(float));
+  });
+  InputStageOptions single, twice;
+  twice.scale = std::vector<double>{2.};
+  rt_mod->set_input_stage(single);
+
+  // Every request runs with either input stage from start to end
+  std::atomic<bool> done{false};
+  std::vector<int> mismatches(4, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&rt_mod, &mismatches, &done, t]() {
+      std::vector<uint8_t> frame(4, (uint8_t) (10 * (t + 1)));
+      std::vector<float> res(4, -1.f);
+      std::vector<XBufferHolder> in {XBufferHolder(
+        new XBuffer((void *) &frame[0], 1, "B", 4,
+                    std::vector<ssize_t>{1, 2, 2, 1}, false, false))};
+      std::vector<XBufferHolder> out {XBufferHolder(
+        new XBuffer((void *) &res[0], 4, "f", 4,
+                    std::vector<ssize_t>{1, 1, 2, 2}, false, false))};
+      while (!done) {
+        rt_mod->execute(in, out);
+        if (res != std::vector<float>(4, (float) frame[0])
+            && res != std::vector<float>(4, 2.f * frame[0]))
+          mismatches[t]++;
+      }
+    });
+  }
+  for (int i = 0; i < 50; ++i) {
+    rt_mod->set_input_stage(i % 2 ? single : twice);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  done = true;
+  for (std::thread &t : threads)
+    t.join();
+  REQUIRE(mismatches == std::vector<int>(4, 0));
+  REQUIRE(rt_mod->has_input_stage());
+}
@@ -0,0 +1,117 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <memory>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/runtime_module.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+RtModHolder get_add_one_rt_mod(bool replace_outputs)
+{
+  if (replace_outputs) {
+    // Compute func handing back its own output buffers
+    return get_mock_rt_mod([](FuncState state,
+                              std::vector<XBufferHolder> &in_tensors,
+                              std::vector<XBufferHolder> &out_tensors)
+    {
+      std::vector<ssize_t> shape(in_tensors[0]->shape);
+      out_tensors[0] = create_buffer(shape);
+      for (ssize_t i = 0; i < in_tensors[0]->size; ++i)
+        ((float *) out_tensors[0]->data)[i] = ((float *) in_tensors[0]->data)[i] + 1;
+    });
+  }
+  return get_mock_rt_mod([](FuncState state,
+                            std::vector<XBufferHolder> &in_tensors,
+                            std::vector<XBufferHolder> &out_tensors)
+  {
+    for (ssize_t i = 0; i < in_tensors[0]->size; ++i)
+      ((float *) out_tensors[0]->data)[i] = ((float *) in_tensors[0]->data)[i] + 1;
+  });
+}
+
+} // namespace
+
+TEST_CASE("Test RuntimeModule execute on bound buffers")
+{
+  RtModHolder rt_mod = get_add_one_rt_mod(false);
+
+  std::vector<float> in_data = {1.f, 2.f, 3.f, 4.f};
+  std::vector<float> out_data(4, 0.f);
+  rt_mod->bind_inputs(std::vector<XBufferHolder>{XBufferHolder(
+    new XBuffer((void *) &in_data[0], 4, "f", 2, std::vector<ssize_t>{1, 4},
+                false, false))});
+  rt_mod->bind_outputs(std::vector<XBufferHolder>{XBufferHolder(
+    new XBuffer((void *) &out_data[0], 4, "f", 2, std::vector<ssize_t>{1, 4},
+                false, false))});
+
+  rt_mod->execute();
+  REQUIRE(out_data == std::vector<float>{2.f, 3.f, 4.f, 5.f});
+
+  // Only update the input contents between runs
+  in_data[0] = 10.f;
+  rt_mod->execute();
+  REQUIRE(out_data == std::vector<float>{11.f, 3.f, 4.f, 5.f});
+
+  // Explicit inputs with bound outputs
+  std::vector<float> in_data_2(4, 0.f);
+  std::vector<XBufferHolder> in {XBufferHolder(
+    new XBuffer((void *) &in_data_2[0], 4, "f", 2, std::vector<ssize_t>{1, 4},
+                false, false))};
+  std::vector<XBufferHolder> out;
+  rt_mod->execute(in, out);
+  REQUIRE(out[0]->data == (void *) &out_data[0]);
+  REQUIRE(out_data == std::vector<float>{1.f, 1.f, 1.f, 1.f});
+
+  rt_mod->clear_bindings();
+  REQUIRE_THROWS(rt_mod->execute());
+}
+
+TEST_CASE("Test RuntimeModule bound outputs with replaced buffers")
+{
+  RtModHolder rt_mod = get_add_one_rt_mod(true);
+
+  std::vector<float> in_data = {1.f, 2.f};
+  std::vector<float> out_data(2, 0.f);
+  rt_mod->bind_inputs(std::vector<XBufferHolder>{XBufferHolder(
+    new XBuffer((void *) &in_data[0], 4, "f", 1, std::vector<ssize_t>{2},
+                false, false))});
+  rt_mod->bind_outputs(std::vector<XBufferHolder>{XBufferHolder(
+    new XBuffer((void *) &out_data[0], 4, "f", 1, std::vector<ssize_t>{2},
+                false, false))});
+
+  rt_mod->execute();
+  REQUIRE(out_data == std::vector<float>{2.f, 3.f});
+}
+
+TEST_CASE("Test RuntimeModule binding validation")
+{
+  RtModHolder rt_mod = get_add_one_rt_mod(false);
+  REQUIRE_THROWS(rt_mod->bind_inputs(std::vector<XBufferHolder>{}));
+  std::vector<ssize_t> shape = {1};
+  REQUIRE_THROWS(rt_mod->bind_outputs(std::vector<XBufferHolder>{
+    create_buffer(shape), create_buffer(shape)}));
+}
@@ -0,0 +1,219 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <memory>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/runtime_module.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/** @brief Model doubling its input through an intermediate buffer of 1KB
+    per sample, the allocators it executes with are recorded in `seen` */
+RtModHolder get_rt_mod(std::shared_ptr<std::vector<Allocator *>> seen = nullptr)
+{
+  return get_mock_rt_mod([seen](FuncState state,
+                                std::vector<XBufferHolder> &in_tensors,
+                                std::vector<XBufferHolder> &out_tensors)
+  {
+    if (seen)
+      seen->push_back(thread_allocator().get());
+    XBufferHolder in = in_tensors[0];
+    const ssize_t batch = in->shape[0];
+    std::vector<ssize_t> tmp_shape {batch, 256};
+    XBufferHolder tmp = create_buffer(tmp_shape);
+    if (out_tensors.empty()) {
+      std::vector<ssize_t> shape(in->shape);
+      out_tensors.push_back(create_buffer(shape));
+    }
+    float *x = (float *) in->data;
+    float *t = (float *) tmp->data;
+    float *y = (float *) out_tensors[0]->data;
+    for (ssize_t b = 0; b < batch; ++b) {
+      t[b * 256] = 2.f * x[b];
+      y[b] = t[b * 256];
+    }
+  });
+}
+
+} // namespace
+
+TEST_CASE("Test RuntimeModule memory accounting")
+{
+  RtModHolder rt_mod = get_rt_mod();
+  std::vector<ssize_t> shape {4};
+  XBufferHolder in = create_buffer(shape);
+  std::vector<XBufferHolder> in_tensors {in}, out_tensors;
+  rt_mod->execute(in_tensors, out_tensors);
+
+  MemoryUsage usage = rt_mod->get_memory_usage();
+  // The output buffer is still alive, the intermediate buffer isn't
+  REQUIRE(usage.intermediates == 16);
+  REQUIRE(usage.peak_intermediates == 16 + 4 * 1024);
+  REQUIRE(usage.budget == 0);
+  out_tensors.clear();
+  REQUIRE(rt_mod->get_memory_usage().intermediates == 0);
+}
+
+TEST_CASE("Test RuntimeModule tracks the thread allocator")
+{
+  std::shared_ptr<std::vector<Allocator *>> seen(new std::vector<Allocator *>());
+  RtModHolder rt_mod = get_rt_mod(seen);
+  AllocatorHolder heap(new TrackingAllocator(
+    std::make_shared<AllocationCounter>()));
+  ScopedAllocator scope(heap);
+
+  std::vector<ssize_t> shape {4};
+  std::vector<XBufferHolder> in_tensors {create_buffer(shape)}, out_tensors;
+  for (int i = 0; i < 3; ++i) {
+    out_tensors.clear();
+    rt_mod->execute(in_tensors, out_tensors);
+  }
+  // Requests reuse the tracking allocator wrapping the thread allocator
+  REQUIRE(seen->size() == 3);
+  REQUIRE((*seen)[0] == (*seen)[1]);
+  REQUIRE((*seen)[1] == (*seen)[2]);
+  REQUIRE(((TrackingAllocator *) (*seen)[0])->get_inner() == heap);
+  REQUIRE(rt_mod->get_memory_usage().intermediates == 16);
+}
+
+TEST_CASE("Test RuntimeModule memory budget splits batches")
+{
+  RtModHolder rt_mod = get_rt_mod();
+  rt_mod->set_memory_budget(3 * 1024);
+
+  std::vector<ssize_t> shape {8};
+  XBufferHolder in = create_buffer(shape);
+  XBufferHolder out = create_buffer(shape);
+  for (int i = 0; i < 8; ++i)
+    ((float *) in->data)[i] = (float) i;
+  std::vector<XBufferHolder> in_tensors {in}, out_tensors {out};
+
+  rt_mod->execute(in_tensors, out_tensors);
+  REQUIRE(rt_mod->get_max_batch_size() == 3);
+  for (int i = 0; i < 8; ++i)
+    ((float *) out->data)[i] = 0.f;
+
+  rt_mod->execute(in_tensors, out_tensors);
+  REQUIRE(out_tensors[0]->data == out->data);
+  for (int i = 0; i < 8; ++i)
+    REQUIRE(((float *) out->data)[i] == 2.f * i);
+  MemoryUsage usage = rt_mod->get_memory_usage();
+  REQUIRE(usage.peak_intermediates <= 3 * 1024);
+  REQUIRE(usage.over_budget == 0);
+  REQUIRE(usage.budget == 3 * 1024);
+}
+
+TEST_CASE("Test RuntimeModule memory budget splits batches without provided outputs")
+{
+  RtModHolder rt_mod = get_rt_mod();
+  rt_mod->set_memory_budget(4 * 1024);
+
+  std::vector<ssize_t> shape {8};
+  XBufferHolder in = create_buffer(shape);
+  for (int i = 0; i < 8; ++i)
+    ((float *) in->data)[i] = (float) i;
+  std::vector<XBufferHolder> in_tensors {in}, out_tensors;
+
+  rt_mod->execute(in_tensors, out_tensors);
+  REQUIRE(rt_mod->get_max_batch_size() == 3);
+
+  for (int r = 0; r < 2; ++r) {
+    out_tensors.clear();
+    rt_mod->execute(in_tensors, out_tensors);
+    REQUIRE(out_tensors.size() == 1);
+    REQUIRE(out_tensors[0]->shape == shape);
+    for (int i = 0; i < 8; ++i)
+      REQUIRE(((float *) out_tensors[0]->data)[i] == 2.f * i);
+  }
+  MemoryUsage usage = rt_mod->get_memory_usage();
+  REQUIRE(rt_mod->get_max_batch_size() == 3);
+  REQUIRE(usage.peak_intermediates <= 4 * 1024);
+  REQUIRE(usage.over_budget == 0);
+
+  // Asynchronous requests are split as well
+  CompletionExecutor executor(1);
+  std::vector<XBufferHolder> async_out;
+  rt_mod->execute_async(in_tensors, async_out, executor)->wait();
+  REQUIRE(async_out.size() == 1);
+  for (int i = 0; i < 8; ++i)
+    REQUIRE(((float *) async_out[0]->data)[i] == 2.f * i);
+  REQUIRE(rt_mod->get_memory_usage().over_budget == 0);
+}
+
+TEST_CASE("Test RuntimeModule reports an unmet memory budget")
+{
+  RtModHolder rt_mod = get_rt_mod();
+  rt_mod->set_memory_budget(512);
+
+  std::vector<ssize_t> shape {1};
+  XBufferHolder in = create_buffer(shape);
+  std::vector<XBufferHolder> in_tensors {in}, out_tensors;
+  rt_mod->execute(in_tensors, out_tensors);
+  rt_mod->execute(in_tensors, out_tensors);
+  REQUIRE(rt_mod->get_memory_usage().over_budget == 2);
+}
+
+TEST_CASE("Test RuntimeModule memory budget doesn't split batches of outputs without batch dimension")
+{
+  std::shared_ptr<std::vector<ssize_t>> calls(new std::vector<ssize_t>());
+  RtModHolder rt_mod = get_mock_rt_mod([calls](FuncState state,
+                                               std::vector<XBufferHolder> &in_tensors,
+                                               std::vector<XBufferHolder> &out_tensors)
+  {
+    XBufferHolder in = in_tensors[0];
+    const ssize_t batch = in->shape[0];
+    calls->push_back(batch);
+    std::vector<ssize_t> tmp_shape {batch, 256};
+    XBufferHolder tmp = create_buffer(tmp_shape);
+    if (out_tensors.empty()) {
+      std::vector<ssize_t> shape {1};
+      out_tensors.push_back(create_buffer(shape));
+    }
+    // Sum over the batch
+    float *x = (float *) in->data;
+    float *y = (float *) out_tensors[0]->data;
+    y[0] = 0.f;
+    for (ssize_t b = 0; b < batch; ++b) {
+      ((float *) tmp->data)[b * 256] = x[b];
+      y[0] += ((float *) tmp->data)[b * 256];
+    }
+  });
+  rt_mod->set_memory_budget(3 * 1024);
+
+  std::vector<ssize_t> shape {8};
+  XBufferHolder in = create_buffer(shape);
+  for (int i = 0; i < 8; ++i)
+    ((float *) in->data)[i] = (float) i;
+  for (int r = 0; r < 2; ++r) {
+    std::vector<XBufferHolder> in_tensors {in}, out_tensors;
+    rt_mod->execute(in_tensors, out_tensors);
+    REQUIRE(((float *) out_tensors[0]->data)[0] == 28.f);
+  }
+  // Every request executes the whole batch exactly once
+  REQUIRE(*calls == std::vector<ssize_t>{8, 8});
+  REQUIRE(rt_mod->get_max_batch_size() == 0);
+  REQUIRE(rt_mod->get_memory_usage().over_budget == 2);
+}
@@ -0,0 +1,120 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+#include "pyxir/runtime/batch_dispatch.hpp"
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/runtime_module.hpp"
+
+/** @brief Stateless and therefore reentrant compute func info around the
+ *   given compute function, callers may still override the other functions
+ *   (submit, release, ...) and the reentrancy
+ */
+inline pyxir::runtime::ComputeFuncInfo
+get_mock_compute_func_info(pyxir::runtime::ComputeFuncFType compute_func)
+{
+  pyxir::runtime::ComputeFuncInfo cfi;
+  cfi.alloc_func = [](pyxir::runtime::FuncState *state) { *state = nullptr; return 0; };
+  cfi.compute_func = compute_func;
+  cfi.release_func = [](pyxir::runtime::FuncState state) {};
+  cfi.reentrant = true;
+  return cfi;
+}
+
+/** @brief Runtime module with input `x` and output `y` wrapping the given
+ *   compute func info
+ */
+inline pyxir::RtModHolder get_mock_rt_mod(
+  pyxir::runtime::ComputeFuncInfo cfi,
+  pyxir::RunOptionsHolder run_options = pyxir::RunOptionsHolder(new pyxir::runtime::RunOptions()))
+{
+  pyxir::ComputeFuncHolder cf(new pyxir::runtime::StatefulComputeFunc(cfi));
+  return pyxir::RtModHolder(
+    new pyxir::runtime::RuntimeModule(cf, std::vector<std::string>{"x"},
+                                      std::vector<std::string>{"y"},
+                                      run_options));
+}
+
+/** @brief Runtime module with input `x` and output `y` executing the given
+ *   stateless compute function
+ */
+inline pyxir::RtModHolder get_mock_rt_mod(
+  pyxir::runtime::ComputeFuncFType compute_func,
+  pyxir::RunOptionsHolder run_options = pyxir::RunOptionsHolder(new pyxir::runtime::RunOptions()))
+{
+  return get_mock_rt_mod(get_mock_compute_func_info(compute_func), run_options);
+}
+
+/** @brief Mocked DPU runner with a fixed batch size and a configurable
+ *   latency per job, doubling its input. Runners are called from worker
+ *   threads so errors are thrown instead of checked with REQUIRE.
+ */
+class MockRunner {
+
+  public:
+    MockRunner(ssize_t batch, int latency_ms)
+      : batch_(batch), latency_ms_(latency_ms) {}
+
+    void execute(const pyxir::XBufferHolder &in, const pyxir::XBufferHolder &out)
+    {
+      if (in->shape[0] > batch_)
+        throw std::runtime_error("MockRunner: chunk exceeds runner batch size");
+      std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms_));
+      for (ssize_t i = 0; i < in->size; ++i)
+        ((float *) out->data)[i] = 2 * ((float *) in->data)[i];
+      ++nb_jobs_;
+    }
+
+    int nb_jobs() const { return nb_jobs_; }
+
+  private:
+    ssize_t batch_;
+    int latency_ms_;
+    std::atomic<int> nb_jobs_{0};
+};
+
+/** @brief Runtime module executing requests one at a time on a pool of
+ *   mocked runners, dispatching batches over the runners like DpuFunc
+ */
+inline pyxir::RtModHolder get_mock_runner_pool_rt_mod(
+  std::vector<std::shared_ptr<MockRunner>> &runners, ssize_t runner_batch)
+{
+  std::vector<std::shared_ptr<MockRunner>> pool(runners);
+  pyxir::runtime::ComputeFuncInfo cfi = get_mock_compute_func_info(
+    [pool, runner_batch](pyxir::runtime::FuncState state,
+                         std::vector<pyxir::XBufferHolder> &in_tensors,
+                         std::vector<pyxir::XBufferHolder> &out_tensors) {
+      pyxir::runtime::dispatch_to_runners(in_tensors, out_tensors,
+        runner_batch, pool.size(),
+        [&pool](size_t runner_idx, std::vector<pyxir::XBufferHolder> &in_chunk,
+                std::vector<pyxir::XBufferHolder> &out_chunk) {
+          pool[runner_idx]->execute(in_chunk[0], out_chunk[0]);
+        });
+    });
+  // A runner can't execute two jobs at the same time
+  cfi.reentrant = false;
+  return get_mock_rt_mod(cfi);
+}
@@ -0,0 +1,212 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/compute_func_registry.hpp"
+#include "pyxir/runtime/model_manager.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/** @brief Serializable compute func multiplying its input with a factor */
+class ScaleComputeFunc : public IComputeFunc {
+
+  public:
+    ScaleComputeFunc(float factor = 1.) : factor_(factor) {}
+
+    std::string get_type() { return "test_scale_compute_func"; }
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors)
+    {
+      ((float *) out_tensors[0]->data)[0] =
+        ((float *) in_tensors[0]->data)[0] * factor_;
+    }
+
+    void serialize_px(PxOStringStream &pstream) { pstream.write(factor_); }
+
+    void deserialize_px(PxIStringStream &pstream) { pstream.read(factor_); }
+
+  private:
+    float factor_;
+};
+
+REGISTER_COMPUTE_FUNC_TYPE("test_scale_compute_func")
+  .set_factory_func([]() -> ComputeFuncHolder {
+    ComputeFuncHolder cf(new ScaleComputeFunc());
+    return cf;
+  });
+
+RtModHolder get_scale_rt_mod(float factor)
+{
+  ComputeFuncHolder cf(new ScaleComputeFunc(factor));
+  RunOptionsHolder run_options(new RunOptions());
+  return RtModHolder(new RuntimeModule(cf, std::vector<std::string>{"x"},
+                                       std::vector<std::string>{"y"},
+                                       run_options));
+}
+
+float run(ModelManager &manager, const std::string &name, float x)
+{
+  std::vector<ssize_t> shape = {1};
+  std::vector<XBufferHolder> in{create_buffer(shape)};
+  std::vector<XBufferHolder> out{create_buffer(shape)};
+  ((float *) in[0]->data)[0] = x;
+  manager.execute(name, in, out);
+  return ((float *) out[0]->data)[0];
+}
+
+} // namespace
+
+TEST_CASE("Test ModelManager lazy loading and LRU eviction")
+{
+  ModelManagerOptions options;
+  options.memory_budget = 200;
+  ModelManager manager(options);
+
+  int nb_loads = 0;
+  for (int i = 1; i <= 3; ++i) {
+    manager.add_model("m" + std::to_string(i), [i, &nb_loads]() {
+      ++nb_loads;
+      return get_scale_rt_mod((float) i);
+    }, 100);
+  }
+  REQUIRE(nb_loads == 0);
+  REQUIRE(manager.resident_size() == 0);
+
+  REQUIRE(run(manager, "m1", 2.f) == 2.f);
+  REQUIRE(run(manager, "m2", 2.f) == 4.f);
+  REQUIRE(nb_loads == 2);
+  REQUIRE(run(manager, "m1", 1.f) == 1.f);
+  REQUIRE(nb_loads == 2);
+
+  // m2 is the least recently used model
+  REQUIRE(run(manager, "m3", 1.f) == 3.f);
+  REQUIRE(manager.resident_models() == std::vector<std::string>{"m3", "m1"});
+  REQUIRE(!manager.is_resident("m2"));
+  REQUIRE(manager.resident_size() == 200);
+
+  // Evicted models are reloaded on their next request
+  REQUIRE(run(manager, "m2", 1.f) == 2.f);
+  REQUIRE(nb_loads == 4);
+  REQUIRE(!manager.is_resident("m1"));
+
+  ModelManagerStats stats = manager.get_stats();
+  REQUIRE(stats.hits == 1);
+  REQUIRE(stats.misses == 4);
+  REQUIRE(stats.evictions == 2);
+  REQUIRE(stats.load_time.count == 4);
+  REQUIRE(stats.evict_time.count == 2);
+  REQUIRE(stats.hit_rate() == Approx(0.2));
+
+  // Explicit evictions count, removals don't
+  REQUIRE(manager.evict("m2"));
+  manager.remove_model("m3");
+  REQUIRE(!manager.has_model("m3"));
+  REQUIRE(manager.resident_size() == 0);
+  stats = manager.get_stats();
+  REQUIRE(stats.evictions == 3);
+  REQUIRE(stats.evict_time.count == 3);
+
+  REQUIRE_THROWS_AS(manager.get("m4"), std::invalid_argument);
+}
+
+TEST_CASE("Test ModelManager doesn't evict models in use")
+{
+  ModelManagerOptions options;
+  options.memory_budget = 100;
+  ModelManager manager(options);
+  manager.add_model("a", []() { return get_scale_rt_mod(1.f); }, 100);
+  manager.add_model("b", []() { return get_scale_rt_mod(2.f); }, 100);
+
+  SharedRtModHolder a = manager.get("a");
+  REQUIRE(!manager.evict("a"));
+  manager.get("b");
+  REQUIRE(manager.is_resident("a"));
+  REQUIRE(manager.resident_size() == 200);
+  REQUIRE(manager.get_stats().over_budget == 1);
+
+  a.reset();
+  REQUIRE(manager.evict("a"));
+  REQUIRE(manager.resident_models() == std::vector<std::string>{"b"});
+}
+
+TEST_CASE("Test ModelManager loading from memory mapped module files")
+{
+  std::string path = "model_manager_test.rtmod";
+  get_scale_rt_mod(3.f)->save(path);
+
+  ModelManager manager;
+  manager.add_model("scale", path);
+  REQUIRE(!manager.is_resident("scale"));
+  REQUIRE(run(manager, "scale", 2.f) == 6.f);
+
+  // The mapping stays valid after the module file is removed
+  std::remove(path.c_str());
+  REQUIRE(manager.evict("scale"));
+  REQUIRE(run(manager, "scale", 1.f) == 3.f);
+  REQUIRE(manager.get_stats().misses == 2);
+}
+
+TEST_CASE("Test ModelManager loads outside of the lock")
+{
+  ModelManager manager;
+  std::atomic<bool> gate{false};
+  std::atomic<int> slow_loads{0};
+  manager.add_model("fast", []() { return get_scale_rt_mod(1.f); }, 100);
+  manager.add_model("slow", [&gate, &slow_loads]() {
+    ++slow_loads;
+    while (!gate)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return get_scale_rt_mod(2.f);
+  }, 100);
+  REQUIRE(run(manager, "fast", 1.f) == 1.f);
+
+  std::vector<float> results(2, 0.f);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 2; ++i)
+    threads.emplace_back([&manager, &results, i]() {
+      results[i] = run(manager, "slow", 1.f);
+    });
+  while (slow_loads == 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  // Other models are served while the slow model is loading
+  REQUIRE(run(manager, "fast", 3.f) == 3.f);
+  REQUIRE(!manager.is_resident("slow"));
+  gate = true;
+  for (std::thread &t : threads)
+    t.join();
+
+  // Concurrent requests for a model share a single load
+  REQUIRE(slow_loads == 1);
+  REQUIRE(results == std::vector<float>{2.f, 2.f});
+  REQUIRE(manager.get_stats().misses == 2);
+  REQUIRE(manager.resident_size() == 200);
+}
@@ -0,0 +1,188 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/module_handle.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/**
+ * @brief Runtime module writing the given value to its output, the released
+ *  flag is set when the module is destroyed
+ */
+RtModHolder get_rt_mod(float value, std::shared_ptr<std::atomic<bool>> released)
+{
+  ComputeFuncInfo cfi = get_mock_compute_func_info(
+    [value](FuncState state,
+            std::vector<XBufferHolder> &in_tensors,
+            std::vector<XBufferHolder> &out_tensors)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ((float *) out_tensors[0]->data)[0] = value;
+  });
+  cfi.release_func = [released](FuncState state) { *released = true; };
+  return get_mock_rt_mod(cfi);
+}
+
+float run(ModuleHandle &handle)
+{
+  std::vector<ssize_t> shape = {1};
+  std::vector<XBufferHolder> in{create_buffer(shape)};
+  std::vector<XBufferHolder> out{create_buffer(shape)};
+  handle.execute(in, out);
+  return ((float *) out[0]->data)[0];
+}
+
+} // namespace
+
+TEST_CASE("Test ModuleHandle swaps without dropping requests")
+{
+  std::shared_ptr<std::atomic<bool>> released_1(new std::atomic<bool>(false));
+  std::shared_ptr<std::atomic<bool>> released_2(new std::atomic<bool>(false));
+  ModuleHandle handle(get_rt_mod(1.f, released_1));
+  REQUIRE(run(handle) == 1.f);
+
+  std::atomic<bool> stop(false);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> clients;
+  for (int i = 0; i < 4; ++i) {
+    clients.emplace_back([&]() {
+      while (!stop) {
+        try {
+          float res = run(handle);
+          if (res != 1.f && res != 2.f)
+            ++failures;
+        } catch (...) {
+          ++failures;
+        }
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  CompletionHolder done = handle.swap_async([released_2]() {
+    // Bound buffers are used for the warmup iterations
+    RtModHolder rt_mod = get_rt_mod(2.f, released_2);
+    std::vector<ssize_t> shape = {1};
+    rt_mod->bind_inputs({create_buffer(shape)});
+    rt_mod->bind_outputs({create_buffer(shape)});
+    return rt_mod;
+  }, 2);
+  done->wait();
+  // The old module is destroyed once its in-flight requests drained
+  REQUIRE(*released_1);
+  REQUIRE(!*released_2);
+  REQUIRE(handle.generation() == 1);
+  REQUIRE(run(handle) == 2.f);
+
+  stop = true;
+  for (auto &c : clients)
+    c.join();
+  REQUIRE(failures == 0);
+}
+
+TEST_CASE("Test ModuleHandle keeps the active module if loading fails")
+{
+  std::shared_ptr<std::atomic<bool>> released(new std::atomic<bool>(false));
+  ModuleHandle handle(get_rt_mod(1.f, released));
+
+  CompletionHolder done = handle.swap_async([]() -> RtModHolder {
+    throw std::runtime_error("load failed");
+  });
+  REQUIRE_THROWS_AS(done->wait(), std::runtime_error);
+  REQUIRE(handle.generation() == 0);
+  REQUIRE(run(handle) == 1.f);
+  REQUIRE(!*released);
+}
+
+TEST_CASE("Test ModuleHandle swap doesn't wait forever on held modules")
+{
+  std::shared_ptr<std::atomic<bool>> released_1(new std::atomic<bool>(false));
+  std::shared_ptr<std::atomic<bool>> released_2(new std::atomic<bool>(false));
+  ModuleHandle handle(get_rt_mod(1.f, released_1));
+
+  // A holder that outlives the swap keeps the old module alive
+  SharedRtModHolder held = handle.get();
+  REQUIRE(!handle.swap(get_rt_mod(2.f, released_2), 0,
+                       std::chrono::milliseconds(10)));
+  REQUIRE(!*released_1);
+  REQUIRE(run(handle) == 2.f);
+
+  // The old module is destroyed once the last holder is released
+  held.reset();
+  REQUIRE(*released_1);
+  REQUIRE(!*released_2);
+
+  // Swaps without outstanding holders destroy the old module right away
+  std::shared_ptr<std::atomic<bool>> released_3(new std::atomic<bool>(false));
+  REQUIRE(handle.swap(get_rt_mod(3.f, released_3), 0));
+  REQUIRE(*released_2);
+  REQUIRE(run(handle) == 3.f);
+}
+
+TEST_CASE("Test ModuleHandle serializes requests on modules that aren't reentrant")
+{
+  std::shared_ptr<std::atomic<int>> active(new std::atomic<int>(0));
+  std::shared_ptr<std::atomic<int>> max_active(new std::atomic<int>(0));
+  ComputeFuncInfo cfi = get_mock_compute_func_info(
+    [active, max_active](FuncState state,
+                         std::vector<XBufferHolder> &in_tensors,
+                         std::vector<XBufferHolder> &out_tensors)
+  {
+    int now_active = ++*active;
+    int prev = *max_active;
+    while (now_active > prev && !max_active->compare_exchange_weak(prev, now_active)) {}
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    --*active;
+  });
+  cfi.reentrant = false;
+  ModuleHandle handle(get_mock_rt_mod(cfi));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&handle]() {
+      for (int i = 0; i < 4; ++i)
+        run(handle);
+    });
+  std::vector<ssize_t> shape = {1};
+  std::vector<std::vector<XBufferHolder>> ins(4), outs(4);
+  std::vector<CompletionHolder> completions;
+  for (size_t i = 0; i < ins.size(); ++i) {
+    ins[i].push_back(create_buffer(shape));
+    outs[i].push_back(create_buffer(shape));
+    completions.push_back(handle.execute_async(ins[i], outs[i]));
+  }
+  for (std::thread &t : threads)
+    t.join();
+  for (CompletionHolder &c : completions)
+    c->wait();
+  REQUIRE(*max_active == 1);
+}
@@ -0,0 +1,309 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/graph/xlayer.hpp"
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/kernel_func_factory.hpp"
+
+using namespace pyxir;
+using namespace pyxir::graph;
+using namespace pyxir::runtime;
+
+static XBufferHolder wrap(std::vector<float> &v, std::vector<ssize_t> shape)
+{
+  return XBufferHolder(new XBuffer((void *) &v[0], 4, "f", shape.size(), shape,
+                                   false, false));
+}
+
+TEST_CASE("Test Softmax kernel func")
+{
+  XLayerHolder X(new XLayer("sm", std::vector<std::string>{"Softmax"}));
+  X->set_attr("axis", XAttr("axis", -1));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Softmax", X);
+
+  std::vector<float> x = {1.f, 2.f, 3.f, 1000.f, 1000.f, 1000.f};
+  std::vector<XBufferHolder> in {wrap(x, {2, 3})};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out.size() == 1);
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{2, 3});
+  float *y = (float *) out[0]->data;
+  float denom = std::exp(-2.f) + std::exp(-1.f) + 1.f;
+  REQUIRE(y[0] == Approx(std::exp(-2.f) / denom));
+  REQUIRE(y[2] == Approx(1.f / denom));
+  // Large inputs may not overflow
+  REQUIRE(y[3] == Approx(1.f / 3));
+  REQUIRE(y[5] == Approx(1.f / 3));
+}
+
+TEST_CASE("Test Softmax kernel func on an empty axis")
+{
+  XLayerHolder X(new XLayer("sm", std::vector<std::string>{"Softmax"}));
+  X->set_attr("axis", XAttr("axis", -1));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Softmax", X);
+
+  std::vector<float> x(1);
+  std::vector<XBufferHolder> in {wrap(x, {2, 0})};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{2, 0});
+}
+
+TEST_CASE("Test NMS kernel func")
+{
+  XLayerHolder X(new XLayer("nms", std::vector<std::string>{"NMS"}));
+  X->set_attr("iou_threshold", XAttr("iou_threshold", 0.5));
+  X->set_attr("score_threshold", XAttr("score_threshold", 0.1));
+  X->set_attr("max_output_size", XAttr("max_output_size", 4));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.NMS", X);
+
+  // Boxes: [x0, y0, x1, y1, score, p_class0, p_class1]
+  std::vector<float> x = {
+    0.f, 0.f, 10.f, 10.f, 0.8f, 0.9f, 0.1f,   // kept
+    1.f, 1.f, 10.f, 10.f, 0.9f, 0.8f, 0.2f,   // kept, highest score
+    0.f, 0.f, 10.f, 10.f, 0.7f, 0.1f, 0.9f,   // kept, other class
+    20.f, 20.f, 30.f, 30.f, 0.05f, 1.f, 0.f   // below score threshold
+  };
+  std::vector<XBufferHolder> in {wrap(x, {1, 4, 7})};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 4, 6});
+  float *y = (float *) out[0]->data;
+  // Highest scoring box first, the overlapping class 0 box is suppressed
+  REQUIRE(y[4] == Approx(0.9f));
+  REQUIRE(y[5] == Approx(0.f));
+  REQUIRE(y[6 + 4] == Approx(0.7f));
+  REQUIRE(y[6 + 5] == Approx(1.f));
+  REQUIRE(y[12 + 5] == Approx(-1.f));
+  REQUIRE(y[18 + 5] == Approx(-1.f));
+}
+
+TEST_CASE("Test NMS kernel func suppresses boxes at the IoU threshold")
+{
+  XLayerHolder X(new XLayer("nms", std::vector<std::string>{"NMS"}));
+  X->set_attr("iou_threshold", XAttr("iou_threshold", 0.));
+  X->set_attr("score_threshold", XAttr("score_threshold", 0.1));
+  X->set_attr("max_output_size", XAttr("max_output_size", 2));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.NMS", X);
+
+  // Disjoint boxes of the same class have an IoU of exactly zero
+  std::vector<float> x = {
+    0.f, 0.f, 10.f, 10.f, 0.9f, 1.f, 0.f,
+    20.f, 20.f, 30.f, 30.f, 0.8f, 1.f, 0.f
+  };
+  std::vector<XBufferHolder> in {wrap(x, {1, 2, 7})};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  float *y = (float *) out[0]->data;
+  REQUIRE(y[4] == Approx(0.9f));
+  REQUIRE(y[6 + 5] == Approx(-1.f));
+}
+
+TEST_CASE("Test NMS kernel func at and just below the IoU threshold")
+{
+  // Overlapping boxes of the same class, the IoU is computed with the same
+  //  epsilon as the kernel so that the threshold matches it exactly
+  std::vector<float> x = {
+    0.f, 0.f, 10.f, 10.f, 0.9f, 1.f, 0.f,
+    0.f, 0.f, 10.f, 5.f, 0.8f, 1.f, 0.f
+  };
+  const float iou = 50.f / (100.f + 50.f - 50.f + 1e-5f);
+
+  for (float threshold : {iou, std::nextafter(iou, 1.f)}) {
+    XLayerHolder X(new XLayer("nms", std::vector<std::string>{"NMS"}));
+    X->set_attr("iou_threshold", XAttr("iou_threshold", (double) threshold));
+    X->set_attr("max_output_size", XAttr("max_output_size", 2));
+    KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.NMS", X);
+
+    std::vector<XBufferHolder> in {wrap(x, {1, 2, 7})};
+    std::vector<XBufferHolder> out;
+    (*kf)(in, out);
+
+    float *y = (float *) out[0]->data;
+    REQUIRE(y[4] == Approx(0.9f));
+    if (threshold == iou) {
+      // Suppressed at the threshold
+      REQUIRE(y[6 + 5] == Approx(-1.f));
+    } else {
+      // Kept below the threshold
+      REQUIRE(y[6 + 4] == Approx(0.8f));
+      REQUIRE(y[6 + 3] == Approx(5.f));
+    }
+  }
+}
+
+TEST_CASE("Test TopK kernel func")
+{
+  XLayerHolder X(new XLayer("topk", std::vector<std::string>{"TopK"}));
+  X->set_attr("k", XAttr("k", 2));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.TopK", X);
+
+  std::vector<float> x = {0.1f, 0.5f, 0.2f, 0.2f, 0.9f, 0.3f, 0.f, 0.f};
+  std::vector<XBufferHolder> in {wrap(x, {2, 4})};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out.size() == 2);
+  REQUIRE(out[1]->format == "i");
+  float *values = (float *) out[0]->data;
+  int32_t *indices = (int32_t *) out[1]->data;
+  REQUIRE(indices[0] == 1);
+  REQUIRE(indices[1] == 2);
+  REQUIRE(values[0] == Approx(0.5f));
+  REQUIRE(indices[2] == 0);
+  REQUIRE(indices[3] == 1);
+}
+
+TEST_CASE("Test ArgMax kernel func")
+{
+  XLayerHolder X(new XLayer("argmax", std::vector<std::string>{"ArgMax"}));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.ArgMax", X);
+
+  std::vector<float> x = {0.1f, 0.5f, 0.2f, 0.9f, 0.3f, 0.f};
+  std::vector<XBufferHolder> in {wrap(x, {1, 2, 3})};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 2});
+  int32_t *y = (int32_t *) out[0]->data;
+  REQUIRE(y[0] == 1);
+  REQUIRE(y[1] == 0);
+}
+
+TEST_CASE("Test GSTiling kernel func")
+{
+  XLayerHolder X(new XLayer("gst", std::vector<std::string>{"GSTiling"}));
+  X->set_attr("stride", XAttr("stride", 2));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.GSTiling", X);
+
+  // (1, 1, 1, 4) -> (1, 2, 2, 1)
+  std::vector<float> x = {0.f, 1.f, 2.f, 3.f};
+  std::vector<XBufferHolder> in {wrap(x, {1, 1, 1, 4})};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 2, 2, 1});
+  float *y = (float *) out[0]->data;
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(y[i] == Approx(x[i]));
+}
+
+TEST_CASE("Test YoloDecode kernel func")
+{
+  XLayerHolder X(new XLayer("yolo", std::vector<std::string>{"YoloDecode"}));
+  X->set_attr("anchors", XAttr("anchors", std::vector<int64_t>{10, 20}));
+  X->set_attr("nb_classes", XAttr("nb_classes", 1));
+  X->set_attr("input_size", XAttr("input_size", std::vector<int64_t>{32, 32}));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.YoloDecode", X);
+
+  // One cell (1x1 grid) with one anchor: tx = ty = tw = th = 0
+  std::vector<float> x = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+  std::vector<XBufferHolder> in {wrap(x, {1, 1, 1, 6})};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 1, 6});
+  float *y = (float *) out[0]->data;
+  // Center at (0.5 * 32, 0.5 * 32), anchor size (10, 20)
+  REQUIRE(y[0] == Approx(11.f));
+  REQUIRE(y[1] == Approx(6.f));
+  REQUIRE(y[2] == Approx(21.f));
+  REQUIRE(y[3] == Approx(26.f));
+  REQUIRE(y[4] == Approx(0.5f));
+  REQUIRE(y[5] == Approx(0.5f));
+}
+
+TEST_CASE("Test post-processing kernel funcs reject undersized outputs")
+{
+  XLayerHolder X(new XLayer("sm", std::vector<std::string>{"Softmax"}));
+  KernelFuncHolder sm = KernelFuncFactory::GetKernelFunc("cpu.Softmax", X);
+  XLayerHolder A(new XLayer("argmax", std::vector<std::string>{"ArgMax"}));
+  KernelFuncHolder am = KernelFuncFactory::GetKernelFunc("cpu.ArgMax", A);
+
+  std::vector<float> x(64, 1.f), y(4, 0.f);
+  std::vector<XBufferHolder> in {wrap(x, {8, 8})};
+  std::vector<XBufferHolder> out {wrap(y, {2, 2})};
+  REQUIRE_THROWS_AS((*sm)(in, out), std::invalid_argument);
+  REQUIRE_THROWS_AS((*am)(in, out), std::invalid_argument);
+
+  // Int32 indices may not be written to a float output of the same size
+  std::vector<float> z(8, 0.f);
+  std::vector<XBufferHolder> float_out {wrap(z, {8})};
+  REQUIRE_THROWS_AS((*am)(in, float_out), std::invalid_argument);
+}
+
+TEST_CASE("Test post-processing kernel funcs reject non float32 inputs")
+{
+  XLayerHolder X(new XLayer("sm", std::vector<std::string>{"Softmax"}));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Softmax", X);
+
+  std::vector<int8_t> x(8, 0);
+  std::vector<ssize_t> shape = {2, 4};
+  std::vector<XBufferHolder> in {XBufferHolder(
+    new XBuffer((void *) &x[0], 1, "b", shape.size(), shape, false, false))};
+  std::vector<XBufferHolder> out;
+  REQUIRE_THROWS_AS((*kf)(in, out), std::invalid_argument);
+}
+
+TEST_CASE("Test post-processing kernel funcs write strided outputs")
+{
+  XLayerHolder X(new XLayer("sm", std::vector<std::string>{"Softmax"}));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Softmax", X);
+
+  std::vector<float> x = {0.f, 0.f, 1.f, 1.f};
+  std::vector<XBufferHolder> in {wrap(x, {2, 2})};
+  // Every other column of a (2, 4) buffer
+  std::vector<float> y(8, -1.f);
+  XBufferHolder parent = wrap(y, {2, 4});
+  std::vector<XBufferHolder> out {create_view(parent, parent->data, {2, 2},
+                                              {16, 8})};
+  (*kf)(in, out);
+
+  REQUIRE(y[0] == Approx(0.5f));
+  REQUIRE(y[1] == -1.f);
+  REQUIRE(y[2] == Approx(0.5f));
+  REQUIRE(y[4] == Approx(0.5f));
+  REQUIRE(y[6] == Approx(0.5f));
+  REQUIRE(y[7] == -1.f);
+
+  XLayerHolder T(new XLayer("topk", std::vector<std::string>{"TopK"}));
+  T->set_attr("k", XAttr("k", 1));
+  KernelFuncHolder topk = KernelFuncFactory::GetKernelFunc("cpu.TopK", T);
+  std::vector<float> v = {0.1f, 0.5f, 0.9f, 0.3f};
+  std::vector<XBufferHolder> topk_in {wrap(v, {2, 2})};
+  std::vector<float> values(4, -1.f);
+  XBufferHolder values_parent = wrap(values, {2, 2});
+  std::vector<ssize_t> indices_shape = {2, 1};
+  std::vector<XBufferHolder> topk_out {select(values_parent, 1, 1),
+                                       create_buffer(indices_shape, 4, "i")};
+  (*topk)(topk_in, topk_out);
+
+  REQUIRE(values[0] == -1.f);
+  REQUIRE(values[1] == Approx(0.5f));
+  REQUIRE(values[3] == Approx(0.9f));
+  REQUIRE(((int32_t *) topk_out[1]->data)[0] == 1);
+  REQUIRE(((int32_t *) topk_out[1]->data)[1] == 0);
+}
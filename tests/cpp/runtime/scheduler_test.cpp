@@ -0,0 +1,366 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/scheduler.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/** @brief Shared state of the mocked model, recording the execution order */
+struct MockModel {
+  std::atomic<bool> gate{true};
+  int latency_ms = 10;
+  std::mutex mtx;
+  std::vector<float> order;
+  /** @brief Executions with a NUMA allocator installed */
+  std::atomic<int> numa_executions{0};
+};
+
+RtModHolder get_model_rt_mod(std::shared_ptr<MockModel> model)
+{
+  return get_mock_rt_mod([model](FuncState state,
+                                 std::vector<XBufferHolder> &in_tensors,
+                                 std::vector<XBufferHolder> &out_tensors)
+  {
+    while (!model->gate)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(model->latency_ms));
+    // Runtime modules track the allocator they execute with
+    Allocator *allocator = thread_allocator().get();
+    TrackingAllocator *tracking = dynamic_cast<TrackingAllocator *>(allocator);
+    if (tracking)
+      allocator = tracking->get_inner().get();
+    if (dynamic_cast<NumaAllocator *>(allocator))
+      ++model->numa_executions;
+    std::lock_guard<std::mutex> lock(model->mtx);
+    model->order.push_back(((float *) in_tensors[0]->data)[0]);
+  });
+}
+
+/** @brief Compute func holding weights, recording the allocator they were
+    moved to */
+class WeightsComputeFunc : public IComputeFunc {
+
+  public:
+    WeightsComputeFunc()
+    {
+      std::vector<ssize_t> shape = {4};
+      weights = create_buffer(shape);
+      for (ssize_t i = 0; i < 4; ++i)
+        ((float *) weights->data)[i] = (float) i;
+    }
+
+    std::string get_type() { return "test_weights_compute_func"; }
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors) {}
+
+    void move_weights(const AllocatorHolder &allocator) override
+    {
+      move_to_allocator(*weights, allocator);
+      weights_allocator = allocator;
+    }
+
+    void serialize_px(PxOStringStream &pstream) {}
+
+    void deserialize_px(PxIStringStream &pstream) {}
+
+    XBufferHolder weights;
+    AllocatorHolder weights_allocator;
+};
+
+std::vector<XBufferHolder> get_input(float id)
+{
+  std::vector<ssize_t> shape = {1};
+  XBufferHolder xb = create_buffer(shape);
+  ((float *) xb->data)[0] = id;
+  return std::vector<XBufferHolder>{xb};
+}
+
+} // namespace
+
+TEST_CASE("Test RequestScheduler priorities and deadlines")
+{
+  std::shared_ptr<MockModel> model(new MockModel());
+  RtModHolder rt_mod = get_model_rt_mod(model);
+  RequestScheduler scheduler(*rt_mod);
+
+  // Block the worker on a first request so that the others get queued
+  model->gate = false;
+  std::vector<std::vector<XBufferHolder>> ins, outs(4);
+  for (float i = 0; i < 4; ++i)
+    ins.push_back(get_input(i));
+  std::vector<CompletionHolder> cs;
+  cs.push_back(scheduler.submit(ins[0], outs[0]));
+  while (scheduler.queue_size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  auto now = RequestScheduler::Clock::now();
+  cs.push_back(scheduler.submit(ins[1], outs[1], Priority::LOW));
+  cs.push_back(scheduler.submit(ins[2], outs[2], Priority::LOW,
+                                now + std::chrono::seconds(10)));
+  cs.push_back(scheduler.submit(ins[3], outs[3], Priority::HIGH));
+  model->gate = true;
+  for (auto &c : cs)
+    c->wait();
+
+  // High priority first, then low priority by earliest deadline
+  REQUIRE(model->order == std::vector<float>{0.f, 3.f, 2.f, 1.f});
+
+  SchedulerMetrics metrics = scheduler.get_metrics();
+  REQUIRE(metrics.submitted == 4);
+  REQUIRE(metrics.completed == 4);
+  REQUIRE(metrics.service_time.count == 4);
+  REQUIRE(metrics.service_time.mean_us() >= 10000.);
+  // Queued requests waited at least for the service time of the first one
+  REQUIRE(metrics.queue_delay.max_us >= metrics.service_time.max_us / 2);
+  REQUIRE(metrics.ewma_service_us > 0.);
+}
+
+TEST_CASE("Test RequestScheduler admission control")
+{
+  std::shared_ptr<MockModel> model(new MockModel());
+  model->latency_ms = 20;
+  RtModHolder rt_mod = get_model_rt_mod(model);
+  SchedulerOptions options;
+  options.max_queue_size = 2;
+  RequestScheduler scheduler(*rt_mod, options);
+
+  // Warm up the service time estimate
+  std::vector<XBufferHolder> in = get_input(0), out;
+  scheduler.submit(in, out)->wait();
+
+  model->gate = false;
+  std::vector<std::vector<XBufferHolder>> ins, outs(4);
+  for (float i = 1; i < 5; ++i)
+    ins.push_back(get_input(i));
+  CompletionHolder running = scheduler.submit(ins[0], outs[0]);
+  while (scheduler.queue_size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  CompletionHolder q1 = scheduler.submit(ins[1], outs[1]);
+
+  // Can't finish within 5ms with a request in service and one queued
+  CompletionHolder tight = scheduler.submit(
+    ins[2], outs[2], Priority::HIGH,
+    RequestScheduler::Clock::now() + std::chrono::milliseconds(5));
+  REQUIRE(tight->ready());
+  REQUIRE_THROWS_AS(tight->wait(), RequestRejected);
+
+  // Back-pressure on a full queue
+  CompletionHolder q2 = scheduler.submit(ins[2], outs[2]);
+  CompletionHolder full = scheduler.submit(ins[3], outs[3]);
+  REQUIRE(full->ready());
+  REQUIRE_THROWS_AS(full->wait(), RequestRejected);
+
+  model->gate = true;
+  running->wait();
+  q1->wait();
+  q2->wait();
+
+  SchedulerMetrics metrics = scheduler.get_metrics();
+  REQUIRE(metrics.rejected_deadline == 1);
+  REQUIRE(metrics.rejected_queue_full == 1);
+  REQUIRE(metrics.completed == 4);
+}
+
+TEST_CASE("Test RequestScheduler NUMA worker groups")
+{
+  std::shared_ptr<MockModel> model(new MockModel());
+  model->latency_ms = 1;
+  RtModHolder rt_mod = get_model_rt_mod(model);
+  SchedulerOptions options;
+  options.nb_workers = 2;
+  options.numa_nodes = {numa::get_current_node()};
+  RequestScheduler scheduler(*rt_mod, options);
+
+  std::vector<XBufferHolder> in = get_input(0), out;
+  scheduler.submit(in, out)->wait();
+  REQUIRE(model->numa_executions == 1);
+
+  // Without worker groups, a module bound to a node allocates on it
+  std::vector<XBufferHolder> out2;
+  rt_mod->execute(in, out2);
+  REQUIRE(model->numa_executions == 1);
+  rt_mod->bind_numa_node(numa::get_current_node());
+  rt_mod->execute(in, out2);
+  REQUIRE(model->numa_executions == 2);
+  REQUIRE(rt_mod->get_numa_node() == numa::get_current_node());
+}
+
+TEST_CASE("Test RuntimeModule bound to a NUMA node moves the weights")
+{
+  WeightsComputeFunc *weights_cf = new WeightsComputeFunc();
+  ComputeFuncHolder cf(weights_cf);
+  RunOptionsHolder run_options(new RunOptions());
+  RuntimeModule rt_mod(cf, std::vector<std::string>{"x"},
+                       std::vector<std::string>{"y"}, run_options);
+  REQUIRE(!weights_cf->weights_allocator);
+
+  rt_mod.bind_numa_node(numa::get_current_node());
+  REQUIRE(dynamic_cast<NumaAllocator *>(weights_cf->weights_allocator.get()));
+  for (ssize_t i = 0; i < 4; ++i)
+    REQUIRE(((float *) weights_cf->weights->data)[i] == (float) i);
+}
+
+TEST_CASE("Test RequestScheduler evicts low priority requests on a full queue")
+{
+  std::shared_ptr<MockModel> model(new MockModel());
+  model->latency_ms = 1;
+  RtModHolder rt_mod = get_model_rt_mod(model);
+  SchedulerOptions options;
+  options.max_queue_size = 2;
+  RequestScheduler scheduler(*rt_mod, options);
+
+  model->gate = false;
+  std::vector<std::vector<XBufferHolder>> ins, outs(5);
+  for (float i = 0; i < 5; ++i)
+    ins.push_back(get_input(i));
+  CompletionHolder running = scheduler.submit(ins[0], outs[0]);
+  while (scheduler.queue_size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  auto now = RequestScheduler::Clock::now();
+  CompletionHolder low_early = scheduler.submit(
+    ins[1], outs[1], Priority::LOW, now + std::chrono::seconds(10));
+  CompletionHolder low_late = scheduler.submit(
+    ins[2], outs[2], Priority::LOW, now + std::chrono::seconds(20));
+
+  // The low priority request with the latest deadline makes room
+  CompletionHolder high = scheduler.submit(ins[3], outs[3], Priority::HIGH);
+  REQUIRE(!high->ready());
+  REQUIRE(low_late->ready());
+  REQUIRE_THROWS_AS(low_late->wait(), RequestRejected);
+
+  // Low priority requests are rejected on a full queue
+  CompletionHolder low = scheduler.submit(ins[4], outs[4], Priority::LOW);
+  REQUIRE_THROWS_AS(low->wait(), RequestRejected);
+
+  // Another high priority request evicts the last low priority one
+  CompletionHolder high2 = scheduler.submit(ins[4], outs[4], Priority::HIGH);
+  REQUIRE_THROWS_AS(low_early->wait(), RequestRejected);
+
+  model->gate = true;
+  running->wait();
+  high->wait();
+  high2->wait();
+  REQUIRE(model->order == std::vector<float>{0.f, 3.f, 4.f});
+
+  SchedulerMetrics metrics = scheduler.get_metrics();
+  REQUIRE(metrics.evicted == 2);
+  REQUIRE(metrics.rejected_queue_full == 1);
+}
+
+TEST_CASE("Test RequestScheduler admission follows deadline order")
+{
+  std::shared_ptr<MockModel> model(new MockModel());
+  model->latency_ms = 20;
+  RtModHolder rt_mod = get_model_rt_mod(model);
+  RequestScheduler scheduler(*rt_mod);
+
+  std::vector<XBufferHolder> in = get_input(0), out;
+  scheduler.submit(in, out)->wait();
+
+  model->gate = false;
+  std::vector<std::vector<XBufferHolder>> ins, outs(8);
+  for (float i = 1; i < 9; ++i)
+    ins.push_back(get_input(i));
+  CompletionHolder running = scheduler.submit(ins[0], outs[0]);
+  while (scheduler.queue_size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  // Queued requests without a deadline are served after a request with a
+  //  deadline of the same priority class, so they don't count towards its
+  //  estimated completion (2 instead of 8 service times)
+  std::vector<CompletionHolder> queued;
+  for (size_t i = 1; i < 7; ++i)
+    queued.push_back(scheduler.submit(ins[i], outs[i]));
+  CompletionHolder urgent = scheduler.submit(
+    ins[7], outs[7], Priority::LOW,
+    RequestScheduler::Clock::now() + std::chrono::milliseconds(120));
+  REQUIRE(!urgent->ready());
+
+  model->gate = true;
+  running->wait();
+  urgent->wait();
+  for (auto &c : queued)
+    c->wait();
+  REQUIRE(scheduler.get_metrics().rejected_deadline == 0);
+  REQUIRE(model->order[2] == 8.f);
+}
+
+TEST_CASE("Test RequestScheduler serializes calls on a shared module that isn't reentrant")
+{
+  std::atomic<int> active{0}, max_active{0};
+  auto make_mod = [&active, &max_active]() {
+    ComputeFuncInfo cfi = get_mock_compute_func_info(
+      [&active, &max_active](FuncState state,
+                             std::vector<XBufferHolder> &in_tensors,
+                             std::vector<XBufferHolder> &out_tensors)
+    {
+      int now_active = ++active;
+      int prev = max_active;
+      while (now_active > prev && !max_active.compare_exchange_weak(prev, now_active)) {}
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      --active;
+    });
+    cfi.reentrant = false;
+    return get_mock_rt_mod(cfi);
+  };
+
+  std::vector<std::vector<XBufferHolder>> ins, outs(8);
+  for (float i = 0; i < 8; ++i)
+    ins.push_back(get_input(i));
+
+  SchedulerOptions options;
+  options.nb_workers = 4;
+  RtModHolder shared = make_mod();
+  {
+    RequestScheduler scheduler(*shared, options);
+    std::vector<CompletionHolder> cs;
+    for (size_t i = 0; i < 8; ++i)
+      cs.push_back(scheduler.submit(ins[i], outs[i]));
+    for (auto &c : cs)
+      c->wait();
+  }
+  REQUIRE(max_active == 1);
+
+  // With a module per worker, workers don't wait on each other
+  std::vector<RtModHolder> clones;
+  std::vector<RuntimeModule *> rt_mods;
+  for (size_t i = 0; i < 4; ++i) {
+    clones.push_back(make_mod());
+    rt_mods.push_back(clones.back().get());
+  }
+  RequestScheduler scheduler(rt_mods, options);
+  std::vector<CompletionHolder> cs;
+  for (size_t i = 0; i < 8; ++i)
+    cs.push_back(scheduler.submit(ins[i], outs[i]));
+  for (auto &c : cs)
+    c->wait();
+  REQUIRE(scheduler.get_metrics().completed == 8);
+}
@@ -0,0 +1,94 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/shadow_compare.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+TEST_CASE("Test float output comparison")
+{
+  std::vector<float> ref(37), data(37);
+  for (size_t i = 0; i < ref.size(); ++i)
+    ref[i] = data[i] = (float) i - 10;
+
+  OutputError err = compare_float(ref.data(), data.data(), ref.size());
+  REQUIRE(err.max_abs == 0.);
+  REQUIRE(err.cosine == Approx(1.));
+  REQUIRE(err.snr_db == 200.);
+
+  data[36] += 0.5f;
+  err = compare_float(ref.data(), data.data(), ref.size());
+  REQUIRE(err.max_abs == Approx(0.5));
+  REQUIRE(err.cosine < 1.);
+  double ref_sq = 0.;
+  for (const float &r : ref)
+    ref_sq += r * r;
+  REQUIRE(err.snr_db == Approx(10. * std::log10(ref_sq / 0.25)));
+
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = -ref[i];
+  REQUIRE(compare_float(ref.data(), data.data(), ref.size()).cosine == Approx(-1.));
+}
+
+TEST_CASE("Test ShadowComparator on sampled requests")
+{
+  // Reference computing the exact result, the primary adds an offset
+  ShadowComparator comparator([](std::vector<XBufferHolder> &in,
+                                 std::vector<XBufferHolder> &out) {
+    float *x = (float *) in[0]->data;
+    if (x[0] < 0)
+      throw std::runtime_error("negative input");
+    for (ssize_t i = 0; i < in[0]->size; ++i)
+      ((float *) out[0]->data)[i] = 2 * x[i];
+  }, 2);
+
+  std::vector<ssize_t> shape = {1, 16};
+  for (int r = 0; r < 6; ++r) {
+    std::vector<XBufferHolder> in{create_buffer(shape)}, out{create_buffer(shape)};
+    for (ssize_t i = 0; i < 16; ++i) {
+      ((float *) in[0]->data)[i] = (float) (r + i);
+      ((float *) out[0]->data)[i] = 2 * (r + i) + 0.25f;
+    }
+    comparator.sample(in, out);
+    comparator.flush();
+  }
+
+  ComparisonStats stats = comparator.get_stats();
+  REQUIRE(stats.sampled == 3);
+  REQUIRE(stats.dropped == 0);
+  REQUIRE(stats.failed == 0);
+  REQUIRE(stats.outputs.size() == 1);
+  REQUIRE(stats.outputs[0].count == 3);
+  REQUIRE(stats.outputs[0].max_abs == Approx(0.25));
+  REQUIRE(stats.outputs[0].mean_cosine() == Approx(1.).epsilon(1e-3));
+  REQUIRE(stats.outputs[0].mean_snr_db() > 20.);
+
+  // Reference failures are counted
+  std::vector<XBufferHolder> in{create_buffer(shape)}, out{create_buffer(shape)};
+  ((float *) in[0]->data)[0] = -1.f;
+  comparator.sample(in, out);
+  comparator.flush();
+  REQUIRE(comparator.get_stats().failed == 1);
+}
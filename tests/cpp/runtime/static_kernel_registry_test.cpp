@@ -0,0 +1,107 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/graph/xlayer.hpp"
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/kernel_func_factory.hpp"
+#include "pyxir/runtime/static_kernel_registry.hpp"
+
+using namespace pyxir;
+using namespace pyxir::graph;
+using namespace pyxir::runtime;
+
+static XBufferHolder wrap(std::vector<float> &v, std::vector<ssize_t> shape)
+{
+  return XBufferHolder(new XBuffer((void *) &v[0], 4, "f", shape.size(), shape,
+                                   false, false));
+}
+
+TEST_CASE("Test static kernel registry lookup")
+{
+  std::vector<std::string> op_types = StaticKernelRegistry::GetOpTypes();
+  REQUIRE(op_types.size() >= 4);
+  for (const std::string &op_type : op_types) {
+    const StaticKernelEntry *entry = StaticKernelRegistry::Find(op_type);
+    REQUIRE(entry != nullptr);
+    REQUIRE(entry->op_type == op_type);
+    REQUIRE(entry->create != nullptr);
+    REQUIRE(entry->invoke != nullptr);
+  }
+  REQUIRE(StaticKernelRegistry::Find("Input") != nullptr);
+  REQUIRE(StaticKernelRegistry::Find("Softmax") != nullptr);
+  REQUIRE(StaticKernelRegistry::Find("Conv2D") == nullptr);
+}
+
+TEST_CASE("Test static kernel dispatch matches virtual dispatch")
+{
+  XLayerHolder X(new XLayer("sm", std::vector<std::string>{"Softmax"}));
+  X->set_attr("axis", XAttr("axis", -1));
+
+  const StaticKernelEntry *entry = StaticKernelRegistry::Find("Softmax");
+  std::unique_ptr<KernelFunc> kf(entry->create(X));
+  KernelFuncHolder ref_kf = KernelFuncFactory::GetKernelFunc("cpu.Softmax", X);
+
+  std::vector<float> x = {1.f, 2.f, 3.f, -1.f, 0.f, 4.f};
+  std::vector<XBufferHolder> in {wrap(x, {2, 3})};
+  std::vector<XBufferHolder> out;
+  std::vector<XBufferHolder> ref_out;
+  entry->invoke(kf.get(), in, out);
+  invoke_virtual_kernel(ref_kf.get(), in, ref_out);
+
+  REQUIRE(out.size() == 1);
+  REQUIRE(out[0]->shape == ref_out[0]->shape);
+  float *y = (float *) out[0]->data;
+  float *ref_y = (float *) ref_out[0]->data;
+  for (size_t i = 0; i < x.size(); ++i)
+    REQUIRE(y[i] == ref_y[i]);
+}
+
+TEST_CASE("Test static kernel dispatch of identity kernels")
+{
+  XLayerHolder X(new XLayer("x", std::vector<std::string>{"Input"}));
+  const StaticKernelEntry *entry = StaticKernelRegistry::Find("Input");
+  std::unique_ptr<KernelFunc> kf(entry->create(X));
+
+  std::vector<float> x = {1.f, 2.f, 3.f};
+  std::vector<XBufferHolder> in {wrap(x, {1, 3})};
+  std::vector<XBufferHolder> out;
+  entry->invoke(kf.get(), in, out);
+
+  REQUIRE(out.size() == 1);
+  REQUIRE(((float *) out[0]->data)[2] == 3.f);
+}
+
+TEST_CASE("Test kernel func factory falls back to built-in kernels")
+{
+  REQUIRE(!KernelFuncFactory::IsRegistered("cpu.Softmax"));
+  REQUIRE(KernelFuncFactory::Exists("cpu.Softmax"));
+  REQUIRE(!KernelFuncFactory::Exists("Softmax"));
+  REQUIRE(!KernelFuncFactory::Exists("cpu.Conv2D"));
+
+  XLayerHolder X(new XLayer("x", std::vector<std::string>{"Input"}));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.Input", X);
+  REQUIRE(kf != nullptr);
+  REQUIRE_THROWS_AS(KernelFuncFactory::GetKernelFunc("cpu.Conv2D", X),
+                    std::runtime_error);
+}
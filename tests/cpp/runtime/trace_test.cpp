@@ -0,0 +1,287 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/trace_replay.hpp"
+
+#include "mock_rt_mod.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+RtModHolder get_scale_rt_mod(float factor,
+                             RunOptionsHolder run_options = RunOptionsHolder(new RunOptions()))
+{
+  return get_mock_rt_mod([factor](FuncState state,
+                                  std::vector<XBufferHolder> &in_tensors,
+                                  std::vector<XBufferHolder> &out_tensors)
+  {
+    XBufferHolder in = ascontiguous(in_tensors[0]);
+    for (ssize_t i = 0; i < in->size; ++i)
+      ((float *) out_tensors[0]->data)[i] = ((float *) in->data)[i] * factor;
+  }, run_options);
+}
+
+XBufferHolder get_buffer(std::vector<ssize_t> shape, float offset)
+{
+  XBufferHolder xb = create_buffer(shape);
+  for (ssize_t i = 0; i < xb->size; ++i)
+    ((float *) xb->data)[i] = offset + i;
+  return xb;
+}
+
+} // namespace
+
+TEST_CASE("Test trace capture and replay")
+{
+  std::string path = "trace_test.pxtrace";
+  RtModHolder rt_mod = get_scale_rt_mod(2.f);
+  TraceOptions options;
+  options.capture_outputs = true;
+  rt_mod->start_capture(path, options);
+
+  for (int r = 0; r < 4; ++r) {
+    std::vector<XBufferHolder> in{get_buffer({1, 2 + r}, (float) r)};
+    std::vector<XBufferHolder> out{create_buffer(in[0]->shape)};
+    rt_mod->execute(in, out);
+  }
+  // Strided inputs are captured packed
+  std::vector<XBufferHolder> in{select(get_buffer({4, 3}, 0.f), 1, 1)};
+  std::vector<XBufferHolder> out{create_buffer(in[0]->shape)};
+  rt_mod->execute(in, out);
+  REQUIRE(rt_mod->get_capture()->nb_records() == 5);
+  REQUIRE(rt_mod->get_capture()->nb_dropped() == 0);
+  rt_mod->stop_capture();
+  REQUIRE(!rt_mod->get_capture());
+
+  TraceReader reader(path);
+  TraceRecord record;
+  for (int r = 0; r < 4; ++r) {
+    REQUIRE(reader.next(record));
+    REQUIRE(record.inputs.size() == 1);
+    REQUIRE(record.outputs.size() == 1);
+    REQUIRE(record.inputs[0]->shape == std::vector<ssize_t>{1, 2 + r});
+    REQUIRE(((float *) record.inputs[0]->data)[1] == r + 1.f);
+    REQUIRE(((float *) record.outputs[0]->data)[1] == 2 * (r + 1.f));
+    REQUIRE(record.latency_us >= 0.);
+  }
+  REQUIRE(reader.next(record));
+  REQUIRE(record.inputs[0]->shape == std::vector<ssize_t>{4});
+  REQUIRE(((float *) record.inputs[0]->data)[3] == 10.f);
+  REQUIRE(!reader.next(record));
+
+  // Replay against the same and a different build
+  ReplayOptions replay_options;
+  replay_options.speedup = 0.;
+  ReplayStats stats = replay_trace(*rt_mod, path, replay_options);
+  REQUIRE(stats.requests == 5);
+  REQUIRE(stats.failed == 0);
+  REQUIRE(stats.mismatches == 0);
+  REQUIRE(stats.latency.count == 5);
+  REQUIRE(stats.recorded_latency.count == 5);
+
+  RtModHolder other_rt_mod = get_scale_rt_mod(3.f);
+  stats = replay_trace(*other_rt_mod, path, replay_options);
+  REQUIRE(stats.mismatches == 5);
+  REQUIRE(stats.max_abs_diff == Approx(10.f));
+
+  std::remove(path.c_str());
+  REQUIRE_THROWS_AS(TraceReader(path.c_str()), std::runtime_error);
+}
+
+TEST_CASE("Test trace capture through run options and async execution")
+{
+  std::string path = "trace_test_async.pxtrace";
+  RunOptionsHolder run_options(new RunOptions());
+  run_options->trace_path = path;
+  RtModHolder rt_mod = get_scale_rt_mod(2.f, run_options);
+  REQUIRE(rt_mod->get_capture());
+  // Every module captures to its own file
+  RtModHolder other_rt_mod = get_scale_rt_mod(2.f, run_options);
+  std::string other_path = other_rt_mod->get_capture()->path();
+  path = rt_mod->get_capture()->path();
+  REQUIRE(path.find("trace_test_async.pxtrace.") == 0);
+  REQUIRE(path != other_path);
+  other_rt_mod.reset();
+  std::remove(other_path.c_str());
+
+  std::vector<XBufferHolder> in{get_buffer({1, 4}, 1.f)};
+  std::vector<XBufferHolder> out{create_buffer(in[0]->shape)};
+  rt_mod->execute_async(in, out)->wait();
+  rt_mod->stop_capture();
+
+  TraceReader reader(path);
+  TraceRecord record;
+  REQUIRE(reader.next(record));
+  REQUIRE(record.outputs.empty());
+  REQUIRE(((float *) record.inputs[0]->data)[3] == 4.f);
+  REQUIRE(!reader.next(record));
+
+  // Outputs are allocated from the given shapes if they weren't captured
+  ReplayOptions replay_options;
+  replay_options.out_shapes = {{1, 4}};
+  ReplayStats stats = replay_trace(*rt_mod, path, replay_options);
+  REQUIRE(stats.requests == 1);
+  REQUIRE(stats.failed == 0);
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Test trace capture drops records exceeding the pending bytes")
+{
+  std::string path = "trace_test_drop.pxtrace";
+  TraceOptions options;
+  options.max_pending_bytes = 256;
+  std::unique_ptr<TraceWriter> writer(new TraceWriter(path, options));
+  std::vector<XBufferHolder> small{get_buffer({1, 4}, 0.f)};
+  std::vector<XBufferHolder> large{get_buffer({1, 256}, 0.f)};
+  std::vector<XBufferHolder> out;
+  TraceWriter::Clock::time_point start = TraceWriter::Clock::now();
+  writer->record(large, out, start, 0.);
+  writer->record(small, out, start, 0.);
+  writer->flush();
+  REQUIRE(writer->nb_records() == 1);
+  REQUIRE(writer->nb_dropped() == 1);
+  writer.reset();
+
+  TraceReader reader(path);
+  TraceRecord record;
+  REQUIRE(reader.next(record));
+  REQUIRE(record.inputs[0]->shape == std::vector<ssize_t>{1, 4});
+  REQUIRE(!reader.next(record));
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Test trace replay issues requests at their recorded offsets")
+{
+  std::string path = "trace_test_offsets.pxtrace";
+  {
+    TraceWriter writer(path);
+    std::vector<XBufferHolder> in{get_buffer({1, 4}, 0.f)};
+    std::vector<XBufferHolder> out;
+    TraceWriter::Clock::time_point start = TraceWriter::Clock::now();
+    for (int r = 0; r < 3; ++r)
+      writer.record(in, out, start + std::chrono::milliseconds(r), 0.);
+    writer.flush();
+  }
+  ReplayOptions replay_options;
+  replay_options.out_shapes = {{1, 4}};
+
+  // All requests are in flight together, later requests don't wait for the
+  //  completion of earlier ones
+  std::shared_ptr<std::atomic<int>> started(new std::atomic<int>(0));
+  std::shared_ptr<std::atomic<bool>> overlapped(new std::atomic<bool>(true));
+  RtModHolder rt_mod = get_mock_rt_mod([started, overlapped](
+    FuncState state, std::vector<XBufferHolder> &in_tensors,
+    std::vector<XBufferHolder> &out_tensors)
+  {
+    ++*started;
+    std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (*started < 3 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (*started < 3)
+      *overlapped = false;
+  });
+  replay_options.concurrency = 3;
+  ReplayStats stats = replay_trace(*rt_mod, path, replay_options);
+  REQUIRE(stats.requests == 3);
+  REQUIRE(stats.failed == 0);
+  REQUIRE(*overlapped);
+
+  // Without a free execution slot, requests queue and their latency
+  //  includes the time they waited
+  RtModHolder slow_rt_mod = get_mock_rt_mod([](
+    FuncState state, std::vector<XBufferHolder> &in_tensors,
+    std::vector<XBufferHolder> &out_tensors)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  });
+  replay_options.concurrency = 1;
+  stats = replay_trace(*slow_rt_mod, path, replay_options);
+  REQUIRE(stats.latency.count == 3);
+  REQUIRE(stats.latency.max_us >= 140000.);
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Test trace replay restores the arrival order of records")
+{
+  // Records are written at completion, the first record arrived last
+  std::string path = "trace_test_order.pxtrace";
+  {
+    TraceWriter writer(path);
+    std::vector<XBufferHolder> out;
+    TraceWriter::Clock::time_point start = TraceWriter::Clock::now();
+    const int arrival_ms[] = {60, 0, 30};
+    for (int r = 0; r < 3; ++r) {
+      std::vector<XBufferHolder> in{get_buffer({1, 4}, (float) r)};
+      writer.record(in, out,
+                    start + std::chrono::milliseconds(arrival_ms[r]), 0.);
+    }
+    writer.flush();
+  }
+
+  std::shared_ptr<std::vector<float>> order(new std::vector<float>());
+  RtModHolder rt_mod = get_mock_rt_mod([order](
+    FuncState state, std::vector<XBufferHolder> &in_tensors,
+    std::vector<XBufferHolder> &out_tensors)
+  {
+    order->push_back(((float *) in_tensors[0]->data)[0]);
+  });
+  ReplayOptions replay_options;
+  replay_options.out_shapes = {{1, 4}};
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  ReplayStats stats = replay_trace(*rt_mod, path, replay_options);
+  double elapsed_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+  REQUIRE(stats.requests == 3);
+  REQUIRE(*order == std::vector<float>{1.f, 2.f, 0.f});
+  // The offsets are relative to the earliest record
+  REQUIRE(elapsed_ms >= 60.);
+
+  // Without a window the records are replayed in file order
+  order->clear();
+  replay_options.reorder_window = 1;
+  replay_trace(*rt_mod, path, replay_options);
+  REQUIRE(*order == std::vector<float>{0.f, 1.f, 2.f});
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Test trace capture reports write errors")
+{
+  TraceWriter writer("/dev/full");
+  std::vector<XBufferHolder> in{get_buffer({1, 4}, 0.f)};
+  std::vector<XBufferHolder> out;
+  writer.record(in, out, TraceWriter::Clock::now(), 0.);
+  REQUIRE_THROWS_AS(writer.flush(), std::runtime_error);
+  REQUIRE(writer.failed());
+
+  writer.record(in, out, TraceWriter::Clock::now(), 0.);
+  REQUIRE(writer.nb_records() == 1);
+  REQUIRE(writer.nb_dropped() == 1);
+}
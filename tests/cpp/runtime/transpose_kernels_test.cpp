@@ -0,0 +1,259 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/graph/xlayer.hpp"
+#include "pyxir/common/xbuffer.hpp"
+#include "pyxir/runtime/kernel_func_factory.hpp"
+
+using namespace pyxir;
+using namespace pyxir::graph;
+using namespace pyxir::runtime;
+
+template <typename T>
+static XBufferHolder wrap(std::vector<T> &v, std::vector<ssize_t> shape,
+                          const std::string &format)
+{
+  return XBufferHolder(new XBuffer((void *) &v[0], sizeof(T), format,
+                                   shape.size(), shape, false, false));
+}
+
+static KernelFuncHolder get_transpose(std::vector<int64_t> axes,
+                                      std::vector<int64_t> out_shape)
+{
+  XLayerHolder X(new XLayer("t", std::vector<std::string>{"Transpose"}));
+  X->shapes = {out_shape};
+  X->set_attr("axes", XAttr("axes", axes));
+  return KernelFuncFactory::GetKernelFunc("cpu.Transpose", X);
+}
+
+// Reference transpose of a contiguous 4D tensor
+template <typename T>
+static std::vector<T> ref_transpose(const std::vector<T> &x,
+                                    std::vector<ssize_t> s,
+                                    std::vector<int64_t> axes)
+{
+  std::vector<T> res(x.size());
+  std::vector<ssize_t> os {s[axes[0]], s[axes[1]], s[axes[2]], s[axes[3]]};
+  ssize_t idx[4];
+  size_t o = 0;
+  for (idx[0] = 0; idx[0] < os[0]; ++idx[0])
+    for (idx[1] = 0; idx[1] < os[1]; ++idx[1])
+      for (idx[2] = 0; idx[2] < os[2]; ++idx[2])
+        for (idx[3] = 0; idx[3] < os[3]; ++idx[3]) {
+          ssize_t in_idx[4];
+          for (int i = 0; i < 4; ++i)
+            in_idx[axes[i]] = idx[i];
+          res[o++] = x[((in_idx[0] * s[1] + in_idx[1]) * s[2] + in_idx[2]) * s[3]
+                       + in_idx[3]];
+        }
+  return res;
+}
+
+TEST_CASE("Test Transpose kernel func NCHW to NHWC")
+{
+  std::vector<ssize_t> shape {2, 3, 5, 7};
+  std::vector<float> x(2 * 3 * 5 * 7);
+  for (size_t i = 0; i < x.size(); ++i)
+    x[i] = (float) i;
+  KernelFuncHolder kf = get_transpose({0, 2, 3, 1}, {-1, 5, 7, 3});
+
+  std::vector<XBufferHolder> in {wrap(x, shape, "f")};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{2, 5, 7, 3});
+  REQUIRE(out[0]->format == "f");
+  std::vector<float> ref = ref_transpose(x, shape, {0, 2, 3, 1});
+  float *y = (float *) out[0]->data;
+  for (size_t i = 0; i < ref.size(); ++i)
+    REQUIRE(y[i] == ref[i]);
+}
+
+TEST_CASE("Test Transpose kernel func with varying batch sizes")
+{
+  KernelFuncHolder kf = get_transpose({0, 3, 1, 2}, {-1, 3, 4, 2});
+
+  for (ssize_t batch : {1, 3, 0, 2}) {
+    std::vector<ssize_t> shape {batch, 4, 2, 3};
+    std::vector<float> x(batch * 24 + 1);
+    for (size_t i = 0; i < x.size(); ++i)
+      x[i] = (float) i;
+
+    std::vector<XBufferHolder> in {wrap(x, shape, "f")};
+    std::vector<XBufferHolder> out;
+    (*kf)(in, out);
+
+    REQUIRE(out[0]->shape == std::vector<ssize_t>{batch, 3, 4, 2});
+    x.pop_back();
+    std::vector<float> ref = ref_transpose(x, shape, {0, 3, 1, 2});
+    float *y = (float *) out[0]->data;
+    for (size_t i = 0; i < ref.size(); ++i)
+      REQUIRE(y[i] == ref[i]);
+  }
+}
+
+TEST_CASE("Test Transpose kernel func dtypes and generic permutations")
+{
+  std::vector<ssize_t> shape {2, 3, 4, 5};
+  std::vector<int64_t> axes {3, 1, 0, 2};
+  KernelFuncHolder kf = get_transpose(axes, {5, 3, 2, 4});
+
+  std::vector<int8_t> x8(120);
+  std::vector<uint16_t> x16(120);
+  std::vector<int32_t> x32(120);
+  for (size_t i = 0; i < 120; ++i) {
+    x8[i] = (int8_t) (i - 60);
+    x16[i] = (uint16_t) (i * 3);
+    x32[i] = (int32_t) (i * 1000);
+  }
+
+  std::vector<XBufferHolder> in8 {wrap(x8, shape, "b")};
+  std::vector<XBufferHolder> in16 {wrap(x16, shape, "e")};
+  std::vector<XBufferHolder> in32 {wrap(x32, shape, "i")};
+  std::vector<XBufferHolder> out8, out16, out32;
+  (*kf)(in8, out8);
+  (*kf)(in16, out16);
+  (*kf)(in32, out32);
+
+  REQUIRE(out8[0]->itemsize == 1);
+  REQUIRE(out16[0]->format == "e");
+  REQUIRE(out32[0]->shape == std::vector<ssize_t>{5, 3, 2, 4});
+  std::vector<int8_t> ref8 = ref_transpose(x8, shape, axes);
+  std::vector<uint16_t> ref16 = ref_transpose(x16, shape, axes);
+  std::vector<int32_t> ref32 = ref_transpose(x32, shape, axes);
+  for (size_t i = 0; i < 120; ++i) {
+    REQUIRE(((int8_t *) out8[0]->data)[i] == ref8[i]);
+    REQUIRE(((uint16_t *) out16[0]->data)[i] == ref16[i]);
+    REQUIRE(((int32_t *) out32[0]->data)[i] == ref32[i]);
+  }
+}
+
+TEST_CASE("Test Transpose kernel func 64 bit and other element types")
+{
+  std::vector<ssize_t> shape {2, 3, 4, 1};
+  std::vector<int64_t> axes {2, 0, 1, 3};
+  KernelFuncHolder kf = get_transpose(axes, {4, 2, 3, 1});
+
+  std::vector<double> xd(24);
+  std::vector<int64_t> xl(24);
+  std::vector<int16_t> xh(24);
+  for (size_t i = 0; i < 24; ++i) {
+    xd[i] = i * 0.5;
+    xl[i] = (int64_t) i << 40;
+    xh[i] = (int16_t) (i - 12);
+  }
+  std::vector<XBufferHolder> ind {wrap(xd, shape, "d")};
+  std::vector<XBufferHolder> inl {wrap(xl, shape, "q")};
+  std::vector<XBufferHolder> inh {wrap(xh, shape, "h")};
+  std::vector<XBufferHolder> outd, outl, outh;
+  (*kf)(ind, outd);
+  (*kf)(inl, outl);
+  (*kf)(inh, outh);
+
+  REQUIRE(outd[0]->format == "d");
+  REQUIRE(outl[0]->format == "q");
+  REQUIRE(outh[0]->format == "h");
+  std::vector<double> refd = ref_transpose(xd, shape, axes);
+  std::vector<int64_t> refl = ref_transpose(xl, shape, axes);
+  std::vector<int16_t> refh = ref_transpose(xh, shape, axes);
+  for (size_t i = 0; i < 24; ++i) {
+    REQUIRE(((double *) outd[0]->data)[i] == refd[i]);
+    REQUIRE(((int64_t *) outl[0]->data)[i] == refl[i]);
+    REQUIRE(((int16_t *) outh[0]->data)[i] == refh[i]);
+  }
+}
+
+TEST_CASE("Test Transpose kernel func into provided output")
+{
+  std::vector<float> x {1.f, 2.f, 3.f, 4.f, 5.f, 6.f};
+  KernelFuncHolder kf = get_transpose({1, 0}, {3, 2});
+
+  std::vector<float> y(6, 0.f);
+  std::vector<XBufferHolder> in {wrap(x, {2, 3}, "f")};
+  std::vector<XBufferHolder> out {wrap(y, {3, 2}, "f")};
+  (*kf)(in, out);
+
+  REQUIRE(y == std::vector<float>{1.f, 4.f, 2.f, 5.f, 3.f, 6.f});
+}
+
+TEST_CASE("Test Transpose kernel func with rank above the specialised plans")
+{
+  std::vector<ssize_t> shape {2, 1, 3, 2, 2, 3, 2};
+  std::vector<int64_t> axes {6, 2, 0, 5, 1, -3, 3};
+  std::vector<ssize_t> out_shape {2, 3, 2, 3, 1, 2, 2};
+  KernelFuncHolder kf = get_transpose(axes, {2, 3, 2, 3, 1, 2, 2});
+
+  std::vector<int32_t> x(144);
+  for (size_t i = 0; i < x.size(); ++i)
+    x[i] = (int32_t) i;
+  std::vector<XBufferHolder> in {wrap(x, shape, "i")};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+  REQUIRE(out[0]->shape == out_shape);
+
+  // Reference walking the output in order
+  std::vector<ssize_t> in_strides(7, 1);
+  for (int i = 5; i >= 0; --i)
+    in_strides[i] = in_strides[i + 1] * shape[i + 1];
+  std::vector<ssize_t> idx(7, 0);
+  for (size_t o = 0; o < x.size(); ++o) {
+    ssize_t offset = 0;
+    for (int i = 0; i < 7; ++i)
+      offset += idx[i] * in_strides[(axes[i] + 7) % 7];
+    REQUIRE(((int32_t *) out[0]->data)[o] == x[offset]);
+    for (int k = 6; k >= 0 && ++idx[k] == out_shape[k]; --k)
+      idx[k] = 0;
+  }
+
+  // Strided outputs are written in place
+  std::vector<ssize_t> parent_shape {2, 3, 2, 3, 1, 2, 4};
+  XBufferHolder parent = create_buffer(parent_shape, 4, "i");
+  std::vector<XBufferHolder> strided_out {
+    create_view(parent, parent->data, out_shape, parent->strides)};
+  (*kf)(in, strided_out);
+  for (ssize_t i = 0; i < 72; ++i)
+    REQUIRE(((int32_t *) parent->data)[(i / 2) * 4 + i % 2]
+            == ((int32_t *) out[0]->data)[i]);
+}
+
+TEST_CASE("Test TupleGetItem kernel func with transpose")
+{
+  XLayerHolder X(new XLayer("tgi", std::vector<std::string>{"TupleGetItem"}));
+  X->shapes = {{1, 3, 2}};
+  X->set_attr("index", XAttr("index", 1));
+  X->set_attr("transpose", XAttr("transpose", true));
+  X->set_attr("axes", XAttr("axes", std::vector<int64_t>{0, 2, 1}));
+  KernelFuncHolder kf = KernelFuncFactory::GetKernelFunc("cpu.TupleGetItem", X);
+
+  std::vector<float> a {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+  std::vector<float> b {1.f, 2.f, 3.f, 4.f, 5.f, 6.f};
+  std::vector<XBufferHolder> in {wrap(a, {1, 2, 3}, "f"), wrap(b, {1, 2, 3}, "f")};
+  std::vector<XBufferHolder> out;
+  (*kf)(in, out);
+
+  REQUIRE(out[0]->shape == std::vector<ssize_t>{1, 3, 2});
+  float *y = (float *) out[0]->data;
+  REQUIRE(std::vector<float>(y, y + 6)
+          == std::vector<float>{1.f, 4.f, 2.f, 5.f, 3.f, 6.f});
+}
@@ -0,0 +1,141 @@
+/*
+ *  Copyright 2020 Xilinx Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <memory>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "pyxir/runtime/compute_func.hpp"
+#include "pyxir/runtime/runtime_module.hpp"
+
+using namespace pyxir;
+using namespace pyxir::runtime;
+
+namespace {
+
+/** @brief Compute func recording the input shapes it was called with */
+class RecordingComputeFunc : public IComputeFunc {
+
+  public:
+    RecordingComputeFunc(std::vector<std::vector<ssize_t>> &calls,
+                         bool allow_iterations = true,
+                         std::vector<std::vector<ssize_t>> in_shapes =
+                           std::vector<std::vector<ssize_t>>())
+      : calls_(calls), allow_iterations_(allow_iterations),
+        in_shapes_(in_shapes) {}
+
+    std::string get_type() { return "recording_compute_func"; }
+
+    void operator()(std::vector<XBufferHolder> &in_tensors,
+                    std::vector<XBufferHolder> &out_tensors)
+    {
+      calls_.push_back(in_tensors[0]->shape);
+    }
+
+    bool warmup() { return allow_iterations_; }
+
+    std::vector<std::vector<ssize_t>> get_in_shapes() { return in_shapes_; }
+
+    void serialize_px(PxOStringStream &pstream) {}
+
+    void deserialize_px(PxIStringStream &pstream) {}
+
+  private:
+    std::vector<std::vector<ssize_t>> &calls_;
+    bool allow_iterations_;
+    std::vector<std::vector<ssize_t>> in_shapes_;
+};
+
+RtModHolder get_rt_mod(ComputeFuncHolder cf, int warmup_iterations = 0)
+{
+  RunOptionsHolder run_options(new RunOptions());
+  run_options->warmup_iterations = warmup_iterations;
+  return RtModHolder(new RuntimeModule(cf, std::vector<std::string>{"x"},
+                                       std::vector<std::string>{"y"},
+                                       run_options));
+}
+
+} // namespace
+
+TEST_CASE("Test RuntimeModule warmup with explicit and declared shapes")
+{
+  std::vector<std::vector<ssize_t>> calls;
+  std::vector<std::vector<ssize_t>> declared = {{1, 3, 4, 4}};
+  RtModHolder rt_mod = get_rt_mod(
+    ComputeFuncHolder(new RecordingComputeFunc(calls, true, declared)));
+
+  WarmupStats stats = rt_mod->warmup(3, {{2, 8}});
+  REQUIRE(stats.iterations == 3);
+  REQUIRE(calls.size() == 3);
+  REQUIRE(calls[0] == std::vector<ssize_t>{2, 8});
+  REQUIRE(stats.total_us >= stats.prepare_us);
+
+  calls.clear();
+  stats = rt_mod->warmup();
+  REQUIRE(stats.iterations == 1);
+  REQUIRE(calls == declared);
+}
+
+TEST_CASE("Test RuntimeModule warmup with bound buffers")
+{
+  std::vector<std::vector<ssize_t>> calls;
+  RtModHolder rt_mod = get_rt_mod(
+    ComputeFuncHolder(new RecordingComputeFunc(calls)));
+  REQUIRE_THROWS_AS(rt_mod->warmup(), std::invalid_argument);
+
+  std::vector<ssize_t> shape = {1, 4096};
+  XBufferHolder in = create_buffer(shape);
+  ((float *) in->data)[5] = 3.f;
+  rt_mod->bind_inputs({in});
+  rt_mod->bind_outputs({create_buffer(shape)});
+  REQUIRE(rt_mod->warmup(2).iterations == 2);
+  REQUIRE(calls.size() == 2);
+  REQUIRE(calls[0] == shape);
+  // Pre-faulting preserves the buffer contents
+  REQUIRE(((float *) in->data)[5] == 3.f);
+}
+
+TEST_CASE("Test RuntimeModule warmup through run options")
+{
+  std::vector<std::vector<ssize_t>> calls;
+  std::vector<std::vector<ssize_t>> declared = {{1, 16}};
+  RtModHolder rt_mod = get_rt_mod(
+    ComputeFuncHolder(new RecordingComputeFunc(calls, true, declared)), 2);
+  REQUIRE(calls.size() == 2);
+
+  // Compute funcs can refuse synthetic iterations, e.g. while calibrating
+  calls.clear();
+  RtModHolder calib_rt_mod = get_rt_mod(
+    ComputeFuncHolder(new RecordingComputeFunc(calls, false, declared)), 2);
+  REQUIRE(calls.empty());
+  REQUIRE(calib_rt_mod->warmup(2).iterations == 0);
+}
+
+TEST_CASE("Test RuntimeModule warmup through the input stage")
+{
+  std::vector<std::vector<ssize_t>> calls;
+  std::vector<std::vector<ssize_t>> declared = {{1, 3, 4, 6}};
+  RtModHolder rt_mod = get_rt_mod(
+    ComputeFuncHolder(new RecordingComputeFunc(calls, true, declared)));
+  rt_mod->set_input_stage(InputStageOptions());
+
+  // uint8 NHWC frames are synthesized and preprocessed into network inputs
+  REQUIRE(rt_mod->warmup(2).iterations == 2);
+  REQUIRE(calls.size() == 2);
+  REQUIRE(calls[0] == declared[0]);
+}
@@ -0,0 +1,66 @@
+# Copyright 2020 Xilinx Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+"""Module for testing the native MSE threshold search"""
+
+import unittest
+import numpy as np
+
+from pyxir.quantization.mse_quantization.threshold_search import \
+    search_mse_thresholds
+
+
+def quantize_unquantize(x, th):
+    return np.round(np.clip(x, -th, th) * (127. / th)) * (th / 127.)
+
+
+def MSE(x1, x2):
+    return ((x1 - x2)**2).mean()
+
+
+class TestThresholdSearch(unittest.TestCase):
+
+    def test_per_channel_and_per_tensor(self):
+        W = np.reshape(
+            np.array([[[1, 1], [0, 1]], [[3, 4], [-1, 0]]], dtype=np.float32),
+            (2, 1, 2, 2))
+        x = np.array([[0.5, -2., 1., 0.25]], dtype=np.float32)
+
+        th_W, th_x = search_mse_thresholds([W, x], axes=[0, None])
+
+        np.testing.assert_array_equal(th_W, np.array([1., 4.]))
+        assert th_x.shape == (1,)
+        assert th_x[0] == 2.
+
+    def test_outliers_are_clipped(self):
+        np.random.seed(0)
+        x = np.random.normal(size=(4, 8, 16, 16)).astype(np.float32)
+        x[0, 0, 0, 0] = 40.
+
+        th = search_mse_thresholds([x], nb_candidates=200)[0][0]
+
+        assert th < 40.
+        candidates = [40. * k / 200 for k in range(1, 201)]
+        best_mse = min([MSE(quantize_unquantize(x, c), x)
+                        for c in candidates])
+        assert MSE(quantize_unquantize(x, th), x) <= 1.01 * best_mse
+
+    def test_invalid_axes(self):
+        with self.assertRaises(ValueError):
+            search_mse_thresholds([np.ones((2, 2))], axes=[0, 1])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python
+#
+# Copyright 2020 Xilinx Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+"""
+Module for testing the native quantization simulation layers of the pyxir
+numpy runtime
+"""
+
+import unittest
+import numpy as np
+
+from pyxir.shapes import TensorShape
+from pyxir.runtime.numpy.rt_layer_np import *
+
+
+class TestRtLayerNPQuant(unittest.TestCase):
+
+    def test_quantize_layer(self):
+        X = QuantizeLayer(
+            name='q',
+            shape=TensorShape([1, 2, 3, 3]),
+            dtype='int8',
+            inputs=['x'],
+            input_shapes=[TensorShape([1, 2, 3, 3])],
+            subgraph=None,
+            input_types=['float32'],
+            threshold=[1., 2.5],
+            axis=1,
+            bitwidth=8,
+            do_rounding=True
+        )
+
+        x = np.random.uniform(-4., 4., (1, 2, 3, 3)).astype(np.float32)
+        th = np.array([1., 2.5]).reshape(1, 2, 1, 1)
+        expected = np.round(np.clip(x, -th, th).astype(np.float32)
+                            * (127. / th).astype(np.float32))
+
+        res = X.forward_exec([x])
+        assert res.dtype == np.int8
+        np.testing.assert_array_equal(res, expected.astype(np.int8))
+
+    def test_unquantize_layer(self):
+        X = UnQuantizeLayer(
+            name='uq',
+            shape=TensorShape([1, 2, 2, 2]),
+            dtype='float32',
+            inputs=['x'],
+            input_shapes=[TensorShape([1, 2, 2, 2])],
+            subgraph=None,
+            input_types=['int8'],
+            threshold=[2.],
+            axis=1,
+            bitwidth=8
+        )
+
+        x = np.arange(-4, 4, dtype=np.int8).reshape(1, 2, 2, 2)
+        res = X.forward_exec([x])
+        np.testing.assert_array_almost_equal(res, x * (2. / 127.))
+
+    def test_quantize_bias_layer(self):
+        X = QuantizeBiasLayer(
+            name='qb',
+            shape=TensorShape([4]),
+            dtype='int32',
+            inputs=['b'],
+            input_shapes=[TensorShape([4])],
+            subgraph=None,
+            input_types=['float32'],
+            threshold_bias=[127., 254.],
+            threshold_ext=127.,
+            bitwidth=8,
+            do_rounding=True
+        )
+
+        b = np.array([3.4, 5., -1e8, 1e8], dtype=np.float32)
+        res = X.forward_exec([b])
+        assert res.dtype == np.int32
+        np.testing.assert_array_equal(res, [3, 2, -8388607, 8388607])
+
+    def test_quantize_inter_layer(self):
+        X = QuantizeInterLayer(
+            name='qi',
+            shape=TensorShape([1, 2, 2]),
+            dtype='int8',
+            inputs=['x'],
+            input_shapes=[TensorShape([1, 2, 2])],
+            subgraph=None,
+            prescale_shift=[0, 0],
+            scale=[3, 5],
+            postscale_shift=[2, 3],
+            axis=1,
+            bitwidth=8,
+            relu=True
+        )
+
+        x = np.array([100., -100., 1000., 7.9], dtype=np.float32)\
+            .reshape(1, 2, 2)
+        res = X.forward_exec([x])
+        # ((x * scale) >> (shift - 1) + 1) >> 1, saturated and rectified
+        np.testing.assert_array_equal(res.reshape(-1), [75, 0, 127, 4])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,159 @@
+# Copyright 2020 Xilinx Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+""" Module for testing the ArtifactStore and partition fingerprints """
+
+import os
+import unittest
+import tempfile
+
+import numpy as np
+
+# ! Important for device registration
+import pyxir as px
+
+from pyxir.graph.xgraph_factory import XGraphFactory
+from pyxir.shared.compiler_output import CompilerOutput
+from pyxir.shared.artifact_store import ArtifactStore, fingerprint_layers,\
+    fingerprint_inputs, fingerprint_files, relocate
+
+
+class TestArtifactStore(unittest.TestCase):
+
+    xgraph_factory = XGraphFactory()
+
+    def _get_layers(self, weight=1.):
+        x1 = px.ops.input("in1", shape=[1, 1, 4, 4])
+        w1 = px.ops.constant(
+            "weight", np.full((2, 1, 2, 2), weight, dtype=np.float32))
+        conv = px.ops.conv2d(
+            op_name="conv1",
+            input_layer=x1,
+            weights_layer=w1,
+            kernel_size=[2, 2],
+        )
+        xgraph = TestArtifactStore.xgraph_factory.build_from_xlayer(
+            [x1, conv])
+        return xgraph.get_layers()
+
+    def test_fingerprint_layers(self):
+        fp = fingerprint_layers(self._get_layers())
+        assert fp == fingerprint_layers(self._get_layers())
+        # Weights changed
+        assert fp != fingerprint_layers(self._get_layers(weight=2.))
+        # Structure changed
+        assert fp != fingerprint_layers(self._get_layers()[:1])
+        # Target changed
+        assert fingerprint_layers(self._get_layers(), ['DPUCZDX8G-zcu104']) !=\
+            fingerprint_layers(self._get_layers(), ['DPUCZDX8G-zcu102'])
+
+    def test_fingerprint_inputs(self):
+        a = np.ones((1, 2, 2), dtype=np.float32)
+        fp = fingerprint_inputs({'in': a})
+        assert fp == fingerprint_inputs({'in': a.copy()})
+        assert fp != fingerprint_inputs({'in': a * 2})
+        assert fp != fingerprint_inputs({'in': a.astype(np.float64)})
+        assert fp != fingerprint_inputs({'in2': a})
+
+    def test_fingerprint_files(self):
+        tmp_dir = tempfile.mkdtemp()
+        file_path = os.path.join(tmp_dir, 'q.txt')
+        with open(file_path, 'w') as f:
+            f.write('1 conv1 8 8')
+        fp = fingerprint_files([file_path])
+        assert fp == fingerprint_files([file_path])
+        with open(file_path, 'w') as f:
+            f.write('1 conv1 8 7')
+        assert fp != fingerprint_files([file_path])
+
+    def test_relocate(self):
+        c_output = CompilerOutput('net')
+        c_output.add('xp0', ['/src/build/lib.so'], {'a': 'a'}, {'b': 'b'})
+        r_output = relocate(c_output, '/src/build', '/dst/build')
+        assert r_output.get_code_files('xp0') == ['/dst/build/lib.so']
+        assert c_output.get_code_files('xp0') == ['/src/build/lib.so']
+        assert relocate({'x': ['/src/buildx', '/src/build']}, '/src/build',
+                        '/dst') == {'x': ['/src/buildx', '/dst']}
+
+    def test_save_load(self):
+        store = ArtifactStore(tempfile.mkdtemp())
+        src_dir = tempfile.mkdtemp()
+        os.makedirs(os.path.join(src_dir, 'sub'))
+        for file_name in ['meta.json', os.path.join('sub', 'net.xmodel')]:
+            with open(os.path.join(src_dir, file_name), 'w') as f:
+                f.write(file_name)
+
+        assert not store.has('key')
+        store.save('key', src_dir,
+                   {'xmodel': os.path.join(src_dir, 'sub', 'net.xmodel')})
+        assert store.has('key')
+
+        dst_dir = tempfile.mkdtemp()
+        meta = store.load('key', dst_dir)
+        assert meta == {'xmodel': os.path.join(dst_dir, 'sub', 'net.xmodel')}
+        with open(os.path.join(dst_dir, 'sub', 'net.xmodel')) as f:
+            assert f.read() == os.path.join('sub', 'net.xmodel')
+        assert os.path.isfile(os.path.join(dst_dir, 'meta.json'))
+
+        # Storing a selection of files
+        store.save('key2', src_dir, None, [os.path.join(src_dir, 'meta.json')])
+        dst_dir = tempfile.mkdtemp()
+        store.load('key2', dst_dir)
+        assert os.listdir(dst_dir) == ['meta.json']
+
+        # Files of an earlier build are removed on load
+        with open(os.path.join(dst_dir, 'stale.xmodel'), 'w') as f:
+            f.write('stale')
+        store.load('key2', dst_dir)
+        assert os.listdir(dst_dir) == ['meta.json']
+        assert not any(d.startswith('.tmp_')
+                       for d in os.listdir(os.path.dirname(dst_dir)))
+
+    def test_load_merge(self):
+        store = ArtifactStore(tempfile.mkdtemp())
+        src_dir = tempfile.mkdtemp()
+        q_file = os.path.join(src_dir, 'q', 'deploy.pb')
+        os.makedirs(os.path.dirname(q_file))
+        with open(q_file, 'w') as f:
+            f.write('deploy')
+        store.save('key', src_dir, {'q_file': q_file}, [q_file])
+
+        # Files in a shared work directory are kept
+        work_dir = tempfile.mkdtemp()
+        with open(os.path.join(work_dir, 'partition.pb'), 'w') as f:
+            f.write('partition')
+        meta = store.load('key', work_dir, merge=True)
+        assert meta == {'q_file': os.path.join(work_dir, 'q', 'deploy.pb')}
+        assert sorted(os.listdir(work_dir)) == ['partition.pb', 'q']
+        with open(meta['q_file']) as f:
+            assert f.read() == 'deploy'
+
+        # Earlier versions of the stored files are overwritten
+        with open(meta['q_file'], 'w') as f:
+            f.write('stale')
+        store.load('key', work_dir, merge=True)
+        with open(meta['q_file']) as f:
+            assert f.read() == 'deploy'
+        assert os.listdir(os.path.join(work_dir, 'q')) == ['deploy.pb']
+
+    def test_from_env(self):
+        os.environ.pop('PX_ARTIFACT_STORE', None)
+        assert ArtifactStore.from_env() is None
+        root = tempfile.mkdtemp()
+        os.environ['PX_ARTIFACT_STORE'] = root
+        try:
+            assert ArtifactStore.from_env().root == root
+        finally:
+            del os.environ['PX_ARTIFACT_STORE']
@@ -82,3 +82,59 @@ class TestXBuffer(unittest.TestCase):
             np.array([2., -1.5], dtype=np.float32))
         np.testing.assert_equal(a, np.array([1., 1.5], dtype=np.float32))
         np.testing.assert_equal(b, np.array([2., -1.5], dtype=np.float32))
+
+    def test_xbuffer_zero_copy(self):
+        a = np.array([1., 1.5], dtype=np.float32)
+        xb = XBuffer(a, copy=False)
+        assert xb.shares_memory
+
+        a[0] = 3.
+        np.testing.assert_equal(xb.to_numpy(),
+                                np.array([3., 1.5], dtype=np.float32))
+
+        # The wrapped array is kept alive by the buffer
+        b = xb.to_numpy()
+        del a
+        np.testing.assert_equal(b, np.array([3., 1.5], dtype=np.float32))
+
+    def test_xbuffer_strided_repack(self):
+        a = np.arange(12, dtype=np.float32).reshape(3, 4)
+        t = a.T
+        xb = XBuffer(t, copy=False)
+        assert xb.is_contiguous
+        assert not xb.shares_memory
+        np.testing.assert_equal(xb.to_numpy(), t)
+
+        r = a[::-1, ::2]
+        xb = XBuffer(r)
+        np.testing.assert_equal(xb.to_numpy(), r)
+
+    def test_xbuffer_dlpack(self):
+        if not hasattr(np, 'from_dlpack'):
+            raise unittest.SkipTest("numpy without DLPack support")
+        a = np.arange(6, dtype=np.int8).reshape(2, 3)
+        xb = XBuffer.from_dlpack(a)
+        assert xb.shares_memory
+        a[0, 0] = 10
+        assert xb.to_numpy()[0, 0] == 10
+        assert xb.dtype == 'int8'
+
+        c = np.from_dlpack(xb)
+        np.testing.assert_equal(c, a)
+        c[1, 2] = -1
+        assert a[1, 2] == -1
+
+    def test_xbuffer_dlpack_bfloat16(self):
+        try:
+            import torch
+        except ImportError:
+            raise unittest.SkipTest("torch not available for bfloat16 tensors")
+        t = torch.arange(6, dtype=torch.bfloat16)
+        xb = XBuffer.from_dlpack(t)
+        assert xb.shares_memory
+
+        u = torch.from_dlpack(xb)
+        assert u.dtype == torch.bfloat16
+        assert torch.equal(u, t)
+        u[0] = 10.
+        assert t[0] == 10.
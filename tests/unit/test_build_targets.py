@@ -0,0 +1,190 @@
+# Copyright 2020 Xilinx Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+"""Module for testing multi-target builds from a single calibration run"""
+
+import os
+import json
+import unittest
+import tempfile
+
+from unittest import mock
+
+import numpy as np
+import pyxir as px
+
+from pyxir.opaque_func import OpaqueFunc
+from pyxir.opaque_func_registry import OpaqueFuncRegistry
+from pyxir.shared.xbuffer import XBuffer
+from pyxir.target_registry import TargetRegistry
+from pyxir.graph.xgraph_factory import XGraphFactory
+from pyxir.shared.quantizer_output import QuantizerOutput
+
+quant_calls = []
+
+
+def xgraph_optimizer(xgraph, target=None, **kwargs):
+    return xgraph.copy()
+
+
+def _quantize(xgraph, name, work_dir):
+    quant_calls.append(name)
+    os.makedirs(work_dir, exist_ok=True)
+    q_file = os.path.join(work_dir, 'deploy_model.pb')
+    with open(q_file, 'w') as f:
+        f.write(name)
+    q_output = QuantizerOutput(name=xgraph.get_name())
+    q_output.add('xp0', q_file, q_file, q_file)
+    xgraph.set_quantizer_output(q_output)
+    return xgraph
+
+
+def shared_quantizer(xgraph, inputs_func, work_dir=None, **kwargs):
+    assert 'in' in inputs_func(0)
+    return _quantize(xgraph, 'shared', work_dir)
+
+
+def other_quantizer(xgraph, inputs_func, work_dir=None, **kwargs):
+    return _quantize(xgraph, 'other', work_dir)
+
+
+def xgraph_compiler(xgraph, work_dir, build_dir, **kwargs):
+    # The shared quantization result is compiled for every target
+    q_output = xgraph.get_quantizer_output()
+    os.makedirs(build_dir, exist_ok=True)
+    with open(os.path.join(build_dir, 'meta.json'), 'w') as f:
+        json.dump({'q_file': q_output.get_q_file('xp0')}, f)
+    return xgraph
+
+
+def xgraph_build_func(xgraph, work_dir=None, **kwargs):
+    return xgraph
+
+
+class TestBuildTargets(unittest.TestCase):
+
+    xgraph_factory = XGraphFactory()
+    target_registry = TargetRegistry()
+    targets = ['test-bt-a', 'test-bt-b', 'test-bt-c']
+
+    @classmethod
+    def setUpClass(cls):
+        for target in cls.targets:
+            quantizer = other_quantizer if target == 'test-bt-c' \
+                else shared_quantizer
+            cls.target_registry.register_target(target,
+                                                xgraph_optimizer,
+                                                quantizer,
+                                                xgraph_compiler,
+                                                xgraph_build_func)
+
+    @classmethod
+    def tearDownClass(cls):
+        for target in cls.targets:
+            cls.target_registry.unregister_target(target)
+
+    def _get_xgraph(self):
+        iX = px.ops.input('in', [1, 1, 4, 4])
+        wX = px.ops.constant('w', np.ones((2, 1, 2, 2), dtype=np.float32))
+        cX = px.ops.conv2d('conv', iX, wX, kernel_size=[2, 2])
+        return TestBuildTargets.xgraph_factory.build_from_xlayer([iX, wX, cX])
+
+    def test_quantization_key(self):
+        xgraph = self._get_xgraph()
+        assert px.get_quantization_key(xgraph, 'test-bt-a') == \
+            px.get_quantization_key(xgraph, 'test-bt-b')
+        assert px.get_quantization_key(xgraph, 'test-bt-a') != \
+            px.get_quantization_key(xgraph, 'test-bt-c')
+
+    def test_build_targets(self):
+        del quant_calls[:]
+        root = tempfile.mkdtemp()
+        build_dirs = [os.path.join(root, t + '_build')
+                      for t in TestBuildTargets.targets]
+        work_dirs = [os.path.join(root, t + '_work')
+                     for t in TestBuildTargets.targets]
+
+        def inputs_func(it):
+            return {'in': np.ones((4, 1, 4, 4), dtype=np.float32)}
+
+        report = px.build_targets(self._get_xgraph(),
+                                  TestBuildTargets.targets, inputs_func,
+                                  build_dirs, work_dirs, max_workers=3)
+
+        # One quantization per quantizer, shared by test-bt-a and test-bt-b
+        assert quant_calls == ['shared', 'other']
+        assert len([n for n in report.timings
+                    if n.startswith('quantize/')]) == 2
+        for target in TestBuildTargets.targets:
+            assert report.timings[target].deps[0].startswith('quantize/')
+        assert report.critical_path()[0].startswith('quantize/')
+
+        for target, build_dir in zip(TestBuildTargets.targets, build_dirs):
+            assert report.get(target) == build_dir
+            assert os.path.isfile(os.path.join(build_dir, 'px_model.json'))
+            with open(os.path.join(build_dir, 'meta.json')) as f:
+                meta_d = json.load(f)
+            assert meta_d['px_model'] == 'px_model.json'
+            q_work_dir = work_dirs[2] if target == 'test-bt-c' \
+                else work_dirs[0]
+            assert meta_d['q_file'] == \
+                os.path.join(q_work_dir, 'deploy_model.pb')
+
+    def test_build_targets_reuse_quantized(self):
+        del quant_calls[:]
+        root = tempfile.mkdtemp()
+        xgraph = self._get_xgraph()
+        opt_xgraph = px.optimize(xgraph, 'test-bt-a')
+        q_key = px.get_quantization_key(opt_xgraph, 'test-bt-a')
+        q_xgraph = shared_quantizer(opt_xgraph, lambda it: {'in': None},
+                                    work_dir=os.path.join(root, 'work'))
+
+        px.build_targets(xgraph, ['test-bt-b'], None,
+                         [os.path.join(root, 'b_build')],
+                         [os.path.join(root, 'b_work')],
+                         quantized={q_key: q_xgraph})
+
+        assert quant_calls == ['shared']
+        assert os.path.isfile(os.path.join(root, 'b_build', 'px_model.json'))
+
+    def test_build_targets_invalid_dirs(self):
+        with self.assertRaises(ValueError):
+            px.build_targets(self._get_xgraph(), ['test-bt-a'], None, [], [])
+
+    def test_online_quant_builds_target_with_cross_targets(self):
+        del quant_calls[:]
+        root = tempfile.mkdtemp()
+        build_dir = os.path.join(root, 'build')
+        work_dir = os.path.join(root, 'work')
+        of = OpaqueFuncRegistry.Get('pyxir.build_online_quant_rt')
+        quant_of, rt_of = OpaqueFunc(), OpaqueFunc()
+        # The CPU calibration runtime isn't needed to collect the inputs
+        with mock.patch('pyxir.base.build'):
+            of(self._get_xgraph(), 'test-bt-a', 'cpu-tf', ['in'], ['conv'],
+               build_dir, work_dir, quant_of, rt_of)
+            rt_of([XBuffer(np.ones((1, 1, 4, 4), dtype=np.float32))], [])
+
+        b_build_dir = os.path.join(root, 'build_test-bt-b')
+        quant_of(['test-bt-b'], [b_build_dir],
+                 [os.path.join(root, 'work_test-bt-b')])
+
+        # The target is built in the same DAG as the cross target, into the
+        #   build directory the runtime loads from
+        assert quant_calls == ['shared']
+        for d in [build_dir, b_build_dir]:
+            assert os.path.isfile(os.path.join(d, 'px_model.json'))
+            with open(os.path.join(d, 'meta.json')) as f:
+                assert json.load(f)['q_file'] == \
+                    os.path.join(work_dir, 'deploy_model.pb')
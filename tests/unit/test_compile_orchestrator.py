@@ -0,0 +1,389 @@
+# Copyright 2020 Xilinx Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+"""Module for testing the compile orchestrator"""
+
+import os
+import sys
+import json
+import time
+import unittest
+import tempfile
+
+from unittest import mock
+
+import numpy as np
+
+# ! Important for device registration
+import pyxir as px
+
+from pyxir.graph.xgraph_factory import XGraphFactory
+from pyxir.target_registry import TargetRegistry, register_op_support_check
+from pyxir.shared.compiler_output import CompilerOutput
+from pyxir.shared.quantizer_output import QuantizerOutput
+from pyxir.shared.artifact_store import ArtifactStore
+from pyxir.compiler.orchestrator import CompileJob, CompileOrchestrator,\
+    CompileReport, JobTiming, compile_partitions, compile_partitioned,\
+    get_partition_xgraph, get_max_workers_from_env,\
+    _get_process_fallback_reason
+from pyxir.base import _compile_and_schedule
+
+
+def sleep_job(name, duration):
+    time.sleep(duration)
+    return name
+
+
+def xgraph_build_func(xgraph):
+    raise NotImplementedError("")
+
+
+def xgraph_optimizer(xgraph):
+    raise NotImplementedError("")
+
+
+def xgraph_quantizer(xgraph):
+    raise NotImplementedError("")
+
+
+compile_calls = []
+
+
+def xgraph_compiler(xgraph, work_dir, build_dir, **kwargs):
+    subgraphs = xgraph.get_subgraph_names()
+    assert len(subgraphs) == 1
+    compile_calls.append(subgraphs[0])
+    os.makedirs(build_dir, exist_ok=True)
+    with open(os.path.join(build_dir, 'meta.json'), 'w') as f:
+        json.dump({subgraphs[0]: subgraphs[0] + '.xmodel'}, f)
+    with open(os.path.join(build_dir, subgraphs[0] + '.xmodel'), 'w') as f:
+        f.write(subgraphs[0])
+    # A file shared by all partitions
+    with open(os.path.join(build_dir, 'arch.json'), 'w') as f:
+        f.write('test')
+    xgraph.meta_attrs['compiled'] = True
+    c_output = CompilerOutput(name=xgraph.get_name())
+    c_output.add(subgraphs[0], [build_dir], {'in': 'in'}, {'out': 'out'})
+    xgraph.set_compiler_output(c_output)
+    return xgraph
+
+
+def xgraph_meta_conflict_compiler(xgraph, work_dir, build_dir, **kwargs):
+    xgraph = xgraph_compiler(xgraph, work_dir, build_dir, **kwargs)
+    with open(os.path.join(build_dir, 'meta.json'), 'w') as f:
+        json.dump({'kernel': xgraph.get_subgraph_names()[0]}, f)
+    return xgraph
+
+
+def xgraph_file_conflict_compiler(xgraph, work_dir, build_dir, **kwargs):
+    xgraph = xgraph_compiler(xgraph, work_dir, build_dir, **kwargs)
+    with open(os.path.join(build_dir, 'arch.json'), 'w') as f:
+        f.write(xgraph.get_subgraph_names()[0])
+    return xgraph
+
+
+class TestCompileOrchestrator(unittest.TestCase):
+
+    xgraph_factory = XGraphFactory()
+    target_registry = TargetRegistry()
+
+    @classmethod
+    def setUpClass(cls):
+        for target in ['test-orch', 'test-orch2']:
+            cls.target_registry.register_target(target,
+                                                xgraph_optimizer,
+                                                xgraph_quantizer,
+                                                xgraph_compiler,
+                                                xgraph_build_func)
+        cls.target_registry.register_target('test-orch-meta',
+                                            xgraph_optimizer,
+                                            xgraph_quantizer,
+                                            xgraph_meta_conflict_compiler,
+                                            xgraph_build_func)
+        cls.target_registry.register_target('test-orch-file',
+                                            xgraph_optimizer,
+                                            xgraph_quantizer,
+                                            xgraph_file_conflict_compiler,
+                                            xgraph_build_func)
+
+        @register_op_support_check('test-orch', 'Convolution')
+        def conv_op_support(X, bXs, tXs):
+            return True
+
+        @register_op_support_check('test-orch', 'Pooling')
+        def pooling_op_support(X, bXs, tXs):
+            return True
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.target_registry.unregister_target('test-orch')
+        cls.target_registry.unregister_target('test-orch2')
+        cls.target_registry.unregister_target('test-orch-meta')
+        cls.target_registry.unregister_target('test-orch-file')
+
+    def _get_partitioned_xgraph(self, weight=1.):
+        x1 = px.ops.input("in1", shape=[1, 1, 4, 4])
+        w1 = px.ops.constant("weight",
+                             np.full((2, 1, 2, 2), weight, dtype=np.float32))
+        conv = px.ops.conv2d(
+            op_name="conv1",
+            input_layer=x1,
+            weights_layer=w1,
+            kernel_size=[2, 2],
+        )
+        pool = px.ops.pool2d(
+            op_name="pool1", input_layer=conv, pool_type="Avg",
+            pool_size=[2, 2],
+        )
+        net = [x1, conv, pool]
+        xgraph = TestCompileOrchestrator.xgraph_factory.build_from_xlayer(net)
+        return px.partition(xgraph, ['test-orch'])
+
+    def _get_two_partition_xgraph(self):
+        # Partitioning keeps the largest partition only, split it in two
+        p_xgraph = self._get_partitioned_xgraph()
+        p_xgraph.get('pool1').subgraph = 'xp1'
+        assert sorted(p_xgraph.get_subgraph_names()) == ['xp0', 'xp1']
+        return p_xgraph
+
+    def test_critical_path(self):
+        report = CompileReport()
+        report.add(JobTiming('quant', 0., 2.))
+        report.add(JobTiming('a', 2., 3., ['quant']))
+        report.add(JobTiming('b', 2., 7., ['quant']))
+        report.add(JobTiming('c', 7., 8., ['a', 'b']))
+
+        assert report.critical_path() == ['quant', 'b', 'c']
+        assert report.get_critical_path_time() == 8.
+        assert report.get_wall_time() == 8.
+        assert report.get_total_time() == 9.
+
+    def test_dependencies(self):
+        jobs = [
+            CompileJob('c', sleep_job, ('c', 0.), ['a', 'b']),
+            CompileJob('a', sleep_job, ('a', 0.2)),
+            CompileJob('b', sleep_job, ('b', 0.2)),
+        ]
+        report = CompileOrchestrator(max_workers=2).run(jobs)
+
+        assert report.get('a') == 'a'
+        assert report.get('c') == 'c'
+        timings = report.timings
+        assert timings['c'].start >= timings['a'].end
+        assert timings['c'].start >= timings['b'].end
+        # a and b are independent and should overlap
+        assert timings['a'].start < timings['b'].end
+        assert timings['b'].start < timings['a'].end
+        assert report.critical_path()[-1] == 'c'
+        assert report.get_wall_time() < report.get_total_time() + 0.1
+
+    def test_invalid_dependencies(self):
+        with self.assertRaises(ValueError):
+            CompileOrchestrator(use_processes=False).run(
+                [CompileJob('a', sleep_job, ('a', 0.), ['x'])])
+
+        with self.assertRaises(ValueError):
+            CompileOrchestrator(use_processes=False).run([
+                CompileJob('a', sleep_job, ('a', 0.), ['b']),
+                CompileJob('b', sleep_job, ('b', 0.), ['a'])
+            ])
+
+    def test_process_fallback(self):
+        # Embedding hosts aren't Python interpreters, jobs run in threads
+        host = os.path.join(tempfile.mkdtemp(), 'inference_server')
+        open(host, 'w').close()
+        with mock.patch('multiprocessing.spawn.get_executable',
+                        return_value=host):
+            assert 'Python interpreter' in _get_process_fallback_reason()
+            report = CompileOrchestrator(max_workers=1).run(
+                [CompileJob('a', os.getpid)])
+        assert report.get('a') == os.getpid()
+
+        # Scripts without a main guard would run again in every worker
+        script = os.path.join(tempfile.mkdtemp(), 'script.py')
+        with open(script, 'w') as f:
+            f.write("print('side effect')\n")
+        main = sys.modules['__main__']
+        with mock.patch.object(main, '__file__', script, create=True):
+            assert 'guard' in _get_process_fallback_reason()
+            with open(script, 'w') as f:
+                f.write("if __name__ == '__main__':\n    print('main')\n")
+            assert _get_process_fallback_reason() is None
+
+    def test_partition_xgraph(self):
+        p_xgraph = self._get_partitioned_xgraph()
+        assert p_xgraph.get_subgraph_names() == ['xp0']
+
+        xp_xgraph = get_partition_xgraph(p_xgraph, 'xp0')
+        assert xp_xgraph.get_name() == 'xp0'
+        assert xp_xgraph.get_subgraph_names() == ['xp0']
+
+        other_xgraph = get_partition_xgraph(p_xgraph, 'xp1')
+        assert other_xgraph.get_subgraph_names() == []
+        assert all([X.target == 'cpu' for X in other_xgraph.get_layers()])
+        # The original XGraph is untouched
+        assert p_xgraph.get_subgraph_names() == ['xp0']
+
+    def test_compile_partitions_multi_target(self):
+        p_xgraph = self._get_partitioned_xgraph()
+        build_dir = tempfile.mkdtemp()
+
+        report = compile_partitions(p_xgraph, ['test-orch', 'test-orch2'],
+                                    work_dir=build_dir, build_dir=build_dir,
+                                    max_workers=2)
+
+        assert set(report.timings.keys()) == \
+            set(['test-orch/xp0', 'test-orch2/xp0'])
+        for target in ['test-orch', 'test-orch2']:
+            c_output = report.get(target)
+            assert list(c_output.keys()) == ['xp0']
+            assert c_output.get_code_files('xp0') == \
+                [os.path.join(build_dir, target, 'xp0')]
+            assert c_output.get_in_map('xp0') == {'in': 'in'}
+        assert len(report.critical_path()) == 1
+
+    def test_compile_partitions_default_target(self):
+        p_xgraph = self._get_partitioned_xgraph()
+        build_dir = tempfile.mkdtemp()
+
+        report = compile_partitions(p_xgraph, work_dir=build_dir,
+                                    build_dir=build_dir, use_processes=False)
+
+        assert list(report.timings.keys()) == ['test-orch/xp0']
+        assert list(report.get('test-orch').keys()) == ['xp0']
+
+    def test_compile_partitions_reuse(self):
+        store = ArtifactStore(tempfile.mkdtemp())
+        del compile_calls[:]
+
+        build_dir = tempfile.mkdtemp()
+        report = compile_partitions(self._get_partitioned_xgraph(),
+                                    work_dir=build_dir, build_dir=build_dir,
+                                    use_processes=False,
+                                    artifact_store=store)
+        assert compile_calls == ['xp0']
+        assert report.reused == []
+
+        # Unchanged partition: reuse the build directory
+        build_dir2 = tempfile.mkdtemp()
+        report = compile_partitions(self._get_partitioned_xgraph(),
+                                    work_dir=build_dir2, build_dir=build_dir2,
+                                    use_processes=False,
+                                    artifact_store=store)
+        assert compile_calls == ['xp0']
+        assert report.reused == ['test-orch/xp0']
+        p_build_dir = os.path.join(build_dir2, 'test-orch', 'xp0')
+        assert os.path.isfile(os.path.join(p_build_dir, 'meta.json'))
+        c_output, meta_diff = report.get('test-orch/xp0')
+        assert c_output.get_code_files('xp0') == [p_build_dir]
+        assert meta_diff == {'compiled': True}
+
+        # Changed weights: recompile
+        report = compile_partitions(self._get_partitioned_xgraph(weight=2.),
+                                    work_dir=build_dir2, build_dir=build_dir2,
+                                    use_processes=False,
+                                    artifact_store=store)
+        assert compile_calls == ['xp0', 'xp0']
+        assert report.reused == []
+
+    def test_compile_partitions_reuse_per_quant_key(self):
+        store = ArtifactStore(tempfile.mkdtemp())
+        q_dir = tempfile.mkdtemp()
+
+        def quantize(p_xgraph, xp0_q):
+            # The quantizer output contains the q files of every partition
+            q_output = QuantizerOutput(p_xgraph.get_name())
+            for q_key, content in [('xp0', xp0_q), ('xp1', 'xp1_q')]:
+                q_file = os.path.join(q_dir, q_key + '_quant.json')
+                with open(q_file, 'w') as f:
+                    f.write(content)
+                q_output.add(q_key, q_file, None, None)
+            p_xgraph.set_quantizer_output(q_output)
+            return p_xgraph
+
+        del compile_calls[:]
+        build_dir = tempfile.mkdtemp()
+        compile_partitions(quantize(self._get_two_partition_xgraph(), 'a'),
+                           work_dir=build_dir, build_dir=build_dir,
+                           use_processes=False, artifact_store=store)
+        assert sorted(compile_calls) == ['xp0', 'xp1']
+
+        # Changing the quantization of xp0 only recompiles xp0
+        del compile_calls[:]
+        report = compile_partitions(
+            quantize(self._get_two_partition_xgraph(), 'b'),
+            work_dir=build_dir, build_dir=build_dir, use_processes=False,
+            artifact_store=store)
+        assert compile_calls == ['xp0']
+        assert report.reused == ['test-orch/xp1']
+
+    def test_compile_partitioned(self):
+        build_dir = tempfile.mkdtemp()
+        c_xgraph = compile_partitioned(self._get_two_partition_xgraph(),
+                                       'test-orch', work_dir=build_dir,
+                                       build_dir=build_dir, max_workers=2)
+
+        assert c_xgraph.is_compiled()
+        assert c_xgraph.meta_attrs['compiled']
+        c_output = c_xgraph.get_compiler_output()
+        assert sorted(c_output.keys()) == ['xp0', 'xp1']
+        assert c_output.get_code_files('xp1') == [build_dir]
+        # The partition builds are merged into the build directory and
+        #   removed afterwards
+        for xp in ['xp0', 'xp1']:
+            with open(os.path.join(build_dir, xp + '.xmodel')) as f:
+                assert f.read() == xp
+        with open(os.path.join(build_dir, 'arch.json')) as f:
+            assert f.read() == 'test'
+        with open(os.path.join(build_dir, 'meta.json')) as f:
+            assert json.load(f) == {'xp0': 'xp0.xmodel', 'xp1': 'xp1.xmodel'}
+        assert not os.path.exists(os.path.join(build_dir, 'test-orch'))
+
+    def test_compile_partitioned_conflicts(self):
+        for target, conflict in [('test-orch-meta', 'meta.json key: kernel'),
+                                 ('test-orch-file', 'arch.json')]:
+            build_dir = tempfile.mkdtemp()
+            with self.assertRaises(ValueError) as cm:
+                compile_partitioned(self._get_two_partition_xgraph(), target,
+                                    work_dir=build_dir, build_dir=build_dir,
+                                    max_workers=2)
+            assert conflict in str(cm.exception)
+
+    def test_compile_and_schedule_partitions(self):
+        def schedule(xgraph, target, **kwargs):
+            return xgraph
+
+        build_dir = tempfile.mkdtemp()
+        del compile_calls[:]
+        with mock.patch('pyxir.base.schedule', side_effect=schedule), \
+                mock.patch('pyxir.base.save'), \
+                mock.patch.dict(os.environ, {'PX_COMPILE_WORKERS': '1'}):
+            assert get_max_workers_from_env() == 1
+            s_xgraph = _compile_and_schedule(self._get_two_partition_xgraph(),
+                                             'test-orch', build_dir, build_dir)
+        assert sorted(s_xgraph.get_compiler_output().keys()) == ['xp0', 'xp1']
+        with open(os.path.join(build_dir, 'meta.json')) as f:
+            meta_d = json.load(f)
+        assert meta_d['xp1'] == 'xp1.xmodel'
+        assert meta_d['px_model'] == 'px_model.json'
+
+        # PX_COMPILE_WORKERS=0 compiles the XGraph in a single call, which
+        #   the test compiler rejects for multiple partitions
+        with mock.patch('pyxir.base.schedule', side_effect=schedule), \
+                mock.patch('pyxir.base.save'), \
+                mock.patch.dict(os.environ, {'PX_COMPILE_WORKERS': '0'}):
+            with self.assertRaises(AssertionError):
+                _compile_and_schedule(self._get_two_partition_xgraph(),
+                                      'test-orch', build_dir, build_dir)